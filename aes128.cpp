@@ -0,0 +1,523 @@
+#include <cstring>
+#include <cstdio>
+
+#include "aes128.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// 不需要全局开启 -maes 等编译选项：用到 AES-NI 等指令的函数各自声明 target，再根据运行时检测的结果选择调用哪个版本
+#define AESNI_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+#define VAES_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1,avx2,avx512f,avx512bw,avx512vl,vaes,vpclmulqdq")))
+
+namespace
+{
+    // ===== AES-128 =====
+
+    AESNI_TARGET inline __m128i expand_step(__m128i key, __m128i gen)
+    {
+        gen = _mm_shuffle_epi32(gen, 0xff);
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, gen);
+    }
+
+    AESNI_TARGET void expand_key(const uint8_t *key, __m128i rk[11])
+    {
+        rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key));
+        rk[1] = expand_step(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+        rk[2] = expand_step(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+        rk[3] = expand_step(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+        rk[4] = expand_step(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+        rk[5] = expand_step(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+        rk[6] = expand_step(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+        rk[7] = expand_step(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+        rk[8] = expand_step(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+        rk[9] = expand_step(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+        rk[10] = expand_step(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+    }
+
+    AESNI_TARGET inline void load_round_keys(const uint8_t (*src)[Aes128::BLOCK_LEN], __m128i rk[11])
+    {
+        for (int i = 0; i < 11; ++i)
+            rk[i] = _mm_load_si128(reinterpret_cast<const __m128i *>(src[i]));
+    }
+
+    AESNI_TARGET inline __m128i encrypt_block(const __m128i rk[11], __m128i x)
+    {
+        x = _mm_xor_si128(x, rk[0]);
+        for (int i = 1; i < 10; ++i)
+            x = _mm_aesenc_si128(x, rk[i]);
+        return _mm_aesenclast_si128(x, rk[10]);
+    }
+
+    // 同时加密 8 个分组，相互独立的 aesenc 可以填满流水线
+    AESNI_TARGET inline void encrypt_8_blocks(const __m128i rk[11], __m128i x[8])
+    {
+        for (int j = 0; j < 8; ++j)
+            x[j] = _mm_xor_si128(x[j], rk[0]);
+        for (int i = 1; i < 10; ++i)
+            for (int j = 0; j < 8; ++j)
+                x[j] = _mm_aesenc_si128(x[j], rk[i]);
+        for (int j = 0; j < 8; ++j)
+            x[j] = _mm_aesenclast_si128(x[j], rk[10]);
+    }
+
+    // ===== GHASH =====
+    // GHASH 的运算在比特序翻转的 GF(2^128) 上进行，这里将每个分组的字节序翻转后使用 PCLMULQDQ 计算，
+    // 参见 Intel 的 "Carry-Less Multiplication Instruction and its Usage for Computing the GCM Mode"。
+
+    AESNI_TARGET inline __m128i bswap_mask() { return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+
+    AESNI_TARGET inline __m128i bswap(__m128i x) { return _mm_shuffle_epi8(x, bswap_mask()); }
+
+    // 计算 a * b 的 256 bits 无约简乘积，异或到 (hi, lo) 上。多个乘积可以先累加，最后只约简一次（aggregated reduction）。
+    AESNI_TARGET inline void clmul_acc(__m128i a, __m128i b, __m128i &lo, __m128i &hi)
+    {
+        __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+        __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+        __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+        __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+        t1 = _mm_xor_si128(t1, t2);
+        lo = _mm_xor_si128(lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+        hi = _mm_xor_si128(hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+    }
+
+    // 将 256 bits 的乘积左移 1 位（补偿比特序翻转）后模 x^128 + x^7 + x^2 + x + 1 约简。
+    AESNI_TARGET inline __m128i reduce(__m128i lo, __m128i hi)
+    {
+        __m128i t7 = _mm_srli_epi32(lo, 31);
+        __m128i t8 = _mm_srli_epi32(hi, 31);
+        lo = _mm_slli_epi32(lo, 1);
+        hi = _mm_slli_epi32(hi, 1);
+        __m128i t9 = _mm_srli_si128(t7, 12);
+        t8 = _mm_slli_si128(t8, 4);
+        t7 = _mm_slli_si128(t7, 4);
+        lo = _mm_or_si128(lo, t7);
+        hi = _mm_or_si128(hi, t8);
+        hi = _mm_or_si128(hi, t9);
+
+        t7 = _mm_slli_epi32(lo, 31);
+        t8 = _mm_slli_epi32(lo, 30);
+        t9 = _mm_slli_epi32(lo, 25);
+        t7 = _mm_xor_si128(t7, _mm_xor_si128(t8, t9));
+        t8 = _mm_srli_si128(t7, 4);
+        t7 = _mm_slli_si128(t7, 12);
+        lo = _mm_xor_si128(lo, t7);
+
+        __m128i t2 = _mm_srli_epi32(lo, 1);
+        __m128i t4 = _mm_srli_epi32(lo, 2);
+        __m128i t5 = _mm_srli_epi32(lo, 7);
+        t2 = _mm_xor_si128(t2, _mm_xor_si128(t4, t5));
+        t2 = _mm_xor_si128(t2, t8);
+        lo = _mm_xor_si128(lo, t2);
+
+        return _mm_xor_si128(hi, lo);
+    }
+
+    AESNI_TARGET inline __m128i gfmul(__m128i a, __m128i b)
+    {
+        __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        clmul_acc(a, b, lo, hi);
+        return reduce(lo, hi);
+    }
+
+    AESNI_TARGET inline __m128i load_partial(const uint8_t *src, size_t len)
+    {
+        alignas(16) uint8_t tmp[16] = {0};
+        memcpy(tmp, src, len);
+        return _mm_load_si128(reinterpret_cast<const __m128i *>(tmp));
+    }
+
+    AESNI_TARGET inline void store_partial(uint8_t *dest, __m128i x, size_t len)
+    {
+        alignas(16) uint8_t tmp[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(tmp), x);
+        memcpy(dest, tmp, len);
+    }
+
+    // 逐块地将 len 个字节吸收进 GHASH 的状态 x，最后不足一块的部分补零。
+    AESNI_TARGET inline __m128i ghash_bytes(__m128i x, __m128i h, const uint8_t *src, size_t len)
+    {
+        for (; len >= 16; src += 16, len -= 16)
+            x = gfmul(_mm_xor_si128(x, bswap(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)))), h);
+        if (len)
+            x = gfmul(_mm_xor_si128(x, bswap(load_partial(src, len))), h);
+        return x;
+    }
+
+    // ===== AES-128-GCM（AES-NI + PCLMULQDQ，每次处理 8 个分组） =====
+
+    struct GcmKey
+    {
+        __m128i rk[11];
+        const __m128i *htable; // H^16, ..., H^1
+    };
+
+    struct GcmState
+    {
+        __m128i j0;      // J0 = nonce || 0x00000001
+        __m128i counter; // 翻转了字节序的计数器分组，最低 32 bits 为 GCM 的 32 bits 计数器，可以直接用 _mm_add_epi32 实现 inc32
+        __m128i x;       // GHASH 的状态
+    };
+
+    AESNI_TARGET inline void gcm_start(const GcmKey &key, GcmState &st, const uint8_t *nonce, const uint8_t *aad, size_t aadlen)
+    {
+        alignas(16) uint8_t j0[16];
+        memcpy(j0, nonce, Aes128::GCM_IV_LEN);
+        j0[12] = 0, j0[13] = 0, j0[14] = 0, j0[15] = 1;
+
+        st.j0 = _mm_load_si128(reinterpret_cast<const __m128i *>(j0));
+        st.counter = _mm_add_epi32(bswap(st.j0), _mm_set_epi32(0, 0, 0, 1)); // payload 从 inc32(J0) 开始
+        st.x = ghash_bytes(_mm_setzero_si128(), _mm_load_si128(&key.htable[15]), aad, aadlen);
+    }
+
+    // CTR 加解密 len 个字节，同时计算 GHASH（ENCRYPT 时对输出的密文，否则对输入的密文）。dest 与 src 可以相同。
+    // 不足一块的尾部只能出现在最后一次调用中。
+    template <bool ENCRYPT>
+    AESNI_TARGET inline void gcm_update(const GcmKey &key, GcmState &st, uint8_t *dest, const uint8_t *src, size_t len)
+    {
+        const __m128i h1 = _mm_load_si128(&key.htable[15]);
+        const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+
+        size_t i = 0;
+        for (; i + 128 <= len; i += 128)
+        {
+            __m128i blocks[8], data[8];
+            for (int j = 0; j < 8; ++j)
+            {
+                blocks[j] = bswap(st.counter);
+                st.counter = _mm_add_epi32(st.counter, one);
+            }
+            encrypt_8_blocks(key.rk, blocks);
+
+            for (int j = 0; j < 8; ++j)
+            {
+                __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16 * j));
+                __m128i out = _mm_xor_si128(in, blocks[j]);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i + 16 * j), out);
+
+                data[j] = bswap(ENCRYPT ? out : in);
+            }
+
+            // X' = (X ^ D0) * H^8 ^ D1 * H^7 ^ ... ^ D7 * H，只约简一次
+            __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+            data[0] = _mm_xor_si128(data[0], st.x);
+            for (int j = 0; j < 8; ++j)
+                clmul_acc(data[j], _mm_load_si128(&key.htable[8 + j]), lo, hi);
+            st.x = reduce(lo, hi);
+        }
+
+        for (; i < len; i += 16)
+        {
+            size_t n = len - i < 16 ? len - i : 16;
+            __m128i ks = encrypt_block(key.rk, bswap(st.counter));
+            st.counter = _mm_add_epi32(st.counter, one);
+
+            __m128i in = load_partial(src + i, n);
+            __m128i out = _mm_xor_si128(in, ks);
+            store_partial(dest + i, out, n);
+
+            // 最后不足一块时，参与 GHASH 的密文需要补零
+            __m128i c = ENCRYPT ? load_partial(dest + i, n) : in;
+            st.x = gfmul(_mm_xor_si128(st.x, bswap(c)), h1);
+        }
+    }
+
+    AESNI_TARGET inline __m128i gcm_finish(const GcmKey &key, GcmState &st, size_t len, size_t aadlen)
+    {
+        __m128i lens = _mm_set_epi64x((long long)(aadlen * 8), (long long)(len * 8));
+        __m128i x = gfmul(_mm_xor_si128(st.x, lens), _mm_load_si128(&key.htable[15]));
+
+        return _mm_xor_si128(bswap(x), encrypt_block(key.rk, st.j0));
+    }
+
+    // ===== AES-128-GCM（VAES + VPCLMULQDQ，每次处理 16 个分组） =====
+
+    VAES_TARGET inline __m512i broadcast128(__m128i x) { return _mm512_maskz_broadcast_i32x4((__mmask16)0xffff, x); }
+
+    VAES_TARGET inline __m512i bswap512(__m512i x) { return _mm512_shuffle_epi8(x, broadcast128(bswap_mask())); }
+
+    VAES_TARGET inline void clmul_acc512(__m512i a, __m512i b, __m512i &lo, __m512i &hi)
+    {
+        __m512i t0 = _mm512_clmulepi64_epi128(a, b, 0x00);
+        __m512i t1 = _mm512_clmulepi64_epi128(a, b, 0x10);
+        __m512i t2 = _mm512_clmulepi64_epi128(a, b, 0x01);
+        __m512i t3 = _mm512_clmulepi64_epi128(a, b, 0x11);
+
+        t1 = _mm512_xor_si512(t1, t2);
+        lo = _mm512_xor_si512(lo, _mm512_xor_si512(t0, _mm512_bslli_epi128(t1, 8)));
+        hi = _mm512_xor_si512(hi, _mm512_xor_si512(t3, _mm512_bsrli_epi128(t1, 8)));
+    }
+
+    // 将 4 个 lane 异或到一起
+    VAES_TARGET inline __m128i fold512(__m512i x)
+    {
+        __m256i y = _mm256_xor_si256(_mm512_maskz_extracti64x4_epi64((__mmask8)0xff, x, 0), _mm512_maskz_extracti64x4_epi64((__mmask8)0xff, x, 1));
+        return _mm_xor_si128(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+    }
+
+    // 以 16 个分组为单位处理尽可能多的数据，返回处理的字节数，剩余部分交给 gcm_update 继续处理。
+    template <bool ENCRYPT>
+    VAES_TARGET size_t gcm_update_vaes(const GcmKey &key, GcmState &st, uint8_t *dest, const uint8_t *src, size_t len)
+    {
+        if (len < 256)
+            return 0;
+
+        __m512i rk[11];
+        for (int r = 0; r < 11; ++r)
+            rk[r] = broadcast128(key.rk[r]);
+
+        __m512i hpow[4]; // [H^16, H^15, H^14, H^13], ..., [H^4, H^3, H^2, H^1]
+        for (int k = 0; k < 4; ++k)
+            hpow[k] = _mm512_loadu_si512(&key.htable[4 * k]);
+
+        // 4 个 lane 分别为 counter + 0, 1, 2, 3
+        __m512i counter = _mm512_add_epi32(broadcast128(st.counter), _mm512_set_epi32(0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));
+        const __m512i four = _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4);
+
+        size_t i = 0;
+        for (; i + 256 <= len; i += 256)
+        {
+            __m512i blocks[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                blocks[k] = _mm512_xor_si512(bswap512(counter), rk[0]);
+                counter = _mm512_add_epi32(counter, four);
+            }
+            for (int r = 1; r < 10; ++r)
+                for (int k = 0; k < 4; ++k)
+                    blocks[k] = _mm512_aesenc_epi128(blocks[k], rk[r]);
+            for (int k = 0; k < 4; ++k)
+                blocks[k] = _mm512_aesenclast_epi128(blocks[k], rk[10]);
+
+            __m512i lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+            for (int k = 0; k < 4; ++k)
+            {
+                __m512i in = _mm512_loadu_si512(src + i + 64 * k);
+                __m512i out = _mm512_xor_si512(in, blocks[k]);
+                _mm512_storeu_si512(dest + i + 64 * k, out);
+
+                __m512i data = bswap512(ENCRYPT ? out : in);
+                if (k == 0)
+                    data = _mm512_xor_si512(data, _mm512_zextsi128_si512(st.x));
+                clmul_acc512(data, hpow[k], lo, hi);
+            }
+            st.x = reduce(fold512(lo), fold512(hi));
+        }
+
+        st.counter = _mm512_maskz_extracti32x4_epi32((__mmask8)0xf, counter, 0);
+        return i;
+    }
+
+    // GCM 加解密 len 个字节，返回 tag。
+    template <bool ENCRYPT>
+    AESNI_TARGET inline __m128i gcm_crypt(bool vaes, const GcmKey &key, uint8_t *dest, const uint8_t *src, size_t len,
+                                          const uint8_t *nonce, const uint8_t *aad, size_t aadlen)
+    {
+        GcmState st;
+        gcm_start(key, st, nonce, aad, aadlen);
+
+        size_t done = vaes ? gcm_update_vaes<ENCRYPT>(key, st, dest, src, len) : 0;
+        gcm_update<ENCRYPT>(key, st, dest + done, src + done, len - done);
+
+        return gcm_finish(key, st, len, aadlen);
+    }
+
+    AESNI_TARGET inline void load_gcm_key(const uint8_t (*round_keys)[Aes128::BLOCK_LEN],
+                                          const uint8_t (*htable)[Aes128::BLOCK_LEN], GcmKey &key)
+    {
+        load_round_keys(round_keys, key.rk);
+        key.htable = reinterpret_cast<const __m128i *>(htable);
+    }
+
+    AESNI_TARGET void aesni_init(const uint8_t *key, uint8_t (*round_keys)[Aes128::BLOCK_LEN], uint8_t (*htable)[Aes128::BLOCK_LEN])
+    {
+        __m128i rk[11];
+        expand_key(key, rk);
+        for (int i = 0; i < 11; ++i)
+            _mm_store_si128(reinterpret_cast<__m128i *>(round_keys[i]), rk[i]);
+
+        // H = E(K, 0^128)，预先计算 H^1 ~ H^16，htable[16 - i] = H^i
+        __m128i h = bswap(encrypt_block(rk, _mm_setzero_si128()));
+        __m128i p = h;
+        for (int i = 1; i <= 16; ++i)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i *>(htable[16 - i]), p);
+            p = gfmul(p, h);
+        }
+    }
+
+    AESNI_TARGET void aesni_encrypt_blocks(const uint8_t (*round_keys)[Aes128::BLOCK_LEN],
+                                           const uint8_t *const *in, uint8_t *const *out, size_t n)
+    {
+        __m128i rk[11];
+        load_round_keys(round_keys, rk);
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i x[8];
+            for (int j = 0; j < 8; ++j)
+                x[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i + j]));
+            encrypt_8_blocks(rk, x);
+            for (int j = 0; j < 8; ++j)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i + j]), x[j]);
+        }
+
+        for (; i < n; ++i)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i]), encrypt_block(rk, x));
+        }
+    }
+
+    AESNI_TARGET void aesni_gcm_seal(bool vaes, const uint8_t (*round_keys)[Aes128::BLOCK_LEN], const uint8_t (*htable)[Aes128::BLOCK_LEN],
+                                     uint8_t *dest, const uint8_t *plaintext, size_t len,
+                                     const uint8_t *nonce, const uint8_t *aad, size_t aadlen)
+    {
+        GcmKey key;
+        load_gcm_key(round_keys, htable, key);
+
+        __m128i tag = gcm_crypt<true>(vaes, key, dest, plaintext, len, nonce, aad, aadlen);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + len), tag);
+    }
+
+    AESNI_TARGET void aesni_gcm_seal_batch(bool vaes, const uint8_t (*round_keys)[Aes128::BLOCK_LEN], const uint8_t (*htable)[Aes128::BLOCK_LEN],
+                                           Aes128::SealRequest *reqs, size_t n)
+    {
+        GcmKey key;
+        load_gcm_key(round_keys, htable, key);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            Aes128::SealRequest &req = reqs[i];
+            uint8_t *payload = req.data + req.aadlen;
+            __m128i tag = gcm_crypt<true>(vaes, key, payload, payload, req.len, req.nonce, req.data, req.aadlen);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(payload + req.len), tag);
+        }
+    }
+
+    AESNI_TARGET int aesni_gcm_open(bool vaes, const uint8_t (*round_keys)[Aes128::BLOCK_LEN], const uint8_t (*htable)[Aes128::BLOCK_LEN],
+                                    uint8_t *dest, const uint8_t *ciphertext, size_t len,
+                                    const uint8_t *nonce, const uint8_t *aad, size_t aadlen)
+    {
+        GcmKey key;
+        load_gcm_key(round_keys, htable, key);
+
+        // 先取出 tag：dest 与 ciphertext 相同时解密过程不会覆盖 tag，但这里不依赖这一点
+        __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ciphertext + len));
+        __m128i tag = gcm_crypt<false>(vaes, key, dest, ciphertext, len, nonce, aad, aadlen);
+
+        // 常数时间比较
+        __m128i diff = _mm_xor_si128(tag, expected);
+        return _mm_testz_si128(diff, diff) ? 0 : -1;
+    }
+} /* namespace */
+
+Aes128::Aes128(const uint8_t *key) : vaes(is_vaes_supported())
+{
+    aesni_init(key, this->round_keys, this->htable);
+}
+
+bool Aes128::is_supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+bool Aes128::is_vaes_supported()
+{
+    __builtin_cpu_init();
+    return is_supported() && __builtin_cpu_supports("vaes") && __builtin_cpu_supports("vpclmulqdq") &&
+           __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+}
+
+bool Aes128::set_vaes(bool vaes)
+{
+    this->vaes = (vaes && is_vaes_supported());
+    return this->vaes;
+}
+
+void Aes128::encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks) const
+{
+    // 按 8 个分组一组转换为指针数组，与 hp_masks 共用同一个实现
+    const uint8_t *in_ptrs[8];
+    uint8_t *out_ptrs[8];
+
+    for (size_t i = 0; i < nblocks; i += 8)
+    {
+        size_t n = nblocks - i < 8 ? nblocks - i : 8;
+        for (size_t j = 0; j < n; ++j)
+        {
+            in_ptrs[j] = in + (i + j) * BLOCK_LEN;
+            out_ptrs[j] = out + (i + j) * BLOCK_LEN;
+        }
+        aesni_encrypt_blocks(this->round_keys, in_ptrs, out_ptrs, n);
+    }
+}
+
+void Aes128::hp_masks(const uint8_t *const *samples, uint8_t (*masks)[BLOCK_LEN], size_t n) const
+{
+    uint8_t *out_ptrs[8];
+
+    for (size_t i = 0; i < n; i += 8)
+    {
+        size_t m = n - i < 8 ? n - i : 8;
+        for (size_t j = 0; j < m; ++j)
+            out_ptrs[j] = masks[i + j];
+        aesni_encrypt_blocks(this->round_keys, samples + i, out_ptrs, m);
+    }
+}
+
+void Aes128::gcm_seal(uint8_t *dest, const uint8_t *plaintext, size_t len,
+                      const uint8_t *nonce, const uint8_t *aad, size_t aadlen) const
+{
+    aesni_gcm_seal(this->vaes, this->round_keys, this->htable, dest, plaintext, len, nonce, aad, aadlen);
+}
+
+int Aes128::gcm_open(uint8_t *dest, const uint8_t *ciphertext, size_t len,
+                     const uint8_t *nonce, const uint8_t *aad, size_t aadlen) const
+{
+    if (len < GCM_TAG_LEN)
+        return -1;
+
+    return aesni_gcm_open(this->vaes, this->round_keys, this->htable, dest, ciphertext, len - GCM_TAG_LEN, nonce, aad, aadlen);
+}
+
+void Aes128::gcm_seal_batch(SealRequest *reqs, size_t n) const
+{
+    aesni_gcm_seal_batch(this->vaes, this->round_keys, this->htable, reqs, n);
+}
+
+#else /* !(defined(__x86_64__) || defined(__i386__)) */
+
+Aes128::Aes128(const uint8_t *key) : vaes(false)
+{
+    (void)key;
+    memset(this->round_keys, 0, sizeof(this->round_keys));
+    memset(this->htable, 0, sizeof(this->htable));
+}
+
+bool Aes128::is_supported() { return false; }
+
+bool Aes128::is_vaes_supported() { return false; }
+
+bool Aes128::set_vaes(bool) { return false; }
+
+// 不支持的平台上 is_supported() 返回 false，以下函数不应被调用
+
+void Aes128::encrypt_blocks(const uint8_t *, uint8_t *, size_t) const {}
+
+void Aes128::hp_masks(const uint8_t *const *, uint8_t (*)[BLOCK_LEN], size_t) const {}
+
+void Aes128::gcm_seal(uint8_t *, const uint8_t *, size_t, const uint8_t *, const uint8_t *, size_t) const {}
+
+int Aes128::gcm_open(uint8_t *, const uint8_t *, size_t, const uint8_t *, const uint8_t *, size_t) const { return -1; }
+
+void Aes128::gcm_seal_batch(SealRequest *, size_t) const {}
+
+#endif
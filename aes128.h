@@ -0,0 +1,75 @@
+#ifndef __AES128_H__
+#define __AES128_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// AES-128 的硬件加速实现（x86-64 的 AES-NI + PCLMULQDQ，运行时检测到 VAES + VPCLMULQDQ + AVX-512 时改用 512 bits 的向量指令），
+// 不依赖任何外部的 TLS/密码学库。提供两种用途：
+//   - AES-128-GCM AEAD，用于 QUIC packet 的 payload protection（RFC 9001 5.3）；
+//   - AES-128-ECB 单块加密，用于 QUIC 的 header protection（RFC 9001 5.4.3），mask 即 sample 的密文。
+// 除了逐个 packet 的接口外，还提供批量接口：一次性保护一整个 GSO batch 中的 packet，一次性计算多个 sample 的 mask，
+// 以便让 AES 指令的流水线保持满载。
+// 对象构造之后只读（set_vaes 除外），可以在多个线程中同时使用。
+class Aes128
+{
+public:
+    static constexpr size_t KEY_LEN = 16;     // AES-128 密钥的长度
+    static constexpr size_t BLOCK_LEN = 16;   // AES 分组的长度，也是 header protection 的 sample 长度
+    static constexpr size_t GCM_IV_LEN = 12;  // GCM nonce 的长度
+    static constexpr size_t GCM_TAG_LEN = 16; // GCM tag 的长度
+
+    // gcm_seal_batch 的一个请求：data 开头的 aadlen 个字节是 AAD（QUIC packet header），其后 len 个字节的明文被原地加密，
+    // 并在其后写入 GCM_TAG_LEN 个字节的 tag，因此 data 必须至少有 aadlen + len + GCM_TAG_LEN 个字节的空间。
+    struct SealRequest
+    {
+        uint8_t *data;
+        size_t aadlen;
+        size_t len;
+        uint8_t nonce[GCM_IV_LEN];
+    };
+
+private:
+    alignas(64) uint8_t round_keys[11][BLOCK_LEN]; // AES-128 的 11 个 round key
+    alignas(64) uint8_t htable[16][BLOCK_LEN];     // GHASH 用到的 H^16, H^15, ..., H^1（字节序翻转后的形式），htable[16 - i] = H^i
+    bool vaes;                                     // 是否使用 VAES + VPCLMULQDQ（AVX-512）
+
+public:
+    // 根据 key（KEY_LEN 个字节）生成 round key 以及 GHASH 的 H 的幂。调用前应当先检查 is_supported()。
+    Aes128(const uint8_t *key);
+
+    // 当前 CPU 是否支持 AES-NI + PCLMULQDQ（不支持时不能使用本类）。
+    static bool is_supported();
+
+    // 当前 CPU 是否支持 VAES + VPCLMULQDQ + AVX-512，若支持则 GCM 会一次处理 16 个分组。
+    static bool is_vaes_supported();
+
+    // 选择 GCM 的实现：vaes 为 true 且 CPU 支持时使用一次处理 16 个分组的 VAES 路径，否则使用一次处理 8 个分组的 AES-NI 路径。
+    // 构造时默认按 is_vaes_supported() 选择，本函数用于测试与 benchmark 分别运行两条路径。返回实际是否使用 VAES 路径。
+    // 必须在对象被多个线程共享之前调用。
+    bool set_vaes(bool vaes);
+
+    // AES-128-ECB：加密 nblocks 个分组，in 与 out 可以相同。
+    void encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks) const;
+
+    // header protection：为 n 个 sample（每个 BLOCK_LEN 个字节）计算 mask，masks[i] 为 samples[i] 的 AES-128-ECB 密文。
+    void hp_masks(const uint8_t *const *samples, uint8_t (*masks)[BLOCK_LEN], size_t n) const;
+
+    // AES-128-GCM 加密：将 len 个字节的 plaintext 加密后写到 dest，并在 dest + len 处写入 tag。dest 与 plaintext 可以相同。
+    void gcm_seal(uint8_t *dest, const uint8_t *plaintext, size_t len,
+                  const uint8_t *nonce, const uint8_t *aad, size_t aadlen) const;
+
+    // AES-128-GCM 解密：ciphertext 的最后 GCM_TAG_LEN 个字节是 tag，解密后的 len - GCM_TAG_LEN 个字节写到 dest。
+    // dest 与 ciphertext 可以相同。tag 校验失败时返回 -1（此时 dest 中的内容不可用），成功时返回 0。
+    int gcm_open(uint8_t *dest, const uint8_t *ciphertext, size_t len,
+                 const uint8_t *nonce, const uint8_t *aad, size_t aadlen) const;
+
+    // 批量地原地加密 n 个 packet（见 SealRequest），round key 只加载一次。
+    void gcm_seal_batch(SealRequest *reqs, size_t n) const;
+
+private:
+    Aes128(const Aes128 &rhs) = delete;            // no copy
+    Aes128 &operator=(const Aes128 &rhs) = delete; // no assignment
+};
+
+#endif /* __AES128_H__ */
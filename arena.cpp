@@ -0,0 +1,214 @@
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <assert.h>
+
+#include "arena.h"
+
+namespace
+{
+    constexpr size_t ALIGNMENT = 16;
+
+    inline size_t align_up(size_t n) { return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+
+    // 计算能容纳 size 个字节的 size class 的下标，size 需不大于最大的 size class。
+    inline uint32_t size_to_class(size_t size)
+    {
+        size_t shift = Arena::MIN_CLASS_SHIFT;
+        while (((size_t)1 << shift) < size)
+            ++shift;
+
+        return (uint32_t)(shift - Arena::MIN_CLASS_SHIFT);
+    }
+
+    inline size_t class_to_size(uint32_t klass) { return (size_t)1 << (klass + Arena::MIN_CLASS_SHIFT); }
+} /* namespace */
+
+Arena::Arena(size_t chunk_size)
+    : mem{this, malloc_cb, free_cb, calloc_cb, realloc_cb},
+      chunk_size(chunk_size < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : chunk_size),
+      chunks(nullptr), chunk_pos(nullptr), chunk_end(nullptr),
+      free_lists{nullptr}, large_blocks(nullptr),
+      live_bytes(0), peak_bytes(0), reserved_bytes(0), n_allocs(0), n_chunks(0)
+{
+}
+
+Arena::~Arena()
+{
+    printf("Debug [%s]: live = %zu bytes, peak = %zu bytes, reserved = %zu bytes, %zu allocs, %zu chunks.\n", __func__,
+           this->live_bytes, this->peak_bytes, this->reserved_bytes, this->n_allocs, this->n_chunks);
+
+    // 一次性把所有 chunk 与大块内存归还给系统，不必再逐个 ::free 切分出去的小块（它们此时应当都已回到 free list 上）
+    for (BlockHeader *blk = this->large_blocks; blk;)
+    {
+        BlockHeader *next = blk->next;
+        ::free(blk);
+        blk = next;
+    }
+
+    for (Chunk *chunk = this->chunks; chunk;)
+    {
+        Chunk *next = chunk->next;
+        ::free(chunk);
+        chunk = next;
+    }
+}
+
+Arena::BlockHeader *Arena::carve(uint32_t klass)
+{
+    size_t need = sizeof(BlockHeader) + class_to_size(klass);
+
+    if (this->chunk_pos == nullptr || (size_t)(this->chunk_end - this->chunk_pos) < need)
+    {
+        // 当前 chunk 剩余的空间直接放弃，申请新的 chunk
+        Chunk *chunk = static_cast<Chunk *>(::malloc(this->chunk_size));
+        if (!chunk)
+            return nullptr;
+
+        chunk->next = this->chunks;
+        this->chunks = chunk;
+        this->chunk_pos = reinterpret_cast<uint8_t *>(chunk) + align_up(sizeof(Chunk));
+        this->chunk_end = reinterpret_cast<uint8_t *>(chunk) + this->chunk_size;
+
+        this->reserved_bytes += this->chunk_size;
+        ++(this->n_chunks);
+    }
+
+    BlockHeader *blk = reinterpret_cast<BlockHeader *>(this->chunk_pos);
+    this->chunk_pos += need;
+
+    blk->size = class_to_size(klass);
+    blk->klass = klass;
+
+    return blk;
+}
+
+void *Arena::malloc(size_t size)
+{
+    BlockHeader *blk = nullptr;
+
+    if (size > class_to_size(N_CLASSES - 1))
+    {
+        blk = static_cast<BlockHeader *>(::malloc(sizeof(BlockHeader) + size));
+        if (!blk)
+            return nullptr;
+
+        blk->size = size;
+        blk->klass = N_CLASSES;
+
+        blk->prev = nullptr;
+        blk->next = this->large_blocks;
+        if (this->large_blocks)
+            this->large_blocks->prev = blk;
+        this->large_blocks = blk;
+
+        this->reserved_bytes += sizeof(BlockHeader) + size;
+    }
+    else
+    {
+        uint32_t klass = size_to_class(size);
+
+        if (this->free_lists[klass]) // 优先重用已经释放的块
+        {
+            blk = this->free_lists[klass];
+            this->free_lists[klass] = blk->next;
+        }
+        else
+        {
+            blk = this->carve(klass);
+            if (!blk)
+                return nullptr;
+        }
+    }
+
+    this->live_bytes += blk->size;
+    this->peak_bytes = std::max(this->peak_bytes, this->live_bytes);
+    ++(this->n_allocs);
+
+    return blk + 1;
+}
+
+void Arena::free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    BlockHeader *blk = static_cast<BlockHeader *>(ptr) - 1;
+    assert(this->live_bytes >= blk->size);
+    this->live_bytes -= blk->size;
+
+    if (blk->klass == N_CLASSES) // 大块内存直接归还给系统
+    {
+        if (blk->prev)
+            blk->prev->next = blk->next;
+        else
+            this->large_blocks = blk->next;
+        if (blk->next)
+            blk->next->prev = blk->prev;
+
+        this->reserved_bytes -= sizeof(BlockHeader) + blk->size;
+        ::free(blk);
+        return;
+    }
+
+    blk->next = this->free_lists[blk->klass];
+    this->free_lists[blk->klass] = blk;
+}
+
+void *Arena::calloc(size_t nmemb, size_t size)
+{
+    if (size && nmemb > SIZE_MAX / size)
+        return nullptr;
+
+    void *ptr = this->malloc(nmemb * size);
+    if (ptr)
+        memset(ptr, 0, nmemb * size);
+
+    return ptr;
+}
+
+void *Arena::realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return this->malloc(size);
+
+    if (size == 0)
+    {
+        this->free(ptr);
+        return nullptr;
+    }
+
+    BlockHeader *blk = static_cast<BlockHeader *>(ptr) - 1;
+    if (size <= blk->size) // 原来的块就能容纳
+        return ptr;
+
+    void *new_ptr = this->malloc(size);
+    if (!new_ptr)
+        return nullptr;
+
+    memcpy(new_ptr, ptr, blk->size);
+    this->free(ptr);
+
+    return new_ptr;
+}
+
+void *Arena::malloc_cb(size_t size, void *user_data)
+{
+    return static_cast<Arena *>(user_data)->malloc(size);
+}
+
+void Arena::free_cb(void *ptr, void *user_data)
+{
+    static_cast<Arena *>(user_data)->free(ptr);
+}
+
+void *Arena::calloc_cb(size_t nmemb, size_t size, void *user_data)
+{
+    return static_cast<Arena *>(user_data)->calloc(nmemb, size);
+}
+
+void *Arena::realloc_cb(void *ptr, size_t size, void *user_data)
+{
+    return static_cast<Arena *>(user_data)->realloc(ptr, size);
+}
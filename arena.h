@@ -0,0 +1,88 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ngtcp2/ngtcp2.h>
+
+// 每个 connection 独占的内存池，通过 ngtcp2_mem 交给 lib ngtcp2 使用（frame chain、rtb entry、ksl block、rob chunk 等）。
+// 小块内存按 size class（16 ~ 4096 bytes）从大块的 chunk 中顺序切分，释放后挂到对应 size class 的 free list 上重用，不归还给 chunk；
+// 更大的内存直接 malloc，并串成链表。Arena 析构时一次性释放所有的 chunk 与大块内存。
+// 注意 ngtcp2_conn_del 仍会逐个 free 它的对象，arena 省下的是这些 free（以及运行期间 malloc）的开销，而不是遍历本身。
+// Arena 不是线程安全的，一个 connection 只应当在一个线程中被处理。
+class Arena
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;  // 每个 chunk 的默认大小
+    static constexpr size_t MIN_CHUNK_SIZE = 8 * 1024; // chunk 的最小大小，保证能切分出最大的 size class
+    static constexpr size_t MIN_CLASS_SHIFT = 4;     // 最小的 size class 为 16 bytes
+    static constexpr size_t MAX_CLASS_SHIFT = 12;    // 最大的 size class 为 4096 bytes，更大的内存直接 malloc
+    static constexpr size_t N_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+
+private:
+    // 每块分配出去的内存前面都有一个 header，保证返回给 lib ngtcp2 的地址按 16 bytes 对齐。
+    struct alignas(16) BlockHeader
+    {
+        BlockHeader *next;  // 在 free list 中时指向下一个空闲的块；若是大块内存，则串起所有的大块内存
+        BlockHeader *prev;  // 仅大块内存使用，便于在释放时将其从链表中摘除
+        size_t size;        // 块的容量（不含 header），即 size class 的大小或大块内存的大小
+        uint32_t klass;     // size class 的下标，大块内存为 N_CLASSES
+    };
+
+    struct Chunk
+    {
+        Chunk *next;
+    };
+
+    ngtcp2_mem mem;
+
+    size_t chunk_size;                   // 每个 chunk 的大小
+    Chunk *chunks;                       // 所有的 chunk
+    uint8_t *chunk_pos;                  // 当前 chunk 中尚未切分的空间的起始地址
+    uint8_t *chunk_end;                  // 当前 chunk 的结束地址
+    BlockHeader *free_lists[N_CLASSES];  // 每个 size class 的 free list
+    BlockHeader *large_blocks;           // 所有直接 malloc 的大块内存
+
+    size_t live_bytes;    // 统计：当前分配出去的内存（按块的容量计）
+    size_t peak_bytes;    // 统计：live_bytes 的峰值
+    size_t reserved_bytes; // 统计：向系统申请的内存（chunk 与大块内存）
+    uint64_t n_allocs;    // 统计：分配次数
+    uint64_t n_chunks;    // 统计：chunk 的数量
+
+public:
+    // chunk_size 为每个 chunk 的大小，小于 MIN_CHUNK_SIZE 时取 MIN_CHUNK_SIZE。
+    // 较大的 chunk 减少 malloc 的次数，较小的 chunk 减少空闲 connection 的内存占用。
+    Arena(size_t chunk_size = CHUNK_SIZE);
+    ~Arena();
+
+    // 获取交给 lib ngtcp2 的 ngtcp2_mem 对象，其生命周期与 Arena 相同，必须在 ngtcp2_conn_del 之后才能销毁 Arena。
+    inline const ngtcp2_mem *get_mem() const { return &(this->mem); }
+
+    void *malloc(size_t size);
+    void free(void *ptr);
+    void *calloc(size_t nmemb, size_t size);
+    void *realloc(void *ptr, size_t size);
+
+    // 查询统计数据。
+    inline size_t get_live_bytes() const { return this->live_bytes; }
+    inline size_t get_peak_bytes() const { return this->peak_bytes; }
+    inline size_t get_reserved_bytes() const { return this->reserved_bytes; }
+    inline uint64_t get_alloc_count() const { return this->n_allocs; }
+
+private:
+    // 从当前 chunk 中切分出一个 size class 为 klass 的块，chunk 空间不足时申请新的 chunk。
+    BlockHeader *carve(uint32_t klass);
+
+    // ngtcp2_mem 的回调函数，user_data 为 Arena 对象。
+    static void *malloc_cb(size_t size, void *user_data);
+    static void free_cb(void *ptr, void *user_data);
+    static void *calloc_cb(size_t nmemb, size_t size, void *user_data);
+    static void *realloc_cb(void *ptr, size_t size, void *user_data);
+
+private:
+    Arena(const Arena &rhs) = delete;            // no copy
+    Arena &operator=(const Arena &rhs) = delete; // no assignment
+};
+
+#endif /* __ARENA_H__ */
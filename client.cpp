@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <memory>
 #include <vector>
 #include <assert.h>
@@ -22,6 +23,19 @@ namespace
     constexpr size_t BUF_SIZE = 1280;
     constexpr size_t N_STREAMS_MAX_ONE_CONN = 3; // 一个 QUIC Connection 中可以创建的 Stream 数量的上限
     constexpr size_t N_COALESCE_MAX = 2;         // 将 N_COALESCE_MAX 次 stdin 读取的数据合并发送
+    constexpr ngtcp2_cc_algo CC_ALGO = NGTCP2_CC_ALGO_CUBIC;        // 拥塞控制算法，选择 NGTCP2_CC_ALGO_BBR/BBR2 时 ngtcp2 会开启 packet pacing
+    constexpr bool USE_SO_TXTIME = true;                            // 开启 packet pacing 时，是否通过 SO_TXTIME 让内核（fq qdisc）按时刻发送 packet，否则只由 ngtcp2 timer 在用户态做 pacing
+    constexpr int SOCKET_RCVBUF_SIZE = 0;                           // socket 接收缓冲区的初始大小（bytes），0 表示使用系统默认值
+    constexpr int SOCKET_SNDBUF_SIZE = 0;                           // socket 发送缓冲区的大小（bytes），0 表示使用系统默认值
+    constexpr size_t SOCKET_RCVBUF_AUTOSIZE_MAX = 16 * 1024 * 1024; // 出现内核丢包时 socket 接收缓冲区自动扩容的上限，0 表示不自动扩容
+    constexpr bool USE_UDP_GSO = true;                              // 是否将连续写出的多个 packet 合并为一次 sendmsg，由内核（或网卡）切分（UDP GSO）
+    constexpr size_t MAX_UDP_PAYLOAD_SIZE = 9000 - 48;              // 收发 UDP payload 的长度上限（PMTUD 的探测上限），同时作为 max_udp_payload_size transport parameter 通告给对端
+    constexpr bool PMTUD_ENABLED = true;                            // 是否开启 Path MTU Discovery，关闭时发送的 packet 不超过 1200 bytes
+    constexpr bool USE_MSG_ZEROCOPY = false;                        // 是否对较大的 GSO batch 使用 MSG_ZEROCOPY 发送，省去用户态到内核的拷贝
+    constexpr bool COMPACT_CONNECTION = false;                      // 是否开启 connection 的 compact 模式（arena 使用更小的 chunk），适用于大量长期空闲的 connection
+    constexpr ngtcp2_plaintext::Profile PLAINTEXT_PROFILE = ngtcp2_plaintext::PROFILE_FAKE_AEAD; // 1RTT packet 的保护方式，PROFILE_NULL 去掉 fake AEAD tag 与 header protection（仅用于可信网络），PROFILE_AES_128_GCM 使用 AES-NI 加密，两端必须一致
+    constexpr const char *PSK_ENV_NAME = "ECHO_PSK";                                              // PROFILE_AES_128_GCM 下从该环境变量读取 pre-shared key（32 个十六进制字符），两端必须一致
+    constexpr bool PACING_ENABLED = (CC_ALGO == NGTCP2_CC_ALGO_BBR || CC_ALGO == NGTCP2_CC_ALGO_BBR2);
 } /* namespace */
 
 namespace
@@ -70,6 +84,17 @@ namespace
         return 0;
     }
 
+    // ngtcp2_callbacks: 当 stream 被关闭时，本函数会被调用。
+    int stream_close_cb(ngtcp2_conn *conn, uint32_t flags,
+                        int64_t stream_id, uint64_t app_error_code,
+                        void *user_data, void *stream_user_data)
+    {
+        auto connection = static_cast<Connection *>(user_data);
+        connection->on_stream_close(stream_id, app_error_code);
+
+        return 0;
+    }
+
     // ngtcp2_callbacks: 当本端发送出去的数据受到累计确认时，本函数会被调用。
     int acked_stream_data_offset_cb(ngtcp2_conn *conn,
                                     int64_t stream_id, uint64_t offset, uint64_t datalen,
@@ -110,6 +135,8 @@ namespace
         EchoClient *cli = static_cast<EchoClient *>(stdin_w->data);
         std::shared_ptr<Connection> connection = cli->get_connection();
 
+        refresh_loop_timestamp(); // 每轮 event loop 迭代采样一次时钟
+
         assert(&(cli->stdin_watcher) == stdin_w);
 
         uint8_t buf[BUF_SIZE + 1];
@@ -172,12 +199,15 @@ namespace
                 return;
             }
 
+            if (connection->has_pending_tx()) // 有 packet 因 EAGAIN 未能发送，等待 socket fd 可写时再发送
+                ev_io_start(loop, &(cli->socket_fd_write_watcher));
+
             cli->coalesce_count = 0;       // 将 coalesce_count 重置为零
             connection->step_cur_stream(); // 切换到下一条 stream
 
             /* 设置下一次的 timer expire 事件（注意这里，不要忘记了） */
             ngtcp2_tstamp expiry = connection->get_expiry();
-            ngtcp2_tstamp now = timestamp();
+            ngtcp2_tstamp now = loop_timestamp();
             ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
             cli->ngtcp2_timer_watcher.repeat = t;
             ev_timer_again(EV_DEFAULT, &(cli->ngtcp2_timer_watcher));
@@ -192,6 +222,10 @@ namespace
         EchoClient *cli = static_cast<EchoClient *>(sock_fd_w->data);
         std::shared_ptr<Connection> connection = cli->get_connection();
 
+        refresh_loop_timestamp(); // 每轮 event loop 迭代采样一次时钟
+
+        connection->handle_zerocopy_completions(); // 回收已发送完成的 zerocopy buffer
+
         int ret = connection->read();
         if (ret < 0)
         {
@@ -201,6 +235,40 @@ namespace
         }
     }
 
+    // libev event loop - io watcher callback：监测到 socket fd 可写时被调用，仅在 connection 有暂存的待发送 packet 时开启。
+    void socket_fd_write_cb(struct ev_loop *loop, ev_io *socket_fd_write_w, int revents)
+    {
+        EchoClient *cli = static_cast<EchoClient *>(socket_fd_write_w->data);
+        std::shared_ptr<Connection> connection = cli->get_connection();
+
+        if (connection == nullptr)
+        {
+            ev_io_stop(loop, socket_fd_write_w);
+            return;
+        }
+
+        refresh_loop_timestamp(); // 每轮 event loop 迭代采样一次时钟
+
+        int ret = connection->write(); // 先发送暂存的 packet，若全部发送完毕则继续写新的 packet
+        if (ret < 0)
+        {
+            fprintf(stderr, "Error [%s] [connection->write]: ret = %d.\n", __func__, ret);
+            connection->close();
+            ev_break(loop, EVBREAK_ALL);
+            return;
+        }
+
+        if (!connection->has_pending_tx())
+            ev_io_stop(loop, socket_fd_write_w);
+
+        /* 设置下一次的 timer expire 事件 */
+        ngtcp2_tstamp expiry = connection->get_expiry();
+        ngtcp2_tstamp now = loop_timestamp();
+        ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
+        cli->ngtcp2_timer_watcher.repeat = t;
+        ev_timer_again(loop, &(cli->ngtcp2_timer_watcher));
+    }
+
     // libev event loop - timer watcher callback：当驱动 ngtcp2 工作的 timer expire 时被调用。
     void timer_cb(struct ev_loop *loop, ev_timer *ngtcp2_timer_w, int revents)
     {
@@ -209,7 +277,7 @@ namespace
 
         assert(connection);
 
-        int ret = connection->handle_expiry(timestamp());
+        int ret = connection->handle_expiry(refresh_loop_timestamp()); // 每轮 event loop 迭代采样一次时钟
         if (ret < 0)
         {
             fprintf(stderr, "Error [%s] [connection->handle_expiry (i.e. ngtcp2_conn_handle_expiry)]: ngtcp2_liberr = %s.\n", __func__, ngtcp2_strerror(ret));
@@ -231,9 +299,12 @@ namespace
             return;
         }
 
+        if (connection->has_pending_tx()) // 有 packet 因 EAGAIN 未能发送，等待 socket fd 可写时再发送
+            ev_io_start(loop, &(cli->socket_fd_write_watcher));
+
         /* 设置下一次的 timer expire 事件 */
         ngtcp2_tstamp expiry = connection->get_expiry();
-        ngtcp2_tstamp now = timestamp();
+        ngtcp2_tstamp now = loop_timestamp();
         ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
         ngtcp2_timer_w->repeat = t;
         ev_timer_again(EV_DEFAULT, ngtcp2_timer_w);
@@ -244,6 +315,13 @@ int main()
 {
     EchoClient cli(N_COALESCE_MAX);
 
+    if (PLAINTEXT_PROFILE == ngtcp2_plaintext::PROFILE_AES_128_GCM &&
+        ngtcp2_plaintext::set_pre_shared_key(getenv(PSK_ENV_NAME)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [ngtcp2_plaintext::set_pre_shared_key]: environment variable %s must be 32 hex characters.\n", __func__, PSK_ENV_NAME);
+        return -1;
+    }
+
     /* Get remote host & port from stdin */
     char remote_host[50] = {0}, remote_port[50] = {0};
     printf("Input local host & port:\n");
@@ -267,29 +345,48 @@ int main()
         return -1;
     }
     printf("Debug: open a socket fd = %d.\n", sock_fd);
+    enable_recv_ecn(sock_fd, remote_addr.ss_family);
+    if (PMTUD_ENABLED)
+        enable_pmtud_probe(sock_fd, remote_addr.ss_family); // 由 ngtcp2 自行探测 path MTU
+    enable_rx_timestamp(sock_fd);
+    enable_rxq_ovfl(sock_fd);
+    set_socket_buffer_size(sock_fd, SOCKET_RCVBUF_SIZE, SOCKET_SNDBUF_SIZE);
 
     /* Create an client ngtcp2 connection */
-    auto connection = std::make_shared<Connection>(sock_fd, N_STREAMS_MAX_ONE_CONN);
+    auto connection = std::make_shared<Connection>(sock_fd, N_STREAMS_MAX_ONE_CONN, COMPACT_CONNECTION);
     connection->set_local_addr((sockaddr *)&local_addr, local_addrlen);
     connection->set_remote_addr((sockaddr *)&remote_addr, remote_addrlen);
+    connection->set_recv_buf_autosize_max(SOCKET_RCVBUF_AUTOSIZE_MAX);
+
+    if (PACING_ENABLED && USE_SO_TXTIME)
+        connection->set_txtime_enabled(enable_so_txtime(sock_fd) == 0); // 若开启失败，则退回到只由 ngtcp2 timer 做 pacing
+    if (USE_UDP_GSO)
+        connection->set_gso_enabled(probe_udp_gso(sock_fd) == 0);
+    if (USE_MSG_ZEROCOPY)
+        connection->set_zerocopy_enabled(enable_zerocopy(sock_fd) == 0);
 
     ngtcp2_callbacks callbacks = {0};
     memset(&callbacks, 0, sizeof(callbacks));
     callbacks.recv_stream_data = recv_stream_data_cb;
     callbacks.acked_stream_data_offset = acked_stream_data_offset_cb;
     callbacks.extend_max_local_streams_bidi = extend_max_local_streams_bidi_cb;
+    callbacks.stream_close = stream_close_cb;
     callbacks.rand = rand_cb;
     callbacks.get_new_connection_id = get_new_connection_id_cb;
-    ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(false, callbacks);
+    ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(false, callbacks, PLAINTEXT_PROFILE);
 
     ngtcp2_settings settings = {0};
-    ngtcp2_plaintext::set_default_ngtcp2_settings(false, settings, log_printf, timestamp());
+    ngtcp2_plaintext::set_default_ngtcp2_settings(false, settings, log_printf, loop_timestamp());
+    settings.cc_algo = CC_ALGO;
+    settings.max_udp_payload_size = MAX_UDP_PAYLOAD_SIZE;
+    settings.no_pmtud = !PMTUD_ENABLED;
 
     ngtcp2_transport_params params = {0};
     ngtcp2_plaintext::set_default_ngtcp2_transport_params(false, params);
+    params.max_udp_payload_size = MAX_UDP_PAYLOAD_SIZE;
 
     ngtcp2_cid dcid, scid;
-    ngtcp2_plaintext::preset_fixed_dcid_scid(false, dcid, scid);
+    ngtcp2_plaintext::preset_fixed_dcid_scid(false, dcid, scid, PLAINTEXT_PROFILE);
 
     ngtcp2_conn *conn = ngtcp2_plaintext::create_handshaked_ngtcp2_conn(
         false,
@@ -297,14 +394,15 @@ int main()
         (const sockaddr *)(&local_addr), local_addrlen,
         (const sockaddr *)(&remote_addr), remote_addrlen,
         callbacks, settings, params,
-        connection.get() /* user_data */
-    );
+        connection.get() /* user_data */,
+        connection->get_mem(), PLAINTEXT_PROFILE);
     if (!conn)
     {
         fprintf(stderr, "Error [%s] [ngtcp2_plaintext::create_handshaked_ngtcp2_conn]: ret = nullptr.", __func__);
         return -1;
     }
     connection->steal_ngtcp2_conn(conn);
+    ECHO_PROBE1(conn_create, connection.get());
 
     cli.set_connection(connection);
 
@@ -320,6 +418,9 @@ int main()
     cli.socket_fd_watcher.data = &cli;
     ev_io_start(loop, &(cli.socket_fd_watcher));
 
+    ev_io_init(&(cli.socket_fd_write_watcher), socket_fd_write_cb, cli.get_connection()->get_socket_fd(), EV_WRITE); // 监测 socket_fd 可写的 io watcher，仅在有暂存的待发送 packet 时开启
+    cli.socket_fd_write_watcher.data = &cli;
+
     ev_timer_init(&(cli.ngtcp2_timer_watcher), timer_cb, /*after = */ 0, /*repeat = */ 0); // 驱动 ngtcp2 工作的时钟
     cli.ngtcp2_timer_watcher.data = &cli;
 
@@ -17,6 +17,7 @@ public:
     /* 为了方便，把这些变量设置成了 public */
     ev_io stdin_watcher;           // libev 中，用来监测 stdin 可读的 io watcher
     ev_io socket_fd_watcher;       // libev 中，用来监测 socket fd 可读的 io watcher
+    ev_io socket_fd_write_watcher; // libev 中，用来监测 socket fd 可写的 io watcher，仅在 connection 有暂存的待发送 packet 时开启
     ev_timer ngtcp2_timer_watcher; // libev 中，用来驱动 ngtcp2 工作的时钟
 
     size_t coalesce_limit;
@@ -25,7 +26,7 @@ public:
 public:
     EchoClient(size_t coalesce_limit = 1)
         : connection(nullptr),
-          stdin_watcher(), ngtcp2_timer_watcher(),
+          stdin_watcher(), socket_fd_watcher(), socket_fd_write_watcher(), ngtcp2_timer_watcher(),
           coalesce_limit(coalesce_limit), coalesce_count(0)
     {
     }
@@ -1,24 +1,51 @@
 #include <cstring>
 #include <vector>
+#include <algorithm>
 #include <assert.h>
 
 #include <unistd.h>
 
 #include "client.h"
 #include "utils.h"
+#include "plaintext.h"
 
 namespace
 {
     constexpr size_t BUF_SIZE = 1280;
+
+    // 将 pkts 中的每个 packet 填入 iov，返回 iovec 的数量，iov 至少要有 pkts.size() 个元素。
+    size_t fill_iovec(const std::vector<PacketBuffer> &pkts, iovec *iov)
+    {
+        for (size_t i = 0; i < pkts.size(); ++i)
+        {
+            iov[i].iov_base = const_cast<uint8_t *>(pkts[i].data());
+            iov[i].iov_len = pkts[i].size();
+        }
+
+        return pkts.size();
+    }
 } /* namespace */
 
-Connection::Connection(int sock_fd, size_t n_streams_max)
-    : conn(nullptr), socket_fd(sock_fd),
-      local_addr{0}, local_addrlen(0),
-      remote_addr{0}, remote_addrlen(0),
-      streams_capacity(n_streams_max), streams(),
-      all_streams_id(), cur_stream_idx(0),
-      last_error(), is_closed(false)
+Connection::Connection(int sock_fd, size_t n_streams_max, bool compact)
+    : arena(compact ? COMPACT_ARENA_CHUNK_SIZE : Arena::CHUNK_SIZE), conn(nullptr), socket_fd(sock_fd), socket_connected(false),
+      local_addr(), local_addrlen(0),
+      remote_addr(), remote_addrlen(0),
+      streams_capacity(n_streams_max), streams(), cur_stream_idx(0),
+      compact(compact),
+      last_error(), is_closed(false),
+      max_pktlen(BUF_SIZE), path_max_pktlen(0),
+      pending_tx(),
+      tx_burst_ts(0), tx_burst_bytes(0), tx_burst_limit(SIZE_MAX),
+      txtime_enabled(false),
+      tx_pkt(), tx_batch(), tx_batch_bytes(0), tx_batch_gso_size(0),
+      tx_batch_ecn(NGTCP2_ECN_NOT_ECT), tx_batch_txtime(0), gso_enabled(false),
+      tx_protection_deferred(false),
+      zerocopy_enabled(false), zerocopy_next_seq(0), zerocopy_inflight(),
+      zerocopy_sends(0), zerocopy_copied(0),
+      send_ecn(NGTCP2_ECN_NOT_ECT),
+      last_rx_ts(0),
+      rx_queue_delay_count(0), rx_queue_delay_sum(0), rx_queue_delay_max(0),
+      rxq_drops(0), recv_buf_max(0)
 {
     ngtcp2_connection_close_error_default(&(this->last_error));
 }
@@ -26,6 +53,10 @@ Connection::Connection(int sock_fd, size_t n_streams_max)
 Connection::~Connection()
 {
     assert(this->conn);
+    printf("Debug [%s]: ngtcp2 live memory = %zu bytes, connection footprint = %zu bytes.\n", __func__,
+           this->arena.get_live_bytes(), this->get_footprint());
+    // ngtcp2_conn_del 仍会遍历并逐个释放 lib ngtcp2 中的对象（同时释放 crypto context 等），只是这些 free 都落在 arena 上，
+    // 仅把块挂回 free list；之后 arena 随 Connection 一起析构，再把所有 chunk 一次性归还给系统。
     ngtcp2_conn_del(this->conn);
 }
 
@@ -35,17 +66,61 @@ int Connection::steal_ngtcp2_conn(ngtcp2_conn *&conn)
         return -1;
 
     this->conn = steal_pointer(conn);
+
+    this->max_pktlen = std::max(ngtcp2_conn_get_max_udp_payload_size(this->conn), BUF_SIZE);
+    if (this->max_pktlen > PacketBuffer::CAPACITY)
+    {
+        fprintf(stderr, "Error [%s]: max udp payload size %zu exceeds packet buffer capacity.\n", __func__, this->max_pktlen);
+        this->max_pktlen = PacketBuffer::CAPACITY;
+    }
+
+    this->tx_protection_deferred = ngtcp2_plaintext::is_tx_protection_deferred(this->conn);
+
     return 0;
 }
 
+size_t Connection::get_footprint() const
+{
+    size_t bytes = sizeof(*this) + this->arena.get_reserved_bytes();
+
+    bytes += this->streams.capacity() * sizeof(std::shared_ptr<Stream>);
+    for (const auto &stream : this->streams) // make_shared 将 Stream 与引用计数分配在一起
+        bytes += sizeof(Stream) + 2 * sizeof(long) + (stream->has_buf() ? Stream::STREAM_BUF_CAPACITY : 0);
+
+    // 仍被该 connection 持有的 packet buffer（来自 slab）
+    bytes += this->tx_pkt.capacity();
+    for (const auto &pb : this->tx_batch)
+        bytes += pb.capacity();
+    for (const auto &pkt : this->pending_tx)
+        for (const auto &pb : pkt.pkts)
+            bytes += pb.capacity();
+    for (const auto &kv : this->zerocopy_inflight)
+        for (const auto &pb : kv.second)
+            bytes += pb.capacity();
+
+    return bytes;
+}
+
 void Connection::set_local_addr(const sockaddr *local_addr, socklen_t local_addrlen)
 {
+    if (local_addrlen > sizeof(this->local_addr))
+    {
+        fprintf(stderr, "Error [%s]: unsupported address family %d.\n", __func__, local_addr->sa_family);
+        return;
+    }
+
     memcpy(&(this->local_addr), local_addr, local_addrlen);
     this->local_addrlen = local_addrlen;
 }
 
 void Connection::set_remote_addr(const sockaddr *remote_addr, socklen_t remote_addrlen)
 {
+    if (remote_addrlen > sizeof(this->remote_addr))
+    {
+        fprintf(stderr, "Error [%s]: unsupported address family %d.\n", __func__, remote_addr->sa_family);
+        return;
+    }
+
     memcpy(&(this->remote_addr), remote_addr, remote_addrlen);
     this->remote_addrlen = remote_addrlen;
 }
@@ -58,55 +133,134 @@ int Connection::new_stream(int64_t stream_id)
     if (get_streams_count() >= get_streams_capacity()) // 如果 streams 的数量已经达到 streams 容量的上限，则不再增加新的 stream
         return 0;
 
-    streams[stream_id] = std::make_shared<Stream>(stream_id);
-    all_streams_id.push_back(stream_id);
+    // stream_id 通常是递增的，此时相当于 push_back
+    streams.insert(streams.begin() + (lower_bound_stream(stream_id) - streams.begin()), std::make_shared<Stream>(stream_id));
+
+    ECHO_PROBE2(stream_open, this, stream_id);
 
     return 0;
 }
 
+std::vector<std::shared_ptr<Stream>>::const_iterator Connection::lower_bound_stream(int64_t stream_id) const
+{
+    return std::lower_bound(streams.begin(), streams.end(), stream_id,
+                            [](const std::shared_ptr<Stream> &stream, int64_t id) { return stream->get_id() < id; });
+}
+
 std::shared_ptr<Stream> Connection::get_stream(int64_t stream_id) const
 {
-    auto iter = streams.find(stream_id);
+    auto iter = lower_bound_stream(stream_id);
 
-    if (iter == streams.end())
+    if (iter == streams.end() || (*iter)->get_id() != stream_id)
         return nullptr;
 
-    return iter->second;
+    return *iter;
 }
 
 int Connection::step_cur_stream()
 {
-    if (all_streams_id.empty())
+    if (streams.empty())
         return -1;
 
-    cur_stream_idx = (cur_stream_idx + 1) % all_streams_id.size();
+    cur_stream_idx = (cur_stream_idx + 1) % streams.size();
     return 0;
 }
 
 int64_t Connection::get_cur_stream_id() const
 {
-    if (cur_stream_idx < 0 || cur_stream_idx >= all_streams_id.size())
+    if (cur_stream_idx >= streams.size())
         return -1;
 
-    return all_streams_id.at(cur_stream_idx);
+    return streams.at(cur_stream_idx)->get_id();
+}
+
+ngtcp2_tstamp Connection::get_rx_timestamp(const RecvPacketInfo &info, int64_t clock_offset)
+{
+    ngtcp2_tstamp now = loop_timestamp(); // application 开始处理这批 packet 的时刻，使得整批 packet 的时间戳都不超过之后的发送时刻
+    ngtcp2_tstamp ts = now;
+
+    if (info.rx_timestamp)
+    {
+        int64_t rx_ts = (int64_t)info.rx_timestamp - clock_offset; // 转换到 CLOCK_MONOTONIC 时间基准下
+        if (rx_ts > 0 && (ngtcp2_tstamp)rx_ts < now)             // 两个时钟的差值在采样之后可能被 NTP 调整，此时退回到当前时刻
+            ts = (ngtcp2_tstamp)rx_ts;
+    }
+
+    if (ts < this->last_rx_ts)
+        ts = this->last_rx_ts;
+    this->last_rx_ts = ts;
+
+    ngtcp2_duration delay = now - ts;
+    ++(this->rx_queue_delay_count);
+    this->rx_queue_delay_sum += delay;
+    ECHO_PROBE2(rx_queue_delay, this, delay);
+    if (delay > this->rx_queue_delay_max) // 只在出现新的最大值时输出，其余的统计通过 USDT probe 获取
+    {
+        this->rx_queue_delay_max = delay;
+        printf("Debug [%s]: new rx queue delay max = %zu ns (avg = %zu ns).\n", __func__, delay, this->get_rx_queue_delay_avg());
+    }
+
+    return ts;
+}
+
+void Connection::update_rxq_drops(uint32_t drops)
+{
+    if (drops <= this->rxq_drops) // 没有新的丢包
+        return;
+
+    uint32_t new_drops = drops - this->rxq_drops;
+    this->rxq_drops = drops;
+    ECHO_PROBE3(rxq_drops, this, new_drops, drops);
+    printf("Debug [%s]: socket fd = %d, %u new rxq drops (total %u).\n", __func__, this->socket_fd, new_drops, drops);
+
+    if (this->recv_buf_max == 0)
+        return;
+
+    int cur_size = get_recv_buffer_size(this->socket_fd);
+    if (cur_size < 0)
+        return;
+
+    // bandwidth-delay product：取拥塞窗口与 delivery rate * smoothed RTT 中的较大者
+    ngtcp2_conn_stat cstat;
+    ngtcp2_conn_get_conn_stat(this->conn, &cstat);
+    uint64_t bdp = std::max(cstat.cwnd, cstat.delivery_rate_sec * cstat.smoothed_rtt / NGTCP2_SECONDS);
+
+    // 发生丢包说明缓冲区至少不够用，至少翻倍，同时保证能容纳两个 BDP 的突发
+    size_t target = std::max<size_t>((size_t)cur_size * 2, bdp * 2);
+    target = std::min(target, this->recv_buf_max);
+    if (target <= (size_t)cur_size)
+        return;
+
+    if (set_socket_buffer_size(this->socket_fd, (int)target, 0) == 0)
+        printf("Debug [%s]: %u new rxq drops, grow socket recv buffer %d -> %zu bytes (bdp = %zu).\n", __func__, new_drops, cur_size, target, bdp);
 }
 
 int Connection::read()
 {
-    uint8_t buf[BUF_SIZE];
+    PacketBuffer pb = PacketBuffer::acquire(); // 本次 read() 结束时归还给 slab
+    if (!pb)
+        return -1;
+
+    uint8_t *buf = pb.data();
+
+    int64_t clock_offset = realtime_clock_offset();
+    uint32_t rxq_drops = this->rxq_drops;
 
     while (true)
     {
         struct sockaddr_storage remote_addr;
         socklen_t remote_addrlen = sizeof(remote_addr);
 
-        ssize_t ret = recv_packet(this->socket_fd, buf, sizeof(buf), (sockaddr *)&remote_addr, &remote_addrlen);
+        RecvPacketInfo info;
+
+        ssize_t ret = recv_packet(this->socket_fd, buf, PacketBuffer::CAPACITY, (sockaddr *)&remote_addr, &remote_addrlen, &info);
         if (ret < 0)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK) // EAGAIN 与 EWOULDBLOCK 等价
             {
                 // 注意 recv_packet 中对 socket_fd 读取时是采用 non-block 方式，因此 EAGAIN 不能算作是错误，只需要再次调用 recvmsg 即可。
                 // 但为了防止阻塞整个 event loop，直接 break 出 while 循环，当 event loop 里下次触发 socket fd 读事件时再来读即可。
+                this->update_rxq_drops(rxq_drops);
                 break;
             }
 
@@ -114,14 +268,18 @@ int Connection::read()
             break; // return -1;
         }
 
+        ECHO_PROBE2(pkt_recv, this, ret);
+        rxq_drops = std::max(rxq_drops, info.rxq_drops);
+
         ngtcp2_path path; // path 用来表明收到的这个 QUIC packet 的网络路径
         memcpy(&path, ngtcp2_conn_get_path(this->conn), sizeof(path));
         path.remote.addrlen = remote_addrlen;
         path.remote.addr = (sockaddr *)&remote_addr;
 
         ngtcp2_pkt_info pi = {0}; // packet metadata
+        pi.ecn = info.ecn;
 
-        ret = this->read_packet(path, pi, buf, ret, timestamp());
+        ret = this->read_packet(path, pi, buf, ret, this->get_rx_timestamp(info, clock_offset));
         if (ret < 0)
         {
             fprintf(stderr, "Error [%s] [this->read_packet (i.e. ngtcp2_conn_read_pkt)]: ngtcp2_liberr = %s.", __func__, ngtcp2_strerror(ret));
@@ -134,7 +292,27 @@ int Connection::read()
 
 int Connection::write()
 {
-    int ret;
+    int ret = this->flush_pending_tx();
+    if (ret < 0)
+        return -1;
+
+    if (this->has_pending_tx()) // socket 仍然不可写，不再产生新的 packet，等待 socket 可写时再来
+        return 0;
+
+    this->tx_burst_ts = loop_timestamp();
+    this->tx_burst_bytes = 0;
+
+    // 只有开启 pacing 时才按 send quantum 限制一轮 burst 的长度，否则一次写到拥塞窗口（或数据）耗尽为止
+    ngtcp2_conn_stat cstat;
+    ngtcp2_conn_get_conn_stat(this->conn, &cstat);
+    this->tx_burst_limit = (cstat.pacing_rate > 0 ? ngtcp2_conn_get_send_quantum(this->conn) : SIZE_MAX);
+
+    size_t path_max_pktlen = ngtcp2_conn_get_path_max_udp_payload_size(this->conn);
+    if (path_max_pktlen != this->path_max_pktlen) // PMTUD 探测到了新的 path MTU
+    {
+        printf("Debug [%s]: path max udp payload size %zu -> %zu.\n", __func__, this->path_max_pktlen, path_max_pktlen);
+        this->path_max_pktlen = path_max_pktlen;
+    }
 
     if (this->streams.empty()) // 如果当前 connection 中还没有建立任何一条 stream
     {
@@ -145,15 +323,27 @@ int Connection::write()
     }
     else
     {
-        for (const auto &kv : this->streams)
+        for (const auto &stream : this->streams)
         {
-            ret = this->write_one_stream(kv.second);
+            ret = this->write_one_stream(stream);
 
             if (ret < 0)
                 return -1;
+
+            if (this->has_pending_tx()) // 写当前 stream 时遇到了 EAGAIN，其余的 stream 等到 socket 可写时再写
+                break;
+
+            if (this->tx_burst_bytes >= this->tx_burst_limit) // 本轮 burst 已经写满，其余的 stream 等到下一轮再写
+                break;
         }
     }
 
+    this->flush_tx_batch(); // 发送本轮 burst 中剩余的 batch
+    this->tx_pkt.reset();   // 归还给 slab，供其他 connection 使用
+
+    // 根据本轮 burst 写出的字节数计算下一轮 burst 的时刻，未开启 pacing 时该函数什么也不做。
+    ngtcp2_conn_update_pkt_tx_time(this->conn, this->tx_burst_ts);
+
     return 0;
 }
 
@@ -161,14 +351,12 @@ int Connection::write_one_stream(std::shared_ptr<Stream> stream)
 {
     printf("Debug [%s]: now is writing stream #%zd.\n", __func__, (stream ? stream->get_id() : -1));
 
-    uint8_t buf[BUF_SIZE];
-
     ngtcp2_path_storage ps;
     ngtcp2_path_storage_zero(&ps);
 
     ngtcp2_pkt_info pi;
 
-    uint64_t ts = timestamp();
+    uint64_t ts = this->tx_burst_ts;
 
     uint32_t flags = NGTCP2_WRITE_DATAGRAM_FLAG_NONE;
 
@@ -206,8 +394,18 @@ int Connection::write_one_stream(std::shared_ptr<Stream> stream)
         ngtcp2_ssize n_read;    // 用来记录：当前传入的 datav 中有多少数据被读取到 packet 里了，不会超过 datav.len
         ngtcp2_ssize n_written; // 用来记录：当前写入到 buf 里的 packet，占用了 buf 多少个字节
 
+        // 写到 tx_pkt 中，若返回 NGTCP2_ERR_WRITE_MORE，下次调用时仍写到同一个 tx_pkt 中。
+        // tx_pkt 按照当前 path 的长度上限（有 PMTUD probe 待发送时按 probe 的长度）从 slab 中取出，ngtcp2 会把普通的 packet 限制在 path 的长度上限内。
+        uint8_t *buf = this->get_tx_pkt();
+        if (!buf)
+            return 0; // slab 申请内存失败，等待 ngtcp2 timer 到期后再写
+
+        // ngtcp2 即将发起 key update 并销毁当前的 tx key，先把用当前 tx key 写出的、尚未加密的 batch 加密并发送出去
+        if (this->tx_protection_deferred && !this->tx_batch.empty() && ngtcp2_plaintext::is_tx_key_update_due(this->conn))
+            this->flush_tx_batch();
+
         n_written = ngtcp2_conn_writev_stream(this->conn, &ps.path, &pi,
-                                              buf, sizeof(buf),
+                                              buf, std::min(this->tx_pkt.capacity(), this->max_pktlen),
                                               &n_read,
                                               flags,
                                               stream_id,
@@ -226,6 +424,13 @@ int Connection::write_one_stream(std::shared_ptr<Stream> stream)
                 continue; // 不需要做别的事情，再次调用 ngtcp2_conn_writev_stream 写更多的数据即可
             }
 
+            if (n_written == NGTCP2_ERR_STREAM_DATA_BLOCKED)
+            {
+                // 该 stream 受到 flow control 限制，暂时不能再写入 stream data，这并不是致命错误，等待对端的 MAX_STREAM_DATA 即可。
+                ECHO_PROBE2(stream_blocked, this, stream_id);
+                return 0;
+            }
+
             fprintf(stderr, "Error [%s] [ngtcp2_conn_writev_stream] ngtcp2_liberr = %s.\n", __func__, ngtcp2_strerror((int)n_written));
             ngtcp2_connection_close_error_set_transport_error_liberr(&(this->last_error), (int)n_written, nullptr, 0);
 
@@ -236,34 +441,287 @@ int Connection::write_one_stream(std::shared_ptr<Stream> stream)
         {
             // 该函数返回 0，表明没有成功写任何 STREAM frame 到 packet 中，原因是缓冲区太小或受拥塞限制。（首先确认我们设置了足够大的 buf）
             // 此时 application 不应该再调用 ngtcp2_conn_writev_stream 尝试写新的 STREAM frame 到 packet，应当等待拥塞窗口的增长。
+            ECHO_PROBE2(cwnd_blocked, this, stream_id);
             return 0;
         }
 
         if (stream && n_read > 0) // 注意 stream->mark_sent 是增量式的标记，若 n_read == 0 则没必要调用 stream->mark_sent
             stream->mark_sent(n_read);
 
-        /* 调用 send_packet 来往 socket fd 中送入 packet */
-        printf("Debug [%s]: to call [send_packet] with socket_fd = %d, n_written = %zd.\n", __func__, this->socket_fd, n_written);
-        debug_print_sockaddr((sockaddr *)&(this->remote_addr), this->remote_addrlen);
-        int ret = send_packet(this->socket_fd, buf, n_written,
-                              (sockaddr *)&(this->remote_addr), this->remote_addrlen);
-        if (ret < 0)
-        {
-            printf("Error [%s] [send_packet]: ret = %d, errno = %s.\n", __func__, ret, strerror(errno));
+        /* 将 packet 加入 GSO batch，batch 凑满时会调用 send_packet 送入 socket fd */
+        printf("Debug [%s]: packet with n_written = %zd is appended to tx batch.\n", __func__, n_written);
+        this->append_tx_batch(n_written, pi.ecn);
+        this->tx_burst_bytes += n_written;
 
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                break; // 为了不阻塞整个 event loop，直接 break 出 while 循环
+        if (this->has_pending_tx()) // 遇到了 EAGAIN，为了不阻塞整个 event loop，直接 break 出 while 循环，在 pending_tx 清空前不再产生新的 packet
+            break;
 
-                // 我们既然已经对 stream 中的这部分数据标记了 sent，但实际最终却没有发送成功，按理来说不应该直接 break，应该反复尝试发送才对。
-                // 我推测：将这部分数据最终正确发送给对端，这个责任应该是交给 ngtcp2 内部的重传机制了。
-            }
+        if (datav.len == 0) // 已经没有 stream data 可发送了，跳出循环
+            break;
+
+        if (this->tx_burst_bytes >= this->tx_burst_limit) // 本轮 burst 已经写满了 send quantum，剩余数据等待 pacing timer 到期后再写
+            break;
+    }
+
+    return 0;
+}
+
+ngtcp2_tstamp Connection::get_pkt_txtime() const
+{
+    if (!this->txtime_enabled)
+        return 0;
+
+    ngtcp2_conn_stat cstat;
+    ngtcp2_conn_get_conn_stat(this->conn, &cstat);
+
+    if (!(cstat.pacing_rate > 0)) // 未开启 pacing
+        return 0;
+
+    // pacing_rate 的单位是 bytes/ns，与 ngtcp2_conn_update_pkt_tx_time 中计算下一轮 burst 时刻的方式一致。
+    return this->tx_burst_ts + static_cast<ngtcp2_duration>(static_cast<double>(this->tx_burst_bytes) / cstat.pacing_rate);
+}
+
+size_t Connection::get_tx_pktlen()
+{
+    size_t pktlen = std::max(ngtcp2_conn_get_path_max_udp_payload_size(this->conn), ngtcp2_conn_get_pmtud_probelen(this->conn));
+    return std::min(pktlen, this->max_pktlen);
+}
+
+uint8_t *Connection::get_tx_pkt()
+{
+    if (!this->tx_pkt)
+        this->tx_pkt = PacketBuffer::acquire(this->get_tx_pktlen());
+
+    return this->tx_pkt.data();
+}
 
-            break; // 替换原先的 `return -1;`
+void Connection::append_tx_batch(size_t pktlen, uint32_t ecn)
+{
+    this->tx_pkt.set_size(pktlen);
+
+    // 新的 packet 与当前 batch 不兼容（ECN 不同、比 gso_size 更长，或者加入后 batch 过长），则先将当前的 batch 发送出去，新的 packet 作为新 batch 的开头。
+    if (!this->tx_batch.empty() &&
+        (ecn != this->tx_batch_ecn || pktlen > this->tx_batch_gso_size || this->tx_batch_bytes + pktlen > TX_BATCH_MAX_BYTES))
+        this->flush_tx_batch();
+
+    if (this->has_pending_tx()) // 之前的 packet 遇到了 EAGAIN，新的 packet 也只能排队
+    {
+        std::vector<PacketBuffer> pkts;
+        pkts.push_back(std::move(this->tx_pkt));
+        if (this->enqueue_pending_tx(std::move(pkts), ecn) < 0)
+            fprintf(stderr, "Error [%s] [this->enqueue_pending_tx]: pending_tx is full, drop the packet.\n", __func__);
+        return;
+    }
+
+    if (this->tx_batch.empty())
+    {
+        this->tx_batch.reserve(TX_BATCH_MAX_SEGMENTS);
+        this->tx_batch_gso_size = pktlen;
+        this->tx_batch_ecn = ecn;
+        this->tx_batch_txtime = this->get_pkt_txtime();
+    }
+
+    this->tx_batch.push_back(std::move(this->tx_pkt));
+    this->tx_batch_bytes += pktlen;
+
+    // 未开启 GSO、batch 已满，或者该 packet 比 gso_size 更短（只能是 batch 的最后一个）时，立即发送
+    if (!this->gso_enabled || this->tx_batch.size() >= TX_BATCH_MAX_SEGMENTS || pktlen < this->tx_batch_gso_size)
+        this->flush_tx_batch();
+}
+
+int Connection::protect_tx_packets(std::vector<PacketBuffer> &pkts)
+{
+    uint8_t *bufs[TX_BATCH_MAX_SEGMENTS];
+    size_t lens[TX_BATCH_MAX_SEGMENTS];
+
+    assert(pkts.size() <= TX_BATCH_MAX_SEGMENTS);
+    for (size_t i = 0; i < pkts.size(); ++i)
+    {
+        bufs[i] = pkts[i].data();
+        lens[i] = pkts[i].size();
+    }
+
+    return ngtcp2_plaintext::protect_tx_packets(this->conn, bufs, lens, pkts.size());
+}
+
+void Connection::flush_tx_batch()
+{
+    if (this->tx_batch.empty())
+        return;
+
+    // 整个 batch 一起加密：之后无论是发送出去、移动到 pending_tx 还是 zerocopy_inflight，都已经是加密后的 packet
+    if (this->tx_protection_deferred && this->protect_tx_packets(this->tx_batch) < 0)
+    {
+        fprintf(stderr, "Error [%s] [this->protect_tx_packets]: failed to protect %zu packets, drop them.\n", __func__, this->tx_batch.size());
+        this->tx_batch.clear();
+        this->tx_batch_bytes = 0;
+        return;
+    }
+
+    iovec iov[TX_BATCH_MAX_SEGMENTS];
+    size_t iovcnt = fill_iovec(this->tx_batch, iov);
+    size_t data_size = this->tx_batch_bytes;
+
+    SendPacketInfo si = {0};
+    si.txtime = this->tx_batch_txtime;
+    si.gso_size = (iovcnt > 1 ? this->tx_batch_gso_size : 0);
+
+    // 较小的 batch 用 zerocopy 反而得不偿失（需要 pin 住页面并处理完成通知）；等待完成通知的 batch 过多时也退回到拷贝发送
+    si.zerocopy = (this->zerocopy_enabled &&
+                   data_size >= ZEROCOPY_MIN_BYTES &&
+                   this->zerocopy_inflight.size() < ZEROCOPY_MAX_INFLIGHT);
+
+    this->update_send_ecn(this->tx_batch_ecn);
+    printf("Debug [%s]: to call [send_packet] with socket_fd = %d, data_size = %zu, gso_size = %zu, zerocopy = %d.\n",
+           __func__, this->socket_fd, data_size, si.gso_size, si.zerocopy);
+
+    ssize_t ret = send_packet(this->socket_fd, iov, iovcnt,
+                              this->get_send_addr(), this->get_send_addrlen(), &si);
+    if (ret < 0 && si.zerocopy && errno == ENOBUFS) // 超出了 optmem 的限制，退回到拷贝发送
+    {
+        si.zerocopy = false;
+        ret = send_packet(this->socket_fd, iov, iovcnt,
+                          this->get_send_addr(), this->get_send_addrlen(), &si);
+    }
+
+    bool gso_disabled = false;
+
+    if (ret < 0 && si.gso_size && errno == EIO)
+    {
+        // 网卡不支持 UDP GSO（例如没有 checksum offload），关闭 GSO，将 batch 中的 packet 逐个移动到 pending_tx 中，随后立即发送
+        fprintf(stderr, "Error [%s] [send_packet]: UDP GSO is not supported, disable it.\n", __func__);
+        this->gso_enabled = false;
+        gso_disabled = true;
+
+        size_t n_dropped = 0;
+        for (auto &pb : this->tx_batch)
+        {
+            std::vector<PacketBuffer> pkts;
+            pkts.push_back(std::move(pb));
+            if (this->enqueue_pending_tx(std::move(pkts), this->tx_batch_ecn) < 0)
+                ++n_dropped;
+        }
+        if (n_dropped)
+            fprintf(stderr, "Error [%s] [this->enqueue_pending_tx]: pending_tx is full, drop %zu packets.\n", __func__, n_dropped);
+    }
+    else if (ret < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // EAGAIN 是正常的背压信号，不打印日志（可以通过 send_eagain probe 观测）。
+            // 这些 packet 已经被 ngtcp2 记为已发送，因此不能丢弃，直接移动到 pending_tx 中，等 socket 可写时再发送。
+            ECHO_PROBE2(send_eagain, this, data_size);
+            if (this->enqueue_pending_tx(std::move(this->tx_batch), this->tx_batch_ecn, si.gso_size) < 0)
+                fprintf(stderr, "Error [%s] [this->enqueue_pending_tx]: pending_tx is full, drop the packet.\n", __func__);
         }
+        else
+        {
+            fprintf(stderr, "Error [%s] [send_packet]: ret = %zd, errno = %s.\n", __func__, ret, strerror(errno));
+        }
+    }
+    else
+    {
+        ECHO_PROBE2(pkt_send, this, data_size);
 
-        if (datav.len == 0) // 已经没有 stream data 可发送了，跳出循环
+        if (si.zerocopy) // 在收到完成通知之前这些 buffer 不能被改写，移动到 zerocopy_inflight 中
+        {
+            ++(this->zerocopy_sends);
+            this->zerocopy_inflight.emplace_back(this->zerocopy_next_seq++, std::move(this->tx_batch));
+        }
+    }
+
+    this->tx_batch.clear(); // 其余情况下 buffer 直接归还给 slab
+    this->tx_batch_bytes = 0;
+
+    if (gso_disabled)
+        this->flush_pending_tx(); // GSO 刚被关闭时，立即发送拆分后的 packet
+}
+
+void Connection::handle_zerocopy_completions()
+{
+    if (this->zerocopy_inflight.empty())
+        return;
+
+    while (true)
+    {
+        uint32_t lo, hi;
+        bool copied;
+
+        int ret = recv_zerocopy_completion(this->socket_fd, &lo, &hi, &copied);
+        if (ret == 0 || ret < 0)
             break;
+        if (ret != 1)
+            continue;
+
+        if (copied)
+        {
+            // 内核实际上仍然进行了拷贝（例如 loopback），zerocopy 只会徒增开销，因此关闭它
+            ++(this->zerocopy_copied);
+            if (this->zerocopy_enabled)
+                printf("Debug [%s]: kernel copied zerocopy sends [%u, %u], disable zerocopy.\n", __func__, lo, hi);
+            this->zerocopy_enabled = false;
+        }
+
+        // 完成通知按序号递增的顺序到达，序号在 [lo, hi] 之内的 buffer 归还给 slab
+        while (!this->zerocopy_inflight.empty() &&
+               (int32_t)(this->zerocopy_inflight.front().first - lo) >= 0 &&
+               (int32_t)(hi - this->zerocopy_inflight.front().first) >= 0)
+            this->zerocopy_inflight.pop_front();
+    }
+}
+
+int Connection::enqueue_pending_tx(std::vector<PacketBuffer> &&pkts, uint32_t ecn, size_t gso_size)
+{
+    if (this->pending_tx.size() >= PENDING_TX_CAPACITY)
+        return -1;
+
+    PendingPacket pkt;
+    pkt.pkts = std::move(pkts);
+    pkt.ecn = ecn;
+    pkt.gso_size = gso_size;
+
+    this->pending_tx.push_back(std::move(pkt));
+    return 0;
+}
+
+void Connection::update_send_ecn(uint32_t ecn)
+{
+    if (this->send_ecn == ecn)
+        return;
+
+    if (set_send_ecn(this->socket_fd, this->local_addr.sa.sa_family, ecn) == 0)
+        this->send_ecn = ecn;
+}
+
+int Connection::flush_pending_tx()
+{
+    while (!this->pending_tx.empty())
+    {
+        const PendingPacket &pkt = this->pending_tx.front();
+
+        iovec iov[TX_BATCH_MAX_SEGMENTS];
+        size_t iovcnt = fill_iovec(pkt.pkts, iov);
+
+        SendPacketInfo si = {0};
+        si.gso_size = pkt.gso_size;
+
+        this->update_send_ecn(pkt.ecn);
+        ssize_t ret = send_packet(this->socket_fd, iov, iovcnt,
+                                  this->get_send_addr(), this->get_send_addrlen(), &si);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) // socket 发送缓冲区仍然是满的，保留剩余的 packet
+                return 0;
+
+            // 与 write_one_stream 中的处理保持一致：其他错误不视为致命错误，丢弃该 packet 即可。
+            fprintf(stderr, "Error [%s] [send_packet]: errno = %s.\n", __func__, strerror(errno));
+        }
+        else
+        {
+            ECHO_PROBE2(pkt_send, this, ret);
+        }
+
+        this->pending_tx.pop_front();
     }
 
     return 0;
@@ -276,10 +734,14 @@ void Connection::close()
 
     this->is_closed = true;
 
+    ECHO_PROBE2(conn_close, this, this->last_error.error_code);
+
     if (ngtcp2_conn_is_in_closing_period(this->conn) || !(this->last_error.error_code))
         return;
 
-    uint8_t buf[BUF_SIZE];
+    PacketBuffer pb = PacketBuffer::acquire(this->get_tx_pktlen());
+    if (!pb)
+        return;
 
     ngtcp2_pkt_info pi;
 
@@ -287,17 +749,31 @@ void Connection::close()
     ngtcp2_path_storage_zero(&ps);
 
     ngtcp2_ssize n_written = ngtcp2_conn_write_connection_close(this->conn, &ps.path, &pi,
-                                                                buf, sizeof(buf),
+                                                                pb.data(), std::min(pb.capacity(), this->max_pktlen),
                                                                 &(this->last_error),
-                                                                timestamp());
+                                                                loop_timestamp());
     if (n_written < 0)
     {
         fprintf(stderr, "Error [%s] [ngtcp2_conn_write_connection_close] ngtcp2_liberr = %s.\n", __func__, ngtcp2_strerror((int)n_written));
         return;
     }
 
-    ssize_t ret = send_packet(this->socket_fd, buf, (size_t)n_written,
-                              (sockaddr *)&(this->remote_addr), this->remote_addrlen);
+    if (this->tx_protection_deferred)
+    {
+        uint8_t *buf = pb.data();
+        size_t len = (size_t)n_written;
+        if (ngtcp2_plaintext::protect_tx_packets(this->conn, &buf, &len, 1) < 0)
+        {
+            fprintf(stderr, "Error [%s] [ngtcp2_plaintext::protect_tx_packets]: failed to protect CONNECTION_CLOSE packet.\n", __func__);
+            return;
+        }
+    }
+
+    this->update_send_ecn(pi.ecn);
+    ssize_t ret = send_packet(this->socket_fd, pb.data(), (size_t)n_written,
+                              this->get_send_addr(), this->get_send_addrlen());
     if (ret < 0)
         fprintf(stderr, "Error [%s] [send_packet] errno = %s.\n", __func__, strerror(errno));
-}
\ No newline at end of file
+    else
+        ECHO_PROBE2(pkt_send, this, n_written);
+}
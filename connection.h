@@ -3,41 +3,124 @@
 
 #include <memory>
 #include <list>
-#include <unordered_map>
 #include <vector>
 
 #include <ngtcp2/ngtcp2.h>
 
 #include "stream.h"
+#include "arena.h"
+#include "pktbuf.h"
+#include "utils.h"
+#include "probes.h"
 
 class Connection
 {
+public:
+    static constexpr size_t PENDING_TX_CAPACITY = 64;         // pending_tx 中最多暂存的 packet 数量
+    static constexpr size_t TX_BATCH_MAX_SEGMENTS = 32;       // 一个 GSO batch 中最多包含的 packet 数量（内核上限为 64）
+    static constexpr size_t TX_BATCH_MAX_BYTES = 65507;       // 一个 GSO batch 的总长度上限，即一个 IPv4 UDP datagram 的最大 payload
+    static constexpr size_t ZEROCOPY_MIN_BYTES = 16 * 1024;   // 只有不小于该长度的 batch 才使用 MSG_ZEROCOPY，更小的 batch 直接拷贝反而更省
+    static constexpr size_t ZEROCOPY_MAX_INFLIGHT = 16;       // 最多同时等待完成通知的 zerocopy batch 数量，超出时退回到拷贝发送
+    static constexpr size_t COMPACT_ARENA_CHUNK_SIZE = 8 * 1024; // compact 模式下 arena 每个 chunk 的大小
+
 private:
+    Arena arena;       // lib ngtcp2 为该 connection 分配的所有内存都来自 arena，随 Connection 一起释放
     ngtcp2_conn *conn; // ngtcp2 QUIC connection object
 
     int socket_fd;
+    bool socket_connected; // socket_fd 是否已经 connect 到 remote_addr，若是则发送时不再指定目的地址，以便内核使用缓存的路由
 
-    struct sockaddr_storage local_addr;
+    SockAddr local_addr;
     socklen_t local_addrlen;
 
-    struct sockaddr_storage remote_addr;
+    SockAddr remote_addr;
     socklen_t remote_addrlen;
 
-    size_t streams_capacity;                                      // 开启 stream 数量的上限
-    std::unordered_map<int64_t, std::shared_ptr<Stream>> streams; // map: stream_id -> stream object
+    size_t streams_capacity;                      // 开启 stream 数量的上限
+    std::vector<std::shared_ptr<Stream>> streams; // 所有的 stream object，按 stream_id 升序排列，查找时二分
+    size_t cur_stream_idx;                        // 是 streams 的某个元素的下标，表示当前从 stdin 接收的数据存放到哪一个 stream 中
 
-    std::vector<int64_t> all_streams_id; // 维护所有 streams 的 ID
-    size_t cur_stream_idx;               // 是 all_streams_id 的某个元素的下标，表示当前从 stdin 接收的数据存放到哪一个 stream 中
+    // compact 模式：为大量长期空闲的 connection 节省内存（而不是 CPU），arena 使用更小的 chunk。
+    // 收发 packet 的 buffer 总是在收发时才从 slab 中取出，用完即归还，空闲的 connection 不持有任何 packet buffer。
+    bool compact;
 
     ngtcp2_connection_close_error last_error; // 记录调用 ngtcp2 库函数时最后一个发生的 error
 
     bool is_closed;
 
+    // 本端收发的 UDP payload 的长度上限，即 ngtcp2_conn_get_max_udp_payload_size（settings.max_udp_payload_size），不超过 PacketBuffer::CAPACITY。
+    // 实际发送的 packet 长度由 ngtcp2 根据 PMTUD 的结果决定（ngtcp2_conn_get_path_max_udp_payload_size），但 PMTUD 的 probe packet 可能达到该上限。
+    // 发送用的 buffer 按 get_tx_pktlen() 取，只有接收用的 buffer 才需要 PacketBuffer::CAPACITY 的长度。
+    size_t max_pktlen;
+    size_t path_max_pktlen; // 上一次观测到的当前 path 的 UDP payload 长度上限，仅用于在 PMTUD 更新时打印日志
+
+    // 因 socket 发送缓冲区已满（EAGAIN）而未能送出的 packet，按发送顺序排队，等 socket 可写时再依次发送。
+    // 这些 packet 在 ngtcp2 看来已经发送出去了，直接丢弃会被当作丢包，进而触发 PTO 以及拥塞窗口的收缩。
+    struct PendingPacket
+    {
+        std::vector<PacketBuffer> pkts; // 一个 packet，或者一个 GSO batch 中的所有 packet（直接从 tx_batch 中移动过来）
+        uint32_t ecn;                   // 由 ngtcp2_conn_writev_stream 给出的 ECN codepoint，重新发送时需要保持一致
+        size_t gso_size;                // pkts 是一个 GSO batch 时每个 packet 的长度，否则为 0
+    };
+    std::list<PendingPacket> pending_tx; // 用 list 而不是 deque，为空时不占用任何堆内存
+
+    // 一次 write() 称为一轮 burst。开启 packet pacing（BBR/BBR2）时，一轮 burst 最多写 send quantum 个字节，
+    // 结束后调用 ngtcp2_conn_update_pkt_tx_time 计算下一轮 burst 的时刻，由 ngtcp2 timer 负责在该时刻再次调用 write()。
+    ngtcp2_tstamp tx_burst_ts; // 本轮 burst 开始的时间戳
+    size_t tx_burst_bytes;     // 本轮 burst 已经写出的字节数
+    size_t tx_burst_limit;     // 本轮 burst 可写的字节数上限，即 ngtcp2_conn_get_send_quantum，未开启 pacing 时为 SIZE_MAX
+
+    bool txtime_enabled; // socket_fd 是否开启了 SO_TXTIME，若开启则按照 pacing rate 为 burst 内的每个 packet 指定发送时刻
+
+    // GSO batch：ngtcp2_conn_writev_stream 把 packet 写到从 slab 中取出的 tx_pkt 里，写完后将 tx_pkt 移动到 tx_batch 中，
+    // 凑成一批后用一次 sendmsg（iovec + UDP_SEGMENT）发送。tx_batch 中的 packet 除最后一个外长度都等于 tx_batch_gso_size，且 ECN codepoint 相同。
+    PacketBuffer tx_pkt;                // 正在写入的 packet，ngtcp2_conn_writev_stream 返回 NGTCP2_ERR_WRITE_MORE 时保留到下次调用
+    std::vector<PacketBuffer> tx_batch; // 尚未发送的 packet
+    size_t tx_batch_bytes;              // tx_batch 中所有 packet 的总长度
+    size_t tx_batch_gso_size;
+    uint32_t tx_batch_ecn;
+    ngtcp2_tstamp tx_batch_txtime; // batch 中第一个 packet 的发送时刻（SO_TXTIME）
+    bool gso_enabled;              // 是否使用 UDP GSO，为 false 时每个 batch 只包含一个 packet
+
+    // 发送的 1RTT packet 是否由 application 加密（PROFILE_AES_128_GCM，见 ngtcp2_plaintext::protect_tx_packets）。
+    // 若是，ngtcp2 写出的 packet 尚未加密，在 flush_tx_batch 中整个 GSO batch 一起加密后再发送。
+    bool tx_protection_deferred;
+
+    // MSG_ZEROCOPY：以 zerocopy 方式发送出去的 packet 在收到内核的完成通知之前不能被修改，
+    // 因此连同其序号（socket 上第几次 zerocopy 发送）一起移动到 zerocopy_inflight 中，完成后 buffer 归还给 slab。
+    bool zerocopy_enabled;
+    uint32_t zerocopy_next_seq;
+    std::list<std::pair<uint32_t, std::vector<PacketBuffer>>> zerocopy_inflight;
+    uint64_t zerocopy_sends;  // 统计：以 zerocopy 方式发送的 batch 数量
+    uint64_t zerocopy_copied; // 统计：内核报告实际仍然进行了拷贝的完成通知数量
+
+    uint32_t send_ecn; // socket_fd 当前设置的 ECN codepoint，只有当 packet 要求的 ECN codepoint 改变时才调用 setsockopt
+
+    ngtcp2_tstamp last_rx_ts; // 上一次交给 ngtcp2_conn_read_pkt 的时间戳，保证传给 ngtcp2 的接收时刻单调不减
+
+    // 接收排队时延：从内核收到 packet 到 application 开始处理该 packet 的时长，反映了 event loop 的过载程度。
+    uint64_t rx_queue_delay_count;        // 统计到的 packet 数量
+    ngtcp2_duration rx_queue_delay_sum;   // 排队时延之和
+    ngtcp2_duration rx_queue_delay_max;   // 排队时延的最大值
+
+    uint32_t rxq_drops;  // 最近一次观测到的 SO_RXQ_OVFL 累计丢包数
+    size_t recv_buf_max; // 出现内核丢包时，socket 接收缓冲区自动扩容的上限，0 表示不自动扩容
+
 public:
-    Connection(int sock_fd, size_t n_streams_max);
+    // compact 为 true 时开启 compact 模式，以少量的 malloc/free 为代价换取更小的空闲内存占用。
+    Connection(int sock_fd, size_t n_streams_max, bool compact = false);
     ~Connection();
 
-    // 将 conn 的所有权转移给 Connection 类对象
+    // 获取创建 ngtcp2_conn 时应当传入的 ngtcp2_mem，使得 lib ngtcp2 从该 connection 的 arena 中分配内存。
+    inline const ngtcp2_mem *get_mem() const { return this->arena.get_mem(); }
+
+    // 查询 lib ngtcp2 当前在该 connection 的 arena 中占用的内存（bytes）。
+    inline size_t get_mem_live_bytes() const { return this->arena.get_live_bytes(); }
+
+    // 估算该 connection 当前占用的全部内存（bytes）：Connection 对象本身、arena 向系统申请的内存、streams 以及各个收发缓冲区。
+    size_t get_footprint() const;
+
+    // 将 conn 的所有权转移给 Connection 类对象，并根据 conn 的 max_udp_payload_size 确定收发 packet 的长度上限
     int steal_ngtcp2_conn(ngtcp2_conn *&conn);
 
     // 检查 `conn_to_check` 是否和当前 connection 中所持有的 ngtcp2_conn 对象相同。
@@ -47,6 +130,21 @@ public:
 
     inline int get_socket_fd() const { return this->socket_fd; }
 
+    // 指明 socket_fd 是否已经 connect 到了 remote_addr（参见 create_connected_socket）。
+    inline void set_socket_connected(bool connected) { this->socket_connected = connected; }
+
+    // 指明 socket_fd 是否已经开启了 SO_TXTIME（参见 enable_so_txtime）。
+    inline void set_txtime_enabled(bool enabled) { this->txtime_enabled = enabled; }
+
+    // 指明是否使用 UDP GSO 将多个 packet 合并成一次 sendmsg。
+    inline void set_gso_enabled(bool enabled) { this->gso_enabled = enabled; }
+
+    // 指明 socket_fd 是否已经开启了 SO_ZEROCOPY（参见 enable_zerocopy），开启后较大的 GSO batch 会以 MSG_ZEROCOPY 方式发送。
+    inline void set_zerocopy_enabled(bool enabled) { this->zerocopy_enabled = enabled; }
+
+    // 读取 socket_fd 错误队列中的 MSG_ZEROCOPY 完成通知，将对应的 buffer 归还给 slab。应当在 socket_fd 可读时调用。
+    void handle_zerocopy_completions();
+
     void set_local_addr(const sockaddr *local_addr, socklen_t local_addrlen);
 
     void set_remote_addr(const sockaddr *remote_addr, socklen_t remote_addrlen);
@@ -60,8 +158,11 @@ public:
     // 在当前的 connection 中新增一个 stream，如果已经到达了数量上限则不会新增，如果 stream_id 已有则返回 -1 且不会新增。
     int new_stream(int64_t stream_id);
 
+    // 远端或本端关闭了 stream_id 对应的 stream 时调用（目前仅用于触发探针，stream 对象仍保留）。
+    inline void on_stream_close(int64_t stream_id, uint64_t app_error_code) { ECHO_PROBE3(stream_close, this, stream_id, app_error_code); }
+
     // 根据 stream_id 查询对应的 stream 是否存在。
-    inline bool stream_exist(int64_t stream_id) { return streams.find(stream_id) != streams.end(); }
+    inline bool stream_exist(int64_t stream_id) const { return get_stream(stream_id) != nullptr; }
 
     // 根据 stream_id 返回对应的 stream，若对应的 stream 不存在则返回 nullptr。
     std::shared_ptr<Stream> get_stream(int64_t stream_id) const;
@@ -78,14 +179,39 @@ public:
     // 查询 connection 是否已经关闭。
     inline bool get_is_closed() const { return this->is_closed; }
 
+    // 根据 recv_packet 返回的内核接收时刻，计算应当传给 ngtcp2_conn_read_pkt 的时间戳，并统计接收排队时延。
+    // clock_offset 为 realtime_clock_offset() 的返回值，每一批 packet 采样一次即可；内核接收时刻不可用时返回当前时刻。
+    ngtcp2_tstamp get_rx_timestamp(const RecvPacketInfo &info, int64_t clock_offset);
+
+    // 查询接收排队时延的平均值与最大值（ns）。
+    inline ngtcp2_duration get_rx_queue_delay_avg() const { return rx_queue_delay_count ? rx_queue_delay_sum / rx_queue_delay_count : 0; }
+    inline ngtcp2_duration get_rx_queue_delay_max() const { return rx_queue_delay_max; }
+
+    // 开启 socket 接收缓冲区的自动扩容，扩容不会超过 max 个字节，max 为 0 表示关闭。
+    inline void set_recv_buf_autosize_max(size_t max) { this->recv_buf_max = max; }
+
+    // 查询最近一次观测到的内核接收丢包累计数量（SO_RXQ_OVFL）。
+    inline uint32_t get_rxq_drops() const { return this->rxq_drops; }
+
+    // 每读完一批 packet 后调用，drops 为这批 packet 中观测到的 SO_RXQ_OVFL 累计丢包数。
+    // 若丢包数有所增长，则根据当前的 bandwidth-delay product 扩大 socket 的接收缓冲区。
+    void update_rxq_drops(uint32_t drops);
+
     // 从 socket_fd 中读取 QUIC packet 并交付给 lib ngtcp2 处理。
     // 由于调用了 ngtcp2_conn_read_pkt，因此该函数有可能触发关闭连接。
     int read();
 
     // 调用 lib ngtcp2 写 QUIC packet 并送入 socket_fd 中。
+    // 会先尝试发送 pending_tx 中暂存的 packet，若 pending_tx 仍非空则不再调用 ngtcp2_conn_writev_stream 写新的 packet。
     // 由于调用了 ngtcp2_conn_writev_stream，该函数有可能触发关闭连接。
     int write();
 
+    // 查询是否还有暂存在 pending_tx 中等待发送的 packet，若有则调用者应当监测 socket_fd 可写，并在可写时再次调用 write()。
+    inline bool has_pending_tx() const { return !pending_tx.empty(); }
+
+    // 查询 pending_tx 中暂存的 packet 数量。
+    inline size_t get_pending_tx_count() const { return pending_tx.size(); }
+
     // 关闭连接。
     void close();
 
@@ -95,6 +221,7 @@ public:
     inline int handle_expiry(ngtcp2_tstamp ts)
     {
         int ret = ngtcp2_conn_handle_expiry(this->conn, ts);
+        ECHO_PROBE3(expiry, this, ts, ret);
         if (ret < 0)
             ngtcp2_connection_close_error_set_transport_error_liberr(&(this->last_error), ret, nullptr, 0); // 根据 ngtcp2 liberr 设置 ccerr
 
@@ -116,9 +243,44 @@ public:
     }
 
 private:
+    // 返回 streams 中第一个 stream_id 不小于 stream_id 的元素。
+    std::vector<std::shared_ptr<Stream>>::const_iterator lower_bound_stream(int64_t stream_id) const;
+
     // 将某一条 stream 中的待发送数据写成 QUIC packet 并送入 socket_fd 发送出去。
     int write_one_stream(std::shared_ptr<Stream> stream);
 
+    // 计算本轮 burst 中下一个 packet 的发送时刻：按照当前的 pacing rate 将 burst 内的 packet 均匀地分布开，未开启 pacing 时返回 0。
+    ngtcp2_tstamp get_pkt_txtime() const;
+
+    // 发送 packet 时向 slab 申请的 buffer 长度：当前 path 的 UDP payload 长度上限，有 PMTUD probe 待发送时取 probe 的长度，不超过 max_pktlen。
+    size_t get_tx_pktlen();
+
+    // 返回 tx_pkt 的首地址（长度为 tx_pkt.capacity()），tx_pkt 为空时先按 get_tx_pktlen() 从 slab 中取出一块 buffer，失败时返回 nullptr。
+    uint8_t *get_tx_pkt();
+
+    // 将刚刚写到 tx_pkt 中的长度为 pktlen 的 packet 移动到 tx_batch 中，必要时将 batch 发送出去。
+    void append_tx_batch(size_t pktlen, uint32_t ecn);
+
+    // 发送 tx_batch 中的所有 packet。遇到 EAGAIN 时将它们移动到 pending_tx 中。
+    void flush_tx_batch();
+
+    // tx_protection_deferred 时，用当前的 tx key 批量加密 pkts 中的所有 packet，失败时返回 -1。
+    int protect_tx_packets(std::vector<PacketBuffer> &pkts);
+
+    // 将 packet（或 GSO batch）移动到 pending_tx 的末尾，若 pending_tx 已满则返回 -1（该 packet 只能交给 ngtcp2 的丢包重传来处理了）。
+    int enqueue_pending_tx(std::vector<PacketBuffer> &&pkts, uint32_t ecn, size_t gso_size = 0);
+
+    // 发送 packet 时传给 send_packet 的目的地址，socket_fd 已经 connect 时为空。
+    inline sockaddr *get_send_addr() { return this->socket_connected ? nullptr : &(this->remote_addr.sa); }
+    inline socklen_t get_send_addrlen() const { return this->socket_connected ? 0 : this->remote_addrlen; }
+
+    // 在发送 packet 之前调用，将 socket_fd 的 ECN codepoint 设置为 ecn（与 send_ecn 相同时什么也不做）。
+    void update_send_ecn(uint32_t ecn);
+
+    // 按顺序发送 pending_tx 中暂存的 packet，直到全部发送完毕或者再次遇到 EAGAIN。
+    // 遇到 EAGAIN 以外的错误时丢弃对应的 packet 并继续发送下一个。返回 0 时 pending_tx 可能仍非空。
+    int flush_pending_tx();
+
 private:
     Connection(const Connection &rhs) = delete;            // no copy
     Connection &operator=(const Connection &rhs) = delete; // no assignment
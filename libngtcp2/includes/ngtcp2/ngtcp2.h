@@ -4751,6 +4751,20 @@ NGTCP2_EXTERN size_t ngtcp2_conn_get_max_udp_payload_size(ngtcp2_conn *conn);
 NGTCP2_EXTERN size_t
 ngtcp2_conn_get_path_max_udp_payload_size(ngtcp2_conn *conn);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_get_pmtud_probelen` returns the length of the Path MTU
+ * Discovery probe packet which the next call of
+ * `ngtcp2_conn_writev_stream` may write, or 0 if no probe is pending.
+ * The probe is only written if the buffer passed to
+ * `ngtcp2_conn_writev_stream` is at least this long; an application
+ * which sizes its buffers by
+ * `ngtcp2_conn_get_path_max_udp_payload_size` should make the buffer
+ * this long while a probe is pending.
+ */
+NGTCP2_EXTERN size_t ngtcp2_conn_get_pmtud_probelen(ngtcp2_conn *conn);
+
 /**
  * @function
  *
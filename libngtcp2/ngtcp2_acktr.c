@@ -28,49 +28,20 @@
 
 #include "ngtcp2_macro.h"
 
-static void acktr_entry_init(ngtcp2_acktr_entry *ent, int64_t pkt_num,
-                             ngtcp2_tstamp tstamp) {
-  ent->pkt_num = pkt_num;
-  ent->len = 1;
-  ent->tstamp = tstamp;
-}
-
-int ngtcp2_acktr_entry_objalloc_new(ngtcp2_acktr_entry **ent, int64_t pkt_num,
-                                    ngtcp2_tstamp tstamp,
-                                    ngtcp2_objalloc *objalloc) {
-  *ent = ngtcp2_objalloc_acktr_entry_get(objalloc);
-  if (*ent == NULL) {
-    return NGTCP2_ERR_NOMEM;
-  }
-
-  acktr_entry_init(*ent, pkt_num, tstamp);
-
-  return 0;
-}
-
-void ngtcp2_acktr_entry_objalloc_del(ngtcp2_acktr_entry *ent,
-                                     ngtcp2_objalloc *objalloc) {
-  ngtcp2_objalloc_acktr_entry_release(objalloc, ent);
-}
-
-static int greater(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
-  return *(int64_t *)lhs > *(int64_t *)rhs;
-}
-
 int ngtcp2_acktr_init(ngtcp2_acktr *acktr, ngtcp2_log *log,
                       const ngtcp2_mem *mem) {
   int rv;
 
-  ngtcp2_objalloc_acktr_entry_init(&acktr->objalloc, 32, mem);
-
   rv = ngtcp2_ringbuf_init(&acktr->acks, 32, sizeof(ngtcp2_acktr_ack_entry),
                            mem);
   if (rv != 0) {
     return rv;
   }
 
-  ngtcp2_ksl_init(&acktr->ents, greater, sizeof(int64_t), mem);
-
+  acktr->ents = NULL;
+  acktr->entcap = 0;
+  acktr->first = 0;
+  acktr->nents = 0;
   acktr->log = log;
   acktr->mem = mem;
   acktr->flags = NGTCP2_ACKTR_FLAG_NONE;
@@ -81,140 +52,225 @@ int ngtcp2_acktr_init(ngtcp2_acktr *acktr, ngtcp2_log *log,
 }
 
 void ngtcp2_acktr_free(ngtcp2_acktr *acktr) {
-#ifdef NOMEMPOOL
-  ngtcp2_ksl_it it;
-#endif /* NOMEMPOOL */
-
   if (acktr == NULL) {
     return;
   }
 
-#ifdef NOMEMPOOL
-  for (it = ngtcp2_ksl_begin(&acktr->ents); !ngtcp2_ksl_it_end(&it);
-       ngtcp2_ksl_it_next(&it)) {
-    ngtcp2_acktr_entry_objalloc_del(ngtcp2_ksl_it_get(&it), &acktr->objalloc);
+  ngtcp2_mem_free(acktr->mem, acktr->ents);
+
+  ngtcp2_ringbuf_free(&acktr->acks);
+}
+
+/*
+ * acktr_reserve makes acktr->ents large enough to store one more
+ * entry.  If it already has NGTCP2_ACKTR_MAX_ENT entries, it does
+ * nothing.
+ */
+static int acktr_reserve(ngtcp2_acktr *acktr) {
+  ngtcp2_acktr_entry *ents;
+  size_t entcap, i;
+
+  if (acktr->nents < acktr->entcap ||
+      acktr->entcap == NGTCP2_ACKTR_MAX_ENT) {
+    return 0;
   }
-#endif /* NOMEMPOOL */
 
-  ngtcp2_ksl_free(&acktr->ents);
+  entcap = acktr->entcap ? acktr->entcap * 2 : NGTCP2_ACKTR_INITIAL_ENT;
 
-  ngtcp2_ringbuf_free(&acktr->acks);
+  ents = ngtcp2_mem_malloc(acktr->mem, sizeof(ngtcp2_acktr_entry) * entcap);
+  if (ents == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  for (i = 0; i < acktr->nents; ++i) {
+    ents[i] = *ngtcp2_acktr_get(acktr, i);
+  }
 
-  ngtcp2_objalloc_free(&acktr->objalloc);
+  ngtcp2_mem_free(acktr->mem, acktr->ents);
+
+  acktr->ents = ents;
+  acktr->entcap = entcap;
+  acktr->first = 0;
+
+  return 0;
 }
 
-int ngtcp2_acktr_add(ngtcp2_acktr *acktr, int64_t pkt_num, int active_ack,
+/*
+ * acktr_insert inserts a new entry which only includes |pkt_num| at
+ * |idx|.  If acktr->ents is full, the last entry is dropped.
+ */
+static void acktr_insert(ngtcp2_acktr *acktr, size_t idx, int64_t pkt_num,
+                         ngtcp2_tstamp ts) {
+  ngtcp2_acktr_entry *ent;
+  size_t i;
+
+  assert(acktr->entcap);
+  assert(idx <= acktr->nents);
+
+  if (acktr->nents == acktr->entcap) {
+    if (idx == acktr->nents) {
+      /* The new entry would be dropped immediately. */
+      return;
+    }
+
+    --acktr->nents;
+  }
+
+  if (idx < acktr->nents - idx) {
+    acktr->first = (acktr->first - 1) & (acktr->entcap - 1);
+    ++acktr->nents;
+
+    for (i = 0; i < idx; ++i) {
+      *ngtcp2_acktr_get(acktr, i) = *ngtcp2_acktr_get(acktr, i + 1);
+    }
+  } else {
+    ++acktr->nents;
+
+    for (i = acktr->nents - 1; i > idx; --i) {
+      *ngtcp2_acktr_get(acktr, i) = *ngtcp2_acktr_get(acktr, i - 1);
+    }
+  }
+
+  ent = ngtcp2_acktr_get(acktr, idx);
+  ent->pkt_num = pkt_num;
+  ent->len = 1;
+  ent->tstamp = ts;
+}
+
+/*
+ * acktr_remove removes the |idx|-th entry.
+ */
+static void acktr_remove(ngtcp2_acktr *acktr, size_t idx) {
+  size_t i;
+
+  assert(idx < acktr->nents);
+
+  if (idx < acktr->nents - idx - 1) {
+    for (i = idx; i > 0; --i) {
+      *ngtcp2_acktr_get(acktr, i) = *ngtcp2_acktr_get(acktr, i - 1);
+    }
+
+    acktr->first = (acktr->first + 1) & (acktr->entcap - 1);
+  } else {
+    for (i = idx; i + 1 < acktr->nents; ++i) {
+      *ngtcp2_acktr_get(acktr, i) = *ngtcp2_acktr_get(acktr, i + 1);
+    }
+  }
+
+  --acktr->nents;
+}
+
+/*
+ * acktr_lower_bound returns the index of the first entry which has
+ * the packet number equal to or less than |pkt_num|.  If there is no
+ * such entry, it returns acktr->nents.
+ */
+static size_t acktr_lower_bound(ngtcp2_acktr *acktr, int64_t pkt_num) {
+  size_t lo = 0, hi = acktr->nents, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ngtcp2_acktr_get(acktr, mid)->pkt_num > pkt_num) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+/*
+ * acktr_add adds |pkt_num| to the ranges in |acktr|.
+ */
+static int acktr_add(ngtcp2_acktr *acktr, int64_t pkt_num,
                      ngtcp2_tstamp ts) {
-  ngtcp2_ksl_it it, prev_it;
-  ngtcp2_acktr_entry *ent, *prev_ent, *delent;
+  ngtcp2_acktr_entry *ent, *prev_ent;
+  size_t idx;
   int rv;
-  int added = 0;
 
-  if (ngtcp2_ksl_len(&acktr->ents)) {
-    it = ngtcp2_ksl_lower_bound(&acktr->ents, &pkt_num);
-    if (ngtcp2_ksl_it_end(&it)) {
-      ngtcp2_ksl_it_prev(&it);
-      ent = ngtcp2_ksl_it_get(&it);
+  if (acktr->nents) {
+    ent = ngtcp2_acktr_get(acktr, 0);
 
-      assert(ent->pkt_num >= pkt_num + (int64_t)ent->len);
+    /* Fast path: the packet arrives in order. */
+    if (ent->pkt_num + 1 == pkt_num) {
+      ent->pkt_num = pkt_num;
+      ent->tstamp = ts;
+      ++ent->len;
 
-      if (ent->pkt_num == pkt_num + (int64_t)ent->len) {
-        ++ent->len;
-        added = 1;
-      }
-    } else {
-      ent = ngtcp2_ksl_it_get(&it);
+      return 0;
+    }
+  }
+
+  idx = acktr_lower_bound(acktr, pkt_num);
+  if (idx) {
+    prev_ent = ngtcp2_acktr_get(acktr, idx - 1);
+
+    assert(prev_ent->pkt_num >= pkt_num + (int64_t)prev_ent->len);
+
+    if (idx < acktr->nents) {
+      ent = ngtcp2_acktr_get(acktr, idx);
 
       assert(ent->pkt_num != pkt_num);
 
-      if (ngtcp2_ksl_it_begin(&it)) {
-        if (ent->pkt_num + 1 == pkt_num) {
-          ngtcp2_ksl_update_key(&acktr->ents, &ent->pkt_num, &pkt_num);
+      if (ent->pkt_num + 1 == pkt_num) {
+        if (prev_ent->pkt_num == pkt_num + (int64_t)prev_ent->len) {
+          prev_ent->len += ent->len + 1;
+          acktr_remove(acktr, idx);
+        } else {
           ent->pkt_num = pkt_num;
           ent->tstamp = ts;
           ++ent->len;
-          added = 1;
-        }
-      } else {
-        prev_it = it;
-        ngtcp2_ksl_it_prev(&prev_it);
-        prev_ent = ngtcp2_ksl_it_get(&prev_it);
-
-        assert(prev_ent->pkt_num >= pkt_num + (int64_t)prev_ent->len);
-
-        if (ent->pkt_num + 1 == pkt_num) {
-          if (prev_ent->pkt_num == pkt_num + (int64_t)prev_ent->len) {
-            prev_ent->len += ent->len + 1;
-            ngtcp2_ksl_remove_hint(&acktr->ents, NULL, &it, &ent->pkt_num);
-            ngtcp2_acktr_entry_objalloc_del(ent, &acktr->objalloc);
-            added = 1;
-          } else {
-            ngtcp2_ksl_update_key(&acktr->ents, &ent->pkt_num, &pkt_num);
-            ent->pkt_num = pkt_num;
-            ent->tstamp = ts;
-            ++ent->len;
-            added = 1;
-          }
-        } else if (prev_ent->pkt_num == pkt_num + (int64_t)prev_ent->len) {
-          ++prev_ent->len;
-          added = 1;
         }
+
+        return 0;
       }
     }
-  }
 
-  if (!added) {
-    rv = ngtcp2_acktr_entry_objalloc_new(&ent, pkt_num, ts, &acktr->objalloc);
-    if (rv != 0) {
-      return rv;
-    }
-    rv = ngtcp2_ksl_insert(&acktr->ents, NULL, &ent->pkt_num, ent);
-    if (rv != 0) {
-      ngtcp2_acktr_entry_objalloc_del(ent, &acktr->objalloc);
-      return rv;
-    }
-  }
+    if (prev_ent->pkt_num == pkt_num + (int64_t)prev_ent->len) {
+      ++prev_ent->len;
 
-  if (active_ack) {
-    acktr->flags |= NGTCP2_ACKTR_FLAG_ACTIVE_ACK;
-    if (acktr->first_unacked_ts == UINT64_MAX) {
-      acktr->first_unacked_ts = ts;
+      return 0;
     }
   }
 
-  if (ngtcp2_ksl_len(&acktr->ents) > NGTCP2_ACKTR_MAX_ENT) {
-    it = ngtcp2_ksl_end(&acktr->ents);
-    ngtcp2_ksl_it_prev(&it);
-    delent = ngtcp2_ksl_it_get(&it);
-    ngtcp2_ksl_remove_hint(&acktr->ents, NULL, &it, &delent->pkt_num);
-    ngtcp2_acktr_entry_objalloc_del(delent, &acktr->objalloc);
+  rv = acktr_reserve(acktr);
+  if (rv != 0) {
+    return rv;
   }
 
+  acktr_insert(acktr, idx, pkt_num, ts);
+
   return 0;
 }
 
-void ngtcp2_acktr_forget(ngtcp2_acktr *acktr, ngtcp2_acktr_entry *ent) {
-  ngtcp2_ksl_it it;
+int ngtcp2_acktr_add(ngtcp2_acktr *acktr, int64_t pkt_num, int active_ack,
+                     ngtcp2_tstamp ts) {
+  int rv;
 
-  it = ngtcp2_ksl_lower_bound(&acktr->ents, &ent->pkt_num);
-  assert(*(int64_t *)ngtcp2_ksl_it_key(&it) == (int64_t)ent->pkt_num);
+  rv = acktr_add(acktr, pkt_num, ts);
+  if (rv != 0) {
+    return rv;
+  }
 
-  for (; !ngtcp2_ksl_it_end(&it);) {
-    ent = ngtcp2_ksl_it_get(&it);
-    ngtcp2_ksl_remove_hint(&acktr->ents, &it, &it, &ent->pkt_num);
-    ngtcp2_acktr_entry_objalloc_del(ent, &acktr->objalloc);
+  if (active_ack) {
+    acktr->flags |= NGTCP2_ACKTR_FLAG_ACTIVE_ACK;
+    if (acktr->first_unacked_ts == UINT64_MAX) {
+      acktr->first_unacked_ts = ts;
+    }
   }
-}
 
-ngtcp2_ksl_it ngtcp2_acktr_get(ngtcp2_acktr *acktr) {
-  return ngtcp2_ksl_begin(&acktr->ents);
+  return 0;
 }
 
-int ngtcp2_acktr_empty(ngtcp2_acktr *acktr) {
-  ngtcp2_ksl_it it = ngtcp2_ksl_begin(&acktr->ents);
-  return ngtcp2_ksl_it_end(&it);
+void ngtcp2_acktr_forget(ngtcp2_acktr *acktr, size_t idx) {
+  assert(idx < acktr->nents);
+
+  acktr->nents = idx;
 }
 
+int ngtcp2_acktr_empty(ngtcp2_acktr *acktr) { return acktr->nents == 0; }
+
 ngtcp2_acktr_ack_entry *ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr,
                                              int64_t pkt_num,
                                              int64_t largest_ack) {
@@ -226,39 +282,20 @@ ngtcp2_acktr_ack_entry *ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr,
   return ent;
 }
 
-/*
- * acktr_remove removes |ent| from |acktr|.  |it| must point to the
- * node whose key identifies |ent|.  The iterator which points to the
- * entry next to |ent| is assigned to |it|.
- */
-static void acktr_remove(ngtcp2_acktr *acktr, ngtcp2_ksl_it *it,
-                         ngtcp2_acktr_entry *ent) {
-  ngtcp2_ksl_remove_hint(&acktr->ents, it, it, &ent->pkt_num);
-  ngtcp2_acktr_entry_objalloc_del(ent, &acktr->objalloc);
-}
-
 static void acktr_on_ack(ngtcp2_acktr *acktr, ngtcp2_ringbuf *rb,
                          size_t ack_ent_offset) {
   ngtcp2_acktr_ack_entry *ack_ent;
   ngtcp2_acktr_entry *ent;
-  ngtcp2_ksl_it it;
 
   assert(ngtcp2_ringbuf_len(rb));
 
   ack_ent = ngtcp2_ringbuf_get(rb, ack_ent_offset);
 
   /* Assume that ngtcp2_pkt_validate_ack(fr) returns 0 */
-  it = ngtcp2_ksl_lower_bound(&acktr->ents, &ack_ent->largest_ack);
-  for (; !ngtcp2_ksl_it_end(&it);) {
-    ent = ngtcp2_ksl_it_get(&it);
-    acktr_remove(acktr, &it, ent);
-  }
-
-  if (ngtcp2_ksl_len(&acktr->ents)) {
-    assert(ngtcp2_ksl_it_end(&it));
+  acktr->nents = acktr_lower_bound(acktr, ack_ent->largest_ack);
 
-    ngtcp2_ksl_it_prev(&it);
-    ent = ngtcp2_ksl_it_get(&it);
+  if (acktr->nents) {
+    ent = ngtcp2_acktr_get(acktr, acktr->nents - 1);
     if (ent->pkt_num > ack_ent->largest_ack &&
         ack_ent->largest_ack >= ent->pkt_num - (int64_t)(ent->len - 1)) {
       ent->len = (size_t)(ent->pkt_num - ack_ent->largest_ack);
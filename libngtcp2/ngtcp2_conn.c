@@ -631,8 +631,8 @@ static int pktns_init(ngtcp2_pktns *pktns, ngtcp2_pktns_id pktns_id,
   ngtcp2_strm_init(&pktns->crypto.strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL,
                    NULL, mem);
 
-  ngtcp2_ksl_init(&pktns->crypto.tx.frq, crypto_offset_less, sizeof(uint64_t),
-                  mem);
+  ngtcp2_ksl_init(&pktns->crypto.tx.frq, crypto_offset_less,
+                  ngtcp2_ksl_int64_less_search, sizeof(uint64_t), mem);
 
   ngtcp2_rtb_init(&pktns->rtb, pktns_id, &pktns->crypto.strm, rst, cc, log,
                   qlog, rtb_entry_objalloc, frc_objalloc, mem);
@@ -1049,7 +1049,8 @@ static int conn_new(ngtcp2_conn **pconn, const ngtcp2_cid *dcid,
 
   ngtcp2_gaptr_init(&(*pconn)->dcid.seqgap, mem);
 
-  ngtcp2_ksl_init(&(*pconn)->scid.set, cid_less, sizeof(ngtcp2_cid), mem);
+  ngtcp2_ksl_init(&(*pconn)->scid.set, cid_less, NULL, sizeof(ngtcp2_cid),
+                  mem);
 
   ngtcp2_pq_init(&(*pconn)->scid.used, retired_ts_less, mem);
 
@@ -1559,9 +1560,8 @@ static int conn_ensure_ack_blks(ngtcp2_conn *conn, size_t n) {
     return 0;
   }
 
-  max *= 2;
-
-  assert(max >= n);
+  for (; max < n; max *= 2)
+    ;
 
   fr = ngtcp2_mem_realloc(conn->mem, conn->tx.ack,
                           sizeof(ngtcp2_ack) + sizeof(ngtcp2_ack_blk) * max);
@@ -1614,10 +1614,9 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
   int64_t last_pkt_num;
   ngtcp2_acktr *acktr = &pktns->acktr;
   ngtcp2_ack_blk *blk;
-  ngtcp2_ksl_it it;
   ngtcp2_acktr_entry *rpkt;
   ngtcp2_ack *ack;
-  size_t blk_idx;
+  size_t blk_idx, idx = 0, nents, num_blks;
   ngtcp2_tstamp largest_ack_ts;
   int rv;
 
@@ -1629,8 +1628,8 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     return 0;
   }
 
-  it = ngtcp2_acktr_get(acktr);
-  if (ngtcp2_ksl_it_end(&it)) {
+  nents = ngtcp2_acktr_len(acktr);
+  if (nents == 0) {
     ngtcp2_acktr_commit_ack(acktr);
     return 0;
   }
@@ -1657,7 +1656,7 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
   }
   ack->num_blks = 0;
 
-  rpkt = ngtcp2_ksl_it_get(&it);
+  rpkt = ngtcp2_acktr_get(acktr, 0);
 
   if (rpkt->pkt_num == pktns->rx.max_pkt_num) {
     last_pkt_num = rpkt->pkt_num - (int64_t)(rpkt->len - 1);
@@ -1665,7 +1664,7 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     ack->largest_ack = rpkt->pkt_num;
     ack->first_ack_blklen = rpkt->len - 1;
 
-    ngtcp2_ksl_it_next(&it);
+    ++idx;
   } else {
     assert(rpkt->pkt_num < pktns->rx.max_pkt_num);
 
@@ -1684,19 +1683,19 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     ack->ack_delay = 0;
   }
 
-  for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
-    if (ack->num_blks == NGTCP2_MAX_ACK_BLKS) {
-      break;
-    }
-
-    rpkt = ngtcp2_ksl_it_get(&it);
-
-    blk_idx = ack->num_blks++;
-    rv = conn_ensure_ack_blks(conn, ack->num_blks);
+  num_blks = ngtcp2_min(nents - idx, NGTCP2_MAX_ACK_BLKS);
+  if (num_blks) {
+    rv = conn_ensure_ack_blks(conn, num_blks);
     if (rv != 0) {
       return rv;
     }
     ack = &conn->tx.ack->ack;
+  }
+
+  /* The ranges in acktr are already sorted in decreasing order, so
+     each of them maps to one ACK block. */
+  for (blk_idx = 0; blk_idx < num_blks; ++blk_idx, ++idx) {
+    rpkt = ngtcp2_acktr_get(acktr, idx);
     blk = &ack->blks[blk_idx];
     blk->gap = (uint64_t)(last_pkt_num - rpkt->pkt_num - 2);
     blk->blklen = rpkt->len - 1;
@@ -1704,10 +1703,12 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     last_pkt_num = rpkt->pkt_num - (int64_t)(rpkt->len - 1);
   }
 
+  ack->num_blks = num_blks;
+
   /* TODO Just remove entries which cannot fit into a single ACK frame
      for now. */
-  if (!ngtcp2_ksl_it_end(&it)) {
-    ngtcp2_acktr_forget(acktr, ngtcp2_ksl_it_get(&it));
+  if (idx < nents) {
+    ngtcp2_acktr_forget(acktr, idx);
   }
 
   *pfr = conn->tx.ack;
@@ -3049,7 +3050,7 @@ static ngtcp2_ssize conn_write_handshake_pkts(ngtcp2_conn *conn,
   ngtcp2_rtb_entry *rtbent;
   uint8_t wflags = NGTCP2_WRITE_PKT_FLAG_NONE;
   ngtcp2_conn_stat *cstat = &conn->cstat;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
 
   /* As a client, we would like to discard Initial packet number space
      when sending the first Handshake packet.  When sending Handshake
@@ -3106,8 +3107,8 @@ static ngtcp2_ssize conn_write_handshake_pkts(ngtcp2_conn *conn,
            will be written. */
         if (conn->server) {
           it = ngtcp2_rtb_head(&conn->in_pktns->rtb);
-          if (!ngtcp2_ksl_it_end(&it)) {
-            rtbent = ngtcp2_ksl_it_get(&it);
+          if (!ngtcp2_rtb_it_end(&it)) {
+            rtbent = ngtcp2_rtb_it_get(&it);
             if (rtbent->flags & NGTCP2_RTB_ENTRY_FLAG_ACK_ELICITING) {
               wflags |= NGTCP2_WRITE_PKT_FLAG_REQUIRE_PADDING;
             }
@@ -3516,6 +3517,13 @@ static ngtcp2_ssize conn_write_pkt(ngtcp2_conn *conn, ngtcp2_pkt_info *pi,
     cc->encrypt = conn->callbacks.encrypt;
     cc->hp_mask = conn->callbacks.hp_mask;
 
+    if (type == NGTCP2_PKT_1RTT &&
+        (conn->flags & (NGTCP2_CONN_FLAG_NULL_PROTECTION |
+                        NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION))) {
+      cc->encrypt = NULL;
+      cc->hp_mask = NULL;
+    }
+
     if (conn_should_send_max_data(conn)) {
       rv = ngtcp2_frame_chain_objalloc_new(&nfrc, &conn->frc_objalloc);
       if (rv != 0) {
@@ -4305,6 +4313,13 @@ ngtcp2_ssize ngtcp2_conn_write_single_frame_pkt(
   cc.encrypt = conn->callbacks.encrypt;
   cc.hp_mask = conn->callbacks.hp_mask;
 
+  if (type == NGTCP2_PKT_1RTT &&
+      (conn->flags & (NGTCP2_CONN_FLAG_NULL_PROTECTION |
+                      NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION))) {
+    cc.encrypt = NULL;
+    cc.hp_mask = NULL;
+  }
+
   ngtcp2_pkt_hd_init(&hd, hd_flags, type, dcid, scid,
                      pktns->tx.last_pkt_num + 1, pktns_select_pkt_numlen(pktns),
                      version, 0);
@@ -4438,11 +4453,11 @@ ngtcp2_ssize ngtcp2_conn_write_single_frame_pkt(
 static void conn_process_early_rtb(ngtcp2_conn *conn) {
   ngtcp2_rtb_entry *ent;
   ngtcp2_rtb *rtb = &conn->pktns.rtb;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
 
-  for (it = ngtcp2_rtb_head(rtb); !ngtcp2_ksl_it_end(&it);
-       ngtcp2_ksl_it_next(&it)) {
-    ent = ngtcp2_ksl_it_get(&it);
+  for (it = ngtcp2_rtb_head(rtb); !ngtcp2_rtb_it_end(&it);
+       ngtcp2_rtb_it_next(&it)) {
+    ent = ngtcp2_rtb_it_get(&it);
 
     if ((ent->hd.flags & NGTCP2_PKT_FLAG_LONG_FORM) == 0 ||
         ent->hd.type != NGTCP2_PKT_0RTT) {
@@ -4613,7 +4628,7 @@ static int conn_bind_dcid(ngtcp2_conn *conn, ngtcp2_dcid **pdcid,
   return 0;
 }
 
-static int conn_start_pmtud(ngtcp2_conn *conn) {
+/* static */ int conn_start_pmtud(ngtcp2_conn *conn) { // expose this function to outside
   int rv;
   size_t hard_max_udp_payload_size;
 
@@ -5659,7 +5674,28 @@ decrypt_hp(ngtcp2_pkt_hd *hd, uint8_t *dest, const ngtcp2_crypto_cipher *hp,
   size_t i;
   int rv;
 
-  assert(hp_mask);
+  if (hp_mask == NULL) {
+    /* Null protection: packet header is not protected. */
+    if (pkt_num_offset >= pktlen) {
+      return NGTCP2_ERR_PROTO;
+    }
+
+    hd->pkt_numlen = (size_t)((pkt[0] & NGTCP2_PKT_NUMLEN_MASK) + 1);
+    if (pkt_num_offset + hd->pkt_numlen > pktlen) {
+      return NGTCP2_ERR_PROTO;
+    }
+
+    p = ngtcp2_cpymem(p, pkt, pkt_num_offset + hd->pkt_numlen);
+
+    if (!(hd->flags & NGTCP2_PKT_FLAG_LONG_FORM) &&
+        (dest[0] & NGTCP2_SHORT_KEY_PHASE_BIT)) {
+      hd->flags |= NGTCP2_PKT_FLAG_KEY_PHASE;
+    }
+
+    hd->pkt_num = ngtcp2_get_pkt_num(p - hd->pkt_numlen, hd->pkt_numlen);
+
+    return p - dest;
+  }
 
   if (pkt_num_offset + 4 + NGTCP2_HP_SAMPLELEN > pktlen) {
     return NGTCP2_ERR_PROTO;
@@ -5715,7 +5751,7 @@ static int conn_emit_pending_crypto_data(ngtcp2_conn *conn,
   int rv;
   uint64_t offset;
 
-  if (!strm->rx.rob) {
+  if (!ngtcp2_strm_rx_reordering(strm)) {
     return 0;
   }
 
@@ -5964,7 +6000,7 @@ static int pktns_commit_recv_pkt_num(ngtcp2_pktns *pktns, int64_t pkt_num,
     return rv;
   }
 
-  if (ngtcp2_ksl_len(&pktns->rx.pngap.gap) > 256) {
+  if (ngtcp2_gaptr_len(&pktns->rx.pngap) > 256) {
     ngtcp2_gaptr_drop_first_gap(&pktns->rx.pngap);
   }
 
@@ -6791,7 +6827,7 @@ static int conn_emit_pending_stream_data(ngtcp2_conn *conn, ngtcp2_strm *strm,
   uint32_t sdflags;
   int handshake_completed = conn_is_handshake_completed(conn);
 
-  if (!strm->rx.rob) {
+  if (!ngtcp2_strm_rx_reordering(strm)) {
     return 0;
   }
 
@@ -7761,7 +7797,7 @@ static int conn_recv_new_connection_id(ngtcp2_conn *conn,
     return rv;
   }
 
-  if (ngtcp2_ksl_len(&conn->dcid.seqgap.gap) > 32) {
+  if (ngtcp2_gaptr_len(&conn->dcid.seqgap) > 32) {
     ngtcp2_gaptr_drop_first_gap(&conn->dcid.seqgap);
   }
 
@@ -8786,8 +8822,14 @@ static ngtcp2_ssize conn_recv_pkt(ngtcp2_conn *conn, const ngtcp2_path *path,
     hp = &pktns->crypto.ctx.hp;
     ckm = pktns->crypto.rx.ckm;
     hp_ctx = &pktns->crypto.rx.hp_ctx;
-    hp_mask = conn->callbacks.hp_mask;
-    decrypt = conn->callbacks.decrypt;
+
+    if (conn->flags & NGTCP2_CONN_FLAG_NULL_PROTECTION) {
+      hp_mask = NULL;
+      decrypt = NULL;
+    } else {
+      hp_mask = conn->callbacks.hp_mask;
+      decrypt = conn->callbacks.decrypt;
+    }
   }
 
   rv = conn_ensure_decrypt_hp_buffer(conn, (size_t)nread + 4);
@@ -8858,9 +8900,14 @@ static ngtcp2_ssize conn_recv_pkt(ngtcp2_conn *conn, const ngtcp2_path *path,
     }
   }
 
-  nwrite = decrypt_pkt(conn->crypto.decrypt_buf.base, aead, payload, payloadlen,
-                       conn->crypto.decrypt_hp_buf.base, hdpktlen, hd.pkt_num,
-                       ckm, decrypt);
+  if (decrypt == NULL) {
+    /* Null protection: payload is used in place. */
+    nwrite = (ngtcp2_ssize)payloadlen;
+  } else {
+    nwrite = decrypt_pkt(conn->crypto.decrypt_buf.base, aead, payload,
+                         payloadlen, conn->crypto.decrypt_hp_buf.base, hdpktlen,
+                         hd.pkt_num, ckm, decrypt);
+  }
 
   if (force_decrypt_failure) {
     nwrite = NGTCP2_ERR_DECRYPT;
@@ -8904,7 +8951,9 @@ static ngtcp2_ssize conn_recv_pkt(ngtcp2_conn *conn, const ngtcp2_path *path,
     return NGTCP2_ERR_DISCARD_PKT;
   }
 
-  payload = conn->crypto.decrypt_buf.base;
+  if (decrypt) {
+    payload = conn->crypto.decrypt_buf.base;
+  }
   payloadlen = (size_t)nwrite;
 
   if (payloadlen == 0) {
@@ -11433,7 +11482,7 @@ ngtcp2_ssize ngtcp2_conn_write_vmsg(ngtcp2_conn *conn, ngtcp2_path *path,
   uint64_t datalen;
   uint64_t write_datalen = 0;
   int64_t prev_in_pkt_num = -1;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_rtb_entry *rtbent;
   (void)pkt_info_version;
 
@@ -11532,8 +11581,8 @@ ngtcp2_ssize ngtcp2_conn_write_vmsg(ngtcp2_conn *conn, ngtcp2_path *path,
 
         if (conn->in_pktns && write_datalen > 0) {
           it = ngtcp2_rtb_head(&conn->in_pktns->rtb);
-          if (!ngtcp2_ksl_it_end(&it)) {
-            rtbent = ngtcp2_ksl_it_get(&it);
+          if (!ngtcp2_rtb_it_end(&it)) {
+            rtbent = ngtcp2_rtb_it_get(&it);
             prev_in_pkt_num = rtbent->hd.pkt_num;
           }
         }
@@ -11550,8 +11599,8 @@ ngtcp2_ssize ngtcp2_conn_write_vmsg(ngtcp2_conn *conn, ngtcp2_path *path,
 
       if (conn->in_pktns && write_datalen > 0) {
         it = ngtcp2_rtb_head(&conn->in_pktns->rtb);
-        if (!ngtcp2_ksl_it_end(&it)) {
-          rtbent = ngtcp2_ksl_it_get(&it);
+        if (!ngtcp2_rtb_it_end(&it)) {
+          rtbent = ngtcp2_rtb_it_get(&it);
           if (rtbent->hd.pkt_num != prev_in_pkt_num &&
               (rtbent->flags & NGTCP2_RTB_ENTRY_FLAG_ACK_ELICITING)) {
             /* We have added padding already, but in that case, there
@@ -12849,6 +12898,15 @@ size_t ngtcp2_conn_get_path_max_udp_payload_size(ngtcp2_conn *conn) {
   return conn->dcid.current.max_udp_payload_size;
 }
 
+size_t ngtcp2_conn_get_pmtud_probelen(ngtcp2_conn *conn) {
+  if (!conn->pmtud || ngtcp2_pmtud_finished(conn->pmtud) ||
+      !ngtcp2_pmtud_require_probe(conn->pmtud)) {
+    return 0;
+  }
+
+  return ngtcp2_pmtud_probelen(conn->pmtud);
+}
+
 static int conn_initiate_migration_precheck(ngtcp2_conn *conn,
                                             const ngtcp2_addr *local_addr) {
   if (conn->remote.transport_params.disable_active_migration ||
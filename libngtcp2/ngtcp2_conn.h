@@ -220,6 +220,22 @@ void ngtcp2_path_challenge_entry_init(ngtcp2_path_challenge_entry *pcent,
 /* NGTCP2_CONN_FLAG_KEY_UPDATE_INITIATOR is set when the local
    endpoint has initiated key update. */
 #define NGTCP2_CONN_FLAG_KEY_UPDATE_INITIATOR 0x10000
+/* NGTCP2_CONN_FLAG_NULL_PROTECTION indicates that 1RTT packets are
+   sent and received without packet protection: the payload is
+   neither encrypted nor authenticated, no AEAD tag is appended, and
+   header protection is not applied.  encrypt, decrypt and hp_mask
+   callbacks are not called for 1RTT packets.  Both endpoints must
+   agree on this out of band.  It must only be used inside a trusted
+   network. */
+#define NGTCP2_CONN_FLAG_NULL_PROTECTION 0x20000
+/* NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION indicates that outgoing
+   1RTT packets are written without packet protection, but with room
+   for AEAD tag at the end of packet.  encrypt and hp_mask callbacks
+   are not called for outgoing 1RTT packets.  Application must apply
+   packet protection with the current 1RTT tx key before sending them,
+   which allows it to protect a batch of packets at once.  Incoming
+   packets are not affected. */
+#define NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION 0x40000
 
 typedef struct ngtcp2_crypto_data {
   ngtcp2_buf buf;
@@ -1109,4 +1125,19 @@ NGTCP2_EXTERN int conn_handshake_completed(ngtcp2_conn *conn);
 } /* extern "C" */
 #endif
 
+/**
+ * 将该函数暴露出来，以便于外部调用。
+ * 正常情况下 ngtcp2 库在 QUIC handshake 完成后（若没有设置 settings.no_pmtud）调用本函数开始 Path MTU Discovery，
+ * 由于明文传输模式跳过了 handshake，因此需要在创建 ngtcp2_conn 对象后手动调用。
+ *
+ * 调用前 conn 必须已经处于 handshake 完成的状态，且 conn->pmtud 为空。
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+NGTCP2_EXTERN int conn_start_pmtud(ngtcp2_conn *conn);
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* NGTCP2_CONN_H */
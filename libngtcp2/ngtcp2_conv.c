@@ -26,6 +26,10 @@
 
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif /* _MSC_VER */
 
 #include "ngtcp2_str.h"
 #include "ngtcp2_pkt.h"
@@ -93,6 +97,47 @@ uint64_t ngtcp2_get_varint(size_t *plen, const uint8_t *p) {
   return 0;
 }
 
+uint64_t ngtcp2_get_varint_padded(size_t *plen, const uint8_t *p) {
+  uint64_t n;
+  size_t shift;
+
+  *plen = (size_t)(1u << (*p >> 6));
+
+  /* The encoded integer occupies the most significant |*plen| bytes
+     of n.  Shifting left by 2 drops the length prefix. */
+  memcpy(&n, p, 8);
+  n = ngtcp2_ntohl64(n);
+  shift = 64 - *plen * 8;
+
+  return (n << 2) >> (shift + 2);
+}
+
+const uint8_t *ngtcp2_get_varints(uint64_t *dest, size_t n, const uint8_t *p,
+                                  const uint8_t *end) {
+  size_t len;
+
+  for (; n && end - p >= 8; --n) {
+    *dest++ = ngtcp2_get_varint_padded(&len, p);
+    p += len;
+  }
+
+  for (; n; --n) {
+    if (p == end) {
+      return NULL;
+    }
+
+    len = ngtcp2_get_varint_len(p);
+    if ((size_t)(end - p) < len) {
+      return NULL;
+    }
+
+    *dest++ = ngtcp2_get_varint(&len, p);
+    p += len;
+  }
+
+  return p;
+}
+
 int64_t ngtcp2_get_pkt_num(const uint8_t *p, size_t pkt_numlen) {
   switch (pkt_numlen) {
   case 1:
@@ -134,26 +179,74 @@ uint8_t *ngtcp2_put_uint16be(uint8_t *p, uint16_t n) {
   return ngtcp2_cpymem(p, (const uint8_t *)&n, sizeof(n));
 }
 
-uint8_t *ngtcp2_put_varint(uint8_t *p, uint64_t n) {
-  uint8_t *rv;
-  if (n < 64) {
-    *p++ = (uint8_t)n;
-    return p;
+/*
+ * varint_prefix_table[i] is the 2 bits length prefix of
+ * variable-length integer encoding for an integer whose bit length is
+ * i.  The encoded length is 1 << varint_prefix_table[i] bytes.
+ */
+static const uint8_t varint_prefix_table[65] = {
+    0, 0, 0, 0, 0, 0, 0,                                  /* 0-6 */
+    1, 1, 1, 1, 1, 1, 1, 1,                               /* 7-14 */
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,       /* 15-30 */
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,       /* 31-46 */
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, /* 47-64 */
+};
+
+/*
+ * bit_length returns the number of bits required to represent |n|.
+ * It returns 0 if |n| is 0.
+ */
+static size_t bit_length(uint64_t n) {
+#if defined(_MSC_VER)
+#  if defined(_M_X64) || defined(_M_ARM64)
+  unsigned long index;
+
+  if (!_BitScanReverse64(&index, n)) {
+    return 0;
   }
-  if (n < 16384) {
-    rv = ngtcp2_put_uint16be(p, (uint16_t)n);
-    *p |= 0x40;
-    return rv;
+
+  return (size_t)index + 1;
+#  else
+  unsigned long index;
+
+  if (_BitScanReverse(&index, (unsigned long)(n >> 32))) {
+    return (size_t)index + 33;
   }
-  if (n < 1073741824) {
-    rv = ngtcp2_put_uint32be(p, (uint32_t)n);
-    *p |= 0x80;
-    return rv;
+
+  if (!_BitScanReverse(&index, (unsigned long)n)) {
+    return 0;
   }
+
+  return (size_t)index + 1;
+#  endif
+#else
+  if (n == 0) {
+    return 0;
+  }
+
+  return (size_t)(sizeof(n) * CHAR_BIT) - (size_t)__builtin_clzll(n);
+#endif
+}
+
+uint8_t *ngtcp2_put_varint(uint8_t *p, uint64_t n) {
+  size_t prefix;
+
   assert(n < 4611686018427387904ULL);
-  rv = ngtcp2_put_uint64be(p, n);
-  *p |= 0xc0;
-  return rv;
+
+  prefix = varint_prefix_table[bit_length(n)];
+  n |= (uint64_t)prefix << ((8u << prefix) - 2);
+
+  switch (prefix) {
+  case 0:
+    *p = (uint8_t)n;
+    return p + 1;
+  case 1:
+    return ngtcp2_put_uint16be(p, (uint16_t)n);
+  case 2:
+    return ngtcp2_put_uint32be(p, (uint32_t)n);
+  default:
+    return ngtcp2_put_uint64be(p, n);
+  }
 }
 
 uint8_t *ngtcp2_put_varint30(uint8_t *p, uint32_t n) {
@@ -192,17 +285,9 @@ size_t ngtcp2_get_varint_len(const uint8_t *p) {
 }
 
 size_t ngtcp2_put_varint_len(uint64_t n) {
-  if (n < 64) {
-    return 1;
-  }
-  if (n < 16384) {
-    return 2;
-  }
-  if (n < 1073741824) {
-    return 4;
-  }
   assert(n < 4611686018427387904ULL);
-  return 8;
+
+  return (size_t)1 << varint_prefix_table[bit_length(n)];
 }
 
 int64_t ngtcp2_nth_server_bidi_id(uint64_t n) {
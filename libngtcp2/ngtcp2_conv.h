@@ -73,6 +73,22 @@ uint16_t ngtcp2_get_uint16(const uint8_t *p);
  */
 uint64_t ngtcp2_get_varint(size_t *plen, const uint8_t *p);
 
+/*
+ * ngtcp2_get_varint_padded is the same as ngtcp2_get_varint, but it
+ * always reads 8 bytes from |p| to avoid branching on the length.
+ * The buffer pointed by |p| must have at least 8 bytes.
+ */
+uint64_t ngtcp2_get_varint_padded(size_t *plen, const uint8_t *p);
+
+/*
+ * ngtcp2_get_varints reads |n| consecutive variable-length integers
+ * from the buffer [|p|, |end|), and stores them to |dest| in host
+ * byte order.  It returns the one beyond of the last byte read, or
+ * NULL if the buffer ends before |n| integers are read.
+ */
+const uint8_t *ngtcp2_get_varints(uint64_t *dest, size_t n, const uint8_t *p,
+                                  const uint8_t *end);
+
 /*
  * ngtcp2_get_pkt_num reads encoded packet number from |p|.  The
  * packet number is encoed in |pkt_numlen| bytes.
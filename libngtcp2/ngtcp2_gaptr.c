@@ -28,24 +28,16 @@
 #include <assert.h>
 
 void ngtcp2_gaptr_init(ngtcp2_gaptr *gaptr, const ngtcp2_mem *mem) {
-  ngtcp2_ksl_init(&gaptr->gap, ngtcp2_ksl_range_compar, sizeof(ngtcp2_range),
-                  mem);
+  ngtcp2_ksl_init(&gaptr->gap, ngtcp2_ksl_range_compar,
+                  ngtcp2_ksl_range_search, sizeof(ngtcp2_range), mem);
 
+  gaptr->inline_gap[0].begin = 0;
+  gaptr->inline_gap[0].end = UINT64_MAX;
+  gaptr->ninline_gap = 1;
+  gaptr->use_ksl = 0;
   gaptr->mem = mem;
 }
 
-static int gaptr_gap_init(ngtcp2_gaptr *gaptr) {
-  ngtcp2_range range = {0, UINT64_MAX};
-  int rv;
-
-  rv = ngtcp2_ksl_insert(&gaptr->gap, NULL, &range, NULL);
-  if (rv != 0) {
-    return rv;
-  }
-
-  return 0;
-}
-
 void ngtcp2_gaptr_free(ngtcp2_gaptr *gaptr) {
   if (gaptr == NULL) {
     return;
@@ -54,20 +46,58 @@ void ngtcp2_gaptr_free(ngtcp2_gaptr *gaptr) {
   ngtcp2_ksl_free(&gaptr->gap);
 }
 
-int ngtcp2_gaptr_push(ngtcp2_gaptr *gaptr, uint64_t offset, uint64_t datalen) {
+/*
+ * gaptr_move_to_ksl moves all gaps in gaptr->inline_gap to
+ * gaptr->gap.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory
+ */
+static int gaptr_move_to_ksl(ngtcp2_gaptr *gaptr) {
+  size_t i;
   int rv;
-  ngtcp2_range k, m, l, r, q = {offset, offset + datalen};
-  ngtcp2_ksl_it it;
 
-  if (ngtcp2_ksl_len(&gaptr->gap) == 0) {
-    rv = gaptr_gap_init(gaptr);
+  for (i = 0; i < gaptr->ninline_gap; ++i) {
+    rv = ngtcp2_ksl_insert(&gaptr->gap, NULL, &gaptr->inline_gap[i], NULL);
     if (rv != 0) {
+      ngtcp2_ksl_clear(&gaptr->gap);
       return rv;
     }
   }
 
-  it = ngtcp2_ksl_lower_bound_compar(&gaptr->gap, &q,
-                                     ngtcp2_ksl_range_exclusive_compar);
+  gaptr->ninline_gap = 0;
+  gaptr->use_ksl = 1;
+
+  return 0;
+}
+
+/*
+ * gaptr_inline_first_gap_after returns the index of the first gap in
+ * gaptr->inline_gap which ends after |offset|.  It returns
+ * gaptr->ninline_gap if there is no such gap.
+ */
+static size_t gaptr_inline_first_gap_after(ngtcp2_gaptr *gaptr,
+                                           uint64_t offset) {
+  size_t i;
+
+  for (i = 0; i < gaptr->ninline_gap && gaptr->inline_gap[i].end <= offset;
+       ++i)
+    ;
+
+  return i;
+}
+
+static int gaptr_push_ksl(ngtcp2_gaptr *gaptr, uint64_t offset,
+                          uint64_t datalen) {
+  int rv;
+  ngtcp2_range k, m, l, r, q = {offset, offset + datalen};
+  ngtcp2_ksl_it it;
+
+  it = ngtcp2_ksl_lower_bound_search(&gaptr->gap, &q,
+                                     ngtcp2_ksl_range_exclusive_search);
 
   for (; !ngtcp2_ksl_it_end(&it);) {
     k = *(ngtcp2_range *)ngtcp2_ksl_it_key(&it);
@@ -98,12 +128,80 @@ int ngtcp2_gaptr_push(ngtcp2_gaptr *gaptr, uint64_t offset, uint64_t datalen) {
   return 0;
 }
 
+int ngtcp2_gaptr_push(ngtcp2_gaptr *gaptr, uint64_t offset, uint64_t datalen) {
+  int rv;
+  ngtcp2_range *g = gaptr->inline_gap;
+  ngtcp2_range q = {offset, offset + datalen};
+  size_t i, j;
+
+  if (gaptr->use_ksl) {
+    return gaptr_push_ksl(gaptr, offset, datalen);
+  }
+
+  if (datalen == 0) {
+    return 0;
+  }
+
+  i = gaptr_inline_first_gap_after(gaptr, q.begin);
+  if (i == gaptr->ninline_gap || q.end <= g[i].begin) {
+    return 0;
+  }
+
+  if (g[i].begin < q.begin && q.end < g[i].end) {
+    /* q splits g[i] into 2 gaps. */
+    if (gaptr->ninline_gap == NGTCP2_GAPTR_MAX_INLINE_GAP) {
+      rv = gaptr_move_to_ksl(gaptr);
+      if (rv != 0) {
+        return rv;
+      }
+
+      return gaptr_push_ksl(gaptr, offset, datalen);
+    }
+
+    memmove(&g[i + 2], &g[i + 1],
+            sizeof(g[0]) * (gaptr->ninline_gap - i - 1));
+    g[i + 1].begin = q.end;
+    g[i + 1].end = g[i].end;
+    g[i].end = q.begin;
+    ++gaptr->ninline_gap;
+
+    return 0;
+  }
+
+  if (g[i].begin < q.begin) {
+    g[i].end = q.begin;
+    ++i;
+  }
+
+  for (j = i; j < gaptr->ninline_gap && g[j].end <= q.end; ++j)
+    ;
+
+  if (j < gaptr->ninline_gap && g[j].begin < q.end) {
+    g[j].begin = q.end;
+  }
+
+  if (i < j) {
+    memmove(&g[i], &g[j], sizeof(g[0]) * (gaptr->ninline_gap - j));
+    gaptr->ninline_gap -= j - i;
+  }
+
+  return 0;
+}
+
 uint64_t ngtcp2_gaptr_first_gap_offset(ngtcp2_gaptr *gaptr) {
   ngtcp2_ksl_it it;
   ngtcp2_range r;
 
+  if (!gaptr->use_ksl) {
+    if (gaptr->ninline_gap == 0) {
+      return UINT64_MAX;
+    }
+
+    return gaptr->inline_gap[0].begin;
+  }
+
   if (ngtcp2_ksl_len(&gaptr->gap) == 0) {
-    return 0;
+    return UINT64_MAX;
   }
 
   it = ngtcp2_ksl_begin(&gaptr->gap);
@@ -115,15 +213,28 @@ uint64_t ngtcp2_gaptr_first_gap_offset(ngtcp2_gaptr *gaptr) {
 ngtcp2_range ngtcp2_gaptr_get_first_gap_after(ngtcp2_gaptr *gaptr,
                                               uint64_t offset) {
   ngtcp2_range q = {offset, offset + 1};
+  ngtcp2_range none = {0, UINT64_MAX};
   ngtcp2_ksl_it it;
+  size_t i;
+
+  if (!gaptr->use_ksl) {
+    if (gaptr->ninline_gap == 0) {
+      return none;
+    }
+
+    i = gaptr_inline_first_gap_after(gaptr, offset);
+
+    assert(i < gaptr->ninline_gap);
+
+    return gaptr->inline_gap[i];
+  }
 
   if (ngtcp2_ksl_len(&gaptr->gap) == 0) {
-    ngtcp2_range r = {0, UINT64_MAX};
-    return r;
+    return none;
   }
 
-  it = ngtcp2_ksl_lower_bound_compar(&gaptr->gap, &q,
-                                     ngtcp2_ksl_range_exclusive_compar);
+  it = ngtcp2_ksl_lower_bound_search(&gaptr->gap, &q,
+                                     ngtcp2_ksl_range_exclusive_search);
 
   assert(!ngtcp2_ksl_it_end(&it));
 
@@ -136,23 +247,54 @@ int ngtcp2_gaptr_is_pushed(ngtcp2_gaptr *gaptr, uint64_t offset,
   ngtcp2_ksl_it it;
   ngtcp2_range k;
   ngtcp2_range m;
+  size_t i;
 
-  if (ngtcp2_ksl_len(&gaptr->gap) == 0) {
-    return 0;
+  if (!gaptr->use_ksl) {
+    i = gaptr_inline_first_gap_after(gaptr, offset);
+    if (i == gaptr->ninline_gap) {
+      return 1;
+    }
+
+    k = gaptr->inline_gap[i];
+  } else {
+    it = ngtcp2_ksl_lower_bound_search(&gaptr->gap, &q,
+                                       ngtcp2_ksl_range_exclusive_search);
+    if (ngtcp2_ksl_it_end(&it)) {
+      return 1;
+    }
+
+    k = *(ngtcp2_range *)ngtcp2_ksl_it_key(&it);
   }
 
-  it = ngtcp2_ksl_lower_bound_compar(&gaptr->gap, &q,
-                                     ngtcp2_ksl_range_exclusive_compar);
-  k = *(ngtcp2_range *)ngtcp2_ksl_it_key(&it);
   m = ngtcp2_range_intersect(&q, &k);
 
   return ngtcp2_range_len(&m) == 0;
 }
 
+size_t ngtcp2_gaptr_len(ngtcp2_gaptr *gaptr) {
+  if (!gaptr->use_ksl) {
+    return gaptr->ninline_gap;
+  }
+
+  return ngtcp2_ksl_len(&gaptr->gap);
+}
+
 void ngtcp2_gaptr_drop_first_gap(ngtcp2_gaptr *gaptr) {
   ngtcp2_ksl_it it;
   ngtcp2_range r;
 
+  if (!gaptr->use_ksl) {
+    if (gaptr->ninline_gap == 0) {
+      return;
+    }
+
+    --gaptr->ninline_gap;
+    memmove(&gaptr->inline_gap[0], &gaptr->inline_gap[1],
+            sizeof(gaptr->inline_gap[0]) * gaptr->ninline_gap);
+
+    return;
+  }
+
   if (ngtcp2_ksl_len(&gaptr->gap) == 0) {
     return;
   }
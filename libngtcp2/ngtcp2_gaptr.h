@@ -35,13 +35,30 @@
 #include "ngtcp2_ksl.h"
 #include "ngtcp2_range.h"
 
+/* NGTCP2_GAPTR_MAX_INLINE_GAP is the maximum number of gaps which
+   ngtcp2_gaptr stores without allocating ngtcp2_ksl. */
+#define NGTCP2_GAPTR_MAX_INLINE_GAP 4
+
 /*
  * ngtcp2_gaptr maintains the gap in the range [0, UINT64_MAX).
+ *
+ * It usually has only a few gaps, so they are stored in a small array
+ * embedded in this object.  They are moved to gap field once the
+ * number of gaps exceeds NGTCP2_GAPTR_MAX_INLINE_GAP, and stay there
+ * until this object is freed.
  */
 typedef struct ngtcp2_gaptr {
-  /* gap maintains the range of offset which is not received
-     yet. Initially, its range is [0, UINT64_MAX). */
+  /* gap maintains the range of offset which is not received yet if
+     use_ksl is nonzero. */
   ngtcp2_ksl gap;
+  /* inline_gap maintains the range of offset which is not received
+     yet in ascending order if use_ksl is zero.  Initially, it
+     contains [0, UINT64_MAX). */
+  ngtcp2_range inline_gap[NGTCP2_GAPTR_MAX_INLINE_GAP];
+  /* ninline_gap is the number of gaps in inline_gap. */
+  size_t ninline_gap;
+  /* use_ksl is nonzero if gap, rather than inline_gap, is used. */
+  int use_ksl;
   /* mem is custom memory allocator */
   const ngtcp2_mem *mem;
 } ngtcp2_gaptr;
@@ -76,7 +93,8 @@ uint64_t ngtcp2_gaptr_first_gap_offset(ngtcp2_gaptr *gaptr);
 
 /*
  * ngtcp2_gaptr_get_first_gap_after returns the first gap which
- * overlaps or comes after |offset|.
+ * overlaps or comes after |offset|.  If there is no gap, it returns
+ * {0, UINT64_MAX}.
  */
 ngtcp2_range ngtcp2_gaptr_get_first_gap_after(ngtcp2_gaptr *gaptr,
                                               uint64_t offset);
@@ -88,6 +106,11 @@ ngtcp2_range ngtcp2_gaptr_get_first_gap_after(ngtcp2_gaptr *gaptr,
 int ngtcp2_gaptr_is_pushed(ngtcp2_gaptr *gaptr, uint64_t offset,
                            uint64_t datalen);
 
+/*
+ * ngtcp2_gaptr_len returns the number of gaps.
+ */
+size_t ngtcp2_gaptr_len(ngtcp2_gaptr *gaptr);
+
 /*
  * ngtcp2_gaptr_drop_first_gap deletes the first gap entirely as if
  * the range is pushed.  This function assumes that at least one gap
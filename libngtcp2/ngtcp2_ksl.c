@@ -33,44 +33,54 @@
 #include "ngtcp2_mem.h"
 #include "ngtcp2_range.h"
 
-static ngtcp2_ksl_blk null_blk = {{{NULL, NULL, 0, 0, {0}}}};
+static ngtcp2_ksl_blk null_blk;
 
-static size_t ksl_nodelen(size_t keylen) {
-  return (sizeof(ngtcp2_ksl_node) + keylen - sizeof(uint64_t) + 0xfllu) &
-         (size_t)~0xfllu;
+static size_t ksl_blklen(size_t keylen) {
+  return sizeof(ngtcp2_ksl_blk) + keylen * (NGTCP2_KSL_MAX_NBLK + 1) -
+         sizeof(uint64_t);
 }
 
-static size_t ksl_blklen(size_t nodelen) {
-  return sizeof(ngtcp2_ksl_blk) + nodelen * NGTCP2_KSL_MAX_NBLK -
-         sizeof(uint64_t);
+/*
+ * ksl_set_key sets |key| to the |i|th node under |blk|.
+ */
+static void ksl_set_key(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i,
+                        const void *key) {
+  memcpy(blk->keys + ksl->keylen * i, key, ksl->keylen);
 }
 
 /*
- * ksl_node_set_key sets |key| to |node|.
+ * ksl_move_nodes moves |n| nodes starting at the index |src_i| under
+ * |src| to the index |dst_i| under |dst| along with their keys.  The
+ * source and destination may overlap.
  */
-static void ksl_node_set_key(ngtcp2_ksl *ksl, ngtcp2_ksl_node *node,
-                             const void *key) {
-  memcpy(node->key, key, ksl->keylen);
+static void ksl_move_nodes(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *dst, size_t dst_i,
+                           ngtcp2_ksl_blk *src, size_t src_i, size_t n) {
+  memmove(dst->nodes + dst_i, src->nodes + src_i, sizeof(ngtcp2_ksl_node) * n);
+  memmove(dst->keys + ksl->keylen * dst_i, src->keys + ksl->keylen * src_i,
+          ksl->keylen * n);
 }
 
-void ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar, size_t keylen,
+static ngtcp2_ksl_search ksl_select_search(ngtcp2_ksl_search search);
+
+void ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar,
+                     ngtcp2_ksl_search search, size_t keylen,
                      const ngtcp2_mem *mem) {
-  size_t nodelen = ksl_nodelen(keylen);
+  size_t blklen = ksl_blklen(keylen);
 
-  ngtcp2_objalloc_init(&ksl->blkalloc,
-                       ((ksl_blklen(nodelen) + 0xfllu) & ~0xfllu) * 8, mem);
+  ngtcp2_objalloc_init(&ksl->blkalloc, ((blklen + 0xfllu) & ~0xfllu) * 8,
+                       mem);
 
   ksl->head = NULL;
   ksl->front = ksl->back = NULL;
   ksl->compar = compar;
+  ksl->search = ksl_select_search(search);
   ksl->keylen = keylen;
-  ksl->nodelen = nodelen;
+  ksl->blklen = blklen;
   ksl->n = 0;
 }
 
 static ngtcp2_ksl_blk *ksl_blk_objalloc_new(ngtcp2_ksl *ksl) {
-  return ngtcp2_objalloc_ksl_blk_len_get(&ksl->blkalloc,
-                                         ksl_blklen(ksl->nodelen));
+  return ngtcp2_objalloc_ksl_blk_len_get(&ksl->blkalloc, ksl->blklen);
 }
 
 static void ksl_blk_objalloc_del(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk) {
@@ -102,7 +112,7 @@ static void ksl_free_blk(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk) {
 
   if (!blk->leaf) {
     for (i = 0; i < blk->n; ++i) {
-      ksl_free_blk(ksl, ngtcp2_ksl_nth_node(ksl, blk, i)->blk);
+      ksl_free_blk(ksl, ngtcp2_ksl_nth_node(blk, i)->blk);
     }
   }
 
@@ -150,8 +160,7 @@ static ngtcp2_ksl_blk *ksl_split_blk(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk) {
 
   rblk->n = blk->n / 2;
 
-  memcpy(rblk->nodes, blk->nodes + ksl->nodelen * (blk->n - rblk->n),
-         ksl->nodelen * rblk->n);
+  ksl_move_nodes(ksl, rblk, 0, blk, blk->n - rblk->n, rblk->n);
 
   blk->n -= rblk->n;
 
@@ -173,25 +182,20 @@ static ngtcp2_ksl_blk *ksl_split_blk(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk) {
  *   Out of memory.
  */
 static int ksl_split_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
-  ngtcp2_ksl_node *node;
-  ngtcp2_ksl_blk *lblk = ngtcp2_ksl_nth_node(ksl, blk, i)->blk, *rblk;
+  ngtcp2_ksl_blk *lblk = ngtcp2_ksl_nth_node(blk, i)->blk, *rblk;
 
   rblk = ksl_split_blk(ksl, lblk);
   if (rblk == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
 
-  memmove(blk->nodes + (i + 2) * ksl->nodelen,
-          blk->nodes + (i + 1) * ksl->nodelen,
-          ksl->nodelen * (blk->n - (i + 1)));
+  ksl_move_nodes(ksl, blk, i + 2, blk, i + 1, blk->n - (i + 1));
 
-  node = ngtcp2_ksl_nth_node(ksl, blk, i + 1);
-  node->blk = rblk;
+  ngtcp2_ksl_nth_node(blk, i + 1)->blk = rblk;
   ++blk->n;
-  ksl_node_set_key(ksl, node, ngtcp2_ksl_nth_node(ksl, rblk, rblk->n - 1)->key);
+  ksl_set_key(ksl, blk, i + 1, ngtcp2_ksl_nth_key(ksl, rblk, rblk->n - 1));
 
-  node = ngtcp2_ksl_nth_node(ksl, blk, i);
-  ksl_node_set_key(ksl, node, ngtcp2_ksl_nth_node(ksl, lblk, lblk->n - 1)->key);
+  ksl_set_key(ksl, blk, i, ngtcp2_ksl_nth_key(ksl, lblk, lblk->n - 1));
 
   return 0;
 }
@@ -208,7 +212,6 @@ static int ksl_split_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
  */
 static int ksl_split_head(ngtcp2_ksl *ksl) {
   ngtcp2_ksl_blk *rblk = NULL, *lblk, *nhead = NULL;
-  ngtcp2_ksl_node *node;
 
   rblk = ksl_split_blk(ksl, ksl->head);
   if (rblk == NULL) {
@@ -226,13 +229,11 @@ static int ksl_split_head(ngtcp2_ksl *ksl) {
   nhead->n = 2;
   nhead->leaf = 0;
 
-  node = ngtcp2_ksl_nth_node(ksl, nhead, 0);
-  ksl_node_set_key(ksl, node, ngtcp2_ksl_nth_node(ksl, lblk, lblk->n - 1)->key);
-  node->blk = lblk;
+  ksl_set_key(ksl, nhead, 0, ngtcp2_ksl_nth_key(ksl, lblk, lblk->n - 1));
+  ngtcp2_ksl_nth_node(nhead, 0)->blk = lblk;
 
-  node = ngtcp2_ksl_nth_node(ksl, nhead, 1);
-  ksl_node_set_key(ksl, node, ngtcp2_ksl_nth_node(ksl, rblk, rblk->n - 1)->key);
-  node->blk = rblk;
+  ksl_set_key(ksl, nhead, 1, ngtcp2_ksl_nth_key(ksl, rblk, rblk->n - 1));
+  ngtcp2_ksl_nth_node(nhead, 1)->blk = rblk;
 
   ksl->head = nhead;
 
@@ -247,28 +248,28 @@ static int ksl_split_head(ngtcp2_ksl *ksl) {
  */
 static void ksl_insert_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i,
                             const ngtcp2_ksl_key *key, void *data) {
-  ngtcp2_ksl_node *node;
-
   assert(blk->n < NGTCP2_KSL_MAX_NBLK);
 
-  memmove(blk->nodes + (i + 1) * ksl->nodelen, blk->nodes + i * ksl->nodelen,
-          ksl->nodelen * (blk->n - i));
+  ksl_move_nodes(ksl, blk, i + 1, blk, i, blk->n - i);
 
-  node = ngtcp2_ksl_nth_node(ksl, blk, i);
-  ksl_node_set_key(ksl, node, key);
-  node->data = data;
+  ksl_set_key(ksl, blk, i, key);
+  ngtcp2_ksl_nth_node(blk, i)->data = data;
 
   ++blk->n;
 }
 
-static size_t ksl_bsearch(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk,
-                          const ngtcp2_ksl_key *key, ngtcp2_ksl_compar compar) {
+/*
+ * ksl_compar_search is the ngtcp2_ksl_search which calls ksl->compar
+ * for each key.
+ */
+static size_t ksl_compar_search(const ngtcp2_ksl *ksl,
+                                const ngtcp2_ksl_blk *blk,
+                                const ngtcp2_ksl_key *key) {
   size_t i;
-  ngtcp2_ksl_node *node;
+  const uint8_t *k;
 
-  for (i = 0, node = (ngtcp2_ksl_node *)(void *)blk->nodes;
-       i < blk->n && compar((ngtcp2_ksl_key *)node->key, key);
-       ++i, node = (ngtcp2_ksl_node *)(void *)((uint8_t *)node + ksl->nodelen))
+  for (i = 0, k = blk->keys; i < blk->n && ksl->compar(k, key);
+       ++i, k += ksl->keylen)
     ;
 
   return i;
@@ -299,11 +300,11 @@ int ngtcp2_ksl_insert(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
   }
 
   for (;;) {
-    i = ksl_bsearch(ksl, blk, key, ksl->compar);
+    i = ksl->search(ksl, blk, key);
 
     if (blk->leaf) {
       if (i < blk->n &&
-          !ksl->compar(key, ngtcp2_ksl_nth_node(ksl, blk, i)->key)) {
+          !ksl->compar(key, ngtcp2_ksl_nth_key(ksl, blk, i))) {
         if (it) {
           *it = ngtcp2_ksl_end(ksl);
         }
@@ -320,15 +321,15 @@ int ngtcp2_ksl_insert(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
     if (i == blk->n) {
       /* This insertion extends the largest key in this subtree. */
       for (; !blk->leaf;) {
-        node = ngtcp2_ksl_nth_node(ksl, blk, blk->n - 1);
+        node = ngtcp2_ksl_nth_node(blk, blk->n - 1);
         if (node->blk->n == NGTCP2_KSL_MAX_NBLK) {
           rv = ksl_split_node(ksl, blk, blk->n - 1);
           if (rv != 0) {
             return rv;
           }
-          node = ngtcp2_ksl_nth_node(ksl, blk, blk->n - 1);
+          node = ngtcp2_ksl_nth_node(blk, blk->n - 1);
         }
-        ksl_node_set_key(ksl, node, key);
+        ksl_set_key(ksl, blk, blk->n - 1, key);
         blk = node->blk;
       }
       ksl_insert_node(ksl, blk, blk->n, key, data);
@@ -339,17 +340,17 @@ int ngtcp2_ksl_insert(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
       return 0;
     }
 
-    node = ngtcp2_ksl_nth_node(ksl, blk, i);
+    node = ngtcp2_ksl_nth_node(blk, i);
 
     if (node->blk->n == NGTCP2_KSL_MAX_NBLK) {
       rv = ksl_split_node(ksl, blk, i);
       if (rv != 0) {
         return rv;
       }
-      if (ksl->compar((ngtcp2_ksl_key *)node->key, key)) {
-        node = ngtcp2_ksl_nth_node(ksl, blk, i + 1);
-        if (ksl->compar((ngtcp2_ksl_key *)node->key, key)) {
-          ksl_node_set_key(ksl, node, key);
+      if (ksl->compar(ngtcp2_ksl_nth_key(ksl, blk, i), key)) {
+        node = ngtcp2_ksl_nth_node(blk, i + 1);
+        if (ksl->compar(ngtcp2_ksl_nth_key(ksl, blk, i + 1), key)) {
+          ksl_set_key(ksl, blk, i + 1, key);
         }
       }
     }
@@ -363,8 +364,7 @@ int ngtcp2_ksl_insert(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
  * |i|.
  */
 static void ksl_remove_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
-  memmove(blk->nodes + i * ksl->nodelen, blk->nodes + (i + 1) * ksl->nodelen,
-          ksl->nodelen * (blk->n - (i + 1)));
+  ksl_move_nodes(ksl, blk, i, blk, i + 1, blk->n - (i + 1));
 
   --blk->n;
 }
@@ -385,13 +385,12 @@ static ngtcp2_ksl_blk *ksl_merge_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk,
 
   assert(i + 1 < blk->n);
 
-  lblk = ngtcp2_ksl_nth_node(ksl, blk, i)->blk;
-  rblk = ngtcp2_ksl_nth_node(ksl, blk, i + 1)->blk;
+  lblk = ngtcp2_ksl_nth_node(blk, i)->blk;
+  rblk = ngtcp2_ksl_nth_node(blk, i + 1)->blk;
 
   assert(lblk->n + rblk->n < NGTCP2_KSL_MAX_NBLK);
 
-  memcpy(lblk->nodes + ksl->nodelen * lblk->n, rblk->nodes,
-         ksl->nodelen * rblk->n);
+  ksl_move_nodes(ksl, lblk, lblk->n, rblk, 0, rblk->n);
 
   lblk->n += rblk->n;
   lblk->next = rblk->next;
@@ -408,8 +407,7 @@ static ngtcp2_ksl_blk *ksl_merge_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk,
     ksl->head = lblk;
   } else {
     ksl_remove_node(ksl, blk, i + 1);
-    ksl_node_set_key(ksl, ngtcp2_ksl_nth_node(ksl, blk, i),
-                     ngtcp2_ksl_nth_node(ksl, lblk, lblk->n - 1)->key);
+    ksl_set_key(ksl, blk, i, ngtcp2_ksl_nth_key(ksl, lblk, lblk->n - 1));
   }
 
   return lblk;
@@ -421,34 +419,31 @@ static ngtcp2_ksl_blk *ksl_merge_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk,
  * same amount of nodes as much as possible.
  */
 static void ksl_shift_left(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
-  ngtcp2_ksl_node *lnode, *rnode;
+  ngtcp2_ksl_blk *lblk, *rblk;
   size_t n;
 
   assert(i > 0);
 
-  lnode = ngtcp2_ksl_nth_node(ksl, blk, i - 1);
-  rnode = ngtcp2_ksl_nth_node(ksl, blk, i);
+  lblk = ngtcp2_ksl_nth_node(blk, i - 1)->blk;
+  rblk = ngtcp2_ksl_nth_node(blk, i)->blk;
 
-  assert(lnode->blk->n < NGTCP2_KSL_MAX_NBLK);
-  assert(rnode->blk->n > NGTCP2_KSL_MIN_NBLK);
+  assert(lblk->n < NGTCP2_KSL_MAX_NBLK);
+  assert(rblk->n > NGTCP2_KSL_MIN_NBLK);
 
-  n = (lnode->blk->n + rnode->blk->n + 1) / 2 - lnode->blk->n;
+  n = (lblk->n + rblk->n + 1) / 2 - lblk->n;
 
   assert(n > 0);
-  assert(lnode->blk->n <= NGTCP2_KSL_MAX_NBLK - n);
-  assert(rnode->blk->n >= NGTCP2_KSL_MIN_NBLK + n);
+  assert(lblk->n <= NGTCP2_KSL_MAX_NBLK - n);
+  assert(rblk->n >= NGTCP2_KSL_MIN_NBLK + n);
 
-  memcpy(lnode->blk->nodes + ksl->nodelen * lnode->blk->n, rnode->blk->nodes,
-         ksl->nodelen * n);
+  ksl_move_nodes(ksl, lblk, lblk->n, rblk, 0, n);
 
-  lnode->blk->n += (uint32_t)n;
-  rnode->blk->n -= (uint32_t)n;
+  lblk->n += (uint32_t)n;
+  rblk->n -= (uint32_t)n;
 
-  ksl_node_set_key(
-      ksl, lnode, ngtcp2_ksl_nth_node(ksl, lnode->blk, lnode->blk->n - 1)->key);
+  ksl_set_key(ksl, blk, i - 1, ngtcp2_ksl_nth_key(ksl, lblk, lblk->n - 1));
 
-  memmove(rnode->blk->nodes, rnode->blk->nodes + ksl->nodelen * n,
-          ksl->nodelen * rnode->blk->n);
+  ksl_move_nodes(ksl, rblk, 0, rblk, n, rblk->n);
 }
 
 /*
@@ -457,34 +452,31 @@ static void ksl_shift_left(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
  * same amount of nodes as much as possible..
  */
 static void ksl_shift_right(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t i) {
-  ngtcp2_ksl_node *lnode, *rnode;
+  ngtcp2_ksl_blk *lblk, *rblk;
   size_t n;
 
   assert(i < blk->n - 1);
 
-  lnode = ngtcp2_ksl_nth_node(ksl, blk, i);
-  rnode = ngtcp2_ksl_nth_node(ksl, blk, i + 1);
+  lblk = ngtcp2_ksl_nth_node(blk, i)->blk;
+  rblk = ngtcp2_ksl_nth_node(blk, i + 1)->blk;
 
-  assert(lnode->blk->n > NGTCP2_KSL_MIN_NBLK);
-  assert(rnode->blk->n < NGTCP2_KSL_MAX_NBLK);
+  assert(lblk->n > NGTCP2_KSL_MIN_NBLK);
+  assert(rblk->n < NGTCP2_KSL_MAX_NBLK);
 
-  n = (lnode->blk->n + rnode->blk->n + 1) / 2 - rnode->blk->n;
+  n = (lblk->n + rblk->n + 1) / 2 - rblk->n;
 
   assert(n > 0);
-  assert(lnode->blk->n >= NGTCP2_KSL_MIN_NBLK + n);
-  assert(rnode->blk->n <= NGTCP2_KSL_MAX_NBLK - n);
+  assert(lblk->n >= NGTCP2_KSL_MIN_NBLK + n);
+  assert(rblk->n <= NGTCP2_KSL_MAX_NBLK - n);
 
-  memmove(rnode->blk->nodes + ksl->nodelen * n, rnode->blk->nodes,
-          ksl->nodelen * rnode->blk->n);
+  ksl_move_nodes(ksl, rblk, n, rblk, 0, rblk->n);
 
-  rnode->blk->n += (uint32_t)n;
-  lnode->blk->n -= (uint32_t)n;
+  rblk->n += (uint32_t)n;
+  lblk->n -= (uint32_t)n;
 
-  memcpy(rnode->blk->nodes, lnode->blk->nodes + ksl->nodelen * lnode->blk->n,
-         ksl->nodelen * n);
+  ksl_move_nodes(ksl, rblk, 0, lblk, lblk->n, n);
 
-  ksl_node_set_key(
-      ksl, lnode, ngtcp2_ksl_nth_node(ksl, lnode->blk, lnode->blk->n - 1)->key);
+  ksl_set_key(ksl, blk, i, ngtcp2_ksl_nth_key(ksl, lblk, lblk->n - 1));
 }
 
 /*
@@ -533,13 +525,13 @@ int ngtcp2_ksl_remove(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
   }
 
   if (!blk->leaf && blk->n == 2 &&
-      ngtcp2_ksl_nth_node(ksl, blk, 0)->blk->n == NGTCP2_KSL_MIN_NBLK &&
-      ngtcp2_ksl_nth_node(ksl, blk, 1)->blk->n == NGTCP2_KSL_MIN_NBLK) {
+      ngtcp2_ksl_nth_node(blk, 0)->blk->n == NGTCP2_KSL_MIN_NBLK &&
+      ngtcp2_ksl_nth_node(blk, 1)->blk->n == NGTCP2_KSL_MIN_NBLK) {
     blk = ksl_merge_node(ksl, ksl->head, 0);
   }
 
   for (;;) {
-    i = ksl_bsearch(ksl, blk, key, ksl->compar);
+    i = ksl->search(ksl, blk, key);
 
     if (i == blk->n) {
       if (it) {
@@ -549,7 +541,7 @@ int ngtcp2_ksl_remove(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
     }
 
     if (blk->leaf) {
-      if (ksl->compar(key, ngtcp2_ksl_nth_node(ksl, blk, i)->key)) {
+      if (ksl->compar(key, ngtcp2_ksl_nth_key(ksl, blk, i))) {
         if (it) {
           *it = ngtcp2_ksl_end(ksl);
         }
@@ -567,7 +559,7 @@ int ngtcp2_ksl_remove(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
       return 0;
     }
 
-    node = ngtcp2_ksl_nth_node(ksl, blk, i);
+    node = ngtcp2_ksl_nth_node(blk, i);
 
     if (node->blk->n > NGTCP2_KSL_MIN_NBLK) {
       blk = node->blk;
@@ -577,14 +569,14 @@ int ngtcp2_ksl_remove(ngtcp2_ksl *ksl, ngtcp2_ksl_it *it,
     assert(node->blk->n == NGTCP2_KSL_MIN_NBLK);
 
     if (i + 1 < blk->n &&
-        ngtcp2_ksl_nth_node(ksl, blk, i + 1)->blk->n > NGTCP2_KSL_MIN_NBLK) {
+        ngtcp2_ksl_nth_node(blk, i + 1)->blk->n > NGTCP2_KSL_MIN_NBLK) {
       ksl_shift_left(ksl, blk, i + 1);
       blk = node->blk;
       continue;
     }
 
     if (i > 0 &&
-        ngtcp2_ksl_nth_node(ksl, blk, i - 1)->blk->n > NGTCP2_KSL_MIN_NBLK) {
+        ngtcp2_ksl_nth_node(blk, i - 1)->blk->n > NGTCP2_KSL_MIN_NBLK) {
       ksl_shift_right(ksl, blk, i - 1);
       blk = node->blk;
       continue;
@@ -613,7 +605,7 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound(ngtcp2_ksl *ksl,
   }
 
   for (;;) {
-    i = ksl_bsearch(ksl, blk, key, ksl->compar);
+    i = ksl->search(ksl, blk, key);
 
     if (blk->leaf) {
       if (i == blk->n && blk->next) {
@@ -627,7 +619,7 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound(ngtcp2_ksl *ksl,
     if (i == blk->n) {
       /* This happens if descendant has smaller key.  Fast forward to
          find last node in this subtree. */
-      for (; !blk->leaf; blk = ngtcp2_ksl_nth_node(ksl, blk, blk->n - 1)->blk)
+      for (; !blk->leaf; blk = ngtcp2_ksl_nth_node(blk, blk->n - 1)->blk)
         ;
       if (blk->next) {
         blk = blk->next;
@@ -638,13 +630,13 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound(ngtcp2_ksl *ksl,
       ngtcp2_ksl_it_init(&it, ksl, blk, i);
       return it;
     }
-    blk = ngtcp2_ksl_nth_node(ksl, blk, i)->blk;
+    blk = ngtcp2_ksl_nth_node(blk, i)->blk;
   }
 }
 
-ngtcp2_ksl_it ngtcp2_ksl_lower_bound_compar(ngtcp2_ksl *ksl,
+ngtcp2_ksl_it ngtcp2_ksl_lower_bound_search(ngtcp2_ksl *ksl,
                                             const ngtcp2_ksl_key *key,
-                                            ngtcp2_ksl_compar compar) {
+                                            ngtcp2_ksl_search search) {
   ngtcp2_ksl_blk *blk = ksl->head;
   ngtcp2_ksl_it it;
   size_t i;
@@ -654,8 +646,10 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound_compar(ngtcp2_ksl *ksl,
     return it;
   }
 
+  search = ksl_select_search(search);
+
   for (;;) {
-    i = ksl_bsearch(ksl, blk, key, compar);
+    i = search(ksl, blk, key);
 
     if (blk->leaf) {
       if (i == blk->n && blk->next) {
@@ -669,7 +663,7 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound_compar(ngtcp2_ksl *ksl,
     if (i == blk->n) {
       /* This happens if descendant has smaller key.  Fast forward to
          find last node in this subtree. */
-      for (; !blk->leaf; blk = ngtcp2_ksl_nth_node(ksl, blk, blk->n - 1)->blk)
+      for (; !blk->leaf; blk = ngtcp2_ksl_nth_node(blk, blk->n - 1)->blk)
         ;
       if (blk->next) {
         blk = blk->next;
@@ -680,56 +674,55 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound_compar(ngtcp2_ksl *ksl,
       ngtcp2_ksl_it_init(&it, ksl, blk, i);
       return it;
     }
-    blk = ngtcp2_ksl_nth_node(ksl, blk, i)->blk;
+    blk = ngtcp2_ksl_nth_node(blk, i)->blk;
   }
 }
 
 void ngtcp2_ksl_update_key(ngtcp2_ksl *ksl, const ngtcp2_ksl_key *old_key,
                            const ngtcp2_ksl_key *new_key) {
   ngtcp2_ksl_blk *blk = ksl->head;
-  ngtcp2_ksl_node *node;
+  ngtcp2_ksl_key *node_key;
   size_t i;
 
   assert(ksl->head);
 
   for (;;) {
-    i = ksl_bsearch(ksl, blk, old_key, ksl->compar);
+    i = ksl->search(ksl, blk, old_key);
 
     assert(i < blk->n);
-    node = ngtcp2_ksl_nth_node(ksl, blk, i);
+    node_key = ngtcp2_ksl_nth_key(ksl, blk, i);
 
     if (blk->leaf) {
-      assert(key_equal(ksl->compar, (ngtcp2_ksl_key *)node->key, old_key));
-      ksl_node_set_key(ksl, node, new_key);
+      assert(key_equal(ksl->compar, node_key, old_key));
+      ksl_set_key(ksl, blk, i, new_key);
       return;
     }
 
-    if (key_equal(ksl->compar, (ngtcp2_ksl_key *)node->key, old_key) ||
-        ksl->compar((ngtcp2_ksl_key *)node->key, new_key)) {
-      ksl_node_set_key(ksl, node, new_key);
+    if (key_equal(ksl->compar, node_key, old_key) ||
+        ksl->compar(node_key, new_key)) {
+      ksl_set_key(ksl, blk, i, new_key);
     }
 
-    blk = node->blk;
+    blk = ngtcp2_ksl_nth_node(blk, i)->blk;
   }
 }
 
 static void ksl_print(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk, size_t level) {
   size_t i;
-  ngtcp2_ksl_node *node;
 
   fprintf(stderr, "LV=%zu n=%u\n", level, blk->n);
 
   if (blk->leaf) {
     for (i = 0; i < blk->n; ++i) {
-      node = ngtcp2_ksl_nth_node(ksl, blk, i);
-      fprintf(stderr, " %" PRId64, *(int64_t *)(void *)node->key);
+      fprintf(stderr, " %" PRId64,
+              *(int64_t *)ngtcp2_ksl_nth_key(ksl, blk, i));
     }
     fprintf(stderr, "\n");
     return;
   }
 
   for (i = 0; i < blk->n; ++i) {
-    ksl_print(ksl, ngtcp2_ksl_nth_node(ksl, blk, i)->blk, level + 1);
+    ksl_print(ksl, ngtcp2_ksl_nth_node(blk, i)->blk, level + 1);
   }
 }
 
@@ -816,3 +809,244 @@ int ngtcp2_ksl_range_exclusive_compar(const ngtcp2_ksl_key *lhs,
   return a->begin < b->begin &&
          !(ngtcp2_max(a->begin, b->begin) < ngtcp2_min(a->end, b->end));
 }
+
+size_t ngtcp2_ksl_int64_greater_search(const ngtcp2_ksl *ksl,
+                                       const ngtcp2_ksl_blk *blk,
+                                       const ngtcp2_ksl_key *key) {
+  const int64_t *keys = (const int64_t *)(const void *)blk->keys;
+  int64_t k = *(const int64_t *)key;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n && keys[i] > k; ++i)
+    ;
+
+  return i;
+}
+
+size_t ngtcp2_ksl_int64_less_search(const ngtcp2_ksl *ksl,
+                                    const ngtcp2_ksl_blk *blk,
+                                    const ngtcp2_ksl_key *key) {
+  const int64_t *keys = (const int64_t *)(const void *)blk->keys;
+  int64_t k = *(const int64_t *)key;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n && keys[i] < k; ++i)
+    ;
+
+  return i;
+}
+
+size_t ngtcp2_ksl_range_search(const ngtcp2_ksl *ksl,
+                               const ngtcp2_ksl_blk *blk,
+                               const ngtcp2_ksl_key *key) {
+  const ngtcp2_range *keys = (const ngtcp2_range *)(const void *)blk->keys;
+  uint64_t begin = ((const ngtcp2_range *)key)->begin;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n && keys[i].begin < begin; ++i)
+    ;
+
+  return i;
+}
+
+size_t ngtcp2_ksl_range_exclusive_search(const ngtcp2_ksl *ksl,
+                                         const ngtcp2_ksl_blk *blk,
+                                         const ngtcp2_ksl_key *key) {
+  const ngtcp2_range *keys = (const ngtcp2_range *)(const void *)blk->keys;
+  const ngtcp2_range *r = key;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n && ngtcp2_ksl_range_exclusive_compar(&keys[i], r);
+       ++i)
+    ;
+
+  return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+
+#  define NGTCP2_KSL_AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+ * The AVX2 variants of the search functions compare 4 keys at once.
+ * Because the keys in a block are sorted, the nodes which satisfy
+ * compar(k, key) are always the prefix of the block, and the answer
+ * is the number of such nodes.  They compare all keys in a block and
+ * count the set bits without any data dependent branch.  The lanes
+ * beyond blk->n are read from the spare key storage and masked out.
+ */
+
+/*
+ * ksl_avx2_count returns the number of set bits in |MASK| which
+ * correspond to the first |N| nodes.
+ */
+#  define ksl_avx2_count(MASK, N)                                              \
+    ((size_t)__builtin_popcount((MASK) & ((1u << (N)) - 1)))
+
+/*
+ * ksl_avx2_movemask returns the most significant bit of each 64 bit
+ * lane of |V| in the lowest 4 bits.
+ */
+#  define ksl_avx2_movemask(V)                                                 \
+    ((uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(V)))
+
+NGTCP2_KSL_AVX2_TARGET static size_t
+ksl_int64_greater_search_avx2(const ngtcp2_ksl *ksl, const ngtcp2_ksl_blk *blk,
+                              const ngtcp2_ksl_key *key) {
+  const int64_t *keys = (const int64_t *)(const void *)blk->keys;
+  __m256i k = _mm256_set1_epi64x(*(const int64_t *)key), v;
+  uint32_t mask = 0;
+  size_t i;
+  (void)ksl;
+
+  /* ngtcp2_rtb inserts a packet whose number is larger than any
+     other, which goes to the front of the block. */
+  if (blk->n == 0 || keys[0] <= *(const int64_t *)key) {
+    return 0;
+  }
+
+  for (i = 0; i < blk->n; i += 4) {
+    v = _mm256_loadu_si256((const __m256i *)(const void *)(keys + i));
+    mask |= ksl_avx2_movemask(_mm256_cmpgt_epi64(v, k)) << i;
+  }
+
+  return ksl_avx2_count(mask, blk->n);
+}
+
+NGTCP2_KSL_AVX2_TARGET static size_t
+ksl_int64_less_search_avx2(const ngtcp2_ksl *ksl, const ngtcp2_ksl_blk *blk,
+                           const ngtcp2_ksl_key *key) {
+  const int64_t *keys = (const int64_t *)(const void *)blk->keys;
+  __m256i k = _mm256_set1_epi64x(*(const int64_t *)key), v;
+  uint32_t mask = 0;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n; i += 4) {
+    v = _mm256_loadu_si256((const __m256i *)(const void *)(keys + i));
+    mask |= ksl_avx2_movemask(_mm256_cmpgt_epi64(k, v)) << i;
+  }
+
+  return ksl_avx2_count(mask, blk->n);
+}
+
+/*
+ * ksl_range_load_avx2 loads 4 ngtcp2_range starting at |r|, and
+ * stores their begin in |*begin| and their end in |*end|.  AVX2 only
+ * has signed comparison, so the sign bit of each value is flipped
+ * with |sign| to compare them as unsigned integers.
+ */
+NGTCP2_KSL_AVX2_TARGET static void ksl_range_load_avx2(__m256i *begin,
+                                                       __m256i *end,
+                                                       const ngtcp2_range *r,
+                                                       __m256i sign) {
+  __m256i lo = _mm256_loadu_si256((const __m256i *)(const void *)r);
+  __m256i hi = _mm256_loadu_si256((const __m256i *)(const void *)(r + 2));
+
+  /* unpack produces the order of r[0], r[2], r[1], r[3]. */
+  *begin = _mm256_xor_si256(
+      _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(lo, hi),
+                               _MM_SHUFFLE(3, 1, 2, 0)),
+      sign);
+  *end = _mm256_xor_si256(
+      _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(lo, hi),
+                               _MM_SHUFFLE(3, 1, 2, 0)),
+      sign);
+}
+
+NGTCP2_KSL_AVX2_TARGET static size_t
+ksl_range_search_avx2(const ngtcp2_ksl *ksl, const ngtcp2_ksl_blk *blk,
+                      const ngtcp2_ksl_key *key) {
+  const ngtcp2_range *keys = (const ngtcp2_range *)(const void *)blk->keys;
+  __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  __m256i k = _mm256_xor_si256(
+      _mm256_set1_epi64x((int64_t)((const ngtcp2_range *)key)->begin), sign);
+  __m256i begin, end;
+  uint32_t mask = 0;
+  size_t i;
+  (void)ksl;
+
+  for (i = 0; i < blk->n; i += 4) {
+    ksl_range_load_avx2(&begin, &end, keys + i, sign);
+    mask |= ksl_avx2_movemask(_mm256_cmpgt_epi64(k, begin)) << i;
+  }
+
+  return ksl_avx2_count(mask, blk->n);
+}
+
+NGTCP2_KSL_AVX2_TARGET static size_t
+ksl_range_exclusive_search_avx2(const ngtcp2_ksl *ksl,
+                                const ngtcp2_ksl_blk *blk,
+                                const ngtcp2_ksl_key *key) {
+  const ngtcp2_range *keys = (const ngtcp2_range *)(const void *)blk->keys;
+  const ngtcp2_range *r = key;
+  __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)r->begin), sign);
+  __m256i begin, end;
+  uint32_t mask = 0;
+  size_t i;
+
+  /* If |r| is empty, ngtcp2_ksl_range_exclusive_compar only compares
+     begin. */
+  if (r->begin >= r->end) {
+    return ksl_range_search_avx2(ksl, blk, key);
+  }
+
+  for (i = 0; i < blk->n; i += 4) {
+    ksl_range_load_avx2(&begin, &end, keys + i, sign);
+    /* begin < r->begin && !(end > r->begin) */
+    mask |= ksl_avx2_movemask(_mm256_andnot_si256(
+                _mm256_cmpgt_epi64(end, k), _mm256_cmpgt_epi64(k, begin)))
+            << i;
+  }
+
+  return ksl_avx2_count(mask, blk->n);
+}
+
+ngtcp2_ksl_search ngtcp2_ksl_avx2_search(ngtcp2_ksl_search search) {
+  if (!__builtin_cpu_supports("avx2")) {
+    return NULL;
+  }
+
+  if (search == ngtcp2_ksl_int64_greater_search) {
+    return ksl_int64_greater_search_avx2;
+  }
+  if (search == ngtcp2_ksl_int64_less_search) {
+    return ksl_int64_less_search_avx2;
+  }
+  if (search == ngtcp2_ksl_range_search) {
+    return ksl_range_search_avx2;
+  }
+  if (search == ngtcp2_ksl_range_exclusive_search) {
+    return ksl_range_exclusive_search_avx2;
+  }
+
+  return NULL;
+}
+#else  /* !(defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) */
+ngtcp2_ksl_search ngtcp2_ksl_avx2_search(ngtcp2_ksl_search search) {
+  (void)search;
+
+  return NULL;
+}
+#endif /* !(defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) */
+
+static ngtcp2_ksl_search ksl_select_search(ngtcp2_ksl_search search) {
+  ngtcp2_ksl_search avx2_search;
+
+  if (search == NULL) {
+    return ksl_compar_search;
+  }
+
+  avx2_search = ngtcp2_ksl_avx2_search(search);
+  if (avx2_search) {
+    return avx2_search;
+  }
+
+  return search;
+}
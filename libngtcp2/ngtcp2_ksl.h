@@ -52,29 +52,20 @@
  */
 typedef void ngtcp2_ksl_key;
 
-typedef struct ngtcp2_ksl_node ngtcp2_ksl_node;
+typedef union ngtcp2_ksl_node ngtcp2_ksl_node;
 
 typedef struct ngtcp2_ksl_blk ngtcp2_ksl_blk;
 
 /*
  * ngtcp2_ksl_node is a node which contains either ngtcp2_ksl_blk or
  * opaque data.  If a node is an internal node, it contains
- * ngtcp2_ksl_blk.  Otherwise, it has data.  The key is stored at the
- * location starting at key.
+ * ngtcp2_ksl_blk.  Otherwise, it has data.  The key of a node is not
+ * stored here, but in the key array of the block which contains the
+ * node.
  */
-struct ngtcp2_ksl_node {
-  union {
-    ngtcp2_ksl_blk *blk;
-    void *data;
-  };
-  union {
-    uint64_t align;
-    /* key is a buffer to include key associated to this node.
-       Because the length of key is unknown until ngtcp2_ksl_init is
-       called, the actual buffer will be allocated after this
-       field. */
-    uint8_t key[1];
-  };
+union ngtcp2_ksl_node {
+  ngtcp2_ksl_blk *blk;
+  void *data;
 };
 
 /*
@@ -91,14 +82,20 @@ struct ngtcp2_ksl_blk {
       uint32_t n;
       /* leaf is nonzero if this block contains leaf nodes. */
       uint32_t leaf;
+      /* nodes contains the nodes of this block. */
+      ngtcp2_ksl_node nodes[NGTCP2_KSL_MAX_NBLK];
       union {
         uint64_t align;
-        /* nodes is a buffer to contain NGTCP2_KSL_MAX_NBLK
-           ngtcp2_ksl_node objects.  Because ngtcp2_ksl_node object is
-           allocated along with the additional variable length key
-           storage, the size of buffer is unknown until ngtcp2_ksl_init is
-           called. */
-        uint8_t nodes[1];
+        /* keys is a buffer to contain the keys of nodes.  The key of
+           nodes[i] is stored at keys + keylen * i, so that the keys
+           of a block are contiguous and can be searched without
+           touching nodes.  The buffer has room for
+           NGTCP2_KSL_MAX_NBLK + 1 keys, so that a vectorized search
+           can load 4 keys at a time without reading beyond the
+           block.  Because the length of key is
+           unknown until ngtcp2_ksl_init is called, the actual buffer
+           will be allocated after this field. */
+        uint8_t keys[1];
       };
     };
 
@@ -117,6 +114,17 @@ typedef int (*ngtcp2_ksl_compar)(const ngtcp2_ksl_key *lhs,
 
 typedef struct ngtcp2_ksl ngtcp2_ksl;
 
+/*
+ * ngtcp2_ksl_search is a function type which returns the index of
+ * the first node in |blk| whose key |k| satisfies !compar(k, key),
+ * where compar is the ngtcp2_ksl_compar that |ksl| (or the caller of
+ * ngtcp2_ksl_lower_bound_search) uses.  If there is no such node, it
+ * returns blk->n.
+ */
+typedef size_t (*ngtcp2_ksl_search)(const ngtcp2_ksl *ksl,
+                                    const ngtcp2_ksl_blk *blk,
+                                    const ngtcp2_ksl_key *key);
+
 typedef struct ngtcp2_ksl_it ngtcp2_ksl_it;
 
 /*
@@ -140,19 +148,25 @@ struct ngtcp2_ksl {
   /* back points to the last leaf block. */
   ngtcp2_ksl_blk *back;
   ngtcp2_ksl_compar compar;
+  /* search finds a key in a block.  It is consistent with compar. */
+  ngtcp2_ksl_search search;
   size_t n;
   /* keylen is the size of key */
   size_t keylen;
-  /* nodelen is the actual size of ngtcp2_ksl_node including key
+  /* blklen is the actual size of ngtcp2_ksl_blk including key
      storage. */
-  size_t nodelen;
+  size_t blklen;
 };
 
 /*
  * ngtcp2_ksl_init initializes |ksl|.  |compar| specifies compare
- * function.  |keylen| is the length of key.
+ * function.  |search| specifies the function which finds a key in a
+ * block and it must be consistent with |compar|.  If |search| is
+ * NULL, a linear search which calls |compar| for each key is used.
+ * |keylen| is the length of key.
  */
-void ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar, size_t keylen,
+void ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar,
+                     ngtcp2_ksl_search search, size_t keylen,
                      const ngtcp2_mem *mem);
 
 /*
@@ -217,12 +231,12 @@ ngtcp2_ksl_it ngtcp2_ksl_lower_bound(ngtcp2_ksl *ksl,
                                      const ngtcp2_ksl_key *key);
 
 /*
- * ngtcp2_ksl_lower_bound_compar works like ngtcp2_ksl_lower_bound,
- * but it takes custom function |compar| to do lower bound search.
+ * ngtcp2_ksl_lower_bound_search works like ngtcp2_ksl_lower_bound,
+ * but it takes custom function |search| to do lower bound search.
  */
-ngtcp2_ksl_it ngtcp2_ksl_lower_bound_compar(ngtcp2_ksl *ksl,
+ngtcp2_ksl_it ngtcp2_ksl_lower_bound_search(ngtcp2_ksl *ksl,
                                             const ngtcp2_ksl_key *key,
-                                            ngtcp2_ksl_compar compar);
+                                            ngtcp2_ksl_search search);
 
 /*
  * ngtcp2_ksl_update_key replaces the key of nodes which has |old_key|
@@ -272,8 +286,13 @@ void ngtcp2_ksl_clear(ngtcp2_ksl *ksl);
 /*
  * ngtcp2_ksl_nth_node returns the |n|th node under |blk|.
  */
-#define ngtcp2_ksl_nth_node(KSL, BLK, N)                                       \
-  ((ngtcp2_ksl_node *)(void *)((BLK)->nodes + (KSL)->nodelen * (N)))
+#define ngtcp2_ksl_nth_node(BLK, N) (&(BLK)->nodes[N])
+
+/*
+ * ngtcp2_ksl_nth_key returns the key of the |n|th node under |blk|.
+ */
+#define ngtcp2_ksl_nth_key(KSL, BLK, N)                                        \
+  ((ngtcp2_ksl_key *)((BLK)->keys + (KSL)->keylen * (N)))
 
 /*
  * ngtcp2_ksl_print prints its internal state in stderr.  It assumes
@@ -293,8 +312,7 @@ void ngtcp2_ksl_it_init(ngtcp2_ksl_it *it, const ngtcp2_ksl *ksl,
  * |it| points to.  It is undefined to call this function when
  * ngtcp2_ksl_it_end(it) returns nonzero.
  */
-#define ngtcp2_ksl_it_get(IT)                                                  \
-  ngtcp2_ksl_nth_node((IT)->ksl, (IT)->blk, (IT)->i)->data
+#define ngtcp2_ksl_it_get(IT) ngtcp2_ksl_nth_node((IT)->blk, (IT)->i)->data
 
 /*
  * ngtcp2_ksl_it_next advances the iterator by one.  It is undefined
@@ -332,8 +350,7 @@ int ngtcp2_ksl_it_begin(const ngtcp2_ksl_it *it);
  * It is undefined to call this function when ngtcp2_ksl_it_end(it)
  * returns nonzero.
  */
-#define ngtcp2_ksl_it_key(IT)                                                  \
-  ((ngtcp2_ksl_key *)ngtcp2_ksl_nth_node((IT)->ksl, (IT)->blk, (IT)->i)->key)
+#define ngtcp2_ksl_it_key(IT) ngtcp2_ksl_nth_key((IT)->ksl, (IT)->blk, (IT)->i)
 
 /*
  * ngtcp2_ksl_range_compar is an implementation of ngtcp2_ksl_compar.
@@ -354,4 +371,56 @@ int ngtcp2_ksl_range_compar(const ngtcp2_ksl_key *lhs,
 int ngtcp2_ksl_range_exclusive_compar(const ngtcp2_ksl_key *lhs,
                                       const ngtcp2_ksl_key *rhs);
 
+/*
+ * The following functions are implementations of ngtcp2_ksl_search
+ * for the fixed-width keys.  They load the keys of a block directly
+ * instead of calling ngtcp2_ksl_compar for each key.  On x86 CPUs
+ * which support AVX2, ngtcp2_ksl_init and
+ * ngtcp2_ksl_lower_bound_search replace them with the variants which
+ * compare 4 keys at once.
+ */
+
+/*
+ * ngtcp2_ksl_int64_greater_search is consistent with the
+ * ngtcp2_ksl_compar which returns nonzero if *(int64_t *)lhs >
+ * *(int64_t *)rhs.
+ */
+size_t ngtcp2_ksl_int64_greater_search(const ngtcp2_ksl *ksl,
+                                       const ngtcp2_ksl_blk *blk,
+                                       const ngtcp2_ksl_key *key);
+
+/*
+ * ngtcp2_ksl_int64_less_search is consistent with the
+ * ngtcp2_ksl_compar which returns nonzero if *(int64_t *)lhs <
+ * *(int64_t *)rhs.
+ */
+size_t ngtcp2_ksl_int64_less_search(const ngtcp2_ksl *ksl,
+                                    const ngtcp2_ksl_blk *blk,
+                                    const ngtcp2_ksl_key *key);
+
+/*
+ * ngtcp2_ksl_range_search is consistent with
+ * ngtcp2_ksl_range_compar.
+ */
+size_t ngtcp2_ksl_range_search(const ngtcp2_ksl *ksl,
+                               const ngtcp2_ksl_blk *blk,
+                               const ngtcp2_ksl_key *key);
+
+/*
+ * ngtcp2_ksl_range_exclusive_search is consistent with
+ * ngtcp2_ksl_range_exclusive_compar.
+ */
+size_t ngtcp2_ksl_range_exclusive_search(const ngtcp2_ksl *ksl,
+                                         const ngtcp2_ksl_blk *blk,
+                                         const ngtcp2_ksl_key *key);
+
+/*
+ * ngtcp2_ksl_avx2_search returns the AVX2 variant of |search|, which
+ * is one of the search functions above.  It returns NULL if |search|
+ * has no such variant, or the CPU does not support AVX2.  ngtcp2_ksl
+ * uses it to pick the search function at run time; tests use it to
+ * compare both variants on the same blocks.
+ */
+ngtcp2_ksl_search ngtcp2_ksl_avx2_search(ngtcp2_ksl_search search);
+
 #endif /* NGTCP2_KSL_H */
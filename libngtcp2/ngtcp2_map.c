@@ -29,6 +29,10 @@
 #include <assert.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
+
 #include "ngtcp2_conv.h"
 
 #define NGTCP2_INITIAL_TABLE_LENBITS 4
@@ -38,7 +42,9 @@ void ngtcp2_map_init(ngtcp2_map *map, const ngtcp2_mem *mem) {
   map->tablelen = 0;
   map->tablelenbits = 0;
   map->table = NULL;
+  map->ctrl = NULL;
   map->size = 0;
+  map->growth_left = 0;
 }
 
 void ngtcp2_map_free(ngtcp2_map *map) {
@@ -49,19 +55,22 @@ void ngtcp2_map_free(ngtcp2_map *map) {
   ngtcp2_mem_free(map->mem, map->table);
 }
 
+/*
+ * ctrl_is_full returns nonzero if the control byte |c| indicates that
+ * the bucket has data.
+ */
+static int ctrl_is_full(uint8_t c) { return (c & 0x80) == 0; }
+
 void ngtcp2_map_each_free(ngtcp2_map *map, int (*func)(void *data, void *ptr),
                           void *ptr) {
   uint32_t i;
-  ngtcp2_map_bucket *bkt;
 
   for (i = 0; i < map->tablelen; ++i) {
-    bkt = &map->table[i];
-
-    if (bkt->data == NULL) {
+    if (!ctrl_is_full(map->ctrl[i])) {
       continue;
     }
 
-    func(bkt->data, ptr);
+    func(map->table[i].data, ptr);
   }
 }
 
@@ -69,20 +78,17 @@ int ngtcp2_map_each(ngtcp2_map *map, int (*func)(void *data, void *ptr),
                     void *ptr) {
   int rv;
   uint32_t i;
-  ngtcp2_map_bucket *bkt;
 
   if (map->size == 0) {
     return 0;
   }
 
   for (i = 0; i < map->tablelen; ++i) {
-    bkt = &map->table[i];
-
-    if (bkt->data == NULL) {
+    if (!ctrl_is_full(map->ctrl[i])) {
       continue;
     }
 
-    rv = func(bkt->data, ptr);
+    rv = func(map->table[i].data, ptr);
     if (rv != 0) {
       return rv;
     }
@@ -91,39 +97,125 @@ int ngtcp2_map_each(ngtcp2_map *map, int (*func)(void *data, void *ptr),
   return 0;
 }
 
-static uint32_t hash(ngtcp2_map_key_type key) {
-  return (uint32_t)((key * 11400714819323198485llu) >> 32);
+static uint64_t hash(ngtcp2_map_key_type key) {
+  return key * 11400714819323198485llu;
 }
 
-static size_t h2idx(uint32_t hash, uint32_t bits) {
-  return hash >> (32 - bits);
+/*
+ * h2idx returns the index of the bucket where the probe for |hash|
+ * starts.
+ */
+static size_t h2idx(uint64_t hash, uint32_t bits) {
+  return (uint32_t)(hash >> 32) >> (32 - bits);
 }
 
-static size_t distance(uint32_t tablelen, uint32_t tablelenbits,
-                       ngtcp2_map_bucket *bkt, size_t idx) {
-  return (idx - h2idx(bkt->hash, tablelenbits)) & (tablelen - 1);
+/*
+ * h2ctrl returns the control byte for |hash|.  It uses the bits
+ * which h2idx does not use.
+ */
+static uint8_t h2ctrl(uint64_t hash) { return (uint8_t)((hash >> 25) & 0x7f); }
+
+/*
+ * max_growth returns the number of buckets which can have data in the
+ * table of |tablelen| buckets.  Load factor is 0.875.
+ */
+static uint32_t max_growth(uint32_t tablelen) {
+  return tablelen - tablelen / 8;
 }
 
-static void map_bucket_swap(ngtcp2_map_bucket *bkt, uint32_t *phash,
-                            ngtcp2_map_key_type *pkey, void **pdata) {
-  uint32_t h = bkt->hash;
-  ngtcp2_map_key_type key = bkt->key;
-  void *data = bkt->data;
+/*
+ * map_group holds NGTCP2_MAP_GROUP_WIDTH control bytes loaded by
+ * group_load.  The group_match functions return the bit mask of the
+ * control bytes in a group which satisfy the condition.  The nth bit
+ * corresponds to the nth control byte.
+ */
 
-  bkt->hash = *phash;
-  bkt->key = *pkey;
-  bkt->data = *pdata;
+#ifdef __SSE2__
+typedef __m128i map_group;
 
-  *phash = h;
-  *pkey = key;
-  *pdata = data;
+static map_group group_load(const uint8_t *ctrl) {
+  return _mm_loadu_si128((const __m128i *)(const void *)ctrl);
 }
 
-static void map_bucket_set_data(ngtcp2_map_bucket *bkt, uint32_t hash,
-                                ngtcp2_map_key_type key, void *data) {
-  bkt->hash = hash;
-  bkt->key = key;
-  bkt->data = data;
+/*
+ * group_match returns the bit mask of the control bytes which equal
+ * |c|.
+ */
+static uint32_t group_match(map_group g, uint8_t c) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+}
+
+/*
+ * group_match_free returns the bit mask of the control bytes which
+ * are either NGTCP2_MAP_CTRL_EMPTY or NGTCP2_MAP_CTRL_DELETED.
+ */
+static uint32_t group_match_free(map_group g) {
+  return (uint32_t)_mm_movemask_epi8(g);
+}
+#else  /* !__SSE2__ */
+typedef const uint8_t *map_group;
+
+static map_group group_load(const uint8_t *ctrl) { return ctrl; }
+
+static uint32_t group_match(map_group g, uint8_t c) {
+  uint32_t mask = 0;
+  size_t i;
+
+  for (i = 0; i < NGTCP2_MAP_GROUP_WIDTH; ++i) {
+    mask |= (uint32_t)(g[i] == c) << i;
+  }
+
+  return mask;
+}
+
+static uint32_t group_match_free(map_group g) {
+  uint32_t mask = 0;
+  size_t i;
+
+  for (i = 0; i < NGTCP2_MAP_GROUP_WIDTH; ++i) {
+    mask |= (uint32_t)!ctrl_is_full(g[i]) << i;
+  }
+
+  return mask;
+}
+#endif /* !__SSE2__ */
+
+/*
+ * mask_ctz returns the number of trailing zero bits in |mask|.
+ * |mask| must not be 0.
+ */
+static uint32_t mask_ctz(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (uint32_t)index;
+#else  /* !defined(_MSC_VER) */
+  return (uint32_t)__builtin_ctz(mask);
+#endif /* !defined(_MSC_VER) */
+}
+
+/*
+ * mask_clz16 returns the number of leading zero bits in the lowest 16
+ * bits of |mask|.  |mask| must not be 0.
+ */
+static uint32_t mask_clz16(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return 15 - (uint32_t)index;
+#else  /* !defined(_MSC_VER) */
+  return (uint32_t)__builtin_clz(mask) - 16;
+#endif /* !defined(_MSC_VER) */
+}
+
+/*
+ * set_ctrl sets |c| to the control byte at |idx| and its mirror.
+ */
+static void set_ctrl(uint8_t *ctrl, uint32_t tablelen, size_t idx, uint8_t c) {
+  ctrl[idx] = c;
+  if (idx < NGTCP2_MAP_GROUP_WIDTH - 1) {
+    ctrl[tablelen + idx] = c;
+  }
 }
 
 void ngtcp2_map_print_distance(ngtcp2_map *map) {
@@ -132,196 +224,266 @@ void ngtcp2_map_print_distance(ngtcp2_map *map) {
   ngtcp2_map_bucket *bkt;
 
   for (i = 0; i < map->tablelen; ++i) {
-    bkt = &map->table[i];
-
-    if (bkt->data == NULL) {
+    if (map->ctrl[i] == NGTCP2_MAP_CTRL_EMPTY) {
       fprintf(stderr, "@%u <EMPTY>\n", i);
       continue;
     }
 
-    idx = h2idx(bkt->hash, map->tablelenbits);
-    fprintf(stderr, "@%u hash=%08x key=%" PRIu64 " base=%zu distance=%zu\n", i,
-            bkt->hash, bkt->key, idx,
-            distance(map->tablelen, map->tablelenbits, bkt, idx));
+    if (map->ctrl[i] == NGTCP2_MAP_CTRL_DELETED) {
+      fprintf(stderr, "@%u <DELETED>\n", i);
+      continue;
+    }
+
+    bkt = &map->table[i];
+    idx = h2idx(hash(bkt->key), map->tablelenbits);
+    fprintf(stderr, "@%u ctrl=%02x key=%" PRIu64 " base=%zu distance=%zu\n", i,
+            map->ctrl[i], bkt->key, idx, (i - idx) & (map->tablelen - 1));
   }
 }
 
-static int insert(ngtcp2_map_bucket *table, uint32_t tablelen,
-                  uint32_t tablelenbits, uint32_t hash, ngtcp2_map_key_type key,
-                  void *data) {
+/*
+ * find_free returns the index of the first free bucket in the probe
+ * sequence for |hash|.  The probe starts at h2idx(hash) and advances
+ * by NGTCP2_MAP_GROUP_WIDTH, 2 * NGTCP2_MAP_GROUP_WIDTH, ...  buckets
+ * so that it visits every bucket in the table.
+ */
+static size_t find_free(const uint8_t *ctrl, uint32_t tablelen,
+                        uint32_t tablelenbits, uint64_t hash) {
   size_t idx = h2idx(hash, tablelenbits);
-  size_t d = 0, dd;
-  ngtcp2_map_bucket *bkt;
+  size_t step = 0;
+  uint32_t mask;
+
+  for (;;) {
+    mask = group_match_free(group_load(ctrl + idx));
+    if (mask) {
+      return (idx + mask_ctz(mask)) & (tablelen - 1);
+    }
+
+    step += NGTCP2_MAP_GROUP_WIDTH;
+    idx = (idx + step) & (tablelen - 1);
+  }
+}
+
+/*
+ * probe returns the index of the bucket which has |key|, or -1 if
+ * there is no such bucket.  |h| is the hash of |key|.
+ */
+static ngtcp2_ssize probe(ngtcp2_map *map, ngtcp2_map_key_type key,
+                          uint64_t h) {
+  uint8_t c = h2ctrl(h);
+  size_t idx = h2idx(h, map->tablelenbits), i;
+  size_t step = 0;
+  map_group g;
+  uint32_t mask;
 
   for (;;) {
-    bkt = &table[idx];
+    g = group_load(map->ctrl + idx);
 
-    if (bkt->data == NULL) {
-      map_bucket_set_data(bkt, hash, key, data);
-      return 0;
+    for (mask = group_match(g, c); mask; mask &= mask - 1) {
+      i = (idx + mask_ctz(mask)) & (map->tablelen - 1);
+      if (map->table[i].key == key) {
+        return (ngtcp2_ssize)i;
+      }
     }
 
-    dd = distance(tablelen, tablelenbits, bkt, idx);
-    if (d > dd) {
-      map_bucket_swap(bkt, &hash, &key, &data);
-      d = dd;
-    } else if (bkt->key == key) {
-      /* TODO This check is just a waste after first swap or if this
-         function is called from map_resize.  That said, there is no
-         difference with or without this conditional in performance
-         wise. */
-      return NGTCP2_ERR_INVALID_ARGUMENT;
+    if (group_match(g, NGTCP2_MAP_CTRL_EMPTY)) {
+      return -1;
     }
 
-    ++d;
-    idx = (idx + 1) & (tablelen - 1);
+    step += NGTCP2_MAP_GROUP_WIDTH;
+    idx = (idx + step) & (map->tablelen - 1);
   }
 }
 
+/*
+ * find returns the index of the bucket which has |key|, or -1 if
+ * there is no such bucket.
+ */
+static ngtcp2_ssize find(ngtcp2_map *map, ngtcp2_map_key_type key) {
+  uint64_t h = hash(key);
+  size_t idx = h2idx(h, map->tablelenbits);
+
+  /* Unless the table is crowded, the key is in the first bucket of
+     the probe.  Check it without loading the control bytes, so that
+     the lookup usually touches just one cache line.  A bucket which
+     has no data always has NULL data. */
+  if (map->table[idx].key == key && map->table[idx].data) {
+    return (ngtcp2_ssize)idx;
+  }
+
+  return probe(map, key, h);
+}
+
 /* new_tablelen must be power of 2 and new_tablelen == (1 <<
    new_tablelenbits) must hold. */
 static int map_resize(ngtcp2_map *map, uint32_t new_tablelen,
                       uint32_t new_tablelenbits) {
   uint32_t i;
   ngtcp2_map_bucket *new_table;
-  ngtcp2_map_bucket *bkt;
-  int rv;
-  (void)rv;
+  uint8_t *new_ctrl;
+  size_t idx;
+  uint64_t h;
 
-  new_table =
-      ngtcp2_mem_calloc(map->mem, new_tablelen, sizeof(ngtcp2_map_bucket));
+  new_table = ngtcp2_mem_calloc(map->mem, 1,
+                                sizeof(ngtcp2_map_bucket) * new_tablelen +
+                                    new_tablelen + NGTCP2_MAP_GROUP_WIDTH - 1);
   if (new_table == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
 
+  new_ctrl = (uint8_t *)(new_table + new_tablelen);
+  memset(new_ctrl, NGTCP2_MAP_CTRL_EMPTY,
+         new_tablelen + NGTCP2_MAP_GROUP_WIDTH - 1);
+
   for (i = 0; i < map->tablelen; ++i) {
-    bkt = &map->table[i];
-    if (bkt->data == NULL) {
+    if (!ctrl_is_full(map->ctrl[i])) {
       continue;
     }
-    rv = insert(new_table, new_tablelen, new_tablelenbits, bkt->hash, bkt->key,
-                bkt->data);
 
-    assert(0 == rv);
+    h = hash(map->table[i].key);
+    idx = find_free(new_ctrl, new_tablelen, new_tablelenbits, h);
+    set_ctrl(new_ctrl, new_tablelen, idx, h2ctrl(h));
+    new_table[idx] = map->table[i];
   }
 
   ngtcp2_mem_free(map->mem, map->table);
   map->tablelen = new_tablelen;
   map->tablelenbits = new_tablelenbits;
   map->table = new_table;
+  map->ctrl = new_ctrl;
+  map->growth_left = max_growth(new_tablelen) - (uint32_t)map->size;
 
   return 0;
 }
 
 int ngtcp2_map_insert(ngtcp2_map *map, ngtcp2_map_key_type key, void *data) {
   int rv;
+  uint64_t h = hash(key);
+  uint8_t c = h2ctrl(h);
+  size_t idx, step = 0, free_idx = SIZE_MAX;
+  map_group g;
+  uint32_t mask;
 
   assert(data);
 
-  /* Load factor is 0.75 */
-  if ((map->size + 1) * 4 > map->tablelen * 3) {
-    if (map->tablelen) {
-      rv = map_resize(map, map->tablelen * 2, map->tablelenbits + 1);
-      if (rv != 0) {
-        return rv;
+  if (map->tablelen == 0) {
+    rv = map_resize(map, 1 << NGTCP2_INITIAL_TABLE_LENBITS,
+                    NGTCP2_INITIAL_TABLE_LENBITS);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  /* Look for |key| and the first free bucket in the same probe. */
+  for (idx = h2idx(h, map->tablelenbits);;) {
+    g = group_load(map->ctrl + idx);
+
+    for (mask = group_match(g, c); mask; mask &= mask - 1) {
+      if (map->table[(idx + mask_ctz(mask)) & (map->tablelen - 1)].key ==
+          key) {
+        return NGTCP2_ERR_INVALID_ARGUMENT;
       }
-    } else {
-      rv = map_resize(map, 1 << NGTCP2_INITIAL_TABLE_LENBITS,
-                      NGTCP2_INITIAL_TABLE_LENBITS);
-      if (rv != 0) {
-        return rv;
+    }
+
+    if (free_idx == SIZE_MAX) {
+      mask = group_match_free(g);
+      if (mask) {
+        free_idx = (idx + mask_ctz(mask)) & (map->tablelen - 1);
       }
     }
+
+    if (group_match(g, NGTCP2_MAP_CTRL_EMPTY)) {
+      break;
+    }
+
+    step += NGTCP2_MAP_GROUP_WIDTH;
+    idx = (idx + step) & (map->tablelen - 1);
+  }
+
+  idx = free_idx;
+
+  if (map->ctrl[idx] == NGTCP2_MAP_CTRL_EMPTY && map->growth_left == 0) {
+    /* If the table is still at most half full after this insertion,
+       the space is mostly taken up by DELETED buckets.  Rehash in
+       place to reclaim them.  Otherwise, grow the table. */
+    if ((map->size + 1) * 2 <= max_growth(map->tablelen)) {
+      rv = map_resize(map, map->tablelen, map->tablelenbits);
+    } else {
+      rv = map_resize(map, map->tablelen * 2, map->tablelenbits + 1);
+    }
+    if (rv != 0) {
+      return rv;
+    }
+
+    idx = find_free(map->ctrl, map->tablelen, map->tablelenbits, h);
   }
 
-  rv = insert(map->table, map->tablelen, map->tablelenbits, hash(key), key,
-              data);
-  if (rv != 0) {
-    return rv;
+  if (map->ctrl[idx] == NGTCP2_MAP_CTRL_EMPTY) {
+    --map->growth_left;
   }
+
+  set_ctrl(map->ctrl, map->tablelen, idx, h2ctrl(h));
+  map->table[idx].key = key;
+  map->table[idx].data = data;
+
   ++map->size;
+
   return 0;
 }
 
 void *ngtcp2_map_find(ngtcp2_map *map, ngtcp2_map_key_type key) {
-  uint32_t h;
-  size_t idx;
-  ngtcp2_map_bucket *bkt;
-  size_t d = 0;
+  ngtcp2_ssize idx;
 
   if (map->size == 0) {
     return NULL;
   }
 
-  h = hash(key);
-  idx = h2idx(h, map->tablelenbits);
-
-  for (;;) {
-    bkt = &map->table[idx];
-
-    if (bkt->data == NULL ||
-        d > distance(map->tablelen, map->tablelenbits, bkt, idx)) {
-      return NULL;
-    }
-
-    if (bkt->key == key) {
-      return bkt->data;
-    }
-
-    ++d;
-    idx = (idx + 1) & (map->tablelen - 1);
+  idx = find(map, key);
+  if (idx == -1) {
+    return NULL;
   }
+
+  return map->table[idx].data;
 }
 
 int ngtcp2_map_remove(ngtcp2_map *map, ngtcp2_map_key_type key) {
-  uint32_t h;
-  size_t idx, didx;
-  ngtcp2_map_bucket *bkt;
-  size_t d = 0;
+  ngtcp2_ssize idx;
+  uint32_t empty_before, empty_after;
 
   if (map->size == 0) {
     return NGTCP2_ERR_INVALID_ARGUMENT;
   }
 
-  h = hash(key);
-  idx = h2idx(h, map->tablelenbits);
-
-  for (;;) {
-    bkt = &map->table[idx];
-
-    if (bkt->data == NULL ||
-        d > distance(map->tablelen, map->tablelenbits, bkt, idx)) {
-      return NGTCP2_ERR_INVALID_ARGUMENT;
-    }
-
-    if (bkt->key == key) {
-      map_bucket_set_data(bkt, 0, 0, NULL);
-
-      didx = idx;
-      idx = (idx + 1) & (map->tablelen - 1);
-
-      for (;;) {
-        bkt = &map->table[idx];
-        if (bkt->data == NULL ||
-            distance(map->tablelen, map->tablelenbits, bkt, idx) == 0) {
-          break;
-        }
-
-        map->table[didx] = *bkt;
-        map_bucket_set_data(bkt, 0, 0, NULL);
-        didx = idx;
+  idx = find(map, key);
+  if (idx == -1) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
 
-        idx = (idx + 1) & (map->tablelen - 1);
-      }
+  /* A lookup stops at the first group which contains an EMPTY
+     bucket.  If every group which contains this bucket already has an
+     EMPTY bucket, no lookup can have passed through it, and it can
+     become EMPTY again.  Otherwise, it must be DELETED. */
+  empty_before = group_match(
+      group_load(map->ctrl + (((size_t)idx - NGTCP2_MAP_GROUP_WIDTH) &
+                              (map->tablelen - 1))),
+      NGTCP2_MAP_CTRL_EMPTY);
+  empty_after =
+      group_match(group_load(map->ctrl + idx), NGTCP2_MAP_CTRL_EMPTY);
+
+  if (empty_before && empty_after &&
+      mask_ctz(empty_after) + mask_clz16(empty_before) <
+          NGTCP2_MAP_GROUP_WIDTH) {
+    set_ctrl(map->ctrl, map->tablelen, (size_t)idx, NGTCP2_MAP_CTRL_EMPTY);
+    ++map->growth_left;
+  } else {
+    set_ctrl(map->ctrl, map->tablelen, (size_t)idx, NGTCP2_MAP_CTRL_DELETED);
+  }
 
-      --map->size;
+  map->table[idx].data = NULL;
 
-      return 0;
-    }
+  --map->size;
 
-    ++d;
-    idx = (idx + 1) & (map->tablelen - 1);
-  }
+  return 0;
 }
 
 void ngtcp2_map_clear(ngtcp2_map *map) {
@@ -330,7 +492,10 @@ void ngtcp2_map_clear(ngtcp2_map *map) {
   }
 
   memset(map->table, 0, sizeof(*map->table) * map->tablelen);
+  memset(map->ctrl, NGTCP2_MAP_CTRL_EMPTY,
+         map->tablelen + NGTCP2_MAP_GROUP_WIDTH - 1);
   map->size = 0;
+  map->growth_left = max_growth(map->tablelen);
 }
 
 size_t ngtcp2_map_size(ngtcp2_map *map) { return map->size; }
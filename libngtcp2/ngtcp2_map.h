@@ -34,22 +34,52 @@
 
 #include "ngtcp2_mem.h"
 
-/* Implementation of unordered map */
+/*
+ * Implementation of unordered map
+ *
+ * The map is an open addressing hash table which keeps a control
+ * byte per bucket in a separate array.  A control byte is either
+ * NGTCP2_MAP_CTRL_EMPTY, NGTCP2_MAP_CTRL_DELETED, or the lowest 7
+ * bits of the hash of the key in the bucket.  A lookup compares
+ * NGTCP2_MAP_GROUP_WIDTH control bytes at once (with SSE2 if it is
+ * available), and only reads the buckets whose control byte matches
+ * the hash.  The buckets hold the key and the pointer to the data,
+ * and a bucket which has no data has NULL data.
+ */
 
 typedef uint64_t ngtcp2_map_key_type;
 
+/* NGTCP2_MAP_GROUP_WIDTH is the number of control bytes which are
+   probed at once. */
+#define NGTCP2_MAP_GROUP_WIDTH 16
+
+/* NGTCP2_MAP_CTRL_EMPTY indicates that the bucket has never been
+   used since the last rehash. */
+#define NGTCP2_MAP_CTRL_EMPTY 0x80
+/* NGTCP2_MAP_CTRL_DELETED indicates that the bucket was used and its
+   data has been removed. */
+#define NGTCP2_MAP_CTRL_DELETED 0xfe
+
 typedef struct ngtcp2_map_bucket {
-  uint32_t hash;
   ngtcp2_map_key_type key;
   void *data;
 } ngtcp2_map_bucket;
 
 typedef struct ngtcp2_map {
   ngtcp2_map_bucket *table;
+  /* ctrl is the array of control bytes.  It has tablelen +
+     NGTCP2_MAP_GROUP_WIDTH - 1 elements; the last
+     NGTCP2_MAP_GROUP_WIDTH - 1 of them mirror the first ones so that
+     a group can be loaded at any position without wrapping around.
+     It is allocated along with table. */
+  uint8_t *ctrl;
   const ngtcp2_mem *mem;
   size_t size;
   uint32_t tablelen;
   uint32_t tablelenbits;
+  /* growth_left is the number of NGTCP2_MAP_CTRL_EMPTY buckets which
+     can be filled before the table is rehashed. */
+  uint32_t growth_left;
 } ngtcp2_map;
 
 /*
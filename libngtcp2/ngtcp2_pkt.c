@@ -470,9 +470,95 @@ ngtcp2_ssize ngtcp2_pkt_encode_hd_short(uint8_t *out, size_t outlen,
   return (ngtcp2_ssize)len;
 }
 
+/*
+ * frame_decoder is the type of the functions in frame_decoders.  Each
+ * function decodes a frame into the union member of ngtcp2_frame
+ * which corresponds to the frame type.
+ */
+typedef ngtcp2_ssize (*frame_decoder)(ngtcp2_frame *dest,
+                                      const uint8_t *payload,
+                                      size_t payloadlen);
+
+static ngtcp2_ssize decode_padding_frame(ngtcp2_frame *dest,
+                                         const uint8_t *payload,
+                                         size_t payloadlen) {
+  return (ngtcp2_ssize)ngtcp2_pkt_decode_padding_frame(&dest->padding,
+                                                       payload, payloadlen);
+}
+
+#define NGTCP2_PKT_FRAME_DECODER_DEF(NAME)                                     \
+  static ngtcp2_ssize decode_##NAME##_frame(                                   \
+      ngtcp2_frame *dest, const uint8_t *payload, size_t payloadlen) {         \
+    return ngtcp2_pkt_decode_##NAME##_frame(&dest->NAME, payload, payloadlen); \
+  }
+
+NGTCP2_PKT_FRAME_DECODER_DEF(reset_stream)
+NGTCP2_PKT_FRAME_DECODER_DEF(connection_close)
+NGTCP2_PKT_FRAME_DECODER_DEF(max_data)
+NGTCP2_PKT_FRAME_DECODER_DEF(max_stream_data)
+NGTCP2_PKT_FRAME_DECODER_DEF(max_streams)
+NGTCP2_PKT_FRAME_DECODER_DEF(ping)
+NGTCP2_PKT_FRAME_DECODER_DEF(data_blocked)
+NGTCP2_PKT_FRAME_DECODER_DEF(stream_data_blocked)
+NGTCP2_PKT_FRAME_DECODER_DEF(streams_blocked)
+NGTCP2_PKT_FRAME_DECODER_DEF(new_connection_id)
+NGTCP2_PKT_FRAME_DECODER_DEF(stop_sending)
+NGTCP2_PKT_FRAME_DECODER_DEF(ack)
+NGTCP2_PKT_FRAME_DECODER_DEF(path_challenge)
+NGTCP2_PKT_FRAME_DECODER_DEF(path_response)
+NGTCP2_PKT_FRAME_DECODER_DEF(crypto)
+NGTCP2_PKT_FRAME_DECODER_DEF(new_token)
+NGTCP2_PKT_FRAME_DECODER_DEF(retire_connection_id)
+NGTCP2_PKT_FRAME_DECODER_DEF(handshake_done)
+NGTCP2_PKT_FRAME_DECODER_DEF(datagram)
+NGTCP2_PKT_FRAME_DECODER_DEF(stream)
+
+#undef NGTCP2_PKT_FRAME_DECODER_DEF
+
+/*
+ * frame_decoders is indexed by the frame type, which is the first
+ * byte of a frame.  It is NULL if the type is unknown.
+ */
+static const frame_decoder frame_decoders[] = {
+    [NGTCP2_FRAME_PADDING] = decode_padding_frame,
+    [NGTCP2_FRAME_PING] = decode_ping_frame,
+    [NGTCP2_FRAME_ACK] = decode_ack_frame,
+    [NGTCP2_FRAME_ACK_ECN] = decode_ack_frame,
+    [NGTCP2_FRAME_RESET_STREAM] = decode_reset_stream_frame,
+    [NGTCP2_FRAME_STOP_SENDING] = decode_stop_sending_frame,
+    [NGTCP2_FRAME_CRYPTO] = decode_crypto_frame,
+    [NGTCP2_FRAME_NEW_TOKEN] = decode_new_token_frame,
+    [NGTCP2_FRAME_STREAM] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x01] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x02] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x03] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x04] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x05] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x06] = decode_stream_frame,
+    [NGTCP2_FRAME_STREAM | 0x07] = decode_stream_frame,
+    [NGTCP2_FRAME_MAX_DATA] = decode_max_data_frame,
+    [NGTCP2_FRAME_MAX_STREAM_DATA] = decode_max_stream_data_frame,
+    [NGTCP2_FRAME_MAX_STREAMS_BIDI] = decode_max_streams_frame,
+    [NGTCP2_FRAME_MAX_STREAMS_UNI] = decode_max_streams_frame,
+    [NGTCP2_FRAME_DATA_BLOCKED] = decode_data_blocked_frame,
+    [NGTCP2_FRAME_STREAM_DATA_BLOCKED] = decode_stream_data_blocked_frame,
+    [NGTCP2_FRAME_STREAMS_BLOCKED_BIDI] = decode_streams_blocked_frame,
+    [NGTCP2_FRAME_STREAMS_BLOCKED_UNI] = decode_streams_blocked_frame,
+    [NGTCP2_FRAME_NEW_CONNECTION_ID] = decode_new_connection_id_frame,
+    [NGTCP2_FRAME_RETIRE_CONNECTION_ID] = decode_retire_connection_id_frame,
+    [NGTCP2_FRAME_PATH_CHALLENGE] = decode_path_challenge_frame,
+    [NGTCP2_FRAME_PATH_RESPONSE] = decode_path_response_frame,
+    [NGTCP2_FRAME_CONNECTION_CLOSE] = decode_connection_close_frame,
+    [NGTCP2_FRAME_CONNECTION_CLOSE_APP] = decode_connection_close_frame,
+    [NGTCP2_FRAME_HANDSHAKE_DONE] = decode_handshake_done_frame,
+    [NGTCP2_FRAME_DATAGRAM] = decode_datagram_frame,
+    [NGTCP2_FRAME_DATAGRAM_LEN] = decode_datagram_frame,
+};
+
 ngtcp2_ssize ngtcp2_pkt_decode_frame(ngtcp2_frame *dest, const uint8_t *payload,
                                      size_t payloadlen) {
   uint8_t type;
+  frame_decoder decode;
 
   if (payloadlen == 0) {
     return 0;
@@ -480,75 +566,18 @@ ngtcp2_ssize ngtcp2_pkt_decode_frame(ngtcp2_frame *dest, const uint8_t *payload,
 
   type = payload[0];
 
-  switch (type) {
-  case NGTCP2_FRAME_PADDING:
-    return (ngtcp2_ssize)ngtcp2_pkt_decode_padding_frame(&dest->padding,
-                                                         payload, payloadlen);
-  case NGTCP2_FRAME_RESET_STREAM:
-    return ngtcp2_pkt_decode_reset_stream_frame(&dest->reset_stream, payload,
-                                                payloadlen);
-  case NGTCP2_FRAME_CONNECTION_CLOSE:
-  case NGTCP2_FRAME_CONNECTION_CLOSE_APP:
-    return ngtcp2_pkt_decode_connection_close_frame(&dest->connection_close,
-                                                    payload, payloadlen);
-  case NGTCP2_FRAME_MAX_DATA:
-    return ngtcp2_pkt_decode_max_data_frame(&dest->max_data, payload,
-                                            payloadlen);
-  case NGTCP2_FRAME_MAX_STREAM_DATA:
-    return ngtcp2_pkt_decode_max_stream_data_frame(&dest->max_stream_data,
-                                                   payload, payloadlen);
-  case NGTCP2_FRAME_MAX_STREAMS_BIDI:
-  case NGTCP2_FRAME_MAX_STREAMS_UNI:
-    return ngtcp2_pkt_decode_max_streams_frame(&dest->max_streams, payload,
-                                               payloadlen);
-  case NGTCP2_FRAME_PING:
-    return ngtcp2_pkt_decode_ping_frame(&dest->ping, payload, payloadlen);
-  case NGTCP2_FRAME_DATA_BLOCKED:
-    return ngtcp2_pkt_decode_data_blocked_frame(&dest->data_blocked, payload,
-                                                payloadlen);
-  case NGTCP2_FRAME_STREAM_DATA_BLOCKED:
-    return ngtcp2_pkt_decode_stream_data_blocked_frame(
-        &dest->stream_data_blocked, payload, payloadlen);
-  case NGTCP2_FRAME_STREAMS_BLOCKED_BIDI:
-  case NGTCP2_FRAME_STREAMS_BLOCKED_UNI:
-    return ngtcp2_pkt_decode_streams_blocked_frame(&dest->streams_blocked,
-                                                   payload, payloadlen);
-  case NGTCP2_FRAME_NEW_CONNECTION_ID:
-    return ngtcp2_pkt_decode_new_connection_id_frame(&dest->new_connection_id,
-                                                     payload, payloadlen);
-  case NGTCP2_FRAME_STOP_SENDING:
-    return ngtcp2_pkt_decode_stop_sending_frame(&dest->stop_sending, payload,
-                                                payloadlen);
-  case NGTCP2_FRAME_ACK:
-  case NGTCP2_FRAME_ACK_ECN:
-    return ngtcp2_pkt_decode_ack_frame(&dest->ack, payload, payloadlen);
-  case NGTCP2_FRAME_PATH_CHALLENGE:
-    return ngtcp2_pkt_decode_path_challenge_frame(&dest->path_challenge,
-                                                  payload, payloadlen);
-  case NGTCP2_FRAME_PATH_RESPONSE:
-    return ngtcp2_pkt_decode_path_response_frame(&dest->path_response, payload,
-                                                 payloadlen);
-  case NGTCP2_FRAME_CRYPTO:
-    return ngtcp2_pkt_decode_crypto_frame(&dest->crypto, payload, payloadlen);
-  case NGTCP2_FRAME_NEW_TOKEN:
-    return ngtcp2_pkt_decode_new_token_frame(&dest->new_token, payload,
-                                             payloadlen);
-  case NGTCP2_FRAME_RETIRE_CONNECTION_ID:
-    return ngtcp2_pkt_decode_retire_connection_id_frame(
-        &dest->retire_connection_id, payload, payloadlen);
-  case NGTCP2_FRAME_HANDSHAKE_DONE:
-    return ngtcp2_pkt_decode_handshake_done_frame(&dest->handshake_done,
-                                                  payload, payloadlen);
-  case NGTCP2_FRAME_DATAGRAM:
-  case NGTCP2_FRAME_DATAGRAM_LEN:
-    return ngtcp2_pkt_decode_datagram_frame(&dest->datagram, payload,
-                                            payloadlen);
-  default:
-    if (has_mask(type, NGTCP2_FRAME_STREAM)) {
-      return ngtcp2_pkt_decode_stream_frame(&dest->stream, payload, payloadlen);
+  if (type < sizeof(frame_decoders) / sizeof(frame_decoders[0])) {
+    decode = frame_decoders[type];
+    if (decode) {
+      return decode(dest, payload, payloadlen);
     }
-    return NGTCP2_ERR_FRAME_ENCODING;
   }
+
+  if (has_mask(type, NGTCP2_FRAME_STREAM)) {
+    return ngtcp2_pkt_decode_stream_frame(&dest->stream, payload, payloadlen);
+  }
+
+  return NGTCP2_ERR_FRAME_ENCODING;
 }
 
 ngtcp2_ssize ngtcp2_pkt_decode_stream_frame(ngtcp2_stream *dest,
@@ -657,14 +686,17 @@ ngtcp2_ssize ngtcp2_pkt_decode_ack_frame(ngtcp2_ack *dest,
                                          const uint8_t *payload,
                                          size_t payloadlen) {
   size_t num_blks, max_num_blks;
-  size_t nnum_blks;
   size_t len = 1 + 1 + 1 + 1 + 1;
-  const uint8_t *p;
-  size_t i, j;
-  ngtcp2_ack_blk *blk;
-  size_t n;
+  const uint8_t *p, *end = payload + payloadlen;
+  size_t i, n;
   uint8_t type;
-  uint64_t vi;
+  /* Largest Acknowledged, ACK Delay, ACK Range Count, and First ACK
+     Range */
+  uint64_t hd[4];
+  /* Gap and ACK Range Length pairs, decoded NGTCP2_MAX_ACK_BLKS pairs
+     at a time */
+  uint64_t blks[NGTCP2_MAX_ACK_BLKS * 2];
+  uint64_t ecn[3];
 
   if (payloadlen < len) {
     return NGTCP2_ERR_FRAME_ENCODING;
@@ -672,131 +704,63 @@ ngtcp2_ssize ngtcp2_pkt_decode_ack_frame(ngtcp2_ack *dest,
 
   type = payload[0];
 
-  p = payload + 1;
-
-  /* Largest Acknowledged */
-  n = ngtcp2_get_varint_len(p);
-  len += n - 1;
-
-  if (payloadlen < len) {
+  p = ngtcp2_get_varints(hd, 3, payload + 1, end);
+  if (p == NULL) {
     return NGTCP2_ERR_FRAME_ENCODING;
   }
 
-  p += n;
-
-  /* ACK Delay */
-  n = ngtcp2_get_varint_len(p);
-  len += n - 1;
+  len = (size_t)(p - payload) + 1;
 
-  if (payloadlen < len) {
+  if (hd[2] > SIZE_MAX / (1 + 1) || payloadlen - len < hd[2] * (1 + 1)) {
     return NGTCP2_ERR_FRAME_ENCODING;
   }
 
-  p += n;
-
-  /* ACK Block Count */
-  nnum_blks = ngtcp2_get_varint_len(p);
-  len += nnum_blks - 1;
-
-  if (payloadlen < len) {
-    return NGTCP2_ERR_FRAME_ENCODING;
-  }
+  num_blks = (size_t)hd[2];
 
-  vi = ngtcp2_get_varint(&nnum_blks, p);
-  if (vi > SIZE_MAX / (1 + 1) || payloadlen - len < vi * (1 + 1)) {
+  p = ngtcp2_get_varints(&hd[3], 1, p, end);
+  if (p == NULL) {
     return NGTCP2_ERR_FRAME_ENCODING;
   }
 
-  num_blks = (size_t)vi;
-  len += num_blks * (1 + 1);
-
-  p += nnum_blks;
-
-  /* First ACK Block */
-  n = ngtcp2_get_varint_len(p);
-  len += n - 1;
-
-  if (payloadlen < len) {
-    return NGTCP2_ERR_FRAME_ENCODING;
-  }
+  /* TODO We might not decode all blocks.  It could be very large. */
+  max_num_blks = ngtcp2_min(NGTCP2_MAX_ACK_BLKS, num_blks);
 
-  p += n;
+  for (i = 0; i < num_blks; i += n) {
+    n = ngtcp2_min(NGTCP2_MAX_ACK_BLKS, num_blks - i);
 
-  for (i = 0; i < num_blks; ++i) {
-    /* Gap, and Additional ACK Block */
-    for (j = 0; j < 2; ++j) {
-      n = ngtcp2_get_varint_len(p);
-      len += n - 1;
+    p = ngtcp2_get_varints(blks, n * 2, p, end);
+    if (p == NULL) {
+      return NGTCP2_ERR_FRAME_ENCODING;
+    }
 
-      if (payloadlen < len) {
-        return NGTCP2_ERR_FRAME_ENCODING;
+    if (i == 0) {
+      for (n = 0; n < max_num_blks; ++n) {
+        dest->blks[n].gap = blks[n * 2];
+        dest->blks[n].blklen = blks[n * 2 + 1];
       }
-
-      p += n;
     }
   }
 
   if (type == NGTCP2_FRAME_ACK_ECN) {
-    len += 3;
-    if (payloadlen < len) {
+    p = ngtcp2_get_varints(ecn, 3, p, end);
+    if (p == NULL) {
       return NGTCP2_ERR_FRAME_ENCODING;
     }
 
-    for (i = 0; i < 3; ++i) {
-      n = ngtcp2_get_varint_len(p);
-      len += n - 1;
-
-      if (payloadlen < len) {
-        return NGTCP2_ERR_FRAME_ENCODING;
-      }
-
-      p += n;
-    }
+    dest->ecn.ect0 = ecn[0];
+    dest->ecn.ect1 = ecn[1];
+    dest->ecn.ce = ecn[2];
   }
 
-  /* TODO We might not decode all blocks.  It could be very large. */
-  max_num_blks = ngtcp2_min(NGTCP2_MAX_ACK_BLKS, num_blks);
-
-  p = payload + 1;
-
   dest->type = type;
-  dest->largest_ack = (int64_t)ngtcp2_get_varint(&n, p);
-  p += n;
-  dest->ack_delay = ngtcp2_get_varint(&n, p);
+  dest->largest_ack = (int64_t)hd[0];
+  dest->ack_delay = hd[1];
   /* This value will be assigned in the upper layer. */
   dest->ack_delay_unscaled = 0;
-  p += n;
   dest->num_blks = max_num_blks;
-  p += nnum_blks;
-  dest->first_ack_blklen = ngtcp2_get_varint(&n, p);
-  p += n;
-
-  for (i = 0; i < max_num_blks; ++i) {
-    blk = &dest->blks[i];
-    blk->gap = ngtcp2_get_varint(&n, p);
-    p += n;
-    blk->blklen = ngtcp2_get_varint(&n, p);
-    p += n;
-  }
-  for (i = max_num_blks; i < num_blks; ++i) {
-    p += ngtcp2_get_varint_len(p);
-    p += ngtcp2_get_varint_len(p);
-  }
-
-  if (type == NGTCP2_FRAME_ACK_ECN) {
-    dest->ecn.ect0 = ngtcp2_get_varint(&n, p);
-    p += n;
-
-    dest->ecn.ect1 = ngtcp2_get_varint(&n, p);
-    p += n;
+  dest->first_ack_blklen = hd[3];
 
-    dest->ecn.ce = ngtcp2_get_varint(&n, p);
-    p += n;
-  }
-
-  assert((size_t)(p - payload) == len);
-
-  return (ngtcp2_ssize)len;
+  return (ngtcp2_ssize)(p - payload);
 }
 
 size_t ngtcp2_pkt_decode_padding_frame(ngtcp2_padding *dest,
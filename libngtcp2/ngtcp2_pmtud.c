@@ -39,6 +39,8 @@ static size_t mtu_probes[] = {
     1390 - 48, /* Typical Tunneled MTU */
     1280 - 48, /* IPv6 minimum MTU */
     1492 - 48, /* PPPoE */
+    1500 - 48, /* Ethernet */
+    9000 - 48, /* Jumbo frame, typical in datacenter networks */
 };
 
 static size_t mtu_probeslen = sizeof(mtu_probes) / sizeof(mtu_probes[0]);
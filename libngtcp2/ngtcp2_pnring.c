@@ -0,0 +1,336 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_pnring.h"
+
+#include <assert.h>
+
+#include "ngtcp2_macro.h"
+
+static int greater(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
+  return *(int64_t *)lhs > *(int64_t *)rhs;
+}
+
+void ngtcp2_pnring_init(ngtcp2_pnring *pr, const ngtcp2_mem *mem) {
+  pr->buf = NULL;
+  pr->nmemb = 0;
+  pr->base = 0;
+  pr->top = 0;
+  pr->nbuf = 0;
+  ngtcp2_ksl_init(&pr->sparse, greater, ngtcp2_ksl_int64_greater_search,
+                  sizeof(int64_t), mem);
+  pr->mem = mem;
+}
+
+void ngtcp2_pnring_free(ngtcp2_pnring *pr) {
+  if (pr == NULL) {
+    return;
+  }
+
+  ngtcp2_mem_free(pr->mem, pr->buf);
+  ngtcp2_ksl_free(&pr->sparse);
+}
+
+#define pnring_slot(PR, PKT_NUM)                                               \
+  (PR)->buf[(size_t)(PKT_NUM) & ((PR)->nmemb - 1)]
+
+/*
+ * pnring_find_down returns the largest packet number which is equal
+ * to or smaller than |pkt_num| and stored in pr->buf.  pr->nbuf must
+ * be nonzero, and |pkt_num| must be in [pr->base, pr->top).
+ */
+static int64_t pnring_find_down(const ngtcp2_pnring *pr, int64_t pkt_num) {
+  assert(pr->nbuf);
+  assert(pr->base <= pkt_num);
+  assert(pkt_num < pr->top);
+
+  /* pr->buf[pr->base] is never NULL, so this loop terminates. */
+  for (; pnring_slot(pr, pkt_num) == NULL; --pkt_num)
+    ;
+
+  return pkt_num;
+}
+
+/*
+ * pnring_find_up returns the smallest packet number which is equal
+ * to or larger than |pkt_num| and stored in pr->buf.  pr->nbuf must
+ * be nonzero, and |pkt_num| must be in [pr->base, pr->top).
+ */
+static int64_t pnring_find_up(const ngtcp2_pnring *pr, int64_t pkt_num) {
+  assert(pr->nbuf);
+  assert(pr->base <= pkt_num);
+  assert(pkt_num < pr->top);
+
+  for (; pnring_slot(pr, pkt_num) == NULL; ++pkt_num)
+    ;
+
+  return pkt_num;
+}
+
+/*
+ * pnring_resize reallocates pr->buf so that it has |nmemb| slots.
+ * |nmemb| must be power of 2, and must be equal to or larger than
+ * pr->top - pr->base if pr->nbuf is nonzero.
+ */
+static int pnring_resize(ngtcp2_pnring *pr, size_t nmemb) {
+  void **buf;
+  int64_t pkt_num;
+
+  buf = ngtcp2_mem_calloc(pr->mem, nmemb, sizeof(void *));
+  if (buf == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  if (pr->nbuf) {
+    assert((size_t)(pr->top - pr->base) <= nmemb);
+
+    for (pkt_num = pr->base; pkt_num < pr->top; ++pkt_num) {
+      buf[(size_t)pkt_num & (nmemb - 1)] = pnring_slot(pr, pkt_num);
+    }
+  }
+
+  ngtcp2_mem_free(pr->mem, pr->buf);
+
+  pr->buf = buf;
+  pr->nmemb = nmemb;
+
+  return 0;
+}
+
+/*
+ * pnring_reserve makes pr->buf large enough to store |pkt_num| which
+ * is equal to or larger than pr->top.  If it would make pr->buf
+ * exceed NGTCP2_PNRING_MAX_NMEMB slots, the entries which have the
+ * smallest packet numbers are moved to pr->sparse.
+ */
+static int pnring_reserve(ngtcp2_pnring *pr, int64_t pkt_num) {
+  size_t span, nmemb;
+  int rv;
+
+  span = pr->nbuf ? (size_t)(pkt_num - pr->base) + 1 : 1;
+
+  if (span <= pr->nmemb) {
+    return 0;
+  }
+
+  nmemb = pr->nmemb ? pr->nmemb : NGTCP2_PNRING_INITIAL_NMEMB;
+  for (; nmemb < span && nmemb < NGTCP2_PNRING_MAX_NMEMB; nmemb <<= 1)
+    ;
+
+  if (nmemb != pr->nmemb) {
+    rv = pnring_resize(pr, nmemb);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  for (; pr->nbuf && (size_t)(pkt_num - pr->base) >= pr->nmemb;) {
+    rv = ngtcp2_ksl_insert(&pr->sparse, NULL, &pr->base,
+                           pnring_slot(pr, pr->base));
+    if (rv != 0) {
+      return rv;
+    }
+
+    pnring_slot(pr, pr->base) = NULL;
+
+    if (--pr->nbuf) {
+      pr->base = pnring_find_up(pr, pr->base + 1);
+    }
+  }
+
+  return 0;
+}
+
+int ngtcp2_pnring_insert(ngtcp2_pnring *pr, int64_t pkt_num, void *data) {
+  ngtcp2_ksl_it it;
+  int rv;
+
+  assert(data);
+
+  if (pr->nbuf == 0) {
+    if (ngtcp2_ksl_len(&pr->sparse)) {
+      it = ngtcp2_ksl_begin(&pr->sparse);
+      if (pkt_num < *(int64_t *)ngtcp2_ksl_it_key(&it)) {
+        return ngtcp2_ksl_insert(&pr->sparse, NULL, &pkt_num, data);
+      }
+    }
+  } else if (pkt_num < pr->base) {
+    return ngtcp2_ksl_insert(&pr->sparse, NULL, &pkt_num, data);
+  } else if (pkt_num < pr->top) {
+    assert(pnring_slot(pr, pkt_num) == NULL);
+
+    pnring_slot(pr, pkt_num) = data;
+    ++pr->nbuf;
+
+    return 0;
+  }
+
+  rv = pnring_reserve(pr, pkt_num);
+  if (rv != 0) {
+    return rv;
+  }
+
+  if (pr->nbuf == 0) {
+    pr->base = pkt_num;
+  }
+
+  pnring_slot(pr, pkt_num) = data;
+  pr->top = pkt_num + 1;
+  ++pr->nbuf;
+
+  return 0;
+}
+
+void ngtcp2_pnring_remove(ngtcp2_pnring *pr, ngtcp2_pnring_it *it) {
+  int64_t pkt_num = it->pkt_num;
+  int rv;
+  (void)rv;
+
+  assert(it->pr == pr);
+
+  if (pkt_num == -1) {
+    pkt_num = *(int64_t *)ngtcp2_ksl_it_key(&it->sparse_it);
+    rv = ngtcp2_ksl_remove_hint(&pr->sparse, &it->sparse_it, &it->sparse_it,
+                                &pkt_num);
+    assert(0 == rv);
+
+    return;
+  }
+
+  assert(pnring_slot(pr, pkt_num));
+
+  pnring_slot(pr, pkt_num) = NULL;
+
+  if (--pr->nbuf == 0 || pkt_num == pr->base) {
+    if (pr->nbuf) {
+      pr->base = pnring_find_up(pr, pkt_num + 1);
+    }
+
+    it->pkt_num = -1;
+    it->sparse_it = ngtcp2_ksl_begin(&pr->sparse);
+
+    return;
+  }
+
+  if (pkt_num == pr->top - 1) {
+    pr->top = pnring_find_down(pr, pkt_num - 1) + 1;
+    it->pkt_num = pr->top - 1;
+
+    return;
+  }
+
+  it->pkt_num = pnring_find_down(pr, pkt_num - 1);
+}
+
+size_t ngtcp2_pnring_len(ngtcp2_pnring *pr) {
+  return pr->nbuf + ngtcp2_ksl_len(&pr->sparse);
+}
+
+ngtcp2_pnring_it ngtcp2_pnring_begin(const ngtcp2_pnring *pr) {
+  ngtcp2_pnring_it it;
+
+  it.pr = pr;
+
+  if (pr->nbuf) {
+    it.pkt_num = pr->top - 1;
+  } else {
+    it.pkt_num = -1;
+  }
+
+  it.sparse_it = ngtcp2_ksl_begin(&pr->sparse);
+
+  return it;
+}
+
+ngtcp2_pnring_it ngtcp2_pnring_end(const ngtcp2_pnring *pr) {
+  ngtcp2_pnring_it it;
+
+  it.pr = pr;
+  it.pkt_num = -1;
+  it.sparse_it = ngtcp2_ksl_end(&pr->sparse);
+
+  return it;
+}
+
+ngtcp2_pnring_it ngtcp2_pnring_lower_bound(ngtcp2_pnring *pr,
+                                           int64_t pkt_num) {
+  ngtcp2_pnring_it it;
+
+  it.pr = pr;
+
+  if (pr->nbuf && pkt_num >= pr->base) {
+    it.pkt_num = pnring_find_down(pr, ngtcp2_min(pkt_num, pr->top - 1));
+    it.sparse_it = ngtcp2_ksl_begin(&pr->sparse);
+  } else {
+    it.pkt_num = -1;
+    it.sparse_it = ngtcp2_ksl_lower_bound(&pr->sparse, &pkt_num);
+  }
+
+  return it;
+}
+
+void ngtcp2_pnring_it_next(ngtcp2_pnring_it *it) {
+  const ngtcp2_pnring *pr = it->pr;
+
+  if (it->pkt_num == -1) {
+    ngtcp2_ksl_it_next(&it->sparse_it);
+    return;
+  }
+
+  if (it->pkt_num == pr->base) {
+    it->pkt_num = -1;
+    it->sparse_it = ngtcp2_ksl_begin(&pr->sparse);
+    return;
+  }
+
+  it->pkt_num = pnring_find_down(pr, it->pkt_num - 1);
+}
+
+void ngtcp2_pnring_it_prev(ngtcp2_pnring_it *it) {
+  const ngtcp2_pnring *pr = it->pr;
+
+  if (it->pkt_num != -1) {
+    it->pkt_num = pnring_find_up(pr, it->pkt_num + 1);
+    return;
+  }
+
+  if (ngtcp2_ksl_it_begin(&it->sparse_it)) {
+    assert(pr->nbuf);
+
+    it->pkt_num = pr->base;
+    return;
+  }
+
+  ngtcp2_ksl_it_prev(&it->sparse_it);
+}
+
+int ngtcp2_pnring_it_begin(const ngtcp2_pnring_it *it) {
+  const ngtcp2_pnring *pr = it->pr;
+
+  if (pr->nbuf) {
+    return it->pkt_num == pr->top - 1;
+  }
+
+  return ngtcp2_ksl_it_begin(&it->sparse_it);
+}
@@ -0,0 +1,185 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_PNRING_H
+#define NGTCP2_PNRING_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_mem.h"
+#include "ngtcp2_ksl.h"
+
+/* NGTCP2_PNRING_INITIAL_NMEMB is the number of slots allocated when
+   the first entry is inserted. */
+#define NGTCP2_PNRING_INITIAL_NMEMB 64
+/* NGTCP2_PNRING_MAX_NMEMB is the maximum number of slots.  Entries
+   which are farther than this from the largest packet number are
+   moved to the sparse skip list. */
+#define NGTCP2_PNRING_MAX_NMEMB 262144
+
+/*
+ * ngtcp2_pnring is a container of entries keyed by packet number,
+ * iterated in decreasing order of packet number.  Packet numbers are
+ * allocated densely and monotonically, so the bulk of entries is
+ * kept in a circular array indexed by packet number, which gives
+ * O(1) insertion, lookup and removal.  Holes (e.g., packets not
+ * tracked, or already removed) are NULL slots.  Entries which would
+ * make the array span more than NGTCP2_PNRING_MAX_NMEMB packet
+ * numbers are moved to a skip list, which is rare in practice.
+ */
+typedef struct ngtcp2_pnring {
+  /* buf is the circular array of nmemb slots.  The entry which has
+     packet number n is stored at buf[n & (nmemb - 1)] if base <= n
+     < top.  Empty slot is NULL. */
+  void **buf;
+  /* nmemb is the number of slots in buf.  It is 0 or power of 2. */
+  size_t nmemb;
+  /* base is the smallest packet number stored in buf, and top is the
+     largest packet number stored in buf plus 1.  They are only
+     meaningful if nbuf > 0. */
+  int64_t base;
+  int64_t top;
+  /* nbuf is the number of entries stored in buf. */
+  size_t nbuf;
+  /* sparse includes the entries which do not fit in buf, sorted by
+     decreasing order of packet number.  All of them have packet
+     number smaller than base. */
+  ngtcp2_ksl sparse;
+  const ngtcp2_mem *mem;
+} ngtcp2_pnring;
+
+/*
+ * ngtcp2_pnring_it is an iterator over ngtcp2_pnring.
+ */
+typedef struct ngtcp2_pnring_it {
+  const ngtcp2_pnring *pr;
+  /* pkt_num is the packet number of the entry in pr->buf which this
+     iterator points to.  If it is -1, this iterator points into
+     pr->sparse through sparse_it. */
+  int64_t pkt_num;
+  ngtcp2_ksl_it sparse_it;
+} ngtcp2_pnring_it;
+
+/*
+ * ngtcp2_pnring_init initializes |pr|.  No memory is allocated until
+ * the first entry is inserted.
+ */
+void ngtcp2_pnring_init(ngtcp2_pnring *pr, const ngtcp2_mem *mem);
+
+/*
+ * ngtcp2_pnring_free frees resources allocated for |pr|.  It does not
+ * free the entries stored in |pr|.
+ */
+void ngtcp2_pnring_free(ngtcp2_pnring *pr);
+
+/*
+ * ngtcp2_pnring_insert inserts |data| with the key |pkt_num|.  |data|
+ * must not be NULL, and |pkt_num| must not be in |pr|.  Inserting
+ * the packet number larger than any other is the fast path.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory
+ */
+int ngtcp2_pnring_insert(ngtcp2_pnring *pr, int64_t pkt_num, void *data);
+
+/*
+ * ngtcp2_pnring_remove removes the entry which |it| points to, and
+ * makes |it| point to the entry following the removed one.
+ */
+void ngtcp2_pnring_remove(ngtcp2_pnring *pr, ngtcp2_pnring_it *it);
+
+/*
+ * ngtcp2_pnring_len returns the number of entries stored in |pr|.
+ */
+size_t ngtcp2_pnring_len(ngtcp2_pnring *pr);
+
+/*
+ * ngtcp2_pnring_begin returns the iterator which points to the entry
+ * which has the largest packet number.  If there is no entry, it
+ * returns the iterator which satisfies ngtcp2_pnring_it_end(it) != 0.
+ */
+ngtcp2_pnring_it ngtcp2_pnring_begin(const ngtcp2_pnring *pr);
+
+/*
+ * ngtcp2_pnring_end returns the iterator which points to the entry
+ * following the one which has the smallest packet number.
+ */
+ngtcp2_pnring_it ngtcp2_pnring_end(const ngtcp2_pnring *pr);
+
+/*
+ * ngtcp2_pnring_lower_bound returns the iterator which points to the
+ * entry which has the largest packet number that is equal to or
+ * smaller than |pkt_num|.  If there is no such entry, it returns the
+ * iterator which satisfies ngtcp2_pnring_it_end(it) != 0.
+ */
+ngtcp2_pnring_it ngtcp2_pnring_lower_bound(ngtcp2_pnring *pr,
+                                           int64_t pkt_num);
+
+/*
+ * ngtcp2_pnring_it_get returns the data associated to the entry which
+ * |it| points to.  It is undefined to call this function when
+ * ngtcp2_pnring_it_end(it) returns nonzero.
+ */
+#define ngtcp2_pnring_it_get(IT)                                               \
+  ((IT)->pkt_num != -1                                                         \
+       ? (IT)->pr->buf[(size_t)(IT)->pkt_num & ((IT)->pr->nmemb - 1)]          \
+       : ngtcp2_ksl_it_get(&(IT)->sparse_it))
+
+/*
+ * ngtcp2_pnring_it_next advances the iterator by one, that is, to the
+ * entry which has the next smaller packet number.  It is undefined
+ * if this function is called when ngtcp2_pnring_it_end(it) returns
+ * nonzero.
+ */
+void ngtcp2_pnring_it_next(ngtcp2_pnring_it *it);
+
+/*
+ * ngtcp2_pnring_it_prev moves backward the iterator by one.  It is
+ * undefined if this function is called when ngtcp2_pnring_it_begin(it)
+ * returns nonzero.
+ */
+void ngtcp2_pnring_it_prev(ngtcp2_pnring_it *it);
+
+/*
+ * ngtcp2_pnring_it_end returns nonzero if |it| points to the beyond
+ * the last entry.
+ */
+#define ngtcp2_pnring_it_end(IT)                                               \
+  ((IT)->pkt_num == -1 && ngtcp2_ksl_it_end(&(IT)->sparse_it))
+
+/*
+ * ngtcp2_pnring_it_begin returns nonzero if |it| points to the first
+ * entry.  |it| might satisfy both ngtcp2_pnring_it_begin(&it) and
+ * ngtcp2_pnring_it_end(&it) if |pr| has no entry.
+ */
+int ngtcp2_pnring_it_begin(const ngtcp2_pnring_it *it);
+
+#endif /* NGTCP2_PNRING_H */
@@ -111,26 +111,38 @@ ngtcp2_ssize ngtcp2_ppe_final(ngtcp2_ppe *ppe, const uint8_t **ppkt) {
   size_t i;
   int rv;
 
-  assert(cc->encrypt);
-  assert(cc->hp_mask);
-
   if (ppe->len_offset) {
     ngtcp2_put_varint30(
         buf->begin + ppe->len_offset,
         (uint16_t)(payloadlen + ppe->pkt_numlen + cc->aead.max_overhead));
   }
 
-  ngtcp2_crypto_create_nonce(ppe->nonce, cc->ckm->iv.base, cc->ckm->iv.len,
-                             ppe->pkt_num);
-
-  rv = cc->encrypt(payload, &cc->aead, &cc->ckm->aead_ctx, payload, payloadlen,
-                   ppe->nonce, cc->ckm->iv.len, buf->begin, ppe->hdlen);
-  if (rv != 0) {
-    return NGTCP2_ERR_CALLBACK_FAILURE;
+  /* encrypt and hp_mask are NULL if the packet is sent without packet
+     protection (NGTCP2_CONN_FLAG_NULL_PROTECTION), or if application
+     protects it later (NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION).  The
+     payload is left in place. */
+  if (cc->encrypt) {
+    ngtcp2_crypto_create_nonce(ppe->nonce, cc->ckm->iv.base, cc->ckm->iv.len,
+                               ppe->pkt_num);
+
+    rv = cc->encrypt(payload, &cc->aead, &cc->ckm->aead_ctx, payload,
+                     payloadlen, ppe->nonce, cc->ckm->iv.len, buf->begin,
+                     ppe->hdlen);
+    if (rv != 0) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
   }
 
   buf->last = payload + payloadlen + cc->aead.max_overhead;
 
+  if (!cc->hp_mask) {
+    if (ppkt != NULL) {
+      *ppkt = buf->begin;
+    }
+
+    return (ngtcp2_ssize)ngtcp2_buf_len(buf);
+  }
+
   /* TODO Check that we have enough space to get sample */
   assert(ppe->sample_offset + NGTCP2_HP_SAMPLELEN <= ngtcp2_buf_len(buf));
 
@@ -194,7 +206,10 @@ size_t ngtcp2_ppe_padding_hp_sample(ngtcp2_ppe *ppe) {
   size_t max_samplelen;
   size_t len = 0;
 
-  assert(cc->aead.max_overhead);
+  /* No sample is taken if header protection is not applied. */
+  if (!cc->hp_mask) {
+    return 0;
+  }
 
   max_samplelen =
       ngtcp2_buf_len(buf) + cc->aead.max_overhead - ppe->sample_offset;
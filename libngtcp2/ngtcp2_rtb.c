@@ -291,10 +291,89 @@ void ngtcp2_rtb_entry_objalloc_del(ngtcp2_rtb_entry *ent,
   ngtcp2_objalloc_rtb_entry_release(objalloc, ent);
 }
 
+#ifdef ENABLE_RTB_PNRING
+static void rtb_ents_init(ngtcp2_rtb *rtb, const ngtcp2_mem *mem) {
+  ngtcp2_pnring_init(&rtb->ents, mem);
+}
+
+static void rtb_ents_free(ngtcp2_rtb *rtb) { ngtcp2_pnring_free(&rtb->ents); }
+
+static int rtb_ents_insert(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
+  return ngtcp2_pnring_insert(&rtb->ents, ent->hd.pkt_num, ent);
+}
+
+/*
+ * rtb_ents_remove removes |ent| which |it| points to, and makes |it|
+ * point to the entry following |ent|.
+ */
+static void rtb_ents_remove(ngtcp2_rtb *rtb, ngtcp2_rtb_it *it,
+                            ngtcp2_rtb_entry *ent) {
+  (void)ent;
+
+  ngtcp2_pnring_remove(&rtb->ents, it);
+}
+
+static ngtcp2_rtb_it rtb_ents_begin(ngtcp2_rtb *rtb) {
+  return ngtcp2_pnring_begin(&rtb->ents);
+}
+
+static ngtcp2_rtb_it rtb_ents_end(ngtcp2_rtb *rtb) {
+  return ngtcp2_pnring_end(&rtb->ents);
+}
+
+static ngtcp2_rtb_it rtb_ents_lower_bound(ngtcp2_rtb *rtb, int64_t pkt_num) {
+  return ngtcp2_pnring_lower_bound(&rtb->ents, pkt_num);
+}
+
+static size_t rtb_ents_len(ngtcp2_rtb *rtb) {
+  return ngtcp2_pnring_len(&rtb->ents);
+}
+#else  /* !ENABLE_RTB_PNRING */
 static int greater(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
   return *(int64_t *)lhs > *(int64_t *)rhs;
 }
 
+static void rtb_ents_init(ngtcp2_rtb *rtb, const ngtcp2_mem *mem) {
+  ngtcp2_ksl_init(&rtb->ents, greater, ngtcp2_ksl_int64_greater_search,
+                  sizeof(int64_t), mem);
+}
+
+static void rtb_ents_free(ngtcp2_rtb *rtb) { ngtcp2_ksl_free(&rtb->ents); }
+
+static int rtb_ents_insert(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
+  return ngtcp2_ksl_insert(&rtb->ents, NULL, &ent->hd.pkt_num, ent);
+}
+
+/*
+ * rtb_ents_remove removes |ent| which |it| points to, and makes |it|
+ * point to the entry following |ent|.
+ */
+static void rtb_ents_remove(ngtcp2_rtb *rtb, ngtcp2_rtb_it *it,
+                            ngtcp2_rtb_entry *ent) {
+  int rv;
+  (void)rv;
+
+  rv = ngtcp2_ksl_remove_hint(&rtb->ents, it, it, &ent->hd.pkt_num);
+  assert(0 == rv);
+}
+
+static ngtcp2_rtb_it rtb_ents_begin(ngtcp2_rtb *rtb) {
+  return ngtcp2_ksl_begin(&rtb->ents);
+}
+
+static ngtcp2_rtb_it rtb_ents_end(ngtcp2_rtb *rtb) {
+  return ngtcp2_ksl_end(&rtb->ents);
+}
+
+static ngtcp2_rtb_it rtb_ents_lower_bound(ngtcp2_rtb *rtb, int64_t pkt_num) {
+  return ngtcp2_ksl_lower_bound(&rtb->ents, &pkt_num);
+}
+
+static size_t rtb_ents_len(ngtcp2_rtb *rtb) {
+  return ngtcp2_ksl_len(&rtb->ents);
+}
+#endif /* !ENABLE_RTB_PNRING */
+
 void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_pktns_id pktns_id,
                      ngtcp2_strm *crypto, ngtcp2_rst *rst, ngtcp2_cc *cc,
                      ngtcp2_log *log, ngtcp2_qlog *qlog,
@@ -302,7 +381,7 @@ void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_pktns_id pktns_id,
                      ngtcp2_objalloc *frc_objalloc, const ngtcp2_mem *mem) {
   rtb->rtb_entry_objalloc = rtb_entry_objalloc;
   rtb->frc_objalloc = frc_objalloc;
-  ngtcp2_ksl_init(&rtb->ents, greater, sizeof(int64_t), mem);
+  rtb_ents_init(rtb, mem);
   rtb->crypto = crypto;
   rtb->rst = rst;
   rtb->cc = cc;
@@ -322,21 +401,21 @@ void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_pktns_id pktns_id,
 }
 
 void ngtcp2_rtb_free(ngtcp2_rtb *rtb) {
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
 
   if (rtb == NULL) {
     return;
   }
 
-  it = ngtcp2_ksl_begin(&rtb->ents);
+  it = rtb_ents_begin(rtb);
 
-  for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
-    ngtcp2_rtb_entry_objalloc_del(ngtcp2_ksl_it_get(&it),
+  for (; !ngtcp2_rtb_it_end(&it); ngtcp2_rtb_it_next(&it)) {
+    ngtcp2_rtb_entry_objalloc_del(ngtcp2_rtb_it_get(&it),
                                   rtb->rtb_entry_objalloc, rtb->frc_objalloc,
                                   rtb->mem);
   }
 
-  ngtcp2_ksl_free(&rtb->ents);
+  rtb_ents_free(rtb);
 }
 
 static void rtb_on_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent,
@@ -580,7 +659,7 @@ static int conn_process_lost_datagram(ngtcp2_conn *conn,
   return 0;
 }
 
-static int rtb_on_pkt_lost(ngtcp2_rtb *rtb, ngtcp2_ksl_it *it,
+static int rtb_on_pkt_lost(ngtcp2_rtb *rtb, ngtcp2_rtb_it *it,
                            ngtcp2_rtb_entry *ent, ngtcp2_conn_stat *cstat,
                            ngtcp2_conn *conn, ngtcp2_pktns *pktns,
                            ngtcp2_tstamp ts) {
@@ -617,7 +696,7 @@ static int rtb_on_pkt_lost(ngtcp2_rtb *rtb, ngtcp2_ksl_it *it,
 
     ++rtb->num_lost_pkts;
 
-    ngtcp2_ksl_it_next(it);
+    ngtcp2_rtb_it_next(it);
 
     return 0;
   }
@@ -646,7 +725,7 @@ static int rtb_on_pkt_lost(ngtcp2_rtb *rtb, ngtcp2_ksl_it *it,
 
   ++rtb->num_lost_pkts;
 
-  ngtcp2_ksl_it_next(it);
+  ngtcp2_rtb_it_next(it);
 
   return 0;
 }
@@ -655,7 +734,7 @@ int ngtcp2_rtb_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent,
                    ngtcp2_conn_stat *cstat) {
   int rv;
 
-  rv = ngtcp2_ksl_insert(&rtb->ents, NULL, &ent->hd.pkt_num, ent);
+  rv = rtb_ents_insert(rtb, ent);
   if (rv != 0) {
     return rv;
   }
@@ -665,18 +744,12 @@ int ngtcp2_rtb_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent,
   return 0;
 }
 
-ngtcp2_ksl_it ngtcp2_rtb_head(ngtcp2_rtb *rtb) {
-  return ngtcp2_ksl_begin(&rtb->ents);
-}
+ngtcp2_rtb_it ngtcp2_rtb_head(ngtcp2_rtb *rtb) { return rtb_ents_begin(rtb); }
 
-static void rtb_remove(ngtcp2_rtb *rtb, ngtcp2_ksl_it *it,
+static void rtb_remove(ngtcp2_rtb *rtb, ngtcp2_rtb_it *it,
                        ngtcp2_rtb_entry **pent, ngtcp2_rtb_entry *ent,
                        ngtcp2_conn_stat *cstat) {
-  int rv;
-  (void)rv;
-
-  rv = ngtcp2_ksl_remove_hint(&rtb->ents, it, it, &ent->hd.pkt_num);
-  assert(0 == rv);
+  rtb_ents_remove(rtb, it, ent);
   rtb_on_remove(rtb, ent, cstat);
 
   assert(ent->next == NULL);
@@ -918,7 +991,7 @@ ngtcp2_ssize ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, const ngtcp2_ack *fr,
   int64_t largest_ack = fr->largest_ack, min_ack;
   size_t i;
   int rv;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_ssize num_acked = 0;
   ngtcp2_tstamp largest_pkt_sent_ts = UINT64_MAX;
   ngtcp2_tstamp largest_acked_sent_ts = UINT64_MAX;
@@ -950,8 +1023,8 @@ ngtcp2_ssize ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, const ngtcp2_ack *fr,
   }
 
   /* Assume that ngtcp2_pkt_validate_ack(fr) returns 0 */
-  it = ngtcp2_ksl_lower_bound(&rtb->ents, &largest_ack);
-  if (ngtcp2_ksl_it_end(&it)) {
+  it = rtb_ents_lower_bound(rtb, largest_ack);
+  if (ngtcp2_rtb_it_end(&it)) {
     if (conn && verify_ecn) {
       conn_verify_ecn(conn, pktns, rtb->cc, cstat, fr, ecn_acked,
                       largest_acked_sent_ts, ts);
@@ -961,8 +1034,9 @@ ngtcp2_ssize ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, const ngtcp2_ack *fr,
 
   min_ack = largest_ack - (int64_t)fr->first_ack_blklen;
 
-  for (; !ngtcp2_ksl_it_end(&it);) {
-    pkt_num = *(int64_t *)ngtcp2_ksl_it_key(&it);
+  for (; !ngtcp2_rtb_it_end(&it);) {
+    ent = ngtcp2_rtb_it_get(&it);
+    pkt_num = ent->hd.pkt_num;
 
     assert(pkt_num <= largest_ack);
 
@@ -970,8 +1044,6 @@ ngtcp2_ssize ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, const ngtcp2_ack *fr,
       break;
     }
 
-    ent = ngtcp2_ksl_it_get(&it);
-
     if (largest_ack == pkt_num) {
       largest_pkt_sent_ts = ent->ts;
     }
@@ -988,17 +1060,17 @@ ngtcp2_ssize ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, const ngtcp2_ack *fr,
     largest_ack = min_ack - (int64_t)fr->blks[i].gap - 2;
     min_ack = largest_ack - (int64_t)fr->blks[i].blklen;
 
-    it = ngtcp2_ksl_lower_bound(&rtb->ents, &largest_ack);
-    if (ngtcp2_ksl_it_end(&it)) {
+    it = rtb_ents_lower_bound(rtb, largest_ack);
+    if (ngtcp2_rtb_it_end(&it)) {
       break;
     }
 
-    for (; !ngtcp2_ksl_it_end(&it);) {
-      pkt_num = *(int64_t *)ngtcp2_ksl_it_key(&it);
+    for (; !ngtcp2_rtb_it_end(&it);) {
+      ent = ngtcp2_rtb_it_get(&it);
+      pkt_num = ent->hd.pkt_num;
       if (pkt_num < min_ack) {
         break;
       }
-      ent = ngtcp2_ksl_it_get(&it);
 
       if (ent->flags & NGTCP2_RTB_ENTRY_FLAG_ACK_ELICITING) {
         ack_eliciting_pkt_acked = 1;
@@ -1150,7 +1222,7 @@ static int rtb_detect_lost_pkt(ngtcp2_rtb *rtb, uint64_t *ppkt_lost,
   ngtcp2_rtb_entry *ent;
   ngtcp2_duration loss_delay;
   ngtcp2_tstamp lost_send_time;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_tstamp latest_ts, oldest_ts;
   int64_t last_lost_pkt_num;
   ngtcp2_duration loss_window, congestion_period;
@@ -1169,9 +1241,9 @@ static int rtb_detect_lost_pkt(ngtcp2_rtb *rtb, uint64_t *ppkt_lost,
   loss_delay = compute_pkt_loss_delay(cstat);
   lost_send_time = ts - loss_delay;
 
-  it = ngtcp2_ksl_lower_bound(&rtb->ents, &rtb->largest_acked_tx_pkt_num);
-  for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
-    ent = ngtcp2_ksl_it_get(&it);
+  it = rtb_ents_lower_bound(rtb, rtb->largest_acked_tx_pkt_num);
+  for (; !ngtcp2_rtb_it_end(&it); ngtcp2_rtb_it_next(&it)) {
+    ent = ngtcp2_rtb_it_get(&it);
 
     if (ent->flags & NGTCP2_RTB_ENTRY_FLAG_LOST_RETRANSMITTED) {
       break;
@@ -1191,8 +1263,8 @@ static int rtb_detect_lost_pkt(ngtcp2_rtb *rtb, uint64_t *ppkt_lost,
       start_ts = ngtcp2_max(rtb->persistent_congestion_start_ts,
                             cstat->first_rtt_sample_ts);
 
-      for (; !ngtcp2_ksl_it_end(&it);) {
-        ent = ngtcp2_ksl_it_get(&it);
+      for (; !ngtcp2_rtb_it_end(&it);) {
+        ent = ngtcp2_rtb_it_get(&it);
 
         if (last_lost_pkt_num == ent->hd.pkt_num + 1 && ent->ts >= start_ts) {
           last_lost_pkt_num = ent->hd.pkt_num;
@@ -1207,7 +1279,7 @@ static int rtb_detect_lost_pkt(ngtcp2_rtb *rtb, uint64_t *ppkt_lost,
               latest_ts - oldest_ts >= congestion_period) {
             break;
           }
-          ngtcp2_ksl_it_next(&it);
+          ngtcp2_rtb_it_next(&it);
           continue;
         }
 
@@ -1299,15 +1371,13 @@ int ngtcp2_rtb_detect_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_conn *conn,
 }
 
 void ngtcp2_rtb_remove_excessive_lost_pkt(ngtcp2_rtb *rtb, size_t n) {
-  ngtcp2_ksl_it it = ngtcp2_ksl_end(&rtb->ents);
+  ngtcp2_rtb_it it = rtb_ents_end(rtb);
   ngtcp2_rtb_entry *ent;
-  int rv;
-  (void)rv;
 
   for (; rtb->num_lost_pkts > n;) {
-    assert(ngtcp2_ksl_it_end(&it));
-    ngtcp2_ksl_it_prev(&it);
-    ent = ngtcp2_ksl_it_get(&it);
+    assert(ngtcp2_rtb_it_end(&it));
+    ngtcp2_rtb_it_prev(&it);
+    ent = ngtcp2_rtb_it_get(&it);
 
     assert(ent->flags & NGTCP2_RTB_ENTRY_FLAG_LOST_RETRANSMITTED);
 
@@ -1315,8 +1385,7 @@ void ngtcp2_rtb_remove_excessive_lost_pkt(ngtcp2_rtb *rtb, size_t n) {
                     "removing stale lost pkn=%" PRId64, ent->hd.pkt_num);
 
     --rtb->num_lost_pkts;
-    rv = ngtcp2_ksl_remove_hint(&rtb->ents, &it, &it, &ent->hd.pkt_num);
-    assert(0 == rv);
+    rtb_ents_remove(rtb, &it, ent);
     ngtcp2_rtb_entry_objalloc_del(ent, rtb->rtb_entry_objalloc,
                                   rtb->frc_objalloc, rtb->mem);
   }
@@ -1324,22 +1393,20 @@ void ngtcp2_rtb_remove_excessive_lost_pkt(ngtcp2_rtb *rtb, size_t n) {
 
 void ngtcp2_rtb_remove_expired_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_duration pto,
                                         ngtcp2_tstamp ts) {
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_rtb_entry *ent;
-  int rv;
-  (void)rv;
 
-  if (ngtcp2_ksl_len(&rtb->ents) == 0) {
+  if (rtb_ents_len(rtb) == 0) {
     return;
   }
 
-  it = ngtcp2_ksl_end(&rtb->ents);
+  it = rtb_ents_end(rtb);
 
   for (;;) {
-    assert(ngtcp2_ksl_it_end(&it));
+    assert(ngtcp2_rtb_it_end(&it));
 
-    ngtcp2_ksl_it_prev(&it);
-    ent = ngtcp2_ksl_it_get(&it);
+    ngtcp2_rtb_it_prev(&it);
+    ent = ngtcp2_rtb_it_get(&it);
 
     if (!(ent->flags & NGTCP2_RTB_ENTRY_FLAG_LOST_RETRANSMITTED) ||
         ts - ent->lost_ts < pto) {
@@ -1350,28 +1417,27 @@ void ngtcp2_rtb_remove_expired_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_duration pto,
                     "removing stale lost pkn=%" PRId64, ent->hd.pkt_num);
 
     --rtb->num_lost_pkts;
-    rv = ngtcp2_ksl_remove_hint(&rtb->ents, &it, &it, &ent->hd.pkt_num);
-    assert(0 == rv);
+    rtb_ents_remove(rtb, &it, ent);
     ngtcp2_rtb_entry_objalloc_del(ent, rtb->rtb_entry_objalloc,
                                   rtb->frc_objalloc, rtb->mem);
 
-    if (ngtcp2_ksl_len(&rtb->ents) == 0) {
+    if (rtb_ents_len(rtb) == 0) {
       return;
     }
   }
 }
 
 ngtcp2_tstamp ngtcp2_rtb_lost_pkt_ts(ngtcp2_rtb *rtb) {
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_rtb_entry *ent;
 
-  if (ngtcp2_ksl_len(&rtb->ents) == 0) {
+  if (rtb_ents_len(rtb) == 0) {
     return UINT64_MAX;
   }
 
-  it = ngtcp2_ksl_end(&rtb->ents);
-  ngtcp2_ksl_it_prev(&it);
-  ent = ngtcp2_ksl_it_get(&it);
+  it = rtb_ents_end(rtb);
+  ngtcp2_rtb_it_prev(&it);
+  ent = ngtcp2_rtb_it_get(&it);
 
   if (!(ent->flags & NGTCP2_RTB_ENTRY_FLAG_LOST_RETRANSMITTED)) {
     return UINT64_MAX;
@@ -1515,17 +1581,16 @@ static int rtb_on_pkt_lost_resched_move(ngtcp2_rtb *rtb, ngtcp2_conn *conn,
 int ngtcp2_rtb_remove_all(ngtcp2_rtb *rtb, ngtcp2_conn *conn,
                           ngtcp2_pktns *pktns, ngtcp2_conn_stat *cstat) {
   ngtcp2_rtb_entry *ent;
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   int rv;
 
-  it = ngtcp2_ksl_begin(&rtb->ents);
+  it = rtb_ents_begin(rtb);
 
-  for (; !ngtcp2_ksl_it_end(&it);) {
-    ent = ngtcp2_ksl_it_get(&it);
+  for (; !ngtcp2_rtb_it_end(&it);) {
+    ent = ngtcp2_rtb_it_get(&it);
 
     rtb_on_remove(rtb, ent, cstat);
-    rv = ngtcp2_ksl_remove_hint(&rtb->ents, &it, &it, &ent->hd.pkt_num);
-    assert(0 == rv);
+    rtb_ents_remove(rtb, &it, ent);
 
     rv = rtb_on_pkt_lost_resched_move(rtb, conn, pktns, ent);
     ngtcp2_rtb_entry_objalloc_del(ent, rtb->rtb_entry_objalloc,
@@ -1540,23 +1605,20 @@ int ngtcp2_rtb_remove_all(ngtcp2_rtb *rtb, ngtcp2_conn *conn,
 
 void ngtcp2_rtb_remove_early_data(ngtcp2_rtb *rtb, ngtcp2_conn_stat *cstat) {
   ngtcp2_rtb_entry *ent;
-  ngtcp2_ksl_it it;
-  int rv;
-  (void)rv;
+  ngtcp2_rtb_it it;
 
-  it = ngtcp2_ksl_begin(&rtb->ents);
+  it = rtb_ents_begin(rtb);
 
-  for (; !ngtcp2_ksl_it_end(&it);) {
-    ent = ngtcp2_ksl_it_get(&it);
+  for (; !ngtcp2_rtb_it_end(&it);) {
+    ent = ngtcp2_rtb_it_get(&it);
 
     if (ent->hd.type != NGTCP2_PKT_0RTT) {
-      ngtcp2_ksl_it_next(&it);
+      ngtcp2_rtb_it_next(&it);
       continue;
     }
 
     rtb_on_remove(rtb, ent, cstat);
-    rv = ngtcp2_ksl_remove_hint(&rtb->ents, &it, &it, &ent->hd.pkt_num);
-    assert(0 == rv);
+    rtb_ents_remove(rtb, &it, ent);
 
     ngtcp2_rtb_entry_objalloc_del(ent, rtb->rtb_entry_objalloc,
                                   rtb->frc_objalloc, rtb->mem);
@@ -1564,7 +1626,7 @@ void ngtcp2_rtb_remove_early_data(ngtcp2_rtb *rtb, ngtcp2_conn_stat *cstat) {
 }
 
 int ngtcp2_rtb_empty(ngtcp2_rtb *rtb) {
-  return ngtcp2_ksl_len(&rtb->ents) == 0;
+  return rtb_ents_len(rtb) == 0;
 }
 
 void ngtcp2_rtb_reset_cc_state(ngtcp2_rtb *rtb, int64_t cc_pkt_num) {
@@ -1574,15 +1636,15 @@ void ngtcp2_rtb_reset_cc_state(ngtcp2_rtb *rtb, int64_t cc_pkt_num) {
 
 ngtcp2_ssize ngtcp2_rtb_reclaim_on_pto(ngtcp2_rtb *rtb, ngtcp2_conn *conn,
                                        ngtcp2_pktns *pktns, size_t num_pkts) {
-  ngtcp2_ksl_it it;
+  ngtcp2_rtb_it it;
   ngtcp2_rtb_entry *ent;
   ngtcp2_ssize reclaimed;
   size_t atmost = num_pkts;
 
-  it = ngtcp2_ksl_end(&rtb->ents);
-  for (; !ngtcp2_ksl_it_begin(&it) && num_pkts >= 1;) {
-    ngtcp2_ksl_it_prev(&it);
-    ent = ngtcp2_ksl_it_get(&it);
+  it = rtb_ents_end(rtb);
+  for (; !ngtcp2_rtb_it_begin(&it) && num_pkts >= 1;) {
+    ngtcp2_rtb_it_prev(&it);
+    ent = ngtcp2_rtb_it_get(&it);
 
     if ((ent->flags & (NGTCP2_RTB_ENTRY_FLAG_LOST_RETRANSMITTED |
                        NGTCP2_RTB_ENTRY_FLAG_PTO_RECLAIMED)) ||
@@ -33,6 +33,7 @@
 
 #include "ngtcp2_pkt.h"
 #include "ngtcp2_ksl.h"
+#include "ngtcp2_pnring.h"
 #include "ngtcp2_pq.h"
 #include "ngtcp2_objalloc.h"
 
@@ -290,6 +291,30 @@ void ngtcp2_rtb_entry_objalloc_del(ngtcp2_rtb_entry *ent,
                                    ngtcp2_objalloc *frc_objalloc,
                                    const ngtcp2_mem *mem);
 
+/*
+ * ngtcp2_rtb_it is an iterator over the entries of ngtcp2_rtb in
+ * decreasing order of packet number.  The entries are stored in
+ * ngtcp2_pnring if ENABLE_RTB_PNRING is defined, otherwise in
+ * ngtcp2_ksl.
+ */
+#ifdef ENABLE_RTB_PNRING
+typedef ngtcp2_pnring_it ngtcp2_rtb_it;
+
+#  define ngtcp2_rtb_it_get(IT) ngtcp2_pnring_it_get(IT)
+#  define ngtcp2_rtb_it_next(IT) ngtcp2_pnring_it_next(IT)
+#  define ngtcp2_rtb_it_prev(IT) ngtcp2_pnring_it_prev(IT)
+#  define ngtcp2_rtb_it_end(IT) ngtcp2_pnring_it_end(IT)
+#  define ngtcp2_rtb_it_begin(IT) ngtcp2_pnring_it_begin(IT)
+#else /* !ENABLE_RTB_PNRING */
+typedef ngtcp2_ksl_it ngtcp2_rtb_it;
+
+#  define ngtcp2_rtb_it_get(IT) ngtcp2_ksl_it_get(IT)
+#  define ngtcp2_rtb_it_next(IT) ngtcp2_ksl_it_next(IT)
+#  define ngtcp2_rtb_it_prev(IT) ngtcp2_ksl_it_prev(IT)
+#  define ngtcp2_rtb_it_end(IT) ngtcp2_ksl_it_end(IT)
+#  define ngtcp2_rtb_it_begin(IT) ngtcp2_ksl_it_begin(IT)
+#endif /* !ENABLE_RTB_PNRING */
+
 /*
  * ngtcp2_rtb tracks sent packets, and its ACK timeout for
  * retransmission.
@@ -299,7 +324,11 @@ typedef struct ngtcp2_rtb {
   ngtcp2_objalloc *rtb_entry_objalloc;
   /* ents includes ngtcp2_rtb_entry sorted by decreasing order of
      packet number. */
+#ifdef ENABLE_RTB_PNRING
+  ngtcp2_pnring ents;
+#else  /* !ENABLE_RTB_PNRING */
   ngtcp2_ksl ents;
+#endif /* !ENABLE_RTB_PNRING */
   /* crypto is CRYPTO stream. */
   ngtcp2_strm *crypto;
   ngtcp2_rst *rst;
@@ -367,9 +396,9 @@ int ngtcp2_rtb_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent,
 /*
  * ngtcp2_rtb_head returns the iterator which points to the entry
  * which has the largest packet number.  If there is no entry,
- * returned value satisfies ngtcp2_ksl_it_end(&it) != 0.
+ * returned value satisfies ngtcp2_rtb_it_end(&it) != 0.
  */
-ngtcp2_ksl_it ngtcp2_rtb_head(ngtcp2_rtb *rtb);
+ngtcp2_rtb_it ngtcp2_rtb_head(ngtcp2_rtb *rtb);
 
 /*
  * ngtcp2_rtb_recv_ack removes acked ngtcp2_rtb_entry from |rtb|.
@@ -109,34 +109,50 @@ static int strm_rob_init(ngtcp2_strm *strm) {
 }
 
 uint64_t ngtcp2_strm_rx_offset(ngtcp2_strm *strm) {
-  if (strm->rx.rob == NULL) {
+  if (!(strm->flags & NGTCP2_STRM_FLAG_RX_REORDERING)) {
     return strm->rx.cont_offset;
   }
   return ngtcp2_rob_first_gap_offset(strm->rx.rob);
 }
 
+int ngtcp2_strm_rx_reordering(ngtcp2_strm *strm) {
+  return (strm->flags & NGTCP2_STRM_FLAG_RX_REORDERING) != 0;
+}
+
 /* strm_rob_heavily_fragmented returns nonzero if the number of gaps
    in |rob| exceeds the limit. */
 static int strm_rob_heavily_fragmented(ngtcp2_rob *rob) {
   return ngtcp2_ksl_len(&rob->gapksl) >= 1000;
 }
 
+/* strm_rob_drained returns nonzero if |rob| has no buffered data and
+   its only gap is the one which extends to the end of stream. */
+static int strm_rob_drained(ngtcp2_rob *rob) {
+  return !ngtcp2_rob_data_buffered(rob) && ngtcp2_ksl_len(&rob->gapksl) == 1;
+}
+
 int ngtcp2_strm_recv_reordering(ngtcp2_strm *strm, const uint8_t *data,
                                 size_t datalen, uint64_t offset) {
   int rv;
 
-  if (strm->rx.rob == NULL) {
-    rv = strm_rob_init(strm);
-    if (rv != 0) {
-      return rv;
+  if (!(strm->flags & NGTCP2_STRM_FLAG_RX_REORDERING)) {
+    if (strm->rx.rob == NULL) {
+      rv = strm_rob_init(strm);
+      if (rv != 0) {
+        return rv;
+      }
     }
 
+    /* rob which is reused still has the gap starting at the offset
+       where it was drained, which is not larger than cont_offset. */
     if (strm->rx.cont_offset) {
       rv = ngtcp2_rob_remove_prefix(strm->rx.rob, strm->rx.cont_offset);
       if (rv != 0) {
         return rv;
       }
     }
+
+    strm->flags |= NGTCP2_STRM_FLAG_RX_REORDERING;
   }
 
   if (strm_rob_heavily_fragmented(strm->rx.rob)) {
@@ -147,12 +163,28 @@ int ngtcp2_strm_recv_reordering(ngtcp2_strm *strm, const uint8_t *data,
 }
 
 int ngtcp2_strm_update_rx_offset(ngtcp2_strm *strm, uint64_t offset) {
-  if (strm->rx.rob == NULL) {
+  int rv;
+
+  if (!(strm->flags & NGTCP2_STRM_FLAG_RX_REORDERING)) {
     strm->rx.cont_offset = offset;
     return 0;
   }
 
-  return ngtcp2_rob_remove_prefix(strm->rx.rob, offset);
+  rv = ngtcp2_rob_remove_prefix(strm->rx.rob, offset);
+  if (rv != 0) {
+    return rv;
+  }
+
+  /* All gaps are filled and buffered data has been consumed.  Further
+     in-order data does not have to go through rob. */
+  if (strm_rob_drained(strm->rx.rob)) {
+    assert(ngtcp2_rob_first_gap_offset(strm->rx.rob) == offset);
+
+    strm->rx.cont_offset = offset;
+    strm->flags &= (uint32_t)~NGTCP2_STRM_FLAG_RX_REORDERING;
+  }
+
+  return 0;
 }
 
 void ngtcp2_strm_shutdown(ngtcp2_strm *strm, uint32_t flags) {
@@ -165,7 +197,8 @@ static int strm_streamfrq_init(ngtcp2_strm *strm) {
     return NGTCP2_ERR_NOMEM;
   }
 
-  ngtcp2_ksl_init(streamfrq, offset_less, sizeof(uint64_t), strm->mem);
+  ngtcp2_ksl_init(streamfrq, offset_less, ngtcp2_ksl_int64_less_search,
+                  sizeof(uint64_t), strm->mem);
 
   strm->tx.streamfrq = streamfrq;
 
@@ -78,6 +78,10 @@ typedef struct ngtcp2_frame_chain ngtcp2_frame_chain;
 /* NGTCP2_STRM_FLAG_STREAM_STOP_SENDING_CALLED is set when
    stream_stop_sending callback is called. */
 #define NGTCP2_STRM_FLAG_STREAM_STOP_SENDING_CALLED 0x200
+/* NGTCP2_STRM_FLAG_RX_REORDERING indicates that rx.rob tracks the
+   offset and data of incoming stream data.  If it is not set,
+   rx.cont_offset is used even if rx.rob is allocated. */
+#define NGTCP2_STRM_FLAG_RX_REORDERING 0x400
 
 typedef struct ngtcp2_strm ngtcp2_strm;
 
@@ -119,8 +123,12 @@ struct ngtcp2_strm {
            in this object. */
         ngtcp2_rob *rob;
         /* cont_offset is the largest offset of consecutive data.  It is
-           used until the endpoint receives out-of-order data.  After
-           that, rob is used to track the offset and data. */
+           used while NGTCP2_STRM_FLAG_RX_REORDERING is not set.  The
+           flag is set when the endpoint receives out-of-order data,
+           and rob is used to track the offset and data until all gaps
+           before the last received data are filled.  rob is kept
+           allocated after that so that it can be reused for the next
+           out-of-order data. */
         uint64_t cont_offset;
         /* last_offset is the largest offset of stream data received for
            this stream. */
@@ -173,6 +181,12 @@ void ngtcp2_strm_free(ngtcp2_strm *strm);
  */
 uint64_t ngtcp2_strm_rx_offset(ngtcp2_strm *strm);
 
+/*
+ * ngtcp2_strm_rx_reordering returns nonzero if rx.rob tracks the
+ * incoming stream data of |strm|.
+ */
+int ngtcp2_strm_rx_reordering(ngtcp2_strm *strm);
+
 /*
  * ngtcp2_strm_recv_reordering handles reordered data.
  *
@@ -187,7 +201,9 @@ int ngtcp2_strm_recv_reordering(ngtcp2_strm *strm, const uint8_t *data,
 
 /*
  * ngtcp2_strm_update_rx_offset tells that data up to offset bytes are
- * received in order.
+ * received in order.  If rob has no gap before |offset| and no
+ * buffered data beyond it, |strm| goes back to tracking the offset in
+ * rx.cont_offset.
  *
  * NGTCP2_ERR_NOMEM
  *     Out of memory
@@ -0,0 +1,233 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark for the variable-length integer helpers in
+ * ngtcp2_conv.c and for ngtcp2_pkt_decode_ack_frame.  The
+ * compare-chain encoder which ngtcp2_put_varint replaced is measured
+ * alongside it, so one run shows both sides of the change.
+ *
+ * Usage: ngtcp2_conv_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ngtcp2_conv.h"
+#include "ngtcp2_pkt.h"
+
+/* Keep the reference encoder out of line, like the library functions
+   it is compared with. */
+#if defined(__GNUC__)
+#  define BENCH_NOINLINE __attribute__((noinline))
+#else
+#  define BENCH_NOINLINE
+#endif
+
+#define N_VALUES 4096
+#define N_VARINT_ROUNDS 2000
+#define N_ACK_ROUNDS 2000000
+
+static double now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ref_put_varint is the compare-chain encoder ngtcp2_put_varint replaced. */
+BENCH_NOINLINE static uint8_t *ref_put_varint(uint8_t *p, uint64_t n) {
+  if (n < 64) {
+    *p++ = (uint8_t)n;
+    return p;
+  }
+  if (n < 16384) {
+    p = ngtcp2_put_uint16be(p, (uint16_t)n);
+    *(p - 2) |= 0x40;
+    return p;
+  }
+  if (n < 1073741824) {
+    p = ngtcp2_put_uint32be(p, (uint32_t)n);
+    *(p - 4) |= 0x80;
+    return p;
+  }
+  p = ngtcp2_put_uint64be(p, n);
+  *(p - 8) |= 0xc0;
+  return p;
+}
+
+BENCH_NOINLINE static size_t ref_put_varint_len(uint64_t n) {
+  if (n < 64) {
+    return 1;
+  }
+  if (n < 16384) {
+    return 2;
+  }
+  if (n < 1073741824) {
+    return 4;
+  }
+  return 8;
+}
+
+static void report(const char *name, double t, double n) {
+  printf("%-32s %8.2f ns\n", name, t / n);
+}
+
+int main(void) {
+  static uint64_t vals[N_VALUES], out[N_VALUES];
+  static uint8_t enc[N_VALUES * 8 + 8];
+  static union {
+    ngtcp2_ack ack;
+    uint8_t buf[sizeof(ngtcp2_ack) +
+                sizeof(ngtcp2_ack_blk) * (NGTCP2_MAX_ACK_BLKS - 1)];
+  } ack;
+  uint8_t frame[1024];
+  volatile uint64_t sink = 0;
+  const uint8_t *cp;
+  uint8_t *p;
+  uint64_t sum;
+  size_t i, r, len, framelen;
+  double t;
+
+  srand(1);
+
+  /* An even mix of the four encoded lengths. */
+  for (i = 0; i < N_VALUES; ++i) {
+    switch (rand() % 4) {
+    case 0:
+      vals[i] = (uint64_t)(rand() % 64);
+      break;
+    case 1:
+      vals[i] = (uint64_t)(rand() % 16384);
+      break;
+    case 2:
+      vals[i] = (uint64_t)rand() % 1073741824;
+      break;
+    default:
+      vals[i] = (uint64_t)rand() << 31 | (uint64_t)rand();
+      break;
+    }
+  }
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    p = enc;
+    for (i = 0; i < N_VALUES; ++i) {
+      p = ref_put_varint(p, vals[i]);
+    }
+    sink += p[-1];
+  }
+  report("put_varint (compare chain)", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    p = enc;
+    for (i = 0; i < N_VALUES; ++i) {
+      p = ngtcp2_put_varint(p, vals[i]);
+    }
+    sink += p[-1];
+  }
+  report("ngtcp2_put_varint", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    len = 0;
+    for (i = 0; i < N_VALUES; ++i) {
+      len += ref_put_varint_len(vals[i] ^ r);
+    }
+    sink += len;
+  }
+  report("put_varint_len (compare chain)", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    len = 0;
+    for (i = 0; i < N_VALUES; ++i) {
+      len += ngtcp2_put_varint_len(vals[i] ^ r);
+    }
+    sink += len;
+  }
+  report("ngtcp2_put_varint_len", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    cp = enc;
+    sum = 0;
+    for (i = 0; i < N_VALUES; ++i) {
+      sum += ngtcp2_get_varint(&len, cp);
+      cp += len;
+    }
+    sink += sum;
+  }
+  report("ngtcp2_get_varint", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  t = now_ns();
+  for (r = 0; r < N_VARINT_ROUNDS; ++r) {
+    ngtcp2_get_varints(out, N_VALUES, enc, enc + sizeof(enc));
+    sink += out[r % N_VALUES];
+  }
+  report("ngtcp2_get_varints", now_ns() - t,
+         (double)N_VARINT_ROUNDS * N_VALUES);
+
+  /* A typical ACK frame: 32 ranges with small gaps and lengths. */
+  p = frame;
+  *p++ = NGTCP2_FRAME_ACK;
+  p = ngtcp2_put_varint(p, 123456);
+  p = ngtcp2_put_varint(p, 25);
+  p = ngtcp2_put_varint(p, 32);
+  p = ngtcp2_put_varint(p, 3);
+  for (i = 0; i < 64; ++i) {
+    p = ngtcp2_put_varint(p, (uint64_t)(rand() % 200));
+  }
+  framelen = (size_t)(p - frame);
+
+  t = now_ns();
+  for (r = 0; r < N_ACK_ROUNDS; ++r) {
+    sink += (uint64_t)ngtcp2_pkt_decode_ack_frame(&ack.ack, frame, framelen);
+  }
+  report("decode ACK (32 ranges)", now_ns() - t, N_ACK_ROUNDS);
+
+  p = frame;
+  *p++ = NGTCP2_FRAME_ACK;
+  p = ngtcp2_put_varint(p, 123456);
+  p = ngtcp2_put_varint(p, 25);
+  p = ngtcp2_put_varint(p, 0);
+  p = ngtcp2_put_varint(p, 3);
+  framelen = (size_t)(p - frame);
+
+  t = now_ns();
+  for (r = 0; r < N_ACK_ROUNDS; ++r) {
+    sink += (uint64_t)ngtcp2_pkt_decode_ack_frame(&ack.ack, frame, framelen);
+  }
+  report("decode ACK (0 ranges)", now_ns() - t, N_ACK_ROUNDS);
+
+  return sink == 0;
+}
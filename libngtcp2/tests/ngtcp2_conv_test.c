@@ -0,0 +1,318 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Randomized equivalence tests for the variable-length integer
+ * helpers in ngtcp2_conv.c and for ngtcp2_pkt_decode_ack_frame.
+ *
+ * - ngtcp2_get_varint_padded and ngtcp2_get_varints must agree with
+ *   ngtcp2_get_varint.
+ * - ngtcp2_put_varint and ngtcp2_put_varint_len must agree with the
+ *   compare-chain encoder they replaced (ref_put_varint below).
+ * - ngtcp2_pkt_decode_ack_frame must decode every well-formed ACK
+ *   frame exactly and reject every truncation of it without reading
+ *   past the end of the input.  Inputs are copied to exact-size heap
+ *   buffers so that a sanitizer build catches over-reads.
+ *
+ * Usage: ngtcp2_conv_test [SEED]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngtcp2_conv.h"
+#include "ngtcp2_pkt.h"
+
+#define N_VARINT_ROUNDS 1000000
+#define N_ACK_ROUNDS 100000
+#define MAX_TEST_ACK_BLKS 40
+
+static int failures;
+
+#define CHECK(COND)                                                            \
+  do {                                                                         \
+    if (!(COND)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #COND); \
+      if (++failures > 10) {                                                   \
+        exit(EXIT_FAILURE);                                                    \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/* xorshift64*, so that a seed reproduces the same inputs everywhere. */
+static uint64_t rng_state;
+
+static uint64_t rnd64(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static size_t rnd(size_t n) { return (size_t)(rnd64() % n); }
+
+/*
+ * rnd_varint returns a value which is spread over all four encoded
+ * lengths, with extra weight on the boundaries between them.
+ */
+static uint64_t rnd_varint(void) {
+  switch (rnd(5)) {
+  case 0:
+    return rnd64() % 64;
+  case 1:
+    return rnd64() % 16384;
+  case 2:
+    return rnd64() % 1073741824;
+  case 3:
+    return rnd64() % 4611686018427387904ULL;
+  default:
+    return (1ULL << rnd(62)) - rnd(2);
+  }
+}
+
+/* ref_put_varint is the compare-chain encoder ngtcp2_put_varint replaced. */
+static uint8_t *ref_put_varint(uint8_t *p, uint64_t n) {
+  size_t len, i;
+  uint8_t prefix;
+
+  if (n < 64) {
+    len = 1;
+    prefix = 0x00;
+  } else if (n < 16384) {
+    len = 2;
+    prefix = 0x40;
+  } else if (n < 1073741824) {
+    len = 4;
+    prefix = 0x80;
+  } else {
+    len = 8;
+    prefix = 0xc0;
+  }
+
+  for (i = 0; i < len; ++i) {
+    p[i] = (uint8_t)(n >> (8 * (len - 1 - i)));
+  }
+  p[0] |= prefix;
+
+  return p + len;
+}
+
+static void test_put_varint(void) {
+  uint8_t buf[16], ref[16];
+  uint8_t *end, *ref_end;
+  uint64_t n;
+  size_t i;
+
+  for (i = 0; i < N_VARINT_ROUNDS; ++i) {
+    n = rnd_varint();
+
+    end = ngtcp2_put_varint(buf, n);
+    ref_end = ref_put_varint(ref, n);
+
+    CHECK(end - buf == ref_end - ref);
+    CHECK(memcmp(buf, ref, (size_t)(ref_end - ref)) == 0);
+    CHECK(ngtcp2_put_varint_len(n) == (size_t)(ref_end - ref));
+  }
+}
+
+static void test_get_varint(void) {
+  uint8_t buf[16];
+  uint8_t *end;
+  uint64_t n, m;
+  size_t i, len, padded_len;
+
+  for (i = 0; i < N_VARINT_ROUNDS; ++i) {
+    n = rnd_varint();
+    end = ref_put_varint(buf, n);
+
+    /* The bytes after the integer must not change the result. */
+    memset(end, (int)rnd(256), sizeof(buf) - (size_t)(end - buf));
+
+    m = ngtcp2_get_varint(&len, buf);
+    CHECK(m == n);
+    CHECK(len == (size_t)(end - buf));
+    CHECK(ngtcp2_get_varint_len(buf) == len);
+
+    CHECK(ngtcp2_get_varint_padded(&padded_len, buf) == n);
+    CHECK(padded_len == len);
+  }
+}
+
+static void test_get_varints(void) {
+  uint64_t vals[64], out[64];
+  uint8_t enc[64 * 8];
+  uint8_t *heap;
+  const uint8_t *p, *q;
+  size_t i, k, n, encodedlen, pos, len;
+
+  for (i = 0; i < N_VARINT_ROUNDS / 64; ++i) {
+    n = 1 + rnd(64);
+
+    p = enc;
+    for (k = 0; k < n; ++k) {
+      vals[k] = rnd_varint();
+      p = ref_put_varint((uint8_t *)p, vals[k]);
+    }
+    encodedlen = (size_t)(p - enc);
+
+    heap = malloc(encodedlen);
+    memcpy(heap, enc, encodedlen);
+
+    /* The whole buffer: every value matches ngtcp2_get_varint. */
+    memset(out, 0, sizeof(out));
+    q = ngtcp2_get_varints(out, n, heap, heap + encodedlen);
+    CHECK(q == heap + encodedlen);
+
+    for (k = 0, pos = 0; k < n; ++k, pos += len) {
+      CHECK(out[k] == ngtcp2_get_varint(&len, enc + pos));
+      CHECK(out[k] == vals[k]);
+    }
+
+    /* Any shorter buffer must be rejected. */
+    len = rnd(encodedlen);
+    CHECK(ngtcp2_get_varints(out, n, heap, heap + len) == NULL);
+
+    free(heap);
+  }
+}
+
+/*
+ * encode_ack writes an ACK or ACK_ECN frame with |num_blks| random
+ * ranges to |buf|, records the encoded values in |fr|, and returns the
+ * length of the frame.
+ */
+static size_t encode_ack(uint8_t *buf, ngtcp2_ack *fr, size_t num_blks) {
+  uint8_t *p = buf;
+  ngtcp2_ack_blk *blks = fr->blks;
+  size_t i;
+
+  fr->type = rnd(2) ? NGTCP2_FRAME_ACK_ECN : NGTCP2_FRAME_ACK;
+  fr->largest_ack = (int64_t)rnd_varint();
+  fr->ack_delay = rnd_varint();
+  fr->first_ack_blklen = rnd_varint();
+  fr->num_blks = num_blks;
+
+  *p++ = fr->type;
+  p = ref_put_varint(p, (uint64_t)fr->largest_ack);
+  p = ref_put_varint(p, fr->ack_delay);
+  p = ref_put_varint(p, num_blks);
+  p = ref_put_varint(p, fr->first_ack_blklen);
+
+  for (i = 0; i < num_blks; ++i) {
+    blks[i].gap = rnd_varint();
+    blks[i].blklen = rnd_varint();
+    p = ref_put_varint(p, blks[i].gap);
+    p = ref_put_varint(p, blks[i].blklen);
+  }
+
+  if (fr->type == NGTCP2_FRAME_ACK_ECN) {
+    fr->ecn.ect0 = rnd_varint();
+    fr->ecn.ect1 = rnd_varint();
+    fr->ecn.ce = rnd_varint();
+    p = ref_put_varint(p, fr->ecn.ect0);
+    p = ref_put_varint(p, fr->ecn.ect1);
+    p = ref_put_varint(p, fr->ecn.ce);
+  }
+
+  return (size_t)(p - buf);
+}
+
+static void test_decode_ack_frame(void) {
+  static union {
+    ngtcp2_ack ack;
+    uint8_t buf[sizeof(ngtcp2_ack) +
+                sizeof(ngtcp2_ack_blk) * (MAX_TEST_ACK_BLKS - 1)];
+  } expected, decoded;
+  uint8_t frame[1 + 8 * (5 + 2 * MAX_TEST_ACK_BLKS + 3)];
+  const ngtcp2_ack_blk *expected_blks = expected.ack.blks;
+  const ngtcp2_ack_blk *decoded_blks = decoded.ack.blks;
+  uint8_t *heap;
+  size_t i, k, framelen, num_blks, truncated;
+  ngtcp2_ssize rv;
+
+  for (i = 0; i < N_ACK_ROUNDS; ++i) {
+    num_blks = rnd(4) ? rnd(4) : rnd(NGTCP2_MAX_ACK_BLKS + 1);
+    framelen = encode_ack(frame, &expected.ack, num_blks);
+
+    heap = malloc(framelen);
+    memcpy(heap, frame, framelen);
+
+    memset(&decoded, 0, sizeof(decoded));
+    rv = ngtcp2_pkt_decode_ack_frame(&decoded.ack, heap, framelen);
+    CHECK(rv == (ngtcp2_ssize)framelen);
+
+    if (rv > 0) {
+      CHECK(decoded.ack.type == expected.ack.type);
+      CHECK(decoded.ack.largest_ack == expected.ack.largest_ack);
+      CHECK(decoded.ack.ack_delay == expected.ack.ack_delay);
+      CHECK(decoded.ack.first_ack_blklen == expected.ack.first_ack_blklen);
+      CHECK(decoded.ack.num_blks == expected.ack.num_blks);
+
+      for (k = 0; k < num_blks; ++k) {
+        CHECK(decoded_blks[k].gap == expected_blks[k].gap);
+        CHECK(decoded_blks[k].blklen == expected_blks[k].blklen);
+      }
+
+      if (expected.ack.type == NGTCP2_FRAME_ACK_ECN) {
+        CHECK(decoded.ack.ecn.ect0 == expected.ack.ecn.ect0);
+        CHECK(decoded.ack.ecn.ect1 == expected.ack.ecn.ect1);
+        CHECK(decoded.ack.ecn.ce == expected.ack.ecn.ce);
+      }
+    }
+
+    free(heap);
+
+    /* Every truncation of the frame is an encoding error. */
+    truncated = rnd(framelen);
+    heap = malloc(truncated ? truncated : 1);
+    memcpy(heap, frame, truncated);
+
+    rv = ngtcp2_pkt_decode_ack_frame(&decoded.ack, heap, truncated);
+    CHECK(rv == NGTCP2_ERR_FRAME_ENCODING);
+
+    free(heap);
+  }
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  rng_state = seed ? seed : 1;
+
+  test_put_varint();
+  test_get_varint();
+  test_get_varints();
+  test_decode_ack_frame();
+
+  if (failures) {
+    fprintf(stderr, "ngtcp2_conv_test: %d failure(s), seed = %llu\n",
+            failures, (unsigned long long)seed);
+    return EXIT_FAILURE;
+  }
+
+  printf("ngtcp2_conv_test: ok, seed = %llu\n", (unsigned long long)seed);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark of the ngtcp2_ksl search functions, for each container
+ * which keeps its entries in ngtcp2_ksl.  Each container is modeled
+ * by its key type, the ngtcp2_ksl_compar and search it uses, and the
+ * order in which it inserts and looks up keys:
+ *
+ * - rtb: packet numbers sorted in descending order (also used by
+ *   pnring for out-of-order entries);
+ * - frq: stream and crypto frame offsets sorted in ascending order;
+ * - rob/gaptr: non-overlapping ranges found by their begin;
+ * - rob/gaptr excl: the same ranges found by
+ *   ngtcp2_ksl_range_exclusive_search, which returns the first range
+ *   which overlaps the query;
+ * - scid: connection IDs, which have no typed search and always use
+ *   compar.
+ *
+ * For each number of entries it measures, in ns per operation,
+ * inserting all keys into an empty skip list and looking up random
+ * keys (best of 3 runs each), with each search a block can be searched
+ * by:
+ *
+ * - compar: the linear search which calls compar for each key, which
+ *   is what ngtcp2_ksl uses if no typed search is given;
+ * - scalar: the typed search function;
+ * - avx2: its AVX2 variant, if the CPU supports AVX2.
+ *
+ * Usage: ngtcp2_ksl_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ngtcp2_ksl.h"
+#include "ngtcp2_range.h"
+#include "ngtcp2_cid.h"
+
+#define N_INSERTS 1000000
+#define N_QUERIES 2000000
+#define N_RUNS 3
+#define MAX_KEYLEN sizeof(ngtcp2_cid)
+
+static double now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 1;
+
+static uint64_t rnd64(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static size_t rnd(size_t n) { return (size_t)(rnd64() % n); }
+
+static int int64_greater(const ngtcp2_ksl_key *lhs,
+                         const ngtcp2_ksl_key *rhs) {
+  return *(const int64_t *)lhs > *(const int64_t *)rhs;
+}
+
+static int int64_less(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
+  return *(const int64_t *)lhs < *(const int64_t *)rhs;
+}
+
+static int cid_less(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
+  return ngtcp2_cid_less(lhs, rhs);
+}
+
+/* Packets are sent in packet number order. */
+static void gen_pkt_num(void *key, size_t i) { *(int64_t *)key = (int64_t)i; }
+
+/* Frames are queued in offset order. */
+static void gen_offset(void *key, size_t i) {
+  *(int64_t *)key = (int64_t)i * 1200;
+}
+
+/* The gaps and the buffered data of rob are separated ranges. */
+static void gen_range(void *key, size_t i) {
+  ngtcp2_range *r = key;
+
+  r->begin = (uint64_t)i * 2400;
+  r->end = r->begin + 1200;
+}
+
+static void gen_cid(void *key, size_t i) {
+  uint8_t data[NGTCP2_MAX_CIDLEN];
+  size_t j;
+  (void)i;
+
+  for (j = 0; j < sizeof(data); ++j) {
+    data[j] = (uint8_t)rnd64();
+  }
+
+  ngtcp2_cid_init(key, data, sizeof(data));
+}
+
+/* A query for a range is the received (or acknowledged) data. */
+static void query_range(void *query, const void *key) {
+  const ngtcp2_range *r = key;
+  ngtcp2_range *q = query;
+
+  q->begin = r->begin + rnd(2400);
+  q->end = q->begin + 1200;
+}
+
+static void query_key(void *query, const void *key) {
+  memcpy(query, key, MAX_KEYLEN);
+}
+
+typedef struct container {
+  const char *name;
+  ngtcp2_ksl_compar compar;
+  /* search is the typed search the container passes to
+     ngtcp2_ksl_init, or NULL. */
+  ngtcp2_ksl_search search;
+  /* lookup_compar and lookup_search are used for lookup.  They
+     differ from compar and search if the container looks up keys
+     with ngtcp2_ksl_lower_bound_search. */
+  ngtcp2_ksl_compar lookup_compar;
+  ngtcp2_ksl_search lookup_search;
+  size_t keylen;
+  void (*gen_key)(void *key, size_t i);
+  void (*gen_query)(void *query, const void *key);
+} container;
+
+static const container containers[] = {
+    {"rtb", int64_greater, ngtcp2_ksl_int64_greater_search, int64_greater,
+     ngtcp2_ksl_int64_greater_search, sizeof(int64_t), gen_pkt_num, query_key},
+    {"frq", int64_less, ngtcp2_ksl_int64_less_search, int64_less,
+     ngtcp2_ksl_int64_less_search, sizeof(int64_t), gen_offset, query_key},
+    {"rob/gaptr", ngtcp2_ksl_range_compar, ngtcp2_ksl_range_search,
+     ngtcp2_ksl_range_compar, ngtcp2_ksl_range_search, sizeof(ngtcp2_range),
+     gen_range, query_range},
+    {"rob/gaptr excl", ngtcp2_ksl_range_compar, ngtcp2_ksl_range_search,
+     ngtcp2_ksl_range_exclusive_compar, ngtcp2_ksl_range_exclusive_search,
+     sizeof(ngtcp2_range), gen_range, query_range},
+    {"scid", cid_less, NULL, cid_less, NULL, sizeof(ngtcp2_cid), gen_cid,
+     query_key},
+};
+
+typedef enum mode {
+  MODE_COMPAR,
+  MODE_SCALAR,
+  MODE_AVX2,
+} mode;
+
+static const char *const mode_names[] = {"compar", "scalar", "avx2"};
+
+/*
+ * mode_search returns the function which searches a block for |mode|,
+ * or NULL if |mode| is not available for |search|.
+ */
+static ngtcp2_ksl_search mode_search(mode m, ngtcp2_ksl_compar compar,
+                                     ngtcp2_ksl_search search) {
+  ngtcp2_ksl ksl;
+
+  switch (m) {
+  case MODE_COMPAR:
+    /* ngtcp2_ksl_init picks the compar search if search is NULL. */
+    ngtcp2_ksl_init(&ksl, compar, NULL, sizeof(int64_t),
+                    ngtcp2_mem_default());
+    search = ksl.search;
+    ngtcp2_ksl_free(&ksl);
+    return search;
+  case MODE_SCALAR:
+    return search;
+  default:
+    return search ? ngtcp2_ksl_avx2_search(search) : NULL;
+  }
+}
+
+static void bench(const container *c, size_t n, mode m) {
+  static uint8_t queries[N_QUERIES * MAX_KEYLEN];
+  ngtcp2_ksl_search search = mode_search(m, c->compar, c->search);
+  ngtcp2_ksl_search lookup_search =
+      mode_search(m, c->lookup_compar, c->lookup_search);
+  volatile size_t sink = 0;
+  uint8_t *keys;
+  ngtcp2_ksl ksl;
+  ngtcp2_ksl_it it;
+  size_t i, rep, nrep = (N_INSERTS + n - 1) / n, run;
+  double t, t_insert = 1e300, t_lookup = 1e300, x;
+
+  if (search == NULL || lookup_search == NULL) {
+    return;
+  }
+
+  keys = malloc(n * MAX_KEYLEN);
+  if (keys == NULL) {
+    abort();
+  }
+
+  for (i = 0; i < n; ++i) {
+    c->gen_key(keys + i * MAX_KEYLEN, i);
+  }
+
+  for (i = 0; i < N_QUERIES; ++i) {
+    c->gen_query(queries + i * MAX_KEYLEN, keys + rnd(n) * MAX_KEYLEN);
+  }
+
+  for (run = 0; run < N_RUNS; ++run) {
+    x = 0;
+
+    for (rep = 0; rep < nrep; ++rep) {
+      ngtcp2_ksl_init(&ksl, c->compar, c->search, c->keylen,
+                      ngtcp2_mem_default());
+      ksl.search = search;
+
+      t = now_ns();
+      for (i = 0; i < n; ++i) {
+        ngtcp2_ksl_insert(&ksl, NULL, keys + i * MAX_KEYLEN, NULL);
+      }
+      x += now_ns() - t;
+
+      if (run + 1 < N_RUNS || rep + 1 < nrep) {
+        ngtcp2_ksl_free(&ksl);
+      }
+    }
+
+    if (x < t_insert) {
+      t_insert = x;
+    }
+  }
+
+  /* ngtcp2_ksl_lower_bound uses compar and search of ksl, which are
+     swapped with those for lookup here, so that the lookup can be
+     done with each mode. */
+  ksl.compar = c->lookup_compar;
+  ksl.search = lookup_search;
+
+  for (run = 0; run < N_RUNS; ++run) {
+    t = now_ns();
+    for (i = 0; i < N_QUERIES; ++i) {
+      it = ngtcp2_ksl_lower_bound(&ksl, queries + i * MAX_KEYLEN);
+      sink += it.i;
+    }
+    x = now_ns() - t;
+    if (x < t_lookup) {
+      t_lookup = x;
+    }
+  }
+
+  ngtcp2_ksl_free(&ksl);
+  free(keys);
+
+  printf("%-15s %8zu %-7s %10.1f %10.1f\n", c->name, n, mode_names[m],
+         t_insert / (double)(n * nrep), t_lookup / N_QUERIES);
+}
+
+int main(void) {
+  static const size_t nentries[] = {32, 1024, 65536};
+  size_t i, k;
+  int m;
+
+  printf("%-15s %8s %-7s %10s %10s\n", "container", "n", "search",
+         "insert ns", "lookup ns");
+
+  for (i = 0; i < sizeof(containers) / sizeof(containers[0]); ++i) {
+    for (k = 0; k < sizeof(nentries) / sizeof(nentries[0]); ++k) {
+      for (m = MODE_COMPAR; m <= MODE_AVX2; ++m) {
+        bench(&containers[i], nentries[k], (mode)m);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Equivalence tests for the typed search functions of ngtcp2_ksl.
+ *
+ * - The scalar search functions (ngtcp2_ksl_int64_greater_search,
+ *   ngtcp2_ksl_int64_less_search, ngtcp2_ksl_range_search and
+ *   ngtcp2_ksl_range_exclusive_search) and their AVX2 variants
+ *   returned by ngtcp2_ksl_avx2_search must return the same index as
+ *   a linear search with the corresponding ngtcp2_ksl_compar, on the
+ *   same key arrays.  Blocks are allocated at their exact size, every
+ *   length from 0 to NGTCP2_KSL_MAX_NBLK is tried, and the key slots
+ *   beyond blk->n (including the spare slot) are filled with garbage,
+ *   so that a sanitizer build catches over-reads and a missing mask
+ *   shows up as a wrong index.
+ * - A skip list which uses a typed search must return the same
+ *   lower bound as the one which uses compar only, after the same
+ *   random inserts and removals.
+ *
+ * If the CPU does not support AVX2, only the scalar functions are
+ * tested.
+ *
+ * Usage: ngtcp2_ksl_test [SEED]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngtcp2_ksl.h"
+#include "ngtcp2_range.h"
+
+#define N_BLK_ROUNDS 2000
+#define N_QUERIES_PER_BLK 64
+#define N_KSL_OPS 200000
+#define KSL_KEY_SPACE 4096
+
+static int failures;
+
+#define CHECK(COND)                                                            \
+  do {                                                                         \
+    if (!(COND)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #COND); \
+      if (++failures > 10) {                                                   \
+        exit(EXIT_FAILURE);                                                    \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/* xorshift64*, so that a seed reproduces the same inputs everywhere. */
+static uint64_t rng_state;
+
+static uint64_t rnd64(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static size_t rnd(size_t n) { return (size_t)(rnd64() % n); }
+
+static int int64_greater(const ngtcp2_ksl_key *lhs,
+                         const ngtcp2_ksl_key *rhs) {
+  return *(const int64_t *)lhs > *(const int64_t *)rhs;
+}
+
+static int int64_less(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
+  return *(const int64_t *)lhs < *(const int64_t *)rhs;
+}
+
+/*
+ * blk_new allocates a block which has exactly as much key storage as
+ * ngtcp2_ksl gives it, and fills the whole key storage with garbage.
+ */
+static ngtcp2_ksl_blk *blk_new(size_t keylen) {
+  size_t blklen = sizeof(ngtcp2_ksl_blk) + keylen * (NGTCP2_KSL_MAX_NBLK + 1) -
+                  sizeof(uint64_t);
+  ngtcp2_ksl_blk *blk = malloc(blklen);
+  uint64_t *p;
+  size_t i;
+
+  if (blk == NULL) {
+    abort();
+  }
+
+  memset(blk, 0, blklen);
+
+  p = (uint64_t *)(void *)blk->keys;
+  for (i = 0; i < keylen * (NGTCP2_KSL_MAX_NBLK + 1) / sizeof(uint64_t);
+       ++i) {
+    p[i] = rnd64();
+  }
+
+  return blk;
+}
+
+static size_t compar_search(ngtcp2_ksl_compar compar, const void *keys,
+                            size_t keylen, size_t n,
+                            const ngtcp2_ksl_key *key) {
+  const uint8_t *k = keys;
+  size_t i;
+
+  for (i = 0; i < n && compar(k + keylen * i, key); ++i)
+    ;
+
+  return i;
+}
+
+/*
+ * check_search checks that |search| and its AVX2 variant agree with
+ * |compar| on |blk| for |key|.
+ */
+static void check_search(ngtcp2_ksl_compar compar, ngtcp2_ksl_search search,
+                         size_t keylen, const ngtcp2_ksl_blk *blk,
+                         const ngtcp2_ksl_key *key) {
+  ngtcp2_ksl_search avx2_search = ngtcp2_ksl_avx2_search(search);
+  size_t expected = compar_search(compar, blk->keys, keylen, blk->n, key);
+
+  CHECK(search(NULL, blk, key) == expected);
+
+  if (avx2_search) {
+    CHECK(avx2_search(NULL, blk, key) == expected);
+  }
+}
+
+/*
+ * rnd_int64 returns a value which often is one of the extremes, so
+ * that the signed comparison is exercised at both ends.
+ */
+static int64_t rnd_int64(void) {
+  switch (rnd(8)) {
+  case 0:
+    return INT64_MIN + (int64_t)rnd(4);
+  case 1:
+    return INT64_MAX - (int64_t)rnd(4);
+  case 2:
+    return (int64_t)rnd(8) - 4;
+  case 3:
+    return (int64_t)rnd64();
+  default:
+    return (int64_t)rnd(1 << 20);
+  }
+}
+
+static int cmp_int64_desc(const void *lhs, const void *rhs) {
+  int64_t a = *(const int64_t *)lhs, b = *(const int64_t *)rhs;
+  return a > b ? -1 : a < b;
+}
+
+static int cmp_int64_asc(const void *lhs, const void *rhs) {
+  return -cmp_int64_desc(lhs, rhs);
+}
+
+/*
+ * rnd_int64_query returns one of |keys|, its neighbor, an extreme or
+ * a random value.
+ */
+static int64_t rnd_int64_query(const int64_t *keys, size_t n) {
+  int64_t k;
+
+  if (n == 0 || rnd(4) == 0) {
+    return rnd_int64();
+  }
+
+  k = keys[rnd(n)];
+
+  switch (rnd(3)) {
+  case 0:
+    return k;
+  case 1:
+    return k == INT64_MIN ? k : k - 1;
+  default:
+    return k == INT64_MAX ? k : k + 1;
+  }
+}
+
+static void test_int64_search(void) {
+  int64_t keys[NGTCP2_KSL_MAX_NBLK];
+  ngtcp2_ksl_blk *blk;
+  size_t round, n, i, q;
+  int64_t k;
+  int desc;
+
+  for (round = 0; round < N_BLK_ROUNDS; ++round) {
+    for (n = 0; n <= NGTCP2_KSL_MAX_NBLK; ++n) {
+      desc = (int)(round & 1);
+
+      for (i = 0; i < n; ++i) {
+        keys[i] = rnd_int64();
+      }
+      qsort(keys, n, sizeof(keys[0]), desc ? cmp_int64_desc : cmp_int64_asc);
+
+      blk = blk_new(sizeof(int64_t));
+      blk->n = (uint32_t)n;
+      memcpy(blk->keys, keys, sizeof(keys[0]) * n);
+
+      for (q = 0; q < N_QUERIES_PER_BLK; ++q) {
+        k = rnd_int64_query(keys, n);
+
+        if (desc) {
+          check_search(int64_greater, ngtcp2_ksl_int64_greater_search,
+                       sizeof(int64_t), blk, &k);
+        } else {
+          check_search(int64_less, ngtcp2_ksl_int64_less_search,
+                       sizeof(int64_t), blk, &k);
+        }
+      }
+
+      free(blk);
+    }
+  }
+}
+
+/*
+ * rnd_range_base returns the start of a run of ranges, often close to
+ * 2^63, where the signed comparison changes sign, or UINT64_MAX.
+ * |span| is the largest distance the run may extend.
+ */
+static uint64_t rnd_range_base(uint64_t span) {
+  switch (rnd(4)) {
+  case 0:
+    return 0;
+  case 1:
+    return (1ULL << 63) - rnd(span);
+  case 2:
+    return UINT64_MAX - span;
+  default:
+    return rnd64() >> 1;
+  }
+}
+
+/*
+ * gen_ranges fills |ranges| with |n| sorted, non-overlapping and
+ * non-empty ranges.  Adjacent ranges may touch.
+ */
+static void gen_ranges(ngtcp2_range *ranges, size_t n) {
+  uint64_t x = rnd_range_base(NGTCP2_KSL_MAX_NBLK * 2 * 16);
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    x += rnd(16);
+    ranges[i].begin = x;
+    x += 1 + rnd(15);
+    ranges[i].end = x;
+  }
+}
+
+/*
+ * rnd_range_query returns a range whose begin is around one of the
+ * boundaries of |ranges|, and which may be empty or inverted.
+ */
+static ngtcp2_range rnd_range_query(const ngtcp2_range *ranges, size_t n) {
+  ngtcp2_range r;
+  uint64_t x;
+
+  if (n == 0 || rnd(8) == 0) {
+    x = rnd(2) ? rnd64() : UINT64_MAX - rnd(4);
+  } else {
+    x = rnd(2) ? ranges[rnd(n)].begin : ranges[rnd(n)].end;
+    x += rnd(3) - 1;
+  }
+
+  r.begin = x;
+
+  switch (rnd(4)) {
+  case 0:
+    /* empty */
+    r.end = x;
+    break;
+  case 1:
+    /* inverted */
+    r.end = x - 1 - rnd(8);
+    break;
+  default:
+    r.end = x + 1 + rnd(32);
+    if (r.end < x) {
+      r.end = UINT64_MAX;
+    }
+    break;
+  }
+
+  return r;
+}
+
+static void test_range_search(void) {
+  ngtcp2_range ranges[NGTCP2_KSL_MAX_NBLK], r;
+  ngtcp2_ksl_blk *blk;
+  size_t round, n, q;
+
+  for (round = 0; round < N_BLK_ROUNDS; ++round) {
+    for (n = 0; n <= NGTCP2_KSL_MAX_NBLK; ++n) {
+      gen_ranges(ranges, n);
+
+      blk = blk_new(sizeof(ngtcp2_range));
+      blk->n = (uint32_t)n;
+      memcpy(blk->keys, ranges, sizeof(ranges[0]) * n);
+
+      for (q = 0; q < N_QUERIES_PER_BLK; ++q) {
+        r = rnd_range_query(ranges, n);
+
+        check_search(ngtcp2_ksl_range_compar, ngtcp2_ksl_range_search,
+                     sizeof(ngtcp2_range), blk, &r);
+        check_search(ngtcp2_ksl_range_exclusive_compar,
+                     ngtcp2_ksl_range_exclusive_search, sizeof(ngtcp2_range),
+                     blk, &r);
+      }
+
+      free(blk);
+    }
+  }
+}
+
+/*
+ * test_ksl_lower_bound applies the same random inserts and removals
+ * of int64 keys to a skip list which uses |search| and to one which
+ * uses |compar| only, and checks that their lower bounds agree.
+ */
+static void test_ksl_lower_bound(ngtcp2_ksl_compar compar,
+                                 ngtcp2_ksl_search search) {
+  const ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_ksl typed, plain;
+  ngtcp2_ksl_it it1, it2;
+  size_t i;
+  int64_t k;
+  int rv1, rv2;
+
+  ngtcp2_ksl_init(&typed, compar, search, sizeof(int64_t), mem);
+  ngtcp2_ksl_init(&plain, compar, NULL, sizeof(int64_t), mem);
+
+  for (i = 0; i < N_KSL_OPS; ++i) {
+    k = (int64_t)rnd(KSL_KEY_SPACE) - KSL_KEY_SPACE / 2;
+
+    switch (rnd(3)) {
+    case 0:
+      rv1 = ngtcp2_ksl_insert(&typed, NULL, &k, NULL);
+      rv2 = ngtcp2_ksl_insert(&plain, NULL, &k, NULL);
+      CHECK(rv1 == rv2);
+      break;
+    case 1:
+      rv1 = ngtcp2_ksl_remove(&typed, NULL, &k);
+      rv2 = ngtcp2_ksl_remove(&plain, NULL, &k);
+      CHECK(rv1 == rv2);
+      break;
+    default:
+      it1 = ngtcp2_ksl_lower_bound(&typed, &k);
+      it2 = ngtcp2_ksl_lower_bound(&plain, &k);
+      CHECK(ngtcp2_ksl_it_end(&it1) == ngtcp2_ksl_it_end(&it2));
+      if (!ngtcp2_ksl_it_end(&it1) && !ngtcp2_ksl_it_end(&it2)) {
+        CHECK(*(const int64_t *)ngtcp2_ksl_it_key(&it1) ==
+              *(const int64_t *)ngtcp2_ksl_it_key(&it2));
+      }
+      break;
+    }
+  }
+
+  CHECK(ngtcp2_ksl_len(&typed) == ngtcp2_ksl_len(&plain));
+
+  ngtcp2_ksl_free(&typed);
+  ngtcp2_ksl_free(&plain);
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+  int avx2 = ngtcp2_ksl_avx2_search(ngtcp2_ksl_int64_less_search) != NULL;
+
+  rng_state = seed ? seed : 1;
+
+  if (!avx2) {
+    printf("ngtcp2_ksl_test: AVX2 is not supported, testing the scalar "
+           "search functions only\n");
+  }
+
+  test_int64_search();
+  test_range_search();
+  test_ksl_lower_bound(int64_greater, ngtcp2_ksl_int64_greater_search);
+  test_ksl_lower_bound(int64_less, ngtcp2_ksl_int64_less_search);
+
+  if (failures) {
+    fprintf(stderr, "ngtcp2_ksl_test: %d failure(s), seed = %llu\n",
+            failures, (unsigned long long)seed);
+    return EXIT_FAILURE;
+  }
+
+  printf("ngtcp2_ksl_test: ok (%s), seed = %llu\n",
+         avx2 ? "scalar and AVX2" : "scalar", (unsigned long long)seed);
+
+  return EXIT_SUCCESS;
+}
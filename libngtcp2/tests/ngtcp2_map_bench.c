@@ -0,0 +1,129 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Stream-count scaling benchmark for ngtcp2_map, which ngtcp2_conn
+ * uses to look up streams by stream ID.  For each table size it
+ * measures, in ns per operation:
+ *
+ * - insert: filling the table with client bidirectional stream IDs
+ *   (0, 4, 8, ...);
+ * - find hit / find miss: random lookups of present / absent IDs, best
+ *   of 5 runs;
+ * - close+open: removing the oldest stream and inserting the next
+ *   stream ID, which keeps the table size constant.
+ *
+ * The ngtcp2_map.c and ngtcp2_map.h it is built with come from
+ * NGTCP2_MAP_BENCH_DIR (see CMakeLists.txt), so the same benchmark can
+ * be built against another revision of the map and the results
+ * compared.
+ *
+ * Usage: ngtcp2_map_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ngtcp2_map.h"
+
+#define N_QUERIES 4000000
+#define N_FIND_RUNS 5
+
+static double now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main(void) {
+  static const size_t nstreams[] = {16, 256, 4096, 65536, 1000000};
+  static uint64_t queries[N_QUERIES];
+  volatile uintptr_t sink = 0;
+  ngtcp2_map map;
+  size_t i, k, n, run;
+  uint64_t next_id;
+  double t, t_insert, t_hit, t_miss, t_churn, x;
+
+  for (k = 0; k < sizeof(nstreams) / sizeof(nstreams[0]); ++k) {
+    n = nstreams[k];
+
+    ngtcp2_map_init(&map, ngtcp2_mem_default());
+
+    t = now_ns();
+    for (i = 0; i < n; ++i) {
+      ngtcp2_map_insert(&map, (ngtcp2_map_key_type)i * 4,
+                        (void *)(uintptr_t)(i + 1));
+    }
+    t_insert = (now_ns() - t) / (double)n;
+
+    srand(1);
+    for (i = 0; i < N_QUERIES; ++i) {
+      queries[i] = (uint64_t)((size_t)rand() % n) * 4;
+    }
+
+    t_hit = t_miss = 1e18;
+
+    for (run = 0; run < N_FIND_RUNS; ++run) {
+      t = now_ns();
+      for (i = 0; i < N_QUERIES; ++i) {
+        sink += (uintptr_t)ngtcp2_map_find(&map, queries[i]);
+      }
+      x = (now_ns() - t) / N_QUERIES;
+      if (x < t_hit) {
+        t_hit = x;
+      }
+
+      /* Server-initiated bidirectional IDs (4k + 1) are never present. */
+      t = now_ns();
+      for (i = 0; i < N_QUERIES; ++i) {
+        sink += (uintptr_t)ngtcp2_map_find(&map, queries[i] + 1);
+      }
+      x = (now_ns() - t) / N_QUERIES;
+      if (x < t_miss) {
+        t_miss = x;
+      }
+    }
+
+    next_id = (uint64_t)n * 4;
+
+    t = now_ns();
+    for (i = 0; i < N_QUERIES; ++i) {
+      ngtcp2_map_remove(&map, next_id - (uint64_t)n * 4);
+      ngtcp2_map_insert(&map, next_id, (void *)1);
+      next_id += 4;
+    }
+    t_churn = (now_ns() - t) / N_QUERIES;
+
+    printf("streams=%7zu insert %6.1f ns, find hit %6.1f ns, "
+           "find miss %6.1f ns, close+open %6.1f ns\n",
+           n, t_insert, t_hit, t_miss, t_churn);
+
+    ngtcp2_map_free(&map);
+  }
+
+  return sink == 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark of ngtcp2_pnring against ngtcp2_ksl, the two containers
+ * ngtcp2_rtb can keep sent packets in, at high bandwidth-delay
+ * products.  The number of packets in flight is kept constant while
+ * the sender keeps sending, and each container is accessed as
+ * ngtcp2_rtb accesses it:
+ *
+ * - sending a packet inserts the next packet number;
+ * - an ACK which acknowledges the 2 oldest packets in flight looks up
+ *   the largest acknowledged packet number, and removes the entries
+ *   down to the smallest one through the iterator;
+ * - with loss, 1 in 100 packets is not acknowledged, and loss
+ *   detection removes it from the oldest end once 3 newer packets are
+ *   acknowledged.
+ *
+ * It reports ns per sent packet, best of 3 runs.  Beyond
+ * NGTCP2_PNRING_MAX_NMEMB packets in flight, ngtcp2_pnring moves the
+ * oldest packets to its sparse skip list.
+ *
+ * Usage: ngtcp2_pnring_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ngtcp2_pnring.h"
+#include "ngtcp2_ksl.h"
+
+#define N_PKTS 2000000
+#define N_RUNS 3
+#define LOSS_INTERVAL 100
+#define PKT_THRESHOLD 3
+
+static double now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int greater(const ngtcp2_ksl_key *lhs, const ngtcp2_ksl_key *rhs) {
+  return *(int64_t *)lhs > *(int64_t *)rhs;
+}
+
+#define pkt_num_data(PKT_NUM) ((void *)(uintptr_t)((PKT_NUM) + 1))
+#define data_pkt_num(DATA) ((int64_t)(uintptr_t)(DATA)-1)
+
+/*
+ * is_lost returns nonzero if |pkt_num| is never acknowledged in the
+ * lossy run.
+ */
+#define is_lost(LOSS, PKT_NUM) ((LOSS) && (PKT_NUM) % LOSS_INTERVAL == 7)
+
+static double bench_ksl(size_t inflight, int loss) {
+  ngtcp2_ksl ksl;
+  ngtcp2_ksl_it it;
+  int64_t next = 0, acked = 0, pkt_num;
+  size_t i;
+  double t;
+
+  ngtcp2_ksl_init(&ksl, greater, ngtcp2_ksl_int64_greater_search,
+                  sizeof(int64_t), ngtcp2_mem_default());
+
+  for (; next < (int64_t)inflight; ++next) {
+    ngtcp2_ksl_insert(&ksl, NULL, &next, pkt_num_data(next));
+  }
+
+  t = now_ns();
+
+  for (i = 0; i < N_PKTS; i += 2) {
+    for (pkt_num = next + 2; next < pkt_num; ++next) {
+      ngtcp2_ksl_insert(&ksl, NULL, &next, pkt_num_data(next));
+    }
+
+    /* ACK [acked, acked + 1] */
+    pkt_num = acked + 1;
+    it = ngtcp2_ksl_lower_bound(&ksl, &pkt_num);
+    for (; !ngtcp2_ksl_it_end(&it);) {
+      pkt_num = data_pkt_num(ngtcp2_ksl_it_get(&it));
+      if (pkt_num < acked) {
+        break;
+      }
+      if (is_lost(loss, pkt_num)) {
+        ngtcp2_ksl_it_next(&it);
+        continue;
+      }
+      ngtcp2_ksl_remove_hint(&ksl, &it, &it, &pkt_num);
+    }
+    acked += 2;
+
+    /* loss detection */
+    for (; ngtcp2_ksl_len(&ksl);) {
+      it = ngtcp2_ksl_end(&ksl);
+      ngtcp2_ksl_it_prev(&it);
+      pkt_num = data_pkt_num(ngtcp2_ksl_it_get(&it));
+      if (pkt_num + PKT_THRESHOLD > acked) {
+        break;
+      }
+      ngtcp2_ksl_remove_hint(&ksl, NULL, &it, &pkt_num);
+    }
+  }
+
+  t = now_ns() - t;
+
+  ngtcp2_ksl_free(&ksl);
+
+  return t / N_PKTS;
+}
+
+static double bench_pnring(size_t inflight, int loss) {
+  ngtcp2_pnring pr;
+  ngtcp2_pnring_it it;
+  int64_t next = 0, acked = 0, pkt_num;
+  size_t i;
+  double t;
+
+  ngtcp2_pnring_init(&pr, ngtcp2_mem_default());
+
+  for (; next < (int64_t)inflight; ++next) {
+    ngtcp2_pnring_insert(&pr, next, pkt_num_data(next));
+  }
+
+  t = now_ns();
+
+  for (i = 0; i < N_PKTS; i += 2) {
+    for (pkt_num = next + 2; next < pkt_num; ++next) {
+      ngtcp2_pnring_insert(&pr, next, pkt_num_data(next));
+    }
+
+    /* ACK [acked, acked + 1] */
+    it = ngtcp2_pnring_lower_bound(&pr, acked + 1);
+    for (; !ngtcp2_pnring_it_end(&it);) {
+      pkt_num = data_pkt_num(ngtcp2_pnring_it_get(&it));
+      if (pkt_num < acked) {
+        break;
+      }
+      if (is_lost(loss, pkt_num)) {
+        ngtcp2_pnring_it_next(&it);
+        continue;
+      }
+      ngtcp2_pnring_remove(&pr, &it);
+    }
+    acked += 2;
+
+    /* loss detection */
+    for (; ngtcp2_pnring_len(&pr);) {
+      it = ngtcp2_pnring_end(&pr);
+      ngtcp2_pnring_it_prev(&it);
+      pkt_num = data_pkt_num(ngtcp2_pnring_it_get(&it));
+      if (pkt_num + PKT_THRESHOLD > acked) {
+        break;
+      }
+      ngtcp2_pnring_remove(&pr, &it);
+    }
+  }
+
+  t = now_ns() - t;
+
+  ngtcp2_pnring_free(&pr);
+
+  return t / N_PKTS;
+}
+
+static double best_of(double (*bench)(size_t, int), size_t inflight,
+                      int loss) {
+  double t = 1e300, x;
+  size_t run;
+
+  for (run = 0; run < N_RUNS; ++run) {
+    x = bench(inflight, loss);
+    if (x < t) {
+      t = x;
+    }
+  }
+
+  return t;
+}
+
+int main(void) {
+  static const size_t ninflight[] = {1000, 10000, 100000, 1000000};
+  size_t k;
+  int loss;
+
+  printf("%10s %5s %10s %10s\n", "in flight", "loss", "ksl ns", "pnring ns");
+
+  for (k = 0; k < sizeof(ninflight) / sizeof(ninflight[0]); ++k) {
+    for (loss = 0; loss <= 1; ++loss) {
+      printf("%10zu %5s %10.1f %10.1f\n", ninflight[k], loss ? "1%" : "0%",
+             best_of(bench_ksl, ninflight[k], loss),
+             best_of(bench_pnring, ninflight[k], loss));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2022 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Randomized model test for ngtcp2_pnring, which ngtcp2_rtb uses
+ * instead of ngtcp2_ksl if ENABLE_RTB_PNRING is defined.  ngtcp2_pnring
+ * is compiled into the library either way, so this test does not
+ * depend on that option.
+ *
+ * Random inserts, removals through an iterator, lower bound lookups
+ * and full iterations in both directions are applied to ngtcp2_pnring
+ * and to a sorted array of packet numbers, and the results must
+ * agree.  Most packet numbers are allocated monotonically, as they
+ * are in ngtcp2_rtb, but old packet numbers are inserted too.  The
+ * test runs twice: once with packet numbers close enough to fit in
+ * the array, and once with jumps farther than
+ * NGTCP2_PNRING_MAX_NMEMB, so that the entries are moved to the
+ * sparse skip list and found there.  The mix of
+ * operations alternates between phases which mostly insert, insert as
+ * much as they remove, and mostly remove, so that the array grows
+ * from empty and drains again.
+ *
+ * Usage: ngtcp2_pnring_test [SEED]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ngtcp2_pnring.h"
+
+#define N_OPS 1000000
+#define MAX_ENTRIES 4096
+#define N_OPS_PER_FULL_CHECK 997
+#define N_OPS_PER_PHASE 20000
+
+static int failures;
+
+#define CHECK(COND)                                                            \
+  do {                                                                         \
+    if (!(COND)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #COND); \
+      if (++failures > 10) {                                                   \
+        exit(EXIT_FAILURE);                                                    \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/* xorshift64*, so that a seed reproduces the same inputs everywhere. */
+static uint64_t rng_state;
+
+static uint64_t rnd64(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+static size_t rnd(size_t n) { return (size_t)(rnd64() % n); }
+
+/*
+ * The model is the packet numbers in |pr| sorted in increasing
+ * order.  The data of each entry is its packet number plus 1, so that
+ * it is never NULL and the packet number can be recovered from it.
+ */
+static int64_t model[MAX_ENTRIES + 1];
+static size_t nmodel;
+
+#define pkt_num_data(PKT_NUM) ((void *)(uintptr_t)((PKT_NUM) + 1))
+#define data_pkt_num(DATA) ((int64_t)(uintptr_t)(DATA)-1)
+
+/*
+ * model_lower_bound returns the index of the first packet number in
+ * model which is larger than |pkt_num|.  The one before it, if any,
+ * is the largest packet number equal to or smaller than |pkt_num|.
+ */
+static size_t model_upper_bound(int64_t pkt_num) {
+  size_t lo = 0, hi = nmodel, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (model[mid] <= pkt_num) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+static int model_contains(int64_t pkt_num) {
+  size_t i = model_upper_bound(pkt_num);
+  return i > 0 && model[i - 1] == pkt_num;
+}
+
+static void model_insert(int64_t pkt_num) {
+  size_t i = model_upper_bound(pkt_num);
+
+  memmove(&model[i + 1], &model[i], sizeof(model[0]) * (nmodel - i));
+  model[i] = pkt_num;
+  ++nmodel;
+}
+
+static void model_remove(size_t i) {
+  memmove(&model[i], &model[i + 1], sizeof(model[0]) * (nmodel - i - 1));
+  --nmodel;
+}
+
+/*
+ * check_it checks that |it| points to the entry which has the largest
+ * packet number in model which is smaller than model[i], that is,
+ * model[i - 1], or to the end if i == 0.
+ */
+static void check_it(const ngtcp2_pnring_it *it, size_t i) {
+  if (i == 0) {
+    CHECK(ngtcp2_pnring_it_end(it));
+    return;
+  }
+
+  CHECK(!ngtcp2_pnring_it_end(it));
+  if (!ngtcp2_pnring_it_end(it)) {
+    CHECK(data_pkt_num(ngtcp2_pnring_it_get(it)) == model[i - 1]);
+  }
+}
+
+/*
+ * rnd_new_pkt_num returns a packet number which is not in the model.
+ * It is usually the next packet number, as ngtcp2_rtb allocates.  If
+ * |far_jump| is nonzero, it occasionally jumps farther than the
+ * array can span.
+ */
+static int64_t rnd_new_pkt_num(int64_t *next_pkt_num, int far_jump) {
+  int64_t pkt_num;
+
+  switch (rnd(2048)) {
+  case 0:
+    if (!far_jump) {
+      break;
+    }
+    /* A jump which does not fit in the array. */
+    *next_pkt_num += NGTCP2_PNRING_MAX_NMEMB + (int64_t)rnd(1024);
+    break;
+  case 1:
+  case 2:
+    /* An old packet number, which might be in the sparse skip list. */
+    if (nmodel) {
+      pkt_num = model[rnd(nmodel)] - 1 - (int64_t)rnd(8);
+      if (pkt_num >= 0 && !model_contains(pkt_num)) {
+        return pkt_num;
+      }
+    }
+    break;
+  default:
+    /* Skipped packet numbers leave holes. */
+    *next_pkt_num += (int64_t)rnd(3);
+    break;
+  }
+
+  return (*next_pkt_num)++;
+}
+
+static int64_t rnd_query(int64_t next_pkt_num) {
+  if (nmodel == 0 || rnd(8) == 0) {
+    return (int64_t)rnd((size_t)next_pkt_num + 2) - 1;
+  }
+
+  return model[rnd(nmodel)] + (int64_t)rnd(3) - 1;
+}
+
+/*
+ * check_all iterates |pr| forward from begin and backward from end,
+ * and checks that both agree with the model.
+ */
+static void check_all(ngtcp2_pnring *pr) {
+  ngtcp2_pnring_it it;
+  size_t i;
+
+  CHECK(ngtcp2_pnring_len(pr) == nmodel);
+
+  it = ngtcp2_pnring_begin(pr);
+  CHECK(ngtcp2_pnring_it_begin(&it));
+
+  for (i = nmodel; i > 0 && !ngtcp2_pnring_it_end(&it);
+       --i, ngtcp2_pnring_it_next(&it)) {
+    CHECK(data_pkt_num(ngtcp2_pnring_it_get(&it)) == model[i - 1]);
+  }
+
+  CHECK(i == 0);
+  CHECK(ngtcp2_pnring_it_end(&it));
+
+  if (nmodel == 0) {
+    return;
+  }
+
+  it = ngtcp2_pnring_end(pr);
+
+  for (i = 0; i < nmodel; ++i) {
+    CHECK(!ngtcp2_pnring_it_begin(&it));
+    if (ngtcp2_pnring_it_begin(&it)) {
+      return;
+    }
+    ngtcp2_pnring_it_prev(&it);
+    CHECK(data_pkt_num(ngtcp2_pnring_it_get(&it)) == model[i]);
+  }
+
+  CHECK(ngtcp2_pnring_it_begin(&it));
+}
+
+static void test_pnring(int far_jump) {
+  ngtcp2_pnring pr;
+  ngtcp2_pnring_it it;
+  /* The percentage of inserts and removals in each phase.  The rest
+     are lookups.  A removal removes 2 entries on average. */
+  static const size_t insert_pct[] = {70, 40, 10};
+  static const size_t remove_pct[] = {10, 20, 60};
+  int64_t next_pkt_num = 0, pkt_num, lo;
+  size_t op, i, phase, r;
+  int rv;
+
+  nmodel = 0;
+
+  ngtcp2_pnring_init(&pr, ngtcp2_mem_default());
+
+  for (op = 0; op < N_OPS; ++op) {
+    phase = op / N_OPS_PER_PHASE % 3;
+    r = rnd(100);
+
+    if (r < remove_pct[phase] || (nmodel >= MAX_ENTRIES && r % 2)) {
+      /* Remove the entries in [lo, pkt_num], as an ACK range does. */
+      pkt_num = rnd_query(next_pkt_num);
+      lo = pkt_num - (int64_t)rnd(rnd(8) ? 4 : 64);
+      i = model_upper_bound(pkt_num);
+      it = ngtcp2_pnring_lower_bound(&pr, pkt_num);
+      check_it(&it, i);
+
+      for (; i > 0 && model[i - 1] >= lo && !ngtcp2_pnring_it_end(&it); --i) {
+        ngtcp2_pnring_remove(&pr, &it);
+        model_remove(i - 1);
+        check_it(&it, i - 1);
+      }
+    } else if (r < remove_pct[phase] + insert_pct[phase] &&
+               nmodel < MAX_ENTRIES) {
+      pkt_num = rnd_new_pkt_num(&next_pkt_num, far_jump);
+      rv = ngtcp2_pnring_insert(&pr, pkt_num, pkt_num_data(pkt_num));
+      CHECK(rv == 0);
+      model_insert(pkt_num);
+    } else {
+      pkt_num = rnd_query(next_pkt_num);
+      it = ngtcp2_pnring_lower_bound(&pr, pkt_num);
+      check_it(&it, model_upper_bound(pkt_num));
+    }
+
+    if (op % N_OPS_PER_FULL_CHECK == 0) {
+      check_all(&pr);
+    }
+  }
+
+  check_all(&pr);
+
+  /* Remove everything from the oldest, as loss detection does. */
+  while (nmodel) {
+    it = ngtcp2_pnring_end(&pr);
+    ngtcp2_pnring_it_prev(&it);
+    CHECK(data_pkt_num(ngtcp2_pnring_it_get(&it)) == model[0]);
+    ngtcp2_pnring_remove(&pr, &it);
+    model_remove(0);
+    CHECK(ngtcp2_pnring_it_end(&it));
+  }
+
+  check_all(&pr);
+
+  ngtcp2_pnring_free(&pr);
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+
+  rng_state = seed ? seed : 1;
+
+  test_pnring(0);
+  test_pnring(1);
+
+  if (failures) {
+    fprintf(stderr, "ngtcp2_pnring_test: %d failure(s), seed = %llu\n",
+            failures, (unsigned long long)seed);
+    return EXIT_FAILURE;
+  }
+
+  printf("ngtcp2_pnring_test: ok, seed = %llu\n", (unsigned long long)seed);
+
+  return EXIT_SUCCESS;
+}
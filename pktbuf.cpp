@@ -0,0 +1,97 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include "pktbuf.h"
+
+namespace
+{
+    // 空闲的 buffer 的前几个字节用来存放 free list 的指针。
+    struct FreeBuffer
+    {
+        FreeBuffer *next;
+    };
+
+    // 每个线程各自的 slab，只包含 POD 成员，线程退出时不需要析构（此时可能仍有 buffer 被 Connection 持有）。
+    // free_lists[0] 存放 SMALL_CAPACITY 长度的 buffer，free_lists[1] 存放 CAPACITY 长度的 buffer。
+    struct Slab
+    {
+        FreeBuffer *free_lists[2];
+        size_t n_free[2];
+        size_t n_total; // 已经分配、尚未释放的 buffer 总数（包括空闲的与被 handle 持有的）
+    };
+
+    thread_local Slab slab = {{nullptr, nullptr}, {0, 0}, 0};
+
+    inline int size_to_class(size_t size) { return size <= PacketBuffer::SMALL_CAPACITY ? 0 : 1; }
+
+    inline size_t class_to_capacity(int klass) { return klass == 0 ? PacketBuffer::SMALL_CAPACITY : PacketBuffer::CAPACITY; }
+} /* namespace */
+
+PacketBuffer &PacketBuffer::operator=(PacketBuffer &&rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        this->reset();
+        this->buf = rhs.buf, this->cap = rhs.cap, this->len = rhs.len;
+        rhs.buf = nullptr, rhs.cap = 0, rhs.len = 0;
+    }
+
+    return *this;
+}
+
+PacketBuffer PacketBuffer::acquire(size_t size)
+{
+    PacketBuffer pb;
+
+    int klass = size_to_class(size);
+    FreeBuffer *fb = slab.free_lists[klass];
+    if (fb) // 优先重用已经归还的 buffer
+    {
+        slab.free_lists[klass] = fb->next;
+        --slab.n_free[klass];
+    }
+    else
+    {
+        void *mem = nullptr;
+        if (posix_memalign(&mem, ALIGNMENT, class_to_capacity(klass)) != 0)
+        {
+            fprintf(stderr, "Error [%s] [posix_memalign]: failed to allocate packet buffer.\n", __func__);
+            return pb;
+        }
+
+        fb = static_cast<FreeBuffer *>(mem);
+        ++slab.n_total;
+    }
+
+    pb.buf = reinterpret_cast<uint8_t *>(fb);
+    pb.cap = class_to_capacity(klass);
+    return pb;
+}
+
+void PacketBuffer::reset()
+{
+    if (!this->buf)
+        return;
+
+    int klass = size_to_class(this->cap);
+    if (slab.n_free[klass] >= SLAB_MAX_FREE) // free list 已满，直接归还给系统
+    {
+        free(this->buf);
+        --slab.n_total;
+    }
+    else
+    {
+        FreeBuffer *fb = reinterpret_cast<FreeBuffer *>(this->buf);
+        fb->next = slab.free_lists[klass];
+        slab.free_lists[klass] = fb;
+        ++slab.n_free[klass];
+    }
+
+    this->buf = nullptr;
+    this->cap = 0;
+    this->len = 0;
+}
+
+size_t PacketBuffer::get_slab_total() { return slab.n_total; }
+
+size_t PacketBuffer::get_slab_free() { return slab.n_free[0] + slab.n_free[1]; }
@@ -0,0 +1,58 @@
+#ifndef __PKTBUF_H__
+#define __PKTBUF_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// 收发 QUIC packet 所用的 buffer 的 handle，只能移动，不能拷贝。
+// buffer 来自当前线程的 slab，按长度分为 SMALL_CAPACITY 与 CAPACITY 两种，首地址按 cache line（64 bytes）对齐，
+// handle 析构时 buffer 回到 slab 中对应长度的 free list。因此 buffer 可以从 ngtcp2_conn_writev_stream 一路移动到 GSO batch、
+// pending_tx 或者等待 MSG_ZEROCOPY 完成通知的队列中，中途不需要拷贝。
+// 每种长度的 free list 最多缓存 SLAB_MAX_FREE 块 buffer，超出的部分在归还时直接释放，避免突发流量之后 slab 一直占用内存。
+// 注意：buffer 必须在取出它的线程中释放。
+class PacketBuffer
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;         // buffer 首地址的对齐（cache line）
+    static constexpr size_t SMALL_CAPACITY = 1536;  // 较小的 buffer 的长度，能够容纳 1500 MTU 的 path 上的 UDP payload
+    static constexpr size_t CAPACITY = 9024;        // 较大的 buffer 的长度，能够容纳 9000 MTU 下的 UDP payload；两者都是 ALIGNMENT 的倍数
+    static constexpr size_t SLAB_MAX_FREE = 64;     // 每种长度的 free list 最多缓存的 buffer 数量
+
+private:
+    uint8_t *buf;
+    size_t cap; // buffer 的长度，SMALL_CAPACITY 或 CAPACITY
+    size_t len; // buffer 中数据的长度，范围 [0, cap]
+
+public:
+    PacketBuffer() : buf(nullptr), cap(0), len(0) {}
+    ~PacketBuffer() { this->reset(); }
+
+    PacketBuffer(PacketBuffer &&rhs) noexcept : buf(rhs.buf), cap(rhs.cap), len(rhs.len) { rhs.buf = nullptr, rhs.cap = 0, rhs.len = 0; }
+    PacketBuffer &operator=(PacketBuffer &&rhs) noexcept;
+
+    // 从当前线程的 slab 中取出一块长度不小于 size 的 buffer（size 不超过 CAPACITY），申请内存失败时返回空的 handle。
+    // 发送 packet 时应当按照当前 path 的 UDP payload 长度上限取 buffer，接收 packet 时则需要取 CAPACITY 长度的 buffer。
+    static PacketBuffer acquire(size_t size = CAPACITY);
+
+    // 将 buffer 归还给当前线程的 slab，handle 变为空。
+    void reset();
+
+    inline explicit operator bool() const { return this->buf != nullptr; }
+
+    inline uint8_t *data() { return this->buf; }
+    inline const uint8_t *data() const { return this->buf; }
+
+    inline size_t capacity() const { return this->cap; }
+    inline size_t size() const { return this->len; }
+    inline void set_size(size_t size) { this->len = size; }
+
+    // 查询当前线程的 slab 中（两种长度合计）buffer 的总数以及空闲的数量。
+    static size_t get_slab_total();
+    static size_t get_slab_free();
+
+private:
+    PacketBuffer(const PacketBuffer &rhs) = delete;            // no copy
+    PacketBuffer &operator=(const PacketBuffer &rhs) = delete; // no assignment
+};
+
+#endif /* __PKTBUF_H__ */
@@ -1,11 +1,13 @@
 #include <cstdio>
 #include <cstring>
+#include <new>
 #include <assert.h>
 
 #include <ngtcp2/ngtcp2.h>
 #include "ngtcp2_conn.h"
 
 #include "utils.h"
+#include "aes128.h"
 #include "plaintext.h"
 
 /**
@@ -65,13 +67,23 @@ namespace ngtcp2_plaintext
     /**
      * Use `ngtcp2_crypto_ctx_tls()` to initialize this struct for Handshake and 1RTT packets.
      * 本函数同 `ngtcp2_crypto_ctx_tls()` 在使用上是一致的。
+     * PROFILE_NULL 下 packet 不带 AEAD tag，因此 AEAD overhead 为零。
      * Ref: "ngtcp2_repo/tests/ngtcp2_conn_test.c", `init_crypto_ctx()`.
      */
-    void crypto_ctx_tls(ngtcp2_crypto_ctx *ctx)
+    void crypto_ctx_tls(ngtcp2_crypto_ctx *ctx, Profile profile = PROFILE_FAKE_AEAD)
     {
         memset(ctx, 0, sizeof(*ctx));
 
-        ctx->aead.max_overhead = NGTCP2_FAKE_AEAD_OVERHEAD;
+        if (profile == PROFILE_AES_128_GCM)
+        {
+            // AES-128-GCM 的 confidentiality limit 与 integrity limit，Ref: RFC 9001 6.6
+            ctx->aead.max_overhead = Aes128::GCM_TAG_LEN;
+            ctx->max_encryption = (1ULL << 23);
+            ctx->max_decryption_failure = (1ULL << 52);
+            return;
+        }
+
+        ctx->aead.max_overhead = (profile == PROFILE_NULL ? 0 : NGTCP2_FAKE_AEAD_OVERHEAD);
 
         ctx->max_encryption = 9999;
         ctx->max_decryption_failure = 8888;
@@ -214,16 +226,16 @@ namespace ngtcp2_plaintext
 
     void delete_crypto_aead_ctx_cb(ngtcp2_conn *conn, ngtcp2_crypto_aead_ctx *aead_ctx, void *user_data)
     {
-        // 由于 aead_ctx->native_handle 应当是一个空指针，因此并不需要 delete 。
-        assert(!(aead_ctx->native_handle));
-        return;
+        // PROFILE_AES_128_GCM 下 native_handle 是 Aes128 对象，其余 profile 下是空指针。
+        delete static_cast<Aes128 *>(aead_ctx->native_handle);
+        aead_ctx->native_handle = nullptr;
     }
 
     void delete_crypto_cipher_ctx_cb(ngtcp2_conn *conn, ngtcp2_crypto_cipher_ctx *cipher_ctx, void *user_data)
     {
-        // 由于 cipher_ctx->native_handle 应当是一个空指针，因此并不需要 delete 。
-        assert(!(cipher_ctx->native_handle));
-        return;
+        // PROFILE_AES_128_GCM 下 native_handle 是 Aes128 对象，其余 profile 下是空指针。
+        delete static_cast<Aes128 *>(cipher_ctx->native_handle);
+        cipher_ctx->native_handle = nullptr;
     }
 
     /**
@@ -259,33 +271,230 @@ namespace ngtcp2_plaintext
 
         return 0;
     }
+
+    /**
+     * PROFILE_AES_128_GCM 的 pre-shared key 与密钥派生。
+     * 由于没有 TLS 握手，这里不使用 HKDF，而是以 AES-128 作为 PRF：out = E(key, label || 0) || E(key, label || 1) || ...
+     *   client/server 发送方向的 secret = PRF(psk, "quic client"/"quic server")，
+     *   由 secret 派生 key = PRF(secret, "quic key")，iv = PRF(secret, "quic iv")，hp key = PRF(secret, "quic hp")，
+     *   key update 时新的 secret = PRF(secret, "quic ku")，hp key 保持不变（RFC 9001 6.1）。
+     */
+    constexpr size_t AES_SECRET_LEN = Aes128::KEY_LEN;
+
+    uint8_t pre_shared_key[Aes128::KEY_LEN] = {0};
+    bool pre_shared_key_set = false;
+
+    void aes_prf(const uint8_t *key, const char *label, uint8_t *out, size_t outlen)
+    {
+        Aes128 prf(key);
+
+        size_t labellen = strlen(label);
+        assert(labellen < Aes128::BLOCK_LEN);
+
+        for (uint8_t i = 0; outlen > 0; ++i)
+        {
+            uint8_t block[Aes128::BLOCK_LEN] = {0};
+            memcpy(block, label, labellen);
+            block[Aes128::BLOCK_LEN - 1] = i;
+
+            prf.encrypt_blocks(block, block, 1);
+
+            size_t n = (outlen < Aes128::BLOCK_LEN ? outlen : Aes128::BLOCK_LEN);
+            memcpy(out, block, n);
+            out += n, outlen -= n;
+        }
+    }
+
+    // 由 secret 派生 AEAD 的 Aes128 对象以及 iv，申请内存失败时返回 nullptr。
+    Aes128 *aes_derive_aead(const uint8_t *secret, uint8_t *iv)
+    {
+        uint8_t key[Aes128::KEY_LEN];
+        aes_prf(secret, "quic key", key, sizeof(key));
+        aes_prf(secret, "quic iv", iv, Aes128::GCM_IV_LEN);
+
+        return new (std::nothrow) Aes128(key);
+    }
+
+    int aes_encrypt_cb(uint8_t *dest, const ngtcp2_crypto_aead *aead,
+                       const ngtcp2_crypto_aead_ctx *aead_ctx,
+                       const uint8_t *plaintext, size_t plaintextlen,
+                       const uint8_t *nonce, size_t noncelen,
+                       const uint8_t *aad, size_t aadlen)
+    {
+        // 只有 1RTT key 带有 Aes128 对象，PROFILE_AES_128_GCM 下不应当发送 Initial/Handshake packet
+        const Aes128 *cipher = static_cast<const Aes128 *>(aead_ctx->native_handle);
+        if (!cipher || noncelen != Aes128::GCM_IV_LEN)
+            return NGTCP2_ERR_CALLBACK_FAILURE;
+
+        cipher->gcm_seal(dest, plaintext, plaintextlen, nonce, aad, aadlen);
+        return 0;
+    }
+
+    int aes_decrypt_cb(uint8_t *dest, const ngtcp2_crypto_aead *aead,
+                       const ngtcp2_crypto_aead_ctx *aead_ctx,
+                       const uint8_t *ciphertext, size_t ciphertextlen,
+                       const uint8_t *nonce, size_t noncelen,
+                       const uint8_t *aad, size_t aadlen)
+    {
+        const Aes128 *cipher = static_cast<const Aes128 *>(aead_ctx->native_handle);
+        if (!cipher || noncelen != Aes128::GCM_IV_LEN)
+            return NGTCP2_ERR_DECRYPT;
+
+        if (cipher->gcm_open(dest, ciphertext, ciphertextlen, nonce, aad, aadlen) < 0)
+            return NGTCP2_ERR_DECRYPT;
+
+        return 0;
+    }
+
+    int aes_hp_mask_cb(uint8_t *dest, const ngtcp2_crypto_cipher *hp,
+                       const ngtcp2_crypto_cipher_ctx *hp_ctx,
+                       const uint8_t *sample)
+    {
+        const Aes128 *cipher = static_cast<const Aes128 *>(hp_ctx->native_handle);
+        if (!cipher)
+            return NGTCP2_ERR_CALLBACK_FAILURE;
+
+        uint8_t mask[1][Aes128::BLOCK_LEN];
+        cipher->hp_masks(&sample, mask, 1);
+        memcpy(dest, mask[0], NGTCP2_HP_MASKLEN);
+
+        return 0;
+    }
+
+    int aes_update_key_cb(ngtcp2_conn *conn, uint8_t *rx_secret, uint8_t *tx_secret,
+                          ngtcp2_crypto_aead_ctx *rx_aead_ctx, uint8_t *rx_iv,
+                          ngtcp2_crypto_aead_ctx *tx_aead_ctx, uint8_t *tx_iv,
+                          const uint8_t *current_rx_secret, const uint8_t *current_tx_secret, size_t secretlen,
+                          void *user_data)
+    {
+        if (secretlen != AES_SECRET_LEN)
+            return NGTCP2_ERR_CALLBACK_FAILURE;
+
+        aes_prf(current_rx_secret, "quic ku", rx_secret, AES_SECRET_LEN);
+        aes_prf(current_tx_secret, "quic ku", tx_secret, AES_SECRET_LEN);
+
+        Aes128 *rx_cipher = aes_derive_aead(rx_secret, rx_iv);
+        Aes128 *tx_cipher = aes_derive_aead(tx_secret, tx_iv);
+        if (!rx_cipher || !tx_cipher)
+        {
+            delete rx_cipher;
+            delete tx_cipher;
+            return NGTCP2_ERR_CALLBACK_FAILURE;
+        }
+
+        rx_aead_ctx->native_handle = rx_cipher;
+        tx_aead_ctx->native_handle = tx_cipher;
+
+        return 0;
+    }
+
+    /**
+     * 为 PROFILE_AES_128_GCM 的 `conn` 安装 1RTT 的收发密钥，成功时返回 0。
+     */
+    int install_aes_1rtt_keys(ngtcp2_conn *conn, bool is_server)
+    {
+        uint8_t client_secret[AES_SECRET_LEN], server_secret[AES_SECRET_LEN];
+        aes_prf(pre_shared_key, "quic client", client_secret, sizeof(client_secret));
+        aes_prf(pre_shared_key, "quic server", server_secret, sizeof(server_secret));
+
+        const uint8_t *rx_secret = (is_server ? client_secret : server_secret);
+        const uint8_t *tx_secret = (is_server ? server_secret : client_secret);
+
+        uint8_t rx_iv[Aes128::GCM_IV_LEN], tx_iv[Aes128::GCM_IV_LEN];
+        uint8_t rx_hp_key[Aes128::KEY_LEN], tx_hp_key[Aes128::KEY_LEN];
+        aes_prf(rx_secret, "quic hp", rx_hp_key, sizeof(rx_hp_key));
+        aes_prf(tx_secret, "quic hp", tx_hp_key, sizeof(tx_hp_key));
+
+        // 安装成功后这些 Aes128 对象由 ngtcp2 持有，通过 delete_crypto_aead_ctx_cb/delete_crypto_cipher_ctx_cb 释放
+        ngtcp2_crypto_aead_ctx rx_aead_ctx = {aes_derive_aead(rx_secret, rx_iv)};
+        ngtcp2_crypto_cipher_ctx rx_hp_ctx = {new (std::nothrow) Aes128(rx_hp_key)};
+        ngtcp2_crypto_aead_ctx tx_aead_ctx = {aes_derive_aead(tx_secret, tx_iv)};
+        ngtcp2_crypto_cipher_ctx tx_hp_ctx = {new (std::nothrow) Aes128(tx_hp_key)};
+
+        int ret = -1;
+        if (rx_aead_ctx.native_handle && rx_hp_ctx.native_handle && tx_aead_ctx.native_handle && tx_hp_ctx.native_handle)
+        {
+            ret = ngtcp2_conn_install_rx_key(conn, rx_secret, AES_SECRET_LEN, &rx_aead_ctx, rx_iv, sizeof(rx_iv), &rx_hp_ctx);
+            if (ret == 0)
+            {
+                rx_aead_ctx.native_handle = rx_hp_ctx.native_handle = nullptr;
+                ret = ngtcp2_conn_install_tx_key(conn, tx_secret, AES_SECRET_LEN, &tx_aead_ctx, tx_iv, sizeof(tx_iv), &tx_hp_ctx);
+                if (ret == 0)
+                    tx_aead_ctx.native_handle = tx_hp_ctx.native_handle = nullptr;
+            }
+        }
+
+        // 释放未能交给 ngtcp2 的对象
+        delete static_cast<Aes128 *>(rx_aead_ctx.native_handle);
+        delete static_cast<Aes128 *>(rx_hp_ctx.native_handle);
+        delete static_cast<Aes128 *>(tx_aead_ctx.native_handle);
+        delete static_cast<Aes128 *>(tx_hp_ctx.native_handle);
+
+        return ret;
+    }
 } /* ngtcp2_plaintext */
 
 namespace ngtcp2_plaintext
 {
-    void preset_fixed_dcid_scid(bool is_server, ngtcp2_cid &dcid, ngtcp2_cid &scid)
+    int set_pre_shared_key(const char *hex)
+    {
+        if (!hex || strlen(hex) != 2 * sizeof(pre_shared_key))
+            return -1;
+
+        for (size_t i = 0; i < sizeof(pre_shared_key); ++i)
+        {
+            unsigned int byte;
+            if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+                return -1;
+            pre_shared_key[i] = (uint8_t)byte;
+        }
+
+        pre_shared_key_set = true;
+        return 0;
+    }
+
+    void preset_fixed_dcid_scid(bool is_server, ngtcp2_cid &dcid, ngtcp2_cid &scid, Profile profile)
     {
         // 代表 client 端的 Connection ID，长度 18 个字节。
-        static const uint8_t client_cid[19] = "\xff\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
-                                              "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xff";
+        static const uint8_t fake_aead_client_cid[19] = "\xff\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+                                                        "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xff";
 
         // 代表 server 端的 Connection ID，长度 18 个字节。
-        static const uint8_t server_cid[19] = "\xee\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
-                                              "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xee";
+        static const uint8_t fake_aead_server_cid[19] = "\xee\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa"
+                                                        "\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xaa\xee";
+
+        // PROFILE_NULL 下 client/server 端的 Connection ID，与 PROFILE_FAKE_AEAD 的不同。
+        static const uint8_t null_client_cid[19] = "\xff\x55\x55\x55\x55\x55\x55\x55\x55"
+                                                   "\x55\x55\x55\x55\x55\x55\x55\x55\xff";
+        static const uint8_t null_server_cid[19] = "\xee\x55\x55\x55\x55\x55\x55\x55\x55"
+                                                   "\x55\x55\x55\x55\x55\x55\x55\x55\xee";
+
+        // PROFILE_AES_128_GCM 下 client/server 端的 Connection ID。
+        static const uint8_t aes_client_cid[19] = "\xff\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xa5"
+                                                  "\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xff";
+        static const uint8_t aes_server_cid[19] = "\xee\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xa5"
+                                                  "\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xa5\xee";
+
+        const uint8_t *client_cid = fake_aead_client_cid;
+        const uint8_t *server_cid = fake_aead_server_cid;
+        if (profile == PROFILE_NULL)
+            client_cid = null_client_cid, server_cid = null_server_cid;
+        else if (profile == PROFILE_AES_128_GCM)
+            client_cid = aes_client_cid, server_cid = aes_server_cid;
 
         if (is_server)
         {
-            ngtcp2_cid_init(&dcid, client_cid, sizeof(client_cid) - 1);
-            ngtcp2_cid_init(&scid, server_cid, sizeof(server_cid) - 1);
+            ngtcp2_cid_init(&dcid, client_cid, sizeof(fake_aead_client_cid) - 1);
+            ngtcp2_cid_init(&scid, server_cid, sizeof(fake_aead_server_cid) - 1);
         }
         else
         {
-            ngtcp2_cid_init(&dcid, server_cid, sizeof(server_cid) - 1);
-            ngtcp2_cid_init(&scid, client_cid, sizeof(client_cid) - 1);
+            ngtcp2_cid_init(&dcid, server_cid, sizeof(fake_aead_server_cid) - 1);
+            ngtcp2_cid_init(&scid, client_cid, sizeof(fake_aead_client_cid) - 1);
         }
     }
 
-    void set_ngtcp2_crypto_callbacks(bool isServer, ngtcp2_callbacks &callbacks)
+    void set_ngtcp2_crypto_callbacks(bool isServer, ngtcp2_callbacks &callbacks, Profile profile)
     {
         if (isServer)
             callbacks.recv_client_initial = ngtcp2_plaintext::recv_client_initial_cb;
@@ -300,6 +509,14 @@ namespace ngtcp2_plaintext
         callbacks.recv_retry = ngtcp2_plaintext::recv_retry_cb;
         callbacks.update_key = ngtcp2_plaintext::update_key_cb;
 
+        if (profile == PROFILE_AES_128_GCM)
+        {
+            callbacks.encrypt = ngtcp2_plaintext::aes_encrypt_cb;
+            callbacks.decrypt = ngtcp2_plaintext::aes_decrypt_cb;
+            callbacks.hp_mask = ngtcp2_plaintext::aes_hp_mask_cb;
+            callbacks.update_key = ngtcp2_plaintext::aes_update_key_cb;
+        }
+
         callbacks.delete_crypto_aead_ctx = ngtcp2_plaintext::delete_crypto_aead_ctx_cb;
         callbacks.delete_crypto_cipher_ctx = ngtcp2_plaintext::delete_crypto_cipher_ctx_cb;
 
@@ -357,10 +574,24 @@ namespace ngtcp2_plaintext
         const sockaddr *local_addr, socklen_t local_addrlen,
         const sockaddr *remote_addr, socklen_t remote_addrlen,
         const ngtcp2_callbacks &callbacks, const ngtcp2_settings &settings, const ngtcp2_transport_params &params,
-        void *user_data)
+        void *user_data, const ngtcp2_mem *mem, Profile profile)
     {
         ngtcp2_conn *conn = nullptr;
 
+        if (profile == PROFILE_AES_128_GCM)
+        {
+            if (!Aes128::is_supported())
+            {
+                fprintf(stderr, "Error [%s]: AES-NI/PCLMULQDQ is not supported by this CPU.\n", __func__);
+                return nullptr;
+            }
+            if (!pre_shared_key_set)
+            {
+                fprintf(stderr, "Error [%s]: pre-shared key is not set.\n", __func__);
+                return nullptr;
+            }
+        }
+
         ngtcp2_path_storage ps;
         ngtcp2_path_storage_init(&ps, local_addr, local_addrlen, remote_addr, remote_addrlen, nullptr);
 
@@ -368,7 +599,7 @@ namespace ngtcp2_plaintext
         {
             int ret = ngtcp2_conn_client_new(&conn, &dcid, &scid, &ps.path,
                                              NGTCP2_PROTO_VER_V1,
-                                             &callbacks, &settings, &params, /* mem = */ nullptr,
+                                             &callbacks, &settings, &params, mem,
                                              /* user_data = */ user_data);
             if (ret < 0)
                 return nullptr;
@@ -377,7 +608,7 @@ namespace ngtcp2_plaintext
         {
             int ret = ngtcp2_conn_server_new(&conn, &dcid, &scid, &ps.path,
                                              NGTCP2_PROTO_VER_V1,
-                                             &callbacks, &settings, &params, /* mem = */ nullptr,
+                                             &callbacks, &settings, &params, mem,
                                              /* user_data = */ user_data);
             if (ret < 0)
                 return nullptr;
@@ -385,7 +616,7 @@ namespace ngtcp2_plaintext
 
         /* Set crypto_ctx for Handshake/1RTT packet encryption. */
         ngtcp2_crypto_ctx crypto_ctx = {0};
-        crypto_ctx_tls(&crypto_ctx);
+        crypto_ctx_tls(&crypto_ctx, profile);
         ngtcp2_conn_set_crypto_ctx(conn, &crypto_ctx);
 
         /* Install packet protection keying materials for decrypting incoming Handshake packets. */
@@ -396,11 +627,24 @@ namespace ngtcp2_plaintext
         /* Install packet protection keying materials for encrypting outgoing Handshake packets. */
         ngtcp2_conn_install_tx_handshake_key(conn, &aead_ctx, null_iv, sizeof(null_iv), &hp_ctx);
 
-        /* Install packet protection keying materials for decrypting Short packets. */
-        ngtcp2_conn_install_rx_key(conn, null_secret, sizeof(null_secret), &aead_ctx, null_iv, sizeof(null_iv), &hp_ctx);
+        if (profile == PROFILE_AES_128_GCM)
+        {
+            /* Install packet protection keying materials derived from pre-shared key for Short packets. */
+            if (install_aes_1rtt_keys(conn, is_server) != 0)
+            {
+                fprintf(stderr, "Error [%s] [install_aes_1rtt_keys]: failed to install 1RTT keys.\n", __func__);
+                ngtcp2_conn_del(conn);
+                return nullptr;
+            }
+        }
+        else
+        {
+            /* Install packet protection keying materials for decrypting Short packets. */
+            ngtcp2_conn_install_rx_key(conn, null_secret, sizeof(null_secret), &aead_ctx, null_iv, sizeof(null_iv), &hp_ctx);
 
-        /* Install packet protection keying materials for encrypting Short packets. */
-        ngtcp2_conn_install_tx_key(conn, null_secret, sizeof(null_secret), &aead_ctx, null_iv, sizeof(null_iv), &hp_ctx);
+            /* Install packet protection keying materials for encrypting Short packets. */
+            ngtcp2_conn_install_tx_key(conn, null_secret, sizeof(null_secret), &aead_ctx, null_iv, sizeof(null_iv), &hp_ctx);
+        }
 
         /* 直接将连接的状态设置为已经 QUIC handshake 完毕 */
         conn->state = NGTCP2_CS_POST_HANDSHAKE;
@@ -408,6 +652,10 @@ namespace ngtcp2_plaintext
                        NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED |
                        NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED_HANDLED |
                        NGTCP2_CONN_FLAG_HANDSHAKE_CONFIRMED;
+        if (profile == PROFILE_NULL) // 1RTT packet 不再经过 encrypt/decrypt/hp_mask 回调函数
+            conn->flags |= NGTCP2_CONN_FLAG_NULL_PROTECTION;
+        else if (profile == PROFILE_AES_128_GCM) // 发送的 1RTT packet 由 application 在发送之前批量加密
+            conn->flags |= NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION;
         conn->dcid.current.flags |= NGTCP2_DCID_FLAG_PATH_VALIDATED;
 
         conn_set_scid_used(conn);
@@ -415,6 +663,7 @@ namespace ngtcp2_plaintext
         /* 由于没有握手阶段了，因此本端所存储的远端 transport params 需要手动设置 */
         ngtcp2_transport_params &remote_params = conn->remote.transport_params;
         set_default_ngtcp2_transport_params(!is_server, remote_params);
+        remote_params.max_udp_payload_size = params.max_udp_payload_size; // 假定两端配置了相同的 max_udp_payload_size
 
         conn->local.bidi.max_streams = remote_params.initial_max_streams_bidi; // 根据远端的设置，设定本端可以开启的双向 stream 的最大数量
         conn->local.uni.max_streams = remote_params.initial_max_streams_uni;   // 根据远端的设置，设定本端可以开启的单向 stream 的最大数量
@@ -434,7 +683,106 @@ namespace ngtcp2_plaintext
         // 该函数作用就是调用 callbacks.{handshake_completed, extend_max_local_streams_bidi, extend_max_local_streams_uni} 这三个回调函数。
         conn_handshake_completed(conn);
 
+        /* 开始 Path MTU Discovery */
+        // 同样由于跳过了 QUIC 握手阶段，ngtcp2 库不会自动开始 PMTUD，需要手动调用。
+        if (!settings.no_pmtud && conn_start_pmtud(conn) != 0)
+        {
+            fprintf(stderr, "Error [%s] [conn_start_pmtud]: failed to start PMTUD.\n", __func__);
+            ngtcp2_conn_del(conn);
+            return nullptr;
+        }
+
         return conn;
     }
 
+    bool is_tx_protection_deferred(const ngtcp2_conn *conn)
+    {
+        return (conn->flags & NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION) != 0;
+    }
+
+    bool is_tx_key_update_due(const ngtcp2_conn *conn)
+    {
+        // 与 conn_prepare_key_update 中发起 key update 的条件一致
+        const ngtcp2_pktns *pktns = &conn->pktns;
+        return pktns->crypto.tx.ckm && pktns->crypto.tx.ckm->use_count >= pktns->crypto.ctx.max_encryption;
+    }
+
+    int protect_tx_packets(const ngtcp2_conn *conn, uint8_t *const *pkts, const size_t *pktlens, size_t n)
+    {
+        constexpr size_t BATCH = 64;
+
+        const ngtcp2_pktns *pktns = &conn->pktns;
+        const ngtcp2_crypto_km *ckm = pktns->crypto.tx.ckm;
+        if (!ckm || ckm->iv.len != Aes128::GCM_IV_LEN)
+            return -1;
+
+        const Aes128 *aead = static_cast<const Aes128 *>(ckm->aead_ctx.native_handle);
+        const Aes128 *hp = static_cast<const Aes128 *>(pktns->crypto.tx.hp_ctx.native_handle);
+        if (!aead || !hp)
+            return -1;
+
+        size_t pn_offset = 1 + conn->dcid.current.cid.datalen;
+        int64_t last_pkt_num = pktns->tx.last_pkt_num;
+
+        Aes128::SealRequest reqs[BATCH];
+        const uint8_t *samples[BATCH];
+        uint8_t masks[BATCH][Aes128::BLOCK_LEN];
+
+        for (size_t begin = 0; begin < n; begin += BATCH)
+        {
+            size_t cnt = (n - begin < BATCH ? n - begin : BATCH);
+
+            for (size_t i = 0; i < cnt; ++i)
+            {
+                uint8_t *pkt = pkts[begin + i];
+                size_t pktlen = pktlens[begin + i];
+
+                // PROFILE_AES_128_GCM 下只会发送 1RTT packet（short header），每个 datagram 中只有一个 packet
+                if (pkt[0] & NGTCP2_HEADER_FORM_BIT)
+                    return -1;
+
+                size_t pkt_numlen = (size_t)(pkt[0] & NGTCP2_PKT_NUMLEN_MASK) + 1;
+                size_t hdlen = pn_offset + pkt_numlen;
+                if (pktlen < pn_offset + 4 + NGTCP2_HP_SAMPLELEN || pktlen < hdlen + Aes128::GCM_TAG_LEN)
+                    return -1;
+
+                // 由截断的 packet number 还原完整的 packet number：batch 中的 packet 都是最近写出的，不大于 last_pkt_num
+                int64_t truncated = 0;
+                for (size_t j = 0; j < pkt_numlen; ++j)
+                    truncated = (truncated << 8) | pkt[pn_offset + j];
+                int64_t win = (int64_t)1 << (8 * pkt_numlen);
+                int64_t pkt_num = (last_pkt_num & ~(win - 1)) | truncated;
+                if (pkt_num > last_pkt_num)
+                    pkt_num -= win;
+
+                // nonce = iv XOR packet number，Ref: RFC 9001 5.3
+                Aes128::SealRequest &req = reqs[i];
+                req.data = pkt;
+                req.aadlen = hdlen;
+                req.len = pktlen - hdlen - Aes128::GCM_TAG_LEN;
+                memcpy(req.nonce, ckm->iv.base, Aes128::GCM_IV_LEN);
+                for (size_t j = 0; j < 8; ++j)
+                    req.nonce[Aes128::GCM_IV_LEN - 1 - j] ^= (uint8_t)(pkt_num >> (8 * j));
+
+                samples[i] = pkt + pn_offset + 4;
+            }
+
+            // 先加密所有 packet 的 payload，再一次性为所有 packet 计算 header protection mask（sample 取自密文）
+            aead->gcm_seal_batch(reqs, cnt);
+            hp->hp_masks(samples, masks, cnt);
+
+            for (size_t i = 0; i < cnt; ++i)
+            {
+                uint8_t *pkt = reqs[i].data;
+                size_t pkt_numlen = reqs[i].aadlen - pn_offset;
+
+                pkt[0] ^= (masks[i][0] & 0x1f);
+                for (size_t j = 0; j < pkt_numlen; ++j)
+                    pkt[pn_offset + j] ^= masks[i][j + 1];
+            }
+        }
+
+        return 0;
+    }
+
 } /* ngtcp2_plaintext */
\ No newline at end of file
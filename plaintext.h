@@ -87,15 +87,40 @@ namespace ngtcp2_plaintext
 namespace ngtcp2_plaintext
 {
     /**
-     * 由于直接跳过了 QUIC handshake 阶段，因此必须为 client 和 server 端预设固定的 Connection ID。
+     * 明文传输模式下 1RTT packet 的保护方式（profile）。
+     * PROFILE_FAKE_AEAD：沿用 ngtcp2 单元测试的做法，每个 packet 带有 16 bytes 全零的 fake AEAD tag，并调用 encrypt/decrypt/hp_mask 回调函数。
+     * PROFILE_NULL：不做任何 packet protection，没有 AEAD tag，payload 原地收发，也不做 header protection（见 NGTCP2_CONN_FLAG_NULL_PROTECTION），
+     *               只应当在可信的网络（例如数据中心内部）中使用。
+     * PROFILE_AES_128_GCM：真正的 packet protection，AEAD 为 AES-128-GCM，header protection 为 AES-128-ECB（RFC 9001 5.3/5.4.3），
+     *                      由 Aes128（AES-NI）实现，密钥由两端预先共享的 PSK 派生（见 set_pre_shared_key）。
+     *                      发送的 1RTT packet 由 application 在发送之前批量加密（见 protect_tx_packets），接收的 packet 仍由 ngtcp2 逐个解密。
+     * 由于跳过了握手，两端无法在线协商 profile，因此 profile 被编码在预设的 Connection ID 中，
+     * 两端的 profile 不一致时，packet 会因为 DCID 不匹配而被对端丢弃，不会意外地互通。
      */
-    void preset_fixed_dcid_scid(bool is_server, ngtcp2_cid &dcid, ngtcp2_cid &scid);
+    enum Profile
+    {
+        PROFILE_FAKE_AEAD,
+        PROFILE_NULL,
+        PROFILE_AES_128_GCM,
+    };
+
+    /**
+     * 设置 PROFILE_AES_128_GCM 所使用的 pre-shared key，`hex` 为 32 个十六进制字符（16 bytes）。
+     * 必须在创建 ngtcp2_conn 之前调用，两端必须一致。成功时返回 0，`hex` 格式不正确时返回 -1。
+     */
+    int set_pre_shared_key(const char *hex);
+
+    /**
+     * 由于直接跳过了 QUIC handshake 阶段，因此必须为 client 和 server 端预设固定的 Connection ID，不同的 `profile` 使用不同的 Connection ID。
+     */
+    void preset_fixed_dcid_scid(bool is_server, ngtcp2_cid &dcid, ngtcp2_cid &scid, Profile profile = PROFILE_FAKE_AEAD);
 
     /**
      * 为 `callbacks` 设置其中 crypto 相关的那些回调函数（注意是明文传输模式下的）。
      * `is_server` 指明 `callbacks` 将会被用于创建 server 端还是 client 端的 ngtcp2_conn 对象。
+     * `profile` 必须与 create_handshaked_ngtcp2_conn 所使用的一致。
      */
-    void set_ngtcp2_crypto_callbacks(bool is_server, ngtcp2_callbacks &callbacks);
+    void set_ngtcp2_crypto_callbacks(bool is_server, ngtcp2_callbacks &callbacks, Profile profile = PROFILE_FAKE_AEAD);
 
     /**
      * 默认设置 `settings`，完成后应当可以被直接用于创建 ngtcp2_conn 对象。
@@ -109,6 +134,8 @@ namespace ngtcp2_plaintext
 
     /**
      * 创建一个 QUIC handshake 已完成的 ngtcp2_conn 对象。
+     * `mem` 为 lib ngtcp2 使用的内存分配器，为 nullptr 时使用 malloc/free。
+     * `profile` 为 1RTT packet 的保护方式，必须与 preset_fixed_dcid_scid 所使用的一致。
      */
     ngtcp2_conn *create_handshaked_ngtcp2_conn(
         bool is_server,
@@ -116,7 +143,25 @@ namespace ngtcp2_plaintext
         const sockaddr *local_addr, socklen_t local_addrlen,
         const sockaddr *remote_addr, socklen_t remote_addrlen,
         const ngtcp2_callbacks &callbacks, const ngtcp2_settings &settings, const ngtcp2_transport_params &params,
-        void *user_data);
+        void *user_data, const ngtcp2_mem *mem = nullptr, Profile profile = PROFILE_FAKE_AEAD);
+
+    /**
+     * 查询 `conn` 发送的 1RTT packet 是否需要由 application 在发送之前调用 protect_tx_packets 加密（见 NGTCP2_CONN_FLAG_DEFERRED_TX_PROTECTION）。
+     */
+    bool is_tx_protection_deferred(const ngtcp2_conn *conn);
+
+    /**
+     * 查询下一次调用 ngtcp2_conn_writev_stream 时 ngtcp2 是否会因为当前的 tx key 加密的 packet 数达到上限而发起 key update。
+     * key update 会立即销毁当前的 tx key，因此在此之前必须先加密并发送所有尚未加密的 packet。
+     */
+    bool is_tx_key_update_due(const ngtcp2_conn *conn);
+
+    /**
+     * 用 `conn` 当前的 1RTT tx key 批量地原地加密 `n` 个尚未加密的 1RTT packet（每个 packet 是一个 UDP datagram），
+     * 先对所有 packet 做 AEAD 加密，再一次性计算所有 packet 的 header protection mask。
+     * 这些 packet 必须是 `conn` 最近写出的、尚未经过 key update 的 packet。成功时返回 0，失败时返回 -1。
+     */
+    int protect_tx_packets(const ngtcp2_conn *conn, uint8_t *const *pkts, const size_t *pktlens, size_t n);
 
 } /* ngtcp2_plaintext */
 
@@ -0,0 +1,55 @@
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+/**
+ * USDT (User-level Statically Defined Tracing) 静态探针。
+ *
+ * 使用 cmake 命令选项 -DOPTION_ENABLE_USDT_PROBES=ON 开启，此时探针经由 <sys/sdt.h> 编译为一条 NOP 指令，
+ * 并在 ELF 的 .note.stapsdt 段中登记探针的位置与参数，只有在 bpftrace/perf 等工具 attach 上来时才会真正触发。
+ * 关闭时（默认）探针被展开为空语句，不产生任何代码。
+ *
+ * 所有探针的 provider 均为 ngtcp2_echo，例如：
+ *   bpftrace -e 'usdt:./server:ngtcp2_echo:pkt_recv { @bytes = hist(arg1); }'
+ *
+ * 探针列表（参数依次为 arg0, arg1, ...）：
+ *   conn_create     (Connection *connection)
+ *   conn_close      (Connection *connection, uint64_t error_code)
+ *   stream_open     (Connection *connection, int64_t stream_id)
+ *   stream_close    (Connection *connection, int64_t stream_id, uint64_t app_error_code)
+ *   pkt_recv        (Connection *connection, size_t pktlen)
+ *   pkt_send        (Connection *connection, size_t pktlen)
+ *   send_eagain     (Connection *connection, size_t pktlen)
+ *   stream_blocked  (Connection *connection, int64_t stream_id)
+ *   cwnd_blocked    (Connection *connection, int64_t stream_id)
+ *   expiry          (Connection *connection, uint64_t ts, int ret)
+ *   rx_queue_delay  (Connection *connection, uint64_t delay_ns)
+ *   rxq_drops       (Connection *connection, uint32_t new_drops, uint32_t total_drops)
+ *   busy_poll_spin  (Connection *connection, uint64_t spin_ns, size_t pkts)
+ */
+
+#ifdef ENABLE_USDT_PROBES
+
+#include <sys/sdt.h>
+
+#define ECHO_PROBE1(name, a1) DTRACE_PROBE1(ngtcp2_echo, name, a1)
+#define ECHO_PROBE2(name, a1, a2) DTRACE_PROBE2(ngtcp2_echo, name, a1, a2)
+#define ECHO_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(ngtcp2_echo, name, a1, a2, a3)
+
+#else /* !ENABLE_USDT_PROBES */
+
+#define ECHO_PROBE1(name, a1) \
+    do                        \
+    {                         \
+    } while (0)
+#define ECHO_PROBE2(name, a1, a2) \
+    do                            \
+    {                             \
+    } while (0)
+#define ECHO_PROBE3(name, a1, a2, a3) \
+    do                                \
+    {                                 \
+    } while (0)
+
+#endif /* ENABLE_USDT_PROBES */
+
+#endif /* __PROBES_H__ */
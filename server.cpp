@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <memory>
 #include <assert.h>
 #include <iostream>
@@ -21,7 +22,24 @@ namespace
 {
     constexpr size_t N_STREAMS_MAX_ONE_CONN = 5;
     constexpr size_t NGTCP2_SERVER_SCIDLEN = 18;
-    constexpr size_t BUF_SIZE = 1280;
+    constexpr ngtcp2_cc_algo CC_ALGO = NGTCP2_CC_ALGO_CUBIC;                    // 拥塞控制算法，选择 NGTCP2_CC_ALGO_BBR/BBR2 时 ngtcp2 会开启 packet pacing
+    constexpr bool USE_SO_TXTIME = true;                                        // 开启 packet pacing 时，是否通过 SO_TXTIME 让内核（fq qdisc）按时刻发送 packet，否则只由 ngtcp2 timer 在用户态做 pacing
+    constexpr int SOCKET_RCVBUF_SIZE = 0;                                       // socket 接收缓冲区的初始大小（bytes），0 表示使用系统默认值
+    constexpr int SOCKET_SNDBUF_SIZE = 0;                                       // socket 发送缓冲区的大小（bytes），0 表示使用系统默认值
+    constexpr size_t SOCKET_RCVBUF_AUTOSIZE_MAX = 16 * 1024 * 1024;             // 出现内核丢包时 socket 接收缓冲区自动扩容的上限，0 表示不自动扩容
+    constexpr bool USE_UDP_GSO = true;                                          // 是否将连续写出的多个 packet 合并为一次 sendmsg，由内核（或网卡）切分（UDP GSO）
+    constexpr size_t MAX_UDP_PAYLOAD_SIZE = 9000 - 48;                          // 收发 UDP payload 的长度上限（PMTUD 的探测上限），同时作为 max_udp_payload_size transport parameter 通告给对端
+    constexpr bool PMTUD_ENABLED = true;                                        // 是否开启 Path MTU Discovery，关闭时发送的 packet 不超过 1200 bytes
+    constexpr bool USE_MSG_ZEROCOPY = false;                                    // 是否对较大的 GSO batch 使用 MSG_ZEROCOPY 发送，省去用户态到内核的拷贝
+    constexpr bool COMPACT_CONNECTION = false;                                  // 是否开启 connection 的 compact 模式（arena 使用更小的 chunk），适用于大量长期空闲的 connection
+    constexpr ngtcp2_plaintext::Profile PLAINTEXT_PROFILE = ngtcp2_plaintext::PROFILE_FAKE_AEAD; // 1RTT packet 的保护方式，PROFILE_NULL 去掉 fake AEAD tag 与 header protection（仅用于可信网络），PROFILE_AES_128_GCM 使用 AES-NI 加密，两端必须一致
+    constexpr const char *PSK_ENV_NAME = "ECHO_PSK";                                              // PROFILE_AES_128_GCM 下从该环境变量读取 pre-shared key（32 个十六进制字符），两端必须一致
+    constexpr bool USE_CONNECTED_SOCKET = false;                                // 是否为建立的 connection 创建专属的 connected socket（SO_REUSEPORT + connect）
+    constexpr bool BUSY_POLL_ENABLED = false;                                   // 是否开启 busy-poll 模式（以 CPU 换取更低的时延）
+    constexpr ngtcp2_duration BUSY_POLL_BUDGET_MIN = 20 * NGTCP2_MICROSECONDS;  // busy-poll 模式下 spin budget 的下限
+    constexpr ngtcp2_duration BUSY_POLL_BUDGET_MAX = 500 * NGTCP2_MICROSECONDS; // busy-poll 模式下 spin budget 的上限
+    constexpr int SO_BUSY_POLL_USEC = 50;                                       // busy-poll 模式下 socket 的 SO_BUSY_POLL（us），在内核中轮询网卡队列的时长
+    constexpr bool PACING_ENABLED = (CC_ALGO == NGTCP2_CC_ALGO_BBR || CC_ALGO == NGTCP2_CC_ALGO_BBR2);
 } /* namespace */
 
 namespace
@@ -55,6 +73,17 @@ namespace
         return 0;
     }
 
+    // ngtcp2_callbacks: 当 stream 被关闭时，本函数会被调用。
+    int stream_close_cb(ngtcp2_conn *conn, uint32_t flags,
+                        int64_t stream_id, uint64_t app_error_code,
+                        void *user_data, void *stream_user_data)
+    {
+        auto connection = static_cast<Connection *>(user_data);
+        connection->on_stream_close(stream_id, app_error_code);
+
+        return 0;
+    }
+
     // ngtcp2_callbacks: 当本端发送出去的数据受到累计确认时，本函数会被调用。
     int acked_stream_data_offset_cb(ngtcp2_conn *conn,
                                     int64_t stream_id, uint64_t offset, uint64_t datalen,
@@ -110,9 +139,21 @@ namespace
         printf("Debug: func [%s] is called.\n", __func__);
         EchoServer *srv = static_cast<EchoServer *>(socket_fd_w->data);
 
+        refresh_loop_timestamp(); // 每轮 event loop 迭代采样一次时钟，整批 packet 的接收时间戳都不会超过该时刻
+
         srv->handle_incoming();
 
         auto connection = srv->get_connection();
+        if (connection == nullptr) // 收到的 packet 都被丢弃了（例如 DCID 不匹配），connection 尚未建立
+        {
+            printf("Debug [%s]: Now server's connection is null.\n", __func__);
+            return;
+        }
+
+        connection->handle_zerocopy_completions(); // 回收已发送完成的 zerocopy buffer
+
+        refresh_loop_timestamp(); // 处理完一批 packet 后重新采样，作为本轮 burst 的发送时刻
+
         int ret = connection->write();
         if (ret < 0)
         {
@@ -122,14 +163,60 @@ namespace
             return;
         }
 
+        ret = srv->busy_poll(); // 若开启了 busy-poll 模式，则继续轮询一段时间
+        if (ret < 0)
+        {
+            fprintf(stderr, "Error [%s] [srv->busy_poll]: ret = %d.\n", __func__, ret);
+            connection->close();
+            ev_break(loop, EVBREAK_ALL);
+            return;
+        }
+
+        if (connection->has_pending_tx()) // 有 packet 因 EAGAIN 未能发送，等待 socket fd 可写时再发送
+            ev_io_start(loop, &(srv->socket_fd_write_watcher));
+
         /* 设置下一次的 timer expire 事件（注意这里，不要忘记了） */
         ngtcp2_tstamp expiry = connection->get_expiry();
-        ngtcp2_tstamp now = timestamp();
+        ngtcp2_tstamp now = loop_timestamp();
         ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
         srv->ngtcp2_timer_watcher.repeat = t;
         ev_timer_again(EV_DEFAULT, &(srv->ngtcp2_timer_watcher));
     }
 
+    // libev event loop - io watcher callback：监测到 socket fd 可写时被调用，仅在 connection 有暂存的待发送 packet 时开启。
+    void socket_fd_write_cb(struct ev_loop *loop, ev_io *socket_fd_write_w, int revents)
+    {
+        EchoServer *srv = static_cast<EchoServer *>(socket_fd_write_w->data);
+        std::shared_ptr<Connection> connection = srv->get_connection();
+
+        if (connection == nullptr)
+        {
+            ev_io_stop(loop, socket_fd_write_w);
+            return;
+        }
+
+        refresh_loop_timestamp(); // 每轮 event loop 迭代采样一次时钟
+
+        int ret = connection->write(); // 先发送暂存的 packet，若全部发送完毕则继续写新的 packet
+        if (ret < 0)
+        {
+            fprintf(stderr, "Error [%s] [connection->write]: ret = %d.\n", __func__, ret);
+            connection->close();
+            ev_break(loop, EVBREAK_ALL);
+            return;
+        }
+
+        if (!connection->has_pending_tx())
+            ev_io_stop(loop, socket_fd_write_w);
+
+        /* 设置下一次的 timer expire 事件 */
+        ngtcp2_tstamp expiry = connection->get_expiry();
+        ngtcp2_tstamp now = loop_timestamp();
+        ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
+        srv->ngtcp2_timer_watcher.repeat = t;
+        ev_timer_again(loop, &(srv->ngtcp2_timer_watcher));
+    }
+
     // libev event loop - timer watcher callback：当驱动 ngtcp2 工作的 timer expire 时被调用。
     void timer_cb(struct ev_loop *loop, ev_timer *ngtcp2_timer_w, int revents)
     {
@@ -142,7 +229,7 @@ namespace
             return;
         }
 
-        int ret = connection->handle_expiry(timestamp());
+        int ret = connection->handle_expiry(refresh_loop_timestamp()); // 每轮 event loop 迭代采样一次时钟
         if (ret < 0)
         {
             fprintf(stderr, "Error [%s] [connection->handle_expiry (i.e. ngtcp2_conn_handle_expiry)]: ngtcp2_liberr = %s.\n", __func__, ngtcp2_strerror(ret));
@@ -164,9 +251,12 @@ namespace
             return;
         }
 
+        if (connection->has_pending_tx()) // 有 packet 因 EAGAIN 未能发送，等待 socket fd 可写时再发送
+            ev_io_start(loop, &(srv->socket_fd_write_watcher));
+
         /* 设置下一次的 timer expire 事件 */
         ngtcp2_tstamp expiry = connection->get_expiry();
-        ngtcp2_tstamp now = timestamp();
+        ngtcp2_tstamp now = loop_timestamp();
         ev_tstamp t = ((expiry <= now) ? 1e-9 : (static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS));
         ngtcp2_timer_w->repeat = t;
         ev_timer_again(EV_DEFAULT, ngtcp2_timer_w);
@@ -177,7 +267,11 @@ EchoServer::EchoServer()
     : connection(nullptr), socket_fd(-1),
       local_addr(), local_addrlen(0),
       callbacks{0}, settings{0}, params{0}, dcid{0}, scid{0},
-      socket_fd_watcher(), ngtcp2_timer_watcher()
+      txtime_enabled(false), gso_enabled(false), zerocopy_enabled(false),
+      connected_socket_enabled(false), conn_socket_fd(-1),
+      busy_poll_budget(0), busy_poll_budget_min(0), busy_poll_budget_max(0),
+      busy_poll_spin_ns(0), busy_poll_spin_count(0), busy_poll_spin_pkts(0),
+      socket_fd_watcher(), socket_fd_write_watcher(), ngtcp2_timer_watcher(), conn_socket_fd_watcher()
 {
 }
 
@@ -191,58 +285,162 @@ void EchoServer::prepare_for_create_connection()
     this->callbacks.recv_stream_data = recv_stream_data_cb;
     this->callbacks.acked_stream_data_offset = acked_stream_data_offset_cb;
     this->callbacks.stream_open = stream_open_cb;
+    this->callbacks.stream_close = stream_close_cb;
     this->callbacks.rand = rand_cb;
     this->callbacks.get_new_connection_id = get_new_connection_id_cb;
-    ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(true, this->callbacks);
+    ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(true, this->callbacks, PLAINTEXT_PROFILE);
 
-    ngtcp2_plaintext::set_default_ngtcp2_settings(true, this->settings, log_printf, timestamp());
+    ngtcp2_plaintext::set_default_ngtcp2_settings(true, this->settings, log_printf, loop_timestamp()); // 不能晚于之后传给 ngtcp2 的时间戳
+    this->settings.cc_algo = CC_ALGO;
+    this->settings.max_udp_payload_size = MAX_UDP_PAYLOAD_SIZE;
+    this->settings.no_pmtud = !PMTUD_ENABLED;
 
     ngtcp2_plaintext::set_default_ngtcp2_transport_params(true, this->params);
+    this->params.max_udp_payload_size = MAX_UDP_PAYLOAD_SIZE;
 
-    ngtcp2_plaintext::preset_fixed_dcid_scid(true, this->dcid, this->scid);
+    ngtcp2_plaintext::preset_fixed_dcid_scid(true, this->dcid, this->scid, PLAINTEXT_PROFILE);
 }
 
 std::shared_ptr<Connection> EchoServer::create_connection(const sockaddr *remote_addr, socklen_t remote_addrlen)
 {
-    auto connection = std::make_shared<Connection>(this->socket_fd, N_STREAMS_MAX_ONE_CONN);
+    auto connection = std::make_shared<Connection>(this->socket_fd, N_STREAMS_MAX_ONE_CONN, COMPACT_CONNECTION);
     connection->set_local_addr((sockaddr *)&(this->local_addr), this->local_addrlen);
     connection->set_remote_addr(remote_addr, remote_addrlen);
+    connection->set_txtime_enabled(this->txtime_enabled);
+    connection->set_gso_enabled(this->gso_enabled);
+    connection->set_zerocopy_enabled(this->zerocopy_enabled);
+    connection->set_recv_buf_autosize_max(SOCKET_RCVBUF_AUTOSIZE_MAX);
 
     ngtcp2_conn *conn = ngtcp2_plaintext::create_handshaked_ngtcp2_conn(
         true, this->dcid, this->scid,
         (sockaddr *)&this->local_addr, this->local_addrlen,
         remote_addr, remote_addrlen,
         this->callbacks, this->settings, this->params,
-        connection.get() /* user_data */
-    );
+        connection.get() /* user_data */,
+        connection->get_mem(), PLAINTEXT_PROFILE);
 
     if (!conn)
         return nullptr;
 
     connection->steal_ngtcp2_conn(conn);
+    ECHO_PROBE1(conn_create, connection.get());
+
+    if (this->connected_socket_enabled)
+        this->connect_socket(connection, remote_addr, remote_addrlen); // 失败时仍可使用 socket_fd 收发
+
     return (this->connection = connection);
 }
 
+void EchoServer::setup_socket(int sock_fd, int family)
+{
+    set_nonblock(sock_fd);
+    enable_recv_ecn(sock_fd, family);
+    if (PMTUD_ENABLED)
+        enable_pmtud_probe(sock_fd, family); // 由 ngtcp2 自行探测 path MTU
+    enable_rx_timestamp(sock_fd);
+    enable_rxq_ovfl(sock_fd);
+    set_socket_buffer_size(sock_fd, SOCKET_RCVBUF_SIZE, SOCKET_SNDBUF_SIZE);
+    if (BUSY_POLL_ENABLED)
+        enable_socket_busy_poll(sock_fd, SO_BUSY_POLL_USEC); // 若内核不支持，则只在用户态 spin
+    if (PACING_ENABLED && USE_SO_TXTIME)
+        this->txtime_enabled = (enable_so_txtime(sock_fd) == 0); // 若开启失败，则退回到只由 ngtcp2 timer 做 pacing
+    if (USE_UDP_GSO)
+        this->gso_enabled = (probe_udp_gso(sock_fd) == 0);
+    if (USE_MSG_ZEROCOPY)
+        this->zerocopy_enabled = (enable_zerocopy(sock_fd) == 0);
+}
+
+int EchoServer::connect_socket(std::shared_ptr<Connection> connection, const sockaddr *remote_addr, socklen_t remote_addrlen)
+{
+    int fd = create_connected_socket((sockaddr *)&this->local_addr, this->local_addrlen, remote_addr, remote_addrlen);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error [%s] [create_connected_socket]: fall back to the shared socket fd.\n", __func__);
+        return -1;
+    }
+    printf("Debug [%s]: open a connected socket fd = %d.\n", __func__, fd);
+
+    this->setup_socket(fd, this->local_addr.ss_family);
+    this->conn_socket_fd = fd;
+
+    connection->set_socket_fd(fd);
+    connection->set_socket_connected(true);
+    connection->set_txtime_enabled(this->txtime_enabled);
+    connection->set_gso_enabled(this->gso_enabled);
+    connection->set_zerocopy_enabled(this->zerocopy_enabled);
+
+    struct ev_loop *loop = EV_DEFAULT;
+
+    // 监测 conn_socket_fd 可读，与 socket_fd 共用同一个回调
+    ev_io_init(&(this->conn_socket_fd_watcher), socket_fd_cb, fd, EV_READ);
+    this->conn_socket_fd_watcher.data = this;
+    ev_io_start(loop, &(this->conn_socket_fd_watcher));
+
+    // connection 之后只通过 conn_socket_fd 发送，可写监测也随之切换
+    ev_io_stop(loop, &(this->socket_fd_write_watcher));
+    ev_io_set(&(this->socket_fd_write_watcher), fd, EV_WRITE);
+
+    return 0;
+}
+
 int EchoServer::handle_incoming()
 {
-    uint8_t buf[BUF_SIZE];
+    int n_pkts = 0;
+
+    // 先处理 connection 专属的 socket，再处理 socket_fd 中的 packet（新 connection 的，以及 connect 之前就已经排队的）
+    if (this->conn_socket_fd >= 0)
+    {
+        n_pkts = this->handle_incoming(this->conn_socket_fd);
+        if (n_pkts < 0)
+            return -1;
+    }
+
+    int n = this->handle_incoming(this->socket_fd);
+    if (n < 0)
+        return -1;
+
+    return n_pkts + n;
+}
+
+int EchoServer::handle_incoming(int sock_fd)
+{
+    PacketBuffer pb = PacketBuffer::acquire(); // 本次调用结束时归还给 slab
+    if (!pb)
+        return -1;
+
+    uint8_t *buf = pb.data();
+    int n_pkts = 0;
+
+    int64_t clock_offset = realtime_clock_offset();
+    uint32_t rxq_drops = 0;
 
     while (true)
     {
         sockaddr_storage remote_addr;
         socklen_t remote_addrlen = sizeof(remote_addr);
 
-        ssize_t n_read = recv_packet(this->socket_fd, buf, sizeof(buf),
-                                     (sockaddr *)&remote_addr, &remote_addrlen);
+        RecvPacketInfo info;
+
+        ssize_t n_read = recv_packet(sock_fd, buf, PacketBuffer::CAPACITY,
+                                     (sockaddr *)&remote_addr, &remote_addrlen, &info);
         if (n_read < 0)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK) // 由于 socket fd 被设定为非阻塞，返回 EAGAIN/EWOULDBLOCK 表示目前暂时读不到数据
-                return 0;
+            {
+                if (this->connection && this->connection->get_socket_fd() == sock_fd) // SO_RXQ_OVFL 是每个 socket 各自的累计值
+                {
+                    this->connection->update_rxq_drops(std::max(rxq_drops, this->connection->get_rxq_drops()));
+                }
+                return n_pkts;
+            }
 
             fprintf(stderr, "Error [%s] [recv_packet]: errno = %s.\n", __func__, strerror(errno));
             return -1;
         }
 
+        rxq_drops = std::max(rxq_drops, info.rxq_drops);
+        ++n_pkts;
+
         uint32_t version;
         const uint8_t *dcid, *scid;
         size_t dcid_len, scid_len;
@@ -262,6 +460,14 @@ int EchoServer::handle_incoming()
         if (!connection) // 若 connection 不存在则需要创建
         {
             this->prepare_for_create_connection();
+
+            // 预设的 Connection ID 编码了 PLAINTEXT_PROFILE，DCID 不匹配说明对端的 profile 与本端不一致（或者根本不是本程序的 client）
+            if (dcid_len != this->scid.datalen || memcmp(dcid, this->scid.data, dcid_len) != 0)
+            {
+                fprintf(stderr, "Error [%s]: DCID does not match, plaintext profile mismatch? drop the packet.\n", __func__);
+                continue;
+            }
+
             connection = this->create_connection((sockaddr *)&remote_addr, remote_addrlen);
 
             if (!connection) // 若 connection 创建失败
@@ -271,6 +477,8 @@ int EchoServer::handle_incoming()
             }
         }
 
+        ECHO_PROBE2(pkt_recv, connection.get(), n_read);
+
         ngtcp2_path path = {0};
         path.local.addr = (sockaddr *)&this->local_addr;
         path.local.addrlen = this->local_addrlen;
@@ -278,8 +486,9 @@ int EchoServer::handle_incoming()
         path.remote.addrlen = remote_addrlen;
 
         ngtcp2_pkt_info pi = {0}; // packet metadata
+        pi.ecn = info.ecn;
 
-        ret = connection->read_packet(path, pi, buf, n_read, timestamp());
+        ret = connection->read_packet(path, pi, buf, n_read, connection->get_rx_timestamp(info, clock_offset));
         if (ret < 0)
         {
             fprintf(stderr, "Error [%s] [ngtcp2_conn_read_pkt]: ngtcp2_liberr = %s.\n", __func__, ngtcp2_strerror(ret));
@@ -291,10 +500,91 @@ int EchoServer::handle_incoming()
     return 0;
 }
 
+void EchoServer::enable_busy_poll(ngtcp2_duration budget_min, ngtcp2_duration budget_max)
+{
+    this->busy_poll_budget_min = budget_min;
+    this->busy_poll_budget_max = std::max(budget_min, budget_max);
+    this->busy_poll_budget = budget_min;
+}
+
+int EchoServer::busy_poll()
+{
+    if (this->busy_poll_budget_min == 0 || !this->connection)
+        return 0;
+
+    if (this->busy_poll_budget == 0)
+    {
+        // 之前的 spin 都没有收到 packet，本次不 spin；但既然这次被唤醒了，说明又有流量了，下次以最小的 budget 重新开始 spin
+        this->busy_poll_budget = this->busy_poll_budget_min;
+        return 0;
+    }
+
+    std::shared_ptr<Connection> connection = this->connection;
+
+    ngtcp2_tstamp start = refresh_loop_timestamp();
+    ngtcp2_tstamp now = start;
+    ngtcp2_tstamp deadline = start + this->busy_poll_budget;
+    size_t n_pkts = 0;
+
+    while (now < deadline && !connection->get_is_closed())
+    {
+        int n = this->handle_incoming();
+        if (n < 0)
+            return -1;
+
+        now = refresh_loop_timestamp(); // spin 期间每轮都需要重新采样
+
+        bool expired = (connection->get_expiry() <= now);
+        if (expired) // 直接在 spin 中处理到期的 ngtcp2 timer，不必等 event loop 的 timer watcher
+        {
+            int ret = connection->handle_expiry(now);
+            if (ret < 0 && ngtcp2_err_is_fatal(ret))
+                return -1;
+        }
+
+        if ((n > 0 || expired) && connection->write() < 0)
+            return -1;
+
+        if (n > 0)
+        {
+            n_pkts += n;
+            deadline = std::max(deadline, now + this->busy_poll_budget_min); // 仍有流量，适当延长本次 spin
+        }
+
+        now = refresh_loop_timestamp();
+    }
+
+    this->busy_poll_spin_ns += now - start;
+    ++(this->busy_poll_spin_count);
+    this->busy_poll_spin_pkts += n_pkts;
+    ECHO_PROBE3(busy_poll_spin, connection.get(), now - start, n_pkts);
+
+    // 自适应调整 spin budget：有收获则翻倍，否则减半（直至为零）
+    ngtcp2_duration prev_budget = this->busy_poll_budget;
+    if (n_pkts)
+        this->busy_poll_budget = std::min(this->busy_poll_budget * 2, this->busy_poll_budget_max);
+    else
+        this->busy_poll_budget /= 2;
+
+    if (this->busy_poll_budget != prev_budget) // 每次 spin 的统计通过 USDT probe 获取，这里只在 budget 变化时输出
+        printf("Debug [%s]: spin %zu ns, %zu pkts, next budget = %zu ns (total: %zu spins, %zu ns, %zu pkts).\n", __func__,
+               now - start, n_pkts, this->busy_poll_budget,
+               this->busy_poll_spin_count, this->busy_poll_spin_ns, this->busy_poll_spin_pkts);
+
+    return 0;
+}
+
 int main()
 {
     EchoServer srv;
 
+    if (PLAINTEXT_PROFILE == ngtcp2_plaintext::PROFILE_AES_128_GCM &&
+        ngtcp2_plaintext::set_pre_shared_key(getenv(PSK_ENV_NAME)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [ngtcp2_plaintext::set_pre_shared_key]: environment variable %s must be 32 hex characters.\n", __func__, PSK_ENV_NAME);
+        return -1;
+    }
+
     /* Get local host & port from stdin */
     char local_host[50] = {0}, local_port[50] = {0};
     printf("Input local host & port:\n");
@@ -310,14 +600,18 @@ int main()
     int sock_fd = resolve_and_bind(
         (local_host[0] ? local_host : nullptr),
         (local_port[0] ? local_port : nullptr),
-        (sockaddr *)&local_addr, &local_addrlen);
+        (sockaddr *)&local_addr, &local_addrlen,
+        USE_CONNECTED_SOCKET);
     if (sock_fd < 0)
     {
         fprintf(stderr, "Error [%s] [resolve_and_connect]: ret = %d.\n", __func__, sock_fd);
         return -1;
     }
     printf("Debug: open a socket fd = %d.\n", sock_fd);
-    set_nonblock(sock_fd);
+    srv.setup_socket(sock_fd, local_addr.ss_family);
+    if (BUSY_POLL_ENABLED)
+        srv.enable_busy_poll(BUSY_POLL_BUDGET_MIN, BUSY_POLL_BUDGET_MAX);
+    srv.set_connected_socket_enabled(USE_CONNECTED_SOCKET);
     srv.set_socket_fd(sock_fd);
     srv.set_local_addr((sockaddr *)&local_addr, local_addrlen);
 
@@ -329,6 +623,10 @@ int main()
     srv.socket_fd_watcher.data = &srv;
     ev_io_start(loop, &srv.socket_fd_watcher);
 
+    // 监测 socket fd 可写的 io watcher，只有当 connection 有暂存的待发送 packet 时才会开启
+    ev_io_init(&(srv.socket_fd_write_watcher), socket_fd_write_cb, srv.get_socket_fd(), EV_WRITE);
+    srv.socket_fd_write_watcher.data = &srv;
+
     // 驱动 ngtcp2 工作的时钟
     ev_timer_init(&(srv.ngtcp2_timer_watcher), timer_cb, /*after = */ 0, /*repeat = */ 0);
     srv.ngtcp2_timer_watcher.data = &srv;
@@ -341,6 +639,8 @@ int main()
     ev_loop_destroy(loop);
 
     close(srv.get_socket_fd()); // 关闭 socket fd
+    if (srv.get_conn_socket_fd() >= 0)
+        close(srv.get_conn_socket_fd());
 
     return 0;
 }
\ No newline at end of file
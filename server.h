@@ -24,9 +24,30 @@ private:
     ngtcp2_transport_params params;
     ngtcp2_cid dcid, scid;
 
+    bool txtime_enabled;   // socket_fd 是否开启了 SO_TXTIME
+    bool gso_enabled;      // socket_fd 是否支持 UDP GSO
+    bool zerocopy_enabled; // socket_fd 是否开启了 SO_ZEROCOPY
+
+    // connected socket 模式：connection 建立后，为其创建一个绑定在同一本端地址（SO_REUSEPORT）并 connect 到远端的 socket，
+    // 由内核按四元组分发 packet 并缓存路由，之后 connection 只通过该 socket 收发 packet，socket_fd 仅用于接收新的 connection。
+    bool connected_socket_enabled;
+    int conn_socket_fd; // connection 专属的 connected socket fd，未创建时为 -1
+
+    // busy-poll 模式：每次 socket_fd 可读被唤醒并处理完之后，继续以非阻塞方式轮询 socket_fd 一段时间（spin budget），
+    // 在此期间直接检查并处理 ngtcp2 timer，以 CPU 换取每次往返中 event loop 的唤醒时延。
+    // spin 期间收到了 packet 则 budget 翻倍，否则减半直至为零，避免在空闲时占满一个 CPU 核。
+    ngtcp2_duration busy_poll_budget;     // 当前的 spin budget，为 0 时本次不 spin
+    ngtcp2_duration busy_poll_budget_min; // spin budget 的下限，为 0 表示关闭 busy-poll 模式
+    ngtcp2_duration busy_poll_budget_max; // spin budget 的上限
+    uint64_t busy_poll_spin_ns;           // 统计：累计 spin 的时长
+    uint64_t busy_poll_spin_count;        // 统计：累计 spin 的次数
+    uint64_t busy_poll_spin_pkts;         // 统计：spin 期间累计收到的 packet 数量
+
 public:
     ev_io socket_fd_watcher;       // libev 中，用来监测 socket_fd 可读的 io watcher
+    ev_io socket_fd_write_watcher; // libev 中，用来监测 socket_fd 可写的 io watcher，仅在 connection 有暂存的待发送 packet 时开启
     ev_timer ngtcp2_timer_watcher; // libev 中，用来驱动 ngtcp2 工作的时钟
+    ev_io conn_socket_fd_watcher;  // libev 中，用来监测 conn_socket_fd 可读的 io watcher
 
 public:
     EchoServer();
@@ -41,6 +62,22 @@ public:
     // 设置 server 的 socket fd。
     inline void set_socket_fd(int sock_fd) { this->socket_fd = sock_fd; }
 
+    // 为 server 使用的 socket fd（socket_fd 以及 conn_socket_fd）设置 socket 选项，并记录 SO_TXTIME、UDP GSO 等是否可用。
+    void setup_socket(int sock_fd, int family);
+
+    // 开启 connected socket 模式，socket_fd 需要在 bind 之前开启 SO_REUSEPORT。
+    inline void set_connected_socket_enabled(bool enabled) { this->connected_socket_enabled = enabled; }
+
+    // 获取 connection 专属的 connected socket fd，未创建时为 -1。
+    inline int get_conn_socket_fd() const { return this->conn_socket_fd; }
+
+    // 指明 socket_fd 是否已经开启了 SO_TXTIME，之后创建的 connection 会据此为 packet 指定发送时刻。
+    inline void set_txtime_enabled(bool enabled) { this->txtime_enabled = enabled; }
+
+    // 指明 socket_fd 是否支持 UDP GSO、是否开启了 SO_ZEROCOPY，之后创建的 connection 会据此合并发送 packet。
+    inline void set_gso_enabled(bool enabled) { this->gso_enabled = enabled; }
+    inline void set_zerocopy_enabled(bool enabled) { this->zerocopy_enabled = enabled; }
+
     // 获取 server 用来收发数据的 socket fd。
     inline int get_socket_fd() const { return this->socket_fd; }
 
@@ -50,11 +87,30 @@ public:
         this->local_addrlen = local_addrlen;
     }
 
-    // 从 socket_fd 取出 packet 并进行处理。
+    // 从 conn_socket_fd（若有）以及 socket_fd 取出 packet 并进行处理，返回处理的 packet 数量，出错时返回 -1。
     int handle_incoming();
 
+    // 开启 busy-poll 模式，spin budget 在 [budget_min, budget_max] 之间自适应调整。
+    void enable_busy_poll(ngtcp2_duration budget_min, ngtcp2_duration budget_max);
+
+    // 在 socket_fd 可读被处理之后调用：在 spin budget 内轮询 socket_fd 并处理到期的 ngtcp2 timer。
+    // 未开启 busy-poll 模式时什么也不做。返回 -1 表示 connection 发生了错误，需要关闭。
+    int busy_poll();
+
+    // 查询 busy-poll 的统计数据。
+    inline uint64_t get_busy_poll_spin_ns() const { return this->busy_poll_spin_ns; }
+    inline uint64_t get_busy_poll_spin_count() const { return this->busy_poll_spin_count; }
+    inline uint64_t get_busy_poll_spin_pkts() const { return this->busy_poll_spin_pkts; }
+
     inline std::shared_ptr<Connection> get_connection() const { return this->connection; }
     inline void set_connection(std::shared_ptr<Connection> connection) { this->connection = connection; }
+
+private:
+    // 从 sock_fd 取出 packet 并进行处理，返回处理的 packet 数量，出错时返回 -1。
+    int handle_incoming(int sock_fd);
+
+    // 为 connection 创建 connected socket，并将其收发以及 io watcher 切换到该 socket 上。失败时 connection 继续使用 socket_fd。
+    int connect_socket(std::shared_ptr<Connection> connection, const sockaddr *remote_addr, socklen_t remote_addrlen);
 };
 
 #endif /* __SERVER_H__ */
\ No newline at end of file
@@ -3,7 +3,7 @@
 #include "stream.h"
 
 Stream::Stream(int64_t stream_id)
-    : id(stream_id), buf{0}, buf_head(0), buf_size(0), nsent_offset(0), acked_offset(0)
+    : id(stream_id), buf(), buf_head(0), buf_size(0), nsent_offset(0), acked_offset(0)
 {
 }
 
@@ -14,6 +14,9 @@ size_t Stream::push_data(const uint8_t *data, size_t data_len)
 
     size_t actual_len = std::min(data_len, get_buf_rmcp());
 
+    if (!buf) // 第一次写入数据（或之前的数据已全部被确认）时才分配 buf
+        buf.reset(new uint8_t[STREAM_BUF_CAPACITY]);
+
     size_t buf_tail = get_buf_tail();
     for (size_t i = 0; i < actual_len; ++i)
         buf[(buf_tail + i) % STREAM_BUF_CAPACITY] = data[i];
@@ -35,7 +38,7 @@ const uint8_t *Stream::peek_tosd_data(size_t &data_size) const
     size_t tosd_begin = (buf_head + get_sent_size()) % STREAM_BUF_CAPACITY; // 待发送数据的起始位置
 
     data_size = std::min(STREAM_BUF_CAPACITY - tosd_begin, tosd_size); // 由于循环向量的限制，不一定可以取到全部的待发送数据
-    return buf + tosd_begin;
+    return buf.get() + tosd_begin;
 }
 
 int Stream::mark_sent(size_t increment)
@@ -65,6 +68,12 @@ int Stream::mark_acked(size_t new_acked_offset)
 
         buf_head += increment, buf_head %= STREAM_BUF_CAPACITY;
         buf_size -= increment;
+
+        if (buf_size == 0) // 数据已全部被确认，释放 buf，之后再有数据写入时重新分配
+        {
+            buf.reset();
+            buf_head = 0;
+        }
     }
 
     return 0;
@@ -3,6 +3,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 
 class Stream
 {
@@ -12,10 +13,12 @@ public:
 private:
     int64_t id; // Stream ID
 
-    uint8_t buf[STREAM_BUF_CAPACITY]; // 循环向量
+    // 循环向量，长度为 STREAM_BUF_CAPACITY。只在有数据写入时才分配，数据全部被确认后立即释放，
+    // 因此空闲的 stream 只占用这个对象本身（几十个字节）。
+    std::unique_ptr<uint8_t[]> buf;
 
-    size_t buf_head; // buf 中数据的首地址，是 buf 的某个下标，范围 [0, STREAM_BUF_CAPACITY)。
-    size_t buf_size; // buf 中数据的长度，范围 [0, STREAM_BUF_CAPACITY]。
+    uint32_t buf_head; // buf 中数据的首地址，是 buf 的某个下标，范围 [0, STREAM_BUF_CAPACITY)。
+    uint32_t buf_size; // buf 中数据的长度，范围 [0, STREAM_BUF_CAPACITY]。
 
     size_t nsent_offset; // 指示在该 stream 中全部已发送的数据的长度，开区间，单调递增。
     size_t acked_offset; // 指示在该 stream 中全部已确认的数据的长度，开区间，单调递增。
@@ -31,6 +34,9 @@ public:
 
     inline size_t get_buf_size() const { return buf_size; }
 
+    // 查询 stream 当前是否持有 buf（即是否有尚未被确认的数据）。
+    inline bool has_buf() const { return (bool)buf; }
+
     // 获取 stream 的 buf 的剩余容量。
     inline size_t get_buf_rmcp() const { return STREAM_BUF_CAPACITY - buf_size; }
 
@@ -50,8 +56,12 @@ public:
     // 更新已发送的数据的位置。
     int mark_sent(size_t increment);
 
-    // 更新已确认的数据的位置。
+    // 更新已确认的数据的位置。若 buf 中的数据已经全部被确认，则释放 buf。
     int mark_acked(size_t new_acked_offset);
+
+private:
+    Stream(const Stream &rhs) = delete;            // no copy
+    Stream &operator=(const Stream &rhs) = delete; // no assignment
 };
 
 #endif /* __STREAM_H__ */
\ No newline at end of file
@@ -0,0 +1,433 @@
+// Aes128（AES-128-GCM 与 AES-128-ECB）的正确性测试。
+// AES-NI 的 8 分组路径与 VAES 的 16 分组路径（CPU 支持时）通过 Aes128::set_vaes 强制选择，分别运行以下检查：
+// 1. NIST 的 known-answer 向量：FIPS-197 附录 C.1（AES-128-ECB），以及 GCM 规范（McGrew & Viega）中 AES-128、96 bits IV 的 Test Case 1～4；
+// 2. 随机的 key、nonce、AAD 与长度（覆盖 8/16 个分组的主循环以及不足一个分组的尾部）：gcm_seal 的结果必须与测试中的软件实现一致，
+//    gcm_open 必须还原出明文（原地与非原地），篡改密文、AAD 或 tag 的任何一个字节后 gcm_open 必须失败；
+// 3. gcm_seal_batch 的结果必须与逐个调用 gcm_seal 一致，hp_masks 的结果必须与 encrypt_blocks 一致。
+// 软件实现逐字节地实现 AES 与 GHASH（SP 800-38D），本身先通过上面的 NIST 向量验证。
+// CPU 不支持 AES-NI 时跳过测试，不支持 VAES 时只测试 AES-NI 路径。
+// 用法：aes128_gcm_test [SEED]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "aes128.h"
+
+namespace
+{
+    constexpr size_t N_RANDOM_ROUNDS = 2000;  // 每条路径随机测试的轮数
+    constexpr size_t MAX_RANDOM_LEN = 2048;   // 随机明文的长度上限
+    constexpr size_t MAX_RANDOM_AADLEN = 64;  // 随机 AAD 的长度上限
+    constexpr size_t N_BATCH_ROUNDS = 200;    // 每条路径 batch 测试的轮数
+    constexpr size_t MAX_BATCH_SIZE = 64;     // 一个 batch 中 packet 数量的上限
+    constexpr size_t MAX_BATCH_PKTLEN = 1500; // batch 中 packet 的长度上限
+
+    int failures = 0;
+
+#define CHECK(cond)                                                                                     \
+    do                                                                                                  \
+    {                                                                                                   \
+        if (!(cond))                                                                                    \
+        {                                                                                               \
+            fprintf(stderr, "Error [%s]: CHECK(%s) failed at line %d.\n", __func__, #cond, __LINE__); \
+            if (++failures > 10)                                                                        \
+                exit(1);                                                                                \
+        }                                                                                               \
+    } while (0)
+
+    // xorshift64*，相同的 seed 在任何机器上产生相同的输入
+    uint64_t rng_state;
+
+    uint64_t rnd64()
+    {
+        rng_state ^= rng_state >> 12;
+        rng_state ^= rng_state << 25;
+        rng_state ^= rng_state >> 27;
+        return rng_state * 2685821657736338717ULL;
+    }
+
+    size_t rnd(size_t n) { return (size_t)(rnd64() % n); }
+
+    void rnd_fill(uint8_t *data, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+            data[i] = (uint8_t)rnd64();
+    }
+
+    std::vector<uint8_t> from_hex(const char *hex)
+    {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; hex[i] && hex[i + 1]; i += 2)
+        {
+            unsigned int byte;
+            sscanf(hex + i, "%2x", &byte);
+            out.push_back((uint8_t)byte);
+        }
+        return out;
+    }
+
+    // ===== 软件实现的 AES-128 与 GCM（只用于对照，不追求速度） =====
+
+    class RefAes128Gcm
+    {
+    private:
+        uint8_t sbox[256];
+        uint8_t round_keys[11][16];
+        uint8_t h[16];
+
+        static uint8_t rotl8(uint8_t x, int shift) { return (uint8_t)((x << shift) | (x >> (8 - shift))); }
+
+        static uint8_t xtime(uint8_t x) { return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0)); }
+
+        // 由 GF(2^8) 的乘法逆元与仿射变换计算 S-box，避免手抄常量表出错
+        void init_sbox()
+        {
+            uint8_t p = 1, q = 1;
+            do
+            {
+                p = (uint8_t)(p ^ xtime(p)); // p *= 3
+                q ^= (uint8_t)(q << 1);      // q /= 3
+                q ^= (uint8_t)(q << 2);
+                q ^= (uint8_t)(q << 4);
+                if (q & 0x80)
+                    q ^= 0x09;
+                sbox[p] = (uint8_t)(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+            } while (p != 1);
+            sbox[0] = 0x63;
+        }
+
+        // GF(2^128) 上的乘法（SP 800-38D Algorithm 1），x = x * y
+        static void gf_mul(uint8_t *x, const uint8_t *y)
+        {
+            uint8_t z[16] = {0}, v[16];
+            memcpy(v, y, 16);
+            for (int i = 0; i < 128; ++i)
+            {
+                if (x[i / 8] & (0x80 >> (i % 8)))
+                    for (int j = 0; j < 16; ++j)
+                        z[j] ^= v[j];
+                bool lsb = v[15] & 1;
+                for (int j = 15; j > 0; --j)
+                    v[j] = (uint8_t)((v[j] >> 1) | (v[j - 1] << 7));
+                v[0] >>= 1;
+                if (lsb)
+                    v[0] ^= 0xe1;
+            }
+            memcpy(x, z, 16);
+        }
+
+        void ghash_update(uint8_t *s, const uint8_t *data, size_t len) const
+        {
+            for (size_t i = 0; i < len; i += 16)
+            {
+                for (size_t j = 0; j < 16 && i + j < len; ++j)
+                    s[j] ^= data[i + j];
+                gf_mul(s, this->h);
+            }
+        }
+
+    public:
+        RefAes128Gcm(const uint8_t *key)
+        {
+            init_sbox();
+
+            memcpy(round_keys[0], key, 16);
+            uint8_t rcon = 1;
+            for (int r = 1; r <= 10; ++r)
+            {
+                const uint8_t *prev = round_keys[r - 1];
+                uint8_t t[4] = {sbox[prev[13]], sbox[prev[14]], sbox[prev[15]], sbox[prev[12]]};
+                t[0] ^= rcon;
+                rcon = xtime(rcon);
+                for (int i = 0; i < 16; ++i)
+                    round_keys[r][i] = (uint8_t)(prev[i] ^ (i < 4 ? t[i] : round_keys[r][i - 4]));
+            }
+
+            uint8_t zero[16] = {0};
+            encrypt_block(zero, this->h);
+        }
+
+        void encrypt_block(const uint8_t *in, uint8_t *out) const
+        {
+            uint8_t s[16], t[16];
+            for (int i = 0; i < 16; ++i)
+                s[i] = in[i] ^ round_keys[0][i];
+
+            for (int r = 1; r <= 10; ++r)
+            {
+                // SubBytes + ShiftRows（state 按列存放，s[4 * c + row]）
+                for (int c = 0; c < 4; ++c)
+                    for (int row = 0; row < 4; ++row)
+                        t[4 * c + row] = sbox[s[4 * ((c + row) % 4) + row]];
+                // MixColumns（最后一轮没有）
+                if (r != 10)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        uint8_t *col = t + 4 * c;
+                        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3], all = (uint8_t)(a0 ^ a1 ^ a2 ^ a3);
+                        col[0] ^= (uint8_t)(all ^ xtime((uint8_t)(a0 ^ a1)));
+                        col[1] ^= (uint8_t)(all ^ xtime((uint8_t)(a1 ^ a2)));
+                        col[2] ^= (uint8_t)(all ^ xtime((uint8_t)(a2 ^ a3)));
+                        col[3] ^= (uint8_t)(all ^ xtime((uint8_t)(a3 ^ a0)));
+                    }
+                }
+                for (int i = 0; i < 16; ++i)
+                    s[i] = t[i] ^ round_keys[r][i];
+            }
+
+            memcpy(out, s, 16);
+        }
+
+        // 与 Aes128::gcm_seal 的约定相同：密文写到 dest，tag 写到 dest + len
+        void gcm_seal(uint8_t *dest, const uint8_t *plaintext, size_t len,
+                      const uint8_t *nonce, const uint8_t *aad, size_t aadlen) const
+        {
+            uint8_t j0[16] = {0}, ctr[16], ks[16], s[16] = {0}, lens[16];
+            memcpy(j0, nonce, 12);
+            j0[15] = 1;
+            memcpy(ctr, j0, 16);
+
+            for (size_t i = 0; i < len; i += 16)
+            {
+                for (int k = 15; k >= 12 && ++ctr[k] == 0; --k)
+                    ;
+                encrypt_block(ctr, ks);
+                for (size_t j = 0; j < 16 && i + j < len; ++j)
+                    dest[i + j] = plaintext[i + j] ^ ks[j];
+            }
+
+            ghash_update(s, aad, aadlen);
+            ghash_update(s, dest, len);
+            uint64_t abits = (uint64_t)aadlen * 8, cbits = (uint64_t)len * 8;
+            for (int i = 0; i < 8; ++i)
+            {
+                lens[i] = (uint8_t)(abits >> (56 - 8 * i));
+                lens[8 + i] = (uint8_t)(cbits >> (56 - 8 * i));
+            }
+            ghash_update(s, lens, 16);
+
+            encrypt_block(j0, ks);
+            for (int i = 0; i < 16; ++i)
+                dest[len + i] = s[i] ^ ks[i];
+        }
+    };
+
+    // ===== 测试 =====
+
+    const char *path_name(bool vaes) { return vaes ? "VAES" : "AES-NI"; }
+
+    // FIPS-197 附录 C.1
+    void test_ecb_vector(bool vaes)
+    {
+        std::vector<uint8_t> key = from_hex("000102030405060708090a0b0c0d0e0f");
+        std::vector<uint8_t> pt = from_hex("00112233445566778899aabbccddeeff");
+        std::vector<uint8_t> ct = from_hex("69c4e0d86a7b0430d8cdb78070b4c55a");
+
+        Aes128 aes(key.data());
+        CHECK(aes.set_vaes(vaes) == vaes);
+        RefAes128Gcm ref(key.data());
+
+        uint8_t out[Aes128::BLOCK_LEN];
+        aes.encrypt_blocks(pt.data(), out, 1);
+        CHECK(memcmp(out, ct.data(), sizeof(out)) == 0);
+
+        ref.encrypt_block(pt.data(), out);
+        CHECK(memcmp(out, ct.data(), sizeof(out)) == 0);
+    }
+
+    struct GcmVector
+    {
+        const char *key, *nonce, *aad, *plaintext, *ciphertext, *tag;
+    };
+
+    // GCM 规范（The Galois/Counter Mode of Operation, McGrew & Viega）附录 B 的 Test Case 1～4
+    const GcmVector GCM_VECTORS[] = {
+        {"00000000000000000000000000000000", "000000000000000000000000", "", "", "",
+         "58e2fccefa7e3061367f1d57a4e7455a"},
+        {"00000000000000000000000000000000", "000000000000000000000000", "",
+         "00000000000000000000000000000000", "0388dace60b6a392f328c2b971b2fe78",
+         "ab6e47d42cec13bdf53a67b21257bddf"},
+        {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888", "",
+         "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+         "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+         "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+         "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+         "4d5c2af327cd64a62cf35abd2ba6fab4"},
+        {"feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+         "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+         "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+         "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+         "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+         "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+         "5bc94fbc3221a5db94fae95ae7121a47"},
+    };
+
+    void test_gcm_vectors(bool vaes)
+    {
+        for (const GcmVector &v : GCM_VECTORS)
+        {
+            std::vector<uint8_t> key = from_hex(v.key), nonce = from_hex(v.nonce), aad = from_hex(v.aad);
+            std::vector<uint8_t> pt = from_hex(v.plaintext), expected = from_hex(v.ciphertext), tag = from_hex(v.tag);
+            expected.insert(expected.end(), tag.begin(), tag.end());
+
+            Aes128 aes(key.data());
+            aes.set_vaes(vaes);
+            RefAes128Gcm ref(key.data());
+
+            std::vector<uint8_t> out(pt.size() + Aes128::GCM_TAG_LEN);
+            aes.gcm_seal(out.data(), pt.data(), pt.size(), nonce.data(), aad.data(), aad.size());
+            CHECK(out == expected);
+
+            ref.gcm_seal(out.data(), pt.data(), pt.size(), nonce.data(), aad.data(), aad.size());
+            CHECK(out == expected);
+
+            // 多留一个字节，使 pt 为空时 opened.data() 也不是空指针
+            std::vector<uint8_t> opened(pt.size() + 1);
+            CHECK(aes.gcm_open(opened.data(), expected.data(), expected.size(), nonce.data(), aad.data(), aad.size()) == 0);
+            opened.resize(pt.size());
+            CHECK(opened == pt);
+
+            opened.resize(pt.size() + 1);
+            expected.back() ^= 1;
+            CHECK(aes.gcm_open(opened.data(), expected.data(), expected.size(), nonce.data(), aad.data(), aad.size()) == -1);
+        }
+    }
+
+    void test_random(bool vaes)
+    {
+        std::vector<uint8_t> pt(MAX_RANDOM_LEN), aad(MAX_RANDOM_AADLEN);
+        std::vector<uint8_t> out(MAX_RANDOM_LEN + Aes128::GCM_TAG_LEN), expected(out.size()), opened(MAX_RANDOM_LEN + 1);
+
+        for (size_t round = 0; round < N_RANDOM_ROUNDS; ++round)
+        {
+            uint8_t key[Aes128::KEY_LEN], nonce[Aes128::GCM_IV_LEN];
+            rnd_fill(key, sizeof(key));
+            rnd_fill(nonce, sizeof(nonce));
+
+            // 一半的轮次使用 QUIC packet 常见的长度附近的值，另一半均匀分布
+            size_t len = (round % 2 ? rnd(MAX_RANDOM_LEN + 1) : 1200 - 8 + rnd(17));
+            size_t aadlen = rnd(MAX_RANDOM_AADLEN + 1);
+            rnd_fill(pt.data(), len);
+            rnd_fill(aad.data(), aadlen);
+
+            Aes128 aes(key);
+            aes.set_vaes(vaes);
+            RefAes128Gcm ref(key);
+
+            ref.gcm_seal(expected.data(), pt.data(), len, nonce, aad.data(), aadlen);
+            aes.gcm_seal(out.data(), pt.data(), len, nonce, aad.data(), aadlen);
+            CHECK(memcmp(out.data(), expected.data(), len + Aes128::GCM_TAG_LEN) == 0);
+
+            // 非原地解密
+            CHECK(aes.gcm_open(opened.data(), out.data(), len + Aes128::GCM_TAG_LEN, nonce, aad.data(), aadlen) == 0);
+            CHECK(memcmp(opened.data(), pt.data(), len) == 0);
+
+            // 原地加密与解密
+            memcpy(out.data(), pt.data(), len);
+            aes.gcm_seal(out.data(), out.data(), len, nonce, aad.data(), aadlen);
+            CHECK(memcmp(out.data(), expected.data(), len + Aes128::GCM_TAG_LEN) == 0);
+            CHECK(aes.gcm_open(out.data(), out.data(), len + Aes128::GCM_TAG_LEN, nonce, aad.data(), aadlen) == 0);
+            CHECK(memcmp(out.data(), pt.data(), len) == 0);
+
+            // 篡改密文（含 tag）或 AAD 中的一个字节
+            memcpy(out.data(), expected.data(), len + Aes128::GCM_TAG_LEN);
+            size_t pos = rnd(len + Aes128::GCM_TAG_LEN + aadlen);
+            uint8_t flip = (uint8_t)(1 + rnd(255));
+            if (pos < len + Aes128::GCM_TAG_LEN)
+                out[pos] ^= flip;
+            else
+                aad[pos - len - Aes128::GCM_TAG_LEN] ^= flip;
+            CHECK(aes.gcm_open(opened.data(), out.data(), len + Aes128::GCM_TAG_LEN, nonce, aad.data(), aadlen) == -1);
+        }
+    }
+
+    void test_batch(bool vaes)
+    {
+        uint8_t key[Aes128::KEY_LEN];
+        rnd_fill(key, sizeof(key));
+        Aes128 aes(key);
+        aes.set_vaes(vaes);
+
+        for (size_t round = 0; round < N_BATCH_ROUNDS; ++round)
+        {
+            size_t n = 1 + rnd(MAX_BATCH_SIZE);
+            std::vector<std::vector<uint8_t>> pkts(n), expected(n);
+            std::vector<Aes128::SealRequest> reqs(n);
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                Aes128::SealRequest &req = reqs[i];
+                req.aadlen = 1 + rnd(40);
+                req.len = rnd(MAX_BATCH_PKTLEN + 1);
+                rnd_fill(req.nonce, sizeof(req.nonce));
+
+                pkts[i].resize(req.aadlen + req.len + Aes128::GCM_TAG_LEN);
+                rnd_fill(pkts[i].data(), req.aadlen + req.len);
+                req.data = pkts[i].data();
+
+                expected[i] = pkts[i];
+                aes.gcm_seal(expected[i].data() + req.aadlen, pkts[i].data() + req.aadlen, req.len,
+                             req.nonce, pkts[i].data(), req.aadlen);
+            }
+
+            aes.gcm_seal_batch(reqs.data(), n);
+
+            for (size_t i = 0; i < n; ++i)
+                CHECK(pkts[i] == expected[i]);
+        }
+
+        // hp_masks 与 encrypt_blocks 一致
+        uint8_t samples[MAX_BATCH_SIZE][Aes128::BLOCK_LEN], masks[MAX_BATCH_SIZE][Aes128::BLOCK_LEN];
+        uint8_t expected_masks[MAX_BATCH_SIZE][Aes128::BLOCK_LEN];
+        const uint8_t *sample_ptrs[MAX_BATCH_SIZE];
+        for (size_t n = 0; n <= MAX_BATCH_SIZE; ++n)
+        {
+            rnd_fill(&samples[0][0], sizeof(samples));
+            for (size_t i = 0; i < n; ++i)
+                sample_ptrs[i] = samples[i];
+            aes.hp_masks(sample_ptrs, masks, n);
+            aes.encrypt_blocks(&samples[0][0], &expected_masks[0][0], n);
+            CHECK(memcmp(masks, expected_masks, n * Aes128::BLOCK_LEN) == 0);
+        }
+    }
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = (argc > 1 ? strtoull(argv[1], nullptr, 10) : 1);
+    rng_state = (seed ? seed : 1);
+
+    if (!Aes128::is_supported())
+    {
+        printf("aes128_gcm_test: AES-NI is not supported, skipped.\n");
+        return 0;
+    }
+
+    bool vaes_supported = Aes128::is_vaes_supported();
+    for (bool vaes : {false, true})
+    {
+        if (vaes && !vaes_supported)
+        {
+            printf("aes128_gcm_test: VAES is not supported, only the AES-NI path is tested.\n");
+            break;
+        }
+
+        printf("Debug [%s]: testing the %s path.\n", __func__, path_name(vaes));
+        test_ecb_vector(vaes);
+        test_gcm_vectors(vaes);
+        test_random(vaes);
+        test_batch(vaes);
+    }
+
+    if (failures)
+    {
+        fprintf(stderr, "Error [%s]: %d failure(s), seed = %llu.\n", __func__, failures, (unsigned long long)seed);
+        return 1;
+    }
+
+    printf("aes128_gcm_test: ok, seed = %llu.\n", (unsigned long long)seed);
+    return 0;
+}
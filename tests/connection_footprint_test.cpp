@@ -0,0 +1,228 @@
+// 空闲 connection 的内存占用测试。
+// 由于 Connection 依赖 libev，这里不直接创建 Connection，而是与 Connection 一样为 client 端的 ngtcp2_conn 配一个 Arena
+// （compact 模式下使用 Connection::COMPACT_ARENA_CHUNK_SIZE），与 server 端在内存中交换一段 stream 数据，
+// 待数据全部被确认、connection 空闲之后统计 arena 的内存占用，并检查：
+// 1. 空闲时 arena 中存活的内存不超过 IDLE_LIVE_MAX；compact 模式下 arena 向系统申请的内存不超过 COMPACT_IDLE_RESERVED_MAX，且不超过默认模式；
+// 2. sizeof(Connection) 不超过 CONNECTION_SIZE_MAX；
+// 3. ngtcp2_conn_del 之后 arena 中不再有存活的内存。
+// 用法：connection_footprint_test
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "connection.h"
+#include "plaintext.h"
+#include "utils.h"
+
+namespace
+{
+    constexpr size_t STREAM_DATA_SIZE = 64 * 1024;           // client 发送的 stream 数据的长度
+    constexpr size_t MAX_PKTLEN = 1200;                       // 每个 packet 的长度上限
+    constexpr size_t IDLE_LIVE_MAX = 72 * 1024;               // 空闲 connection 在 arena 中存活的内存上限（目前约 61KB，lib ngtcp2 的 balloc/objalloc 会保留已分配的块）
+    constexpr size_t COMPACT_IDLE_RESERVED_MAX = 80 * 1024;   // compact 模式下空闲 connection 的 arena 占用上限（目前约 67KB）
+    constexpr size_t CONNECTION_SIZE_MAX = 1024;              // Connection 对象本身的大小上限
+
+    int failures = 0;
+
+#define CHECK(cond)                                                                      \
+    do                                                                                   \
+    {                                                                                    \
+        if (!(cond))                                                                     \
+        {                                                                                \
+            fprintf(stderr, "Error [%s]: CHECK(%s) failed at line %d.\n", __func__, #cond, __LINE__); \
+            ++failures;                                                                  \
+        }                                                                                \
+    } while (0)
+
+    int recv_stream_data_cb(ngtcp2_conn *conn, uint32_t flags, int64_t stream_id, uint64_t offset,
+                            const uint8_t *data, size_t datalen, void *user_data, void *stream_user_data)
+    {
+        ngtcp2_conn_extend_max_stream_offset(conn, stream_id, datalen);
+        ngtcp2_conn_extend_max_offset(conn, datalen);
+        return 0;
+    }
+
+    void rand_cb(uint8_t *dest, size_t destlen, const ngtcp2_rand_ctx *rand_ctx) { rand_bytes(dest, destlen); }
+
+    int get_new_connection_id_cb(ngtcp2_conn *conn, ngtcp2_cid *cid, uint8_t *token, size_t cidlen, void *user_data)
+    {
+        rand_bytes(cid->data, cidlen);
+        cid->datalen = cidlen;
+        rand_bytes(token, NGTCP2_STATELESS_RESET_TOKENLEN);
+        return 0;
+    }
+
+    ngtcp2_conn *create_conn(bool is_server, const sockaddr_in &local_addr, const sockaddr_in &remote_addr, const ngtcp2_mem *mem)
+    {
+        ngtcp2_callbacks callbacks;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.recv_stream_data = recv_stream_data_cb;
+        callbacks.rand = rand_cb;
+        callbacks.get_new_connection_id = get_new_connection_id_cb;
+        ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(is_server, callbacks);
+
+        ngtcp2_settings settings;
+        ngtcp2_plaintext::set_default_ngtcp2_settings(is_server, settings, nullptr, 1);
+        settings.no_pmtud = 1;
+
+        ngtcp2_transport_params params;
+        ngtcp2_plaintext::set_default_ngtcp2_transport_params(is_server, params);
+
+        ngtcp2_cid dcid, scid;
+        ngtcp2_plaintext::preset_fixed_dcid_scid(is_server, dcid, scid);
+
+        return ngtcp2_plaintext::create_handshaked_ngtcp2_conn(is_server, dcid, scid,
+                                                               (const sockaddr *)&local_addr, sizeof(local_addr),
+                                                               (const sockaddr *)&remote_addr, sizeof(remote_addr),
+                                                               callbacks, settings, params, nullptr, mem);
+    }
+
+    // 将 from 写出的所有 packet 交给 to，返回写出的 packet 数量，出错时返回 -1。
+    int transfer(ngtcp2_conn *from, ngtcp2_conn *to, const sockaddr_in &to_addr, const sockaddr_in &from_addr,
+                 int64_t stream_id, const uint8_t *data, size_t datalen, size_t &offset, ngtcp2_tstamp ts)
+    {
+        int n_pkts = 0;
+
+        while (true)
+        {
+            uint8_t buf[MAX_PKTLEN];
+            ngtcp2_path_storage ps;
+            ngtcp2_path_storage_zero(&ps);
+            ngtcp2_pkt_info pi;
+            ngtcp2_ssize n_read = -1;
+
+            ngtcp2_vec datav = {const_cast<uint8_t *>(data) + offset, datalen - offset};
+            ngtcp2_ssize n_written = ngtcp2_conn_writev_stream(from, &ps.path, &pi, buf, sizeof(buf), &n_read,
+                                                               NGTCP2_WRITE_STREAM_FLAG_NONE,
+                                                               (offset < datalen ? stream_id : -1),
+                                                               &datav, (offset < datalen ? 1 : 0), ts);
+            if (n_written < 0)
+                return -1;
+            if (n_written == 0)
+                return n_pkts;
+            if (n_read > 0)
+                offset += n_read;
+
+            if (ngtcp2_plaintext::is_tx_protection_deferred(from))
+            {
+                uint8_t *pkt = buf;
+                size_t pktlen = n_written;
+                if (ngtcp2_plaintext::protect_tx_packets(from, &pkt, &pktlen, 1) != 0)
+                    return -1;
+            }
+
+            ngtcp2_path path;
+            path.local.addr = (sockaddr *)&to_addr;
+            path.local.addrlen = sizeof(to_addr);
+            path.remote.addr = (sockaddr *)&from_addr;
+            path.remote.addrlen = sizeof(from_addr);
+
+            ngtcp2_pkt_info rpi = {0};
+            if (ngtcp2_conn_read_pkt(to, &path, &rpi, buf, n_written, ts) != 0)
+                return -1;
+
+            ++n_pkts;
+        }
+    }
+
+    struct Footprint
+    {
+        size_t idle_live;      // 空闲时 arena 中存活的内存
+        size_t idle_reserved;  // 空闲时 arena 向系统申请的内存
+        size_t peak_reserved;  // 传输过程中 arena 向系统申请的内存的峰值
+        size_t live_after_del; // ngtcp2_conn_del 之后 arena 中存活的内存
+    };
+
+    // 以 chunk_size 为 arena chunk 的大小创建 client 端的 ngtcp2_conn，发送 STREAM_DATA_SIZE 字节的数据直至全部被确认，
+    // 然后统计空闲时 arena 的内存占用。
+    int measure(size_t chunk_size, Footprint &fp)
+    {
+        sockaddr_in client_addr = {0}, server_addr = {0};
+        client_addr.sin_family = server_addr.sin_family = AF_INET;
+        client_addr.sin_port = htons(1);
+        server_addr.sin_port = htons(2);
+
+        Arena arena(chunk_size);
+        ngtcp2_conn *client = create_conn(false, client_addr, server_addr, arena.get_mem());
+        ngtcp2_conn *server = create_conn(true, server_addr, client_addr, nullptr);
+        if (!client || !server)
+            return -1;
+
+        int64_t stream_id;
+        if (ngtcp2_conn_open_bidi_stream(client, &stream_id, nullptr) != 0)
+            return -1;
+
+        std::vector<uint8_t> data(STREAM_DATA_SIZE, 'x');
+        size_t offset = 0, server_offset = 0;
+        ngtcp2_tstamp ts = 1;
+        fp.peak_reserved = 0;
+
+        // 直到所有数据都被发送并确认，且双方都没有 packet 要发送为止
+        for (int round = 0; round < 10000; ++round)
+        {
+            int n_client = transfer(client, server, server_addr, client_addr, stream_id, data.data(), data.size(), offset, ts);
+            int n_server = transfer(server, client, client_addr, server_addr, -1, nullptr, 0, server_offset, ts);
+            if (n_client < 0 || n_server < 0)
+                return -1;
+
+            fp.peak_reserved = std::max(fp.peak_reserved, arena.get_reserved_bytes());
+
+            ngtcp2_conn_stat cstat;
+            ngtcp2_conn_get_conn_stat(client, &cstat);
+            if (offset == data.size() && n_client == 0 && n_server == 0 && cstat.bytes_in_flight == 0)
+                break;
+
+            ts += NGTCP2_MILLISECONDS;
+            if (ngtcp2_conn_get_expiry(client) <= ts)
+                ngtcp2_conn_handle_expiry(client, ts);
+            if (ngtcp2_conn_get_expiry(server) <= ts)
+                ngtcp2_conn_handle_expiry(server, ts);
+        }
+
+        if (offset != data.size())
+            return -1;
+
+        fp.idle_live = arena.get_live_bytes();
+        fp.idle_reserved = arena.get_reserved_bytes();
+
+        ngtcp2_conn_del(client);
+        ngtcp2_conn_del(server);
+        fp.live_after_del = arena.get_live_bytes();
+
+        return 0;
+    }
+} /* namespace */
+
+int main()
+{
+    Footprint fp_default, fp_compact;
+
+    if (measure(Arena::CHUNK_SIZE, fp_default) < 0 || measure(Connection::COMPACT_ARENA_CHUNK_SIZE, fp_compact) < 0)
+    {
+        fprintf(stderr, "Error [%s] [measure]: failed to exchange stream data.\n", __func__);
+        return 1;
+    }
+
+    printf("sizeof(Connection) = %zu bytes, sizeof(Stream) = %zu bytes.\n", sizeof(Connection), sizeof(Stream));
+    printf("default: idle live = %zu bytes, idle reserved = %zu bytes, peak reserved = %zu bytes.\n",
+           fp_default.idle_live, fp_default.idle_reserved, fp_default.peak_reserved);
+    printf("compact: idle live = %zu bytes, idle reserved = %zu bytes, peak reserved = %zu bytes.\n",
+           fp_compact.idle_live, fp_compact.idle_reserved, fp_compact.peak_reserved);
+
+    CHECK(sizeof(Connection) <= CONNECTION_SIZE_MAX);
+    CHECK(fp_default.idle_live <= IDLE_LIVE_MAX);
+    CHECK(fp_compact.idle_live <= IDLE_LIVE_MAX);
+    CHECK(fp_compact.idle_reserved <= COMPACT_IDLE_RESERVED_MAX);
+    CHECK(fp_compact.idle_reserved <= fp_default.idle_reserved);
+    CHECK(fp_default.live_after_del == 0);
+    CHECK(fp_compact.live_after_del == 0);
+
+    if (failures)
+        return 1;
+
+    printf("connection_footprint_test: ok.\n");
+    return 0;
+}
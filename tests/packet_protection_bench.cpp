@@ -0,0 +1,289 @@
+// 各种 1RTT packet 保护方式（见 ngtcp2_plaintext::Profile）的吞吐量 benchmark，不加入 ctest，需要手动运行。
+// 1. loopback：client 与 server 的 ngtcp2_conn 在同一个线程中直接交换 packet（不经过 socket），client 向 server 发送 DATA_SIZE 字节的 stream 数据，
+//    统计每种 profile 的吞吐量（MB/s），其中包含 ngtcp2 本身的开销。PROFILE_AES_128_GCM 下与 Connection::flush_tx_batch 一样，
+//    把至多 TX_BATCH_SIZE 个 packet 攒成一批之后再调用 protect_tx_packets 批量加密；接收方向由 ngtcp2 逐个解密。
+// 2. seal：单独测量 Aes128::gcm_seal_batch 在 AES-NI（8 个分组）与 VAES（16 个分组，CPU 支持时）两条路径下加密 MAX_PKTLEN 字节 packet 的吞吐量。
+// 由于顶层 CMakeLists 以 -O0 编译，本 benchmark 以 -O2 编译并链接 ngtcp2_bench_static。
+// 用法：packet_protection_bench
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <netinet/in.h>
+#include <time.h>
+
+#include "aes128.h"
+#include "plaintext.h"
+#include "utils.h"
+
+namespace
+{
+    constexpr size_t DATA_SIZE = 256 * 1024 * 1024;   // loopback 中 client 发送的 stream 数据的长度
+    constexpr size_t MAX_PKTLEN = 1200;               // 每个 packet 的长度上限
+    constexpr size_t TX_BATCH_SIZE = 10;              // 一批加密的 packet 数量上限（与 GSO batch 相当）
+    constexpr size_t SEAL_BYTES = 1024 * 1024 * 1024; // seal 测试中加密的数据总量
+    constexpr int N_RUNS = 3;                         // 每项测试取 N_RUNS 次中的最好成绩
+
+    double now_sec()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    size_t received = 0; // server 收到的 stream 数据的长度
+
+    int recv_stream_data_cb(ngtcp2_conn *conn, uint32_t flags, int64_t stream_id, uint64_t offset,
+                            const uint8_t *data, size_t datalen, void *user_data, void *stream_user_data)
+    {
+        received += datalen;
+        ngtcp2_conn_extend_max_stream_offset(conn, stream_id, datalen);
+        ngtcp2_conn_extend_max_offset(conn, datalen);
+        return 0;
+    }
+
+    void rand_cb(uint8_t *dest, size_t destlen, const ngtcp2_rand_ctx *rand_ctx) { rand_bytes(dest, destlen); }
+
+    int get_new_connection_id_cb(ngtcp2_conn *conn, ngtcp2_cid *cid, uint8_t *token, size_t cidlen, void *user_data)
+    {
+        rand_bytes(cid->data, cidlen);
+        cid->datalen = cidlen;
+        rand_bytes(token, NGTCP2_STATELESS_RESET_TOKENLEN);
+        return 0;
+    }
+
+    ngtcp2_conn *create_conn(bool is_server, const sockaddr_in &local_addr, const sockaddr_in &remote_addr,
+                             ngtcp2_plaintext::Profile profile)
+    {
+        ngtcp2_callbacks callbacks;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.recv_stream_data = recv_stream_data_cb;
+        callbacks.rand = rand_cb;
+        callbacks.get_new_connection_id = get_new_connection_id_cb;
+        ngtcp2_plaintext::set_ngtcp2_crypto_callbacks(is_server, callbacks, profile);
+
+        ngtcp2_settings settings;
+        ngtcp2_plaintext::set_default_ngtcp2_settings(is_server, settings, nullptr, 1);
+        settings.no_pmtud = 1;
+
+        ngtcp2_transport_params params;
+        ngtcp2_plaintext::set_default_ngtcp2_transport_params(is_server, params);
+
+        ngtcp2_cid dcid, scid;
+        ngtcp2_plaintext::preset_fixed_dcid_scid(is_server, dcid, scid, profile);
+
+        return ngtcp2_plaintext::create_handshaked_ngtcp2_conn(is_server, dcid, scid,
+                                                               (const sockaddr *)&local_addr, sizeof(local_addr),
+                                                               (const sockaddr *)&remote_addr, sizeof(remote_addr),
+                                                               callbacks, settings, params, nullptr, nullptr, profile);
+    }
+
+    // 将 from 写出的 packet 每 TX_BATCH_SIZE 个（需要时先批量加密）交给 to，返回写出的 packet 数量，出错时返回 -1。
+    int transfer(ngtcp2_conn *from, ngtcp2_conn *to, const sockaddr_in &to_addr, const sockaddr_in &from_addr,
+                 int64_t stream_id, const uint8_t *data, size_t datalen, size_t &offset, ngtcp2_tstamp ts)
+    {
+        static uint8_t bufs[TX_BATCH_SIZE][MAX_PKTLEN];
+        int n_pkts = 0;
+        bool blocked = false; // stream 受到流量控制的限制，本轮只发送其它 frame
+
+        ngtcp2_path path;
+        path.local.addr = (sockaddr *)&to_addr;
+        path.local.addrlen = sizeof(to_addr);
+        path.remote.addr = (sockaddr *)&from_addr;
+        path.remote.addrlen = sizeof(from_addr);
+
+        while (true)
+        {
+            uint8_t *pkts[TX_BATCH_SIZE];
+            size_t pktlens[TX_BATCH_SIZE];
+            size_t n = 0;
+
+            while (n < TX_BATCH_SIZE)
+            {
+                ngtcp2_path_storage ps;
+                ngtcp2_path_storage_zero(&ps);
+                ngtcp2_pkt_info pi;
+                ngtcp2_ssize n_read = -1;
+
+                bool has_data = (offset < datalen && !blocked);
+                ngtcp2_vec datav = {const_cast<uint8_t *>(data) + offset, datalen - offset};
+                ngtcp2_ssize n_written = ngtcp2_conn_writev_stream(from, &ps.path, &pi, bufs[n], MAX_PKTLEN, &n_read,
+                                                                   NGTCP2_WRITE_STREAM_FLAG_NONE,
+                                                                   (has_data ? stream_id : -1),
+                                                                   &datav, (has_data ? 1 : 0), ts);
+                if (n_written == NGTCP2_ERR_STREAM_DATA_BLOCKED)
+                {
+                    blocked = true;
+                    continue;
+                }
+                if (n_written < 0)
+                    return -1;
+                if (n_written == 0)
+                    break;
+                if (n_read > 0)
+                    offset += n_read;
+
+                pkts[n] = bufs[n];
+                pktlens[n] = n_written;
+                ++n;
+            }
+
+            if (n == 0)
+                return n_pkts;
+
+            if (ngtcp2_plaintext::is_tx_protection_deferred(from) &&
+                ngtcp2_plaintext::protect_tx_packets(from, pkts, pktlens, n) != 0)
+                return -1;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                ngtcp2_pkt_info rpi = {0};
+                if (ngtcp2_conn_read_pkt(to, &path, &rpi, pkts[i], pktlens[i], ts) != 0)
+                    return -1;
+            }
+
+            n_pkts += n;
+        }
+    }
+
+    // 以 profile 传输 DATA_SIZE 字节的数据直至全部被确认，返回吞吐量（MB/s），出错时返回负数。
+    double loopback(ngtcp2_plaintext::Profile profile, const std::vector<uint8_t> &data)
+    {
+        sockaddr_in client_addr = {0}, server_addr = {0};
+        client_addr.sin_family = server_addr.sin_family = AF_INET;
+        client_addr.sin_port = htons(1);
+        server_addr.sin_port = htons(2);
+
+        ngtcp2_conn *client = create_conn(false, client_addr, server_addr, profile);
+        ngtcp2_conn *server = create_conn(true, server_addr, client_addr, profile);
+        int64_t stream_id;
+        if (!client || !server || ngtcp2_conn_open_bidi_stream(client, &stream_id, nullptr) != 0)
+            return -1;
+
+        size_t offset = 0, server_offset = 0;
+        ngtcp2_tstamp ts = 1;
+        received = 0;
+        double t = now_sec();
+
+        while (true)
+        {
+            int n_client = transfer(client, server, server_addr, client_addr, stream_id, data.data(), data.size(), offset, ts);
+            int n_server = transfer(server, client, client_addr, server_addr, -1, nullptr, 0, server_offset, ts);
+            if (n_client < 0 || n_server < 0)
+                return -1;
+
+            ngtcp2_conn_stat cstat;
+            ngtcp2_conn_get_conn_stat(client, &cstat);
+            if (offset == data.size() && n_client == 0 && n_server == 0 && cstat.bytes_in_flight == 0)
+                break;
+
+            ts += NGTCP2_MILLISECONDS;
+            if (ngtcp2_conn_get_expiry(client) <= ts)
+                ngtcp2_conn_handle_expiry(client, ts);
+            if (ngtcp2_conn_get_expiry(server) <= ts)
+                ngtcp2_conn_handle_expiry(server, ts);
+        }
+
+        t = now_sec() - t;
+
+        ngtcp2_conn_del(client);
+        ngtcp2_conn_del(server);
+
+        if (received != data.size())
+            return -1;
+
+        return data.size() / t / 1e6;
+    }
+
+    // 以 gcm_seal_batch 每次加密 TX_BATCH_SIZE 个 MAX_PKTLEN 字节的 packet，返回吞吐量（MB/s）。
+    double seal(bool vaes)
+    {
+        static uint8_t pkts[TX_BATCH_SIZE][MAX_PKTLEN];
+        constexpr size_t AADLEN = 24; // 1RTT packet header 的典型长度
+        const uint8_t key[Aes128::KEY_LEN] = {0};
+
+        Aes128 aes(key);
+        aes.set_vaes(vaes);
+
+        Aes128::SealRequest reqs[TX_BATCH_SIZE];
+        for (size_t i = 0; i < TX_BATCH_SIZE; ++i)
+        {
+            reqs[i].data = pkts[i];
+            reqs[i].aadlen = AADLEN;
+            reqs[i].len = MAX_PKTLEN - AADLEN - Aes128::GCM_TAG_LEN;
+            memset(reqs[i].nonce, (int)i, sizeof(reqs[i].nonce));
+        }
+
+        size_t n_batches = SEAL_BYTES / (TX_BATCH_SIZE * reqs[0].len);
+        double t = now_sec();
+        for (size_t i = 0; i < n_batches; ++i)
+            aes.gcm_seal_batch(reqs, TX_BATCH_SIZE);
+        t = now_sec() - t;
+
+        return n_batches * TX_BATCH_SIZE * reqs[0].len / t / 1e6;
+    }
+
+    double best_of(double (*fn)(bool), bool arg)
+    {
+        double best = 0;
+        for (int run = 0; run < N_RUNS; ++run)
+            best = std::max(best, fn(arg));
+        return best;
+    }
+} /* namespace */
+
+int main()
+{
+    struct
+    {
+        const char *name;
+        ngtcp2_plaintext::Profile profile;
+    } profiles[] = {
+        {"PROFILE_FAKE_AEAD", ngtcp2_plaintext::PROFILE_FAKE_AEAD},
+        {"PROFILE_NULL", ngtcp2_plaintext::PROFILE_NULL},
+        {"PROFILE_AES_128_GCM", ngtcp2_plaintext::PROFILE_AES_128_GCM},
+    };
+
+    bool aes_supported = Aes128::is_supported();
+    if (aes_supported)
+        ngtcp2_plaintext::set_pre_shared_key("000102030405060708090a0b0c0d0e0f");
+
+    std::vector<uint8_t> data(DATA_SIZE, 'x');
+
+    printf("loopback, %zu MB, %zu bytes per packet:\n", DATA_SIZE / (1024 * 1024), MAX_PKTLEN);
+    for (const auto &p : profiles)
+    {
+        if (p.profile == ngtcp2_plaintext::PROFILE_AES_128_GCM && !aes_supported)
+        {
+            printf("  %-20s skipped (AES-NI is not supported)\n", p.name);
+            continue;
+        }
+
+        double best = 0;
+        for (int run = 0; run < N_RUNS; ++run)
+        {
+            double mbps = loopback(p.profile, data);
+            if (mbps < 0)
+            {
+                fprintf(stderr, "Error [%s] [loopback]: failed to transfer data with %s.\n", __func__, p.name);
+                return 1;
+            }
+            best = std::max(best, mbps);
+        }
+        printf("  %-20s %8.1f MB/s\n", p.name, best);
+    }
+
+    if (!aes_supported)
+        return 0;
+
+    printf("gcm_seal_batch, %zu packets of %zu bytes per batch:\n", TX_BATCH_SIZE, MAX_PKTLEN);
+    printf("  %-20s %8.1f MB/s\n", "AES-NI (8 blocks)", best_of(seal, false));
+    if (Aes128::is_vaes_supported())
+        printf("  %-20s %8.1f MB/s\n", "VAES (16 blocks)", best_of(seal, true));
+    else
+        printf("  %-20s skipped (VAES is not supported)\n", "VAES (16 blocks)");
+
+    return 0;
+}
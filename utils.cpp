@@ -1,14 +1,33 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <time.h>
 #include <errno.h>
 
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+#include <sys/random.h>
+#define HAVE_GETRANDOM
+#endif
+
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#endif
+#include <netinet/udp.h>
+
+#if defined(ENABLE_TSC_CLOCK) && defined(__x86_64__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define USE_TSC_CLOCK
+#endif
+
 #include "utils.h"
 
 void debug_print_sockaddr(const sockaddr *addr, socklen_t addrlen)
@@ -85,7 +104,8 @@ int resolve_and_connect(const char *host, const char *port,
 }
 
 int resolve_and_bind(const char *host, const char *port,
-                     sockaddr *local_addr, socklen_t *local_addrlen)
+                     sockaddr *local_addr, socklen_t *local_addrlen,
+                     bool reuseport)
 {
     struct addrinfo hints = {0};
     memset(&hints, 0, sizeof(hints));
@@ -105,6 +125,10 @@ int resolve_and_bind(const char *host, const char *port,
         if (fd < 0) // 若创建 socket fd 失败则直接尝试下一个
             continue;
 
+        int on = 1;
+        if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+            fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+
         if (bind(fd, rp->ai_addr, rp->ai_addrlen) == 0)
         {
             // 返回：本端的 socket addr
@@ -122,6 +146,41 @@ int resolve_and_bind(const char *host, const char *port,
     return fd;
 }
 
+int create_connected_socket(const sockaddr *local_addr, socklen_t local_addrlen,
+                            const sockaddr *remote_addr, socklen_t remote_addrlen)
+{
+    int fd = socket(local_addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error [%s] [socket]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, local_addr, local_addrlen) < 0)
+    {
+        fprintf(stderr, "Error [%s] [bind]: errno = %s.\n", __func__, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (connect(fd, remote_addr, remote_addrlen) < 0)
+    {
+        fprintf(stderr, "Error [%s] [connect]: errno = %s.\n", __func__, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
 uint64_t timestamp()
 {
     struct timespec tp;
@@ -132,6 +191,117 @@ uint64_t timestamp()
     return (uint64_t)tp.tv_sec * NGTCP2_SECONDS + (uint64_t)tp.tv_nsec;
 }
 
+namespace
+{
+    // 每个 event loop 线程各自缓存自己的时钟，与 ChaCha20 RNG、packet buffer slab 一样不需要加锁
+    thread_local uint64_t loop_ts = 0; // 最近一次 refresh_loop_timestamp() 的采样值
+
+#ifdef USE_TSC_CLOCK
+    constexpr uint64_t TSC_CALIBRATE_NS = 1 * NGTCP2_MILLISECONDS;  // 校准 TSC 频率时 spin 的时长
+    constexpr uint64_t TSC_REANCHOR_NS = 100 * NGTCP2_MILLISECONDS; // 每隔多久用 timestamp() 重新对齐一次，限制换算误差的累积
+
+    // TSC 时钟：ns = base_ns + ((tsc - base_tsc) * mult) >> 32，每隔 TSC_REANCHOR_NS 重新对齐 base_ns 与 base_tsc。
+    // 每个线程各自校准并重新对齐，重新对齐时会改写 base_tsc 与 base_ns，因此不能在线程之间共享。
+    struct TscClock
+    {
+        int state;             // 0：未校准，1：可用，-1：不可用（退回到 timestamp()）
+        uint64_t mult;         // 每个 TSC tick 对应的 ns 数（32.32 定点数）
+        uint64_t base_tsc;
+        uint64_t base_ns;
+        uint64_t reanchor_tsc; // TSC 达到该值时重新对齐，同时保证 (tsc - base_tsc) * mult 不会溢出
+    };
+    thread_local TscClock tsc_clock = {0};
+
+    void tsc_reanchor(uint64_t now_ns)
+    {
+        tsc_clock.base_tsc = __rdtsc();
+        tsc_clock.base_ns = now_ns;
+        tsc_clock.reanchor_tsc = tsc_clock.base_tsc + (TSC_REANCHOR_NS << 32) / tsc_clock.mult;
+    }
+
+    void tsc_calibrate()
+    {
+        tsc_clock.state = -1;
+
+        // 只有 invariant TSC（CPUID.80000007H:EDX[8]）的频率才不受 P-state/C-state 的影响，且在各个核之间同步
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8)))
+        {
+            fprintf(stderr, "Error [%s]: invariant TSC is not available, fall back to clock_gettime.\n", __func__);
+            return;
+        }
+
+        uint64_t ns0 = timestamp();
+        uint64_t tsc0 = __rdtsc();
+        uint64_t ns1 = ns0;
+        while (ns1 - ns0 < TSC_CALIBRATE_NS)
+            ns1 = timestamp();
+        uint64_t tsc1 = __rdtsc();
+
+        if (tsc1 <= tsc0)
+            return;
+
+        tsc_clock.mult = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+        if (tsc_clock.mult == 0)
+            return;
+
+        tsc_reanchor(ns1);
+        tsc_clock.state = 1;
+        printf("Debug [%s]: TSC frequency = %.3f MHz.\n", __func__, (double)(tsc1 - tsc0) * 1e3 / (double)(ns1 - ns0));
+    }
+
+    uint64_t tsc_timestamp()
+    {
+        if (tsc_clock.state == 0)
+            tsc_calibrate();
+        if (tsc_clock.state < 0)
+            return timestamp();
+
+        uint64_t tsc = __rdtsc();
+        if (tsc >= tsc_clock.reanchor_tsc || tsc < tsc_clock.base_tsc)
+        {
+            tsc_reanchor(timestamp());
+            return tsc_clock.base_ns;
+        }
+
+        return tsc_clock.base_ns + (((tsc - tsc_clock.base_tsc) * tsc_clock.mult) >> 32);
+    }
+#endif /* USE_TSC_CLOCK */
+} /* namespace */
+
+uint64_t refresh_loop_timestamp()
+{
+#ifdef USE_TSC_CLOCK
+    uint64_t now = tsc_timestamp();
+#else
+    uint64_t now = timestamp();
+#endif
+
+    // 重新对齐 TSC 时可能出现小幅回退，传给 ngtcp2 的时间戳必须单调不减
+    if (now > loop_ts)
+        loop_ts = now;
+
+    return loop_ts;
+}
+
+uint64_t loop_timestamp()
+{
+    return loop_ts ? loop_ts : refresh_loop_timestamp();
+}
+
+int64_t realtime_clock_offset()
+{
+    struct timespec real_tp, mono_tp;
+
+    if (clock_gettime(CLOCK_REALTIME, &real_tp) < 0 || clock_gettime(CLOCK_MONOTONIC, &mono_tp) < 0)
+        return 0;
+
+    int64_t real_ts = (int64_t)real_tp.tv_sec * NGTCP2_SECONDS + (int64_t)real_tp.tv_nsec;
+    int64_t mono_ts = (int64_t)mono_tp.tv_sec * NGTCP2_SECONDS + (int64_t)mono_tp.tv_nsec;
+
+    return real_ts - mono_ts;
+}
+
 void log_printf(void *user_data, const char *fmt, ...)
 {
 #ifdef ENABLE_NGTCP2_LOG_PRINTF
@@ -146,22 +316,149 @@ void log_printf(void *user_data, const char *fmt, ...)
 #endif
 }
 
+namespace
+{
+    constexpr size_t CHACHA20_BLOCK_SIZE = 64;
+    constexpr size_t CHACHA20_KEY_SIZE = 32;
+    constexpr size_t RNG_BUF_BLOCKS = 4; // 每次生成的 keystream block 数量
+
+#define CHACHA20_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA20_QR(a, b, c, d)                 \
+    do                                          \
+    {                                           \
+        a += b, d ^= a, d = CHACHA20_ROTL(d, 16); \
+        c += d, b ^= c, b = CHACHA20_ROTL(b, 12); \
+        a += b, d ^= a, d = CHACHA20_ROTL(d, 8);  \
+        c += d, b ^= c, b = CHACHA20_ROTL(b, 7);  \
+    } while (0)
+
+    inline uint32_t load32_le(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    inline void store32_le(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)v, p[1] = (uint8_t)(v >> 8), p[2] = (uint8_t)(v >> 16), p[3] = (uint8_t)(v >> 24);
+    }
+
+    // 以 key、counter 和全零的 nonce 生成一个 64 字节的 ChaCha20 keystream block（RFC 8439）。
+    void chacha20_block(const uint8_t key[CHACHA20_KEY_SIZE], uint64_t counter, uint8_t out[CHACHA20_BLOCK_SIZE])
+    {
+        uint32_t in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574}; // "expand 32-byte k"
+        for (int i = 0; i < 8; ++i)
+            in[4 + i] = load32_le(key + 4 * i);
+        in[12] = (uint32_t)counter;
+        in[13] = (uint32_t)(counter >> 32);
+        in[14] = in[15] = 0;
+
+        uint32_t x[16];
+        memcpy(x, in, sizeof(x));
+
+        for (int i = 0; i < 10; ++i) // 20 rounds：10 次 column round + diagonal round
+        {
+            CHACHA20_QR(x[0], x[4], x[8], x[12]);
+            CHACHA20_QR(x[1], x[5], x[9], x[13]);
+            CHACHA20_QR(x[2], x[6], x[10], x[14]);
+            CHACHA20_QR(x[3], x[7], x[11], x[15]);
+            CHACHA20_QR(x[0], x[5], x[10], x[15]);
+            CHACHA20_QR(x[1], x[6], x[11], x[12]);
+            CHACHA20_QR(x[2], x[7], x[8], x[13]);
+            CHACHA20_QR(x[3], x[4], x[9], x[14]);
+        }
+
+        for (int i = 0; i < 16; ++i)
+            store32_le(out + 4 * i, x[i] + in[i]);
+    }
+
+#undef CHACHA20_QR
+#undef CHACHA20_ROTL
+
+    // 从内核获取随机的种子，成功返回 0。
+    int get_entropy(uint8_t *data, size_t len)
+    {
+#ifdef HAVE_GETRANDOM
+        while (len > 0)
+        {
+            ssize_t n = getrandom(data, len, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break; // 例如内核不支持 getrandom（ENOSYS），退回到 /dev/urandom
+            }
+            data += n, len -= (size_t)n;
+        }
+        if (len == 0)
+            return 0;
+#endif
+        FILE *fp = fopen("/dev/urandom", "rb");
+        if (!fp)
+            return -1;
+        size_t n = fread(data, 1, len, fp);
+        fclose(fp);
+
+        return n == len ? 0 : -1;
+    }
+
+    // 每个线程各自的 ChaCha20 生成器（fast key erasure）：每次用当前 key 生成 RNG_BUF_BLOCKS 个 block，
+    // 其中前 32 字节立即作为新的 key，其余的作为输出缓存起来，输出后即清零，因此之后泄露生成器的状态也无法还原之前的输出。
+    struct ChaCha20Rng
+    {
+        uint8_t key[CHACHA20_KEY_SIZE];
+        uint8_t buf[RNG_BUF_BLOCKS * CHACHA20_BLOCK_SIZE];
+        size_t pos; // buf 中 [pos, sizeof(buf)) 是尚未输出的随机字节
+        bool seeded;
+    };
+    thread_local ChaCha20Rng rng = {{0}, {0}, RNG_BUF_BLOCKS * CHACHA20_BLOCK_SIZE, false};
+
+    void rng_refill()
+    {
+        if (!rng.seeded)
+        {
+            if (get_entropy(rng.key, sizeof(rng.key)) < 0)
+            {
+                fprintf(stderr, "Error [%s] [get_entropy]: errno = %s.\n", __func__, strerror(errno));
+                abort(); // 没有可靠的种子时宁可退出，也不生成可预测的 CID 与 token
+            }
+            rng.seeded = true;
+        }
+
+        for (size_t i = 0; i < RNG_BUF_BLOCKS; ++i)
+            chacha20_block(rng.key, i, rng.buf + i * CHACHA20_BLOCK_SIZE); // 每次都换新的 key，因此 counter 可以从 0 开始
+
+        memcpy(rng.key, rng.buf, sizeof(rng.key));
+        memset(rng.buf, 0, sizeof(rng.key));
+        rng.pos = sizeof(rng.key);
+    }
+} /* namespace */
+
 void rand_bytes(uint8_t *data, size_t len)
 {
-    static int for_srand = (srand(timestamp()), 0);
-    (void)for_srand;
+    while (len > 0)
+    {
+        if (rng.pos == sizeof(rng.buf))
+            rng_refill();
+
+        size_t n = std::min(len, sizeof(rng.buf) - rng.pos);
+        memcpy(data, rng.buf + rng.pos, n);
+        memset(rng.buf + rng.pos, 0, n);
 
-    for (size_t i = 0; i < len; ++i)
-        data[i] = static_cast<uint8_t>(rand());
+        rng.pos += n;
+        data += n, len -= n;
+    }
 }
 
 ssize_t recv_packet(int fd, uint8_t *data, size_t data_size,
-                    sockaddr *remote_addr, socklen_t *remote_addrlen)
+                    sockaddr *remote_addr, socklen_t *remote_addrlen,
+                    RecvPacketInfo *info)
 {
     struct iovec iov;
     iov.iov_base = data;
     iov.iov_len = data_size;
 
+    uint8_t msg_ctrl[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+
     struct msghdr msg;
     memset(&msg, 0, sizeof(msg));
 
@@ -169,6 +466,8 @@ ssize_t recv_packet(int fd, uint8_t *data, size_t data_size,
     msg.msg_namelen = *remote_addrlen;
     msg.msg_iov = &iov;
     msg.msg_iovlen = 1;
+    msg.msg_control = msg_ctrl;
+    msg.msg_controllen = sizeof(msg_ctrl);
 
     ssize_t ret;
     do
@@ -178,16 +477,63 @@ ssize_t recv_packet(int fd, uint8_t *data, size_t data_size,
 
     *remote_addrlen = msg.msg_namelen;
 
+    if (ret < 0 || !info)
+        return ret;
+
+    memset(info, 0, sizeof(*info));
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS && cmsg->cmsg_len)
+        {
+            // IPv4 下 IP_TOS 的 cmsg 数据只有一个字节
+            info->ecn = *(reinterpret_cast<uint8_t *>(CMSG_DATA(cmsg))) & 0x03;
+        }
+        else if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS && cmsg->cmsg_len)
+        {
+            // IPv6 下 IPV6_TCLASS 的 cmsg 数据是一个 int
+            int tclass;
+            memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+            info->ecn = static_cast<uint32_t>(tclass) & 0x03;
+        }
+#ifdef SCM_TIMESTAMPNS
+        else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec tp;
+            memcpy(&tp, CMSG_DATA(cmsg), sizeof(tp));
+            info->rx_timestamp = (uint64_t)tp.tv_sec * NGTCP2_SECONDS + (uint64_t)tp.tv_nsec;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&(info->rxq_drops), CMSG_DATA(cmsg), sizeof(uint32_t));
+        }
+#endif
+    }
+
     return ret;
 }
 
 ssize_t send_packet(int fd, const uint8_t *data, size_t data_size,
-                    sockaddr *remote_addr, socklen_t remote_addrlen)
+                    sockaddr *remote_addr, socklen_t remote_addrlen,
+                    const SendPacketInfo *info)
 {
     struct iovec iov;
     iov.iov_base = (void *)data;
     iov.iov_len = data_size;
 
+    return send_packet(fd, &iov, 1, remote_addr, remote_addrlen, info);
+}
+
+ssize_t send_packet(int fd, const iovec *iov, size_t iovcnt,
+                    sockaddr *remote_addr, socklen_t remote_addrlen,
+                    const SendPacketInfo *info)
+{
+    size_t data_size = 0;
+    for (size_t i = 0; i < iovcnt; ++i)
+        data_size += iov[i].iov_len;
+
     struct msghdr msg;
     memset(&msg, 0, sizeof(msg));
 
@@ -197,18 +543,358 @@ ssize_t send_packet(int fd, const uint8_t *data, size_t data_size,
     // msg.msg_name = nullptr;
     // msg.msg_namelen = 0;
 
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
+    msg.msg_iov = const_cast<iovec *>(iov);
+    msg.msg_iovlen = iovcnt;
+
+    int flags = MSG_DONTWAIT;
+
+    uint8_t msg_ctrl[CMSG_SPACE(sizeof(uint64_t)) + CMSG_SPACE(sizeof(uint16_t))];
+    memset(msg_ctrl, 0, sizeof(msg_ctrl));
+    msg.msg_control = msg_ctrl;
+    msg.msg_controllen = sizeof(msg_ctrl);
+
+    size_t controllen = 0;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+#ifdef SCM_TXTIME
+    if (info && info->txtime)
+    {
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_TXTIME;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cmsg), &(info->txtime), sizeof(uint64_t));
+
+        controllen += CMSG_SPACE(sizeof(uint64_t));
+        cmsg = CMSG_NXTHDR(&msg, cmsg);
+    }
+#endif
+
+#ifdef UDP_SEGMENT
+    if (info && info->gso_size && info->gso_size < data_size)
+    {
+        uint16_t gso_size = static_cast<uint16_t>(info->gso_size);
+
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(uint16_t));
+
+        controllen += CMSG_SPACE(sizeof(uint16_t));
+    }
+#endif
+
+    msg.msg_controllen = controllen;
+    if (controllen == 0)
+        msg.msg_control = nullptr;
+
+#ifdef MSG_ZEROCOPY
+    if (info && info->zerocopy)
+        flags |= MSG_ZEROCOPY;
+#endif
 
     ssize_t ret;
     do
     {
-        ret = sendmsg(fd, &msg, MSG_DONTWAIT);
+        ret = sendmsg(fd, &msg, flags);
     } while (ret < 0 && errno == EINTR);
 
     return ret;
 }
 
+int enable_recv_ecn(int fd, int family)
+{
+    unsigned int on = 1;
+    int ret = -1;
+
+    switch (family)
+    {
+    case AF_INET:
+        ret = setsockopt(fd, IPPROTO_IP, IP_RECVTOS, &on, sizeof(on));
+        break;
+    case AF_INET6:
+        ret = setsockopt(fd, IPPROTO_IPV6, IPV6_RECVTCLASS, &on, sizeof(on));
+        break;
+    default:
+        errno = EAFNOSUPPORT;
+        break;
+    }
+
+    if (ret < 0)
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+
+    return ret < 0 ? -1 : 0;
+}
+
+int set_send_ecn(int fd, int family, uint32_t ecn)
+{
+    int tos = static_cast<int>(ecn & 0x03); // DSCP 部分保持为零
+    int ret = -1;
+
+    switch (family)
+    {
+    case AF_INET:
+        ret = setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+        break;
+    case AF_INET6:
+        ret = setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+        break;
+    default:
+        errno = EAFNOSUPPORT;
+        break;
+    }
+
+    if (ret < 0)
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+
+    return ret < 0 ? -1 : 0;
+}
+
+int enable_pmtud_probe(int fd, int family)
+{
+    int ret = -1;
+
+    switch (family)
+    {
+    case AF_INET:
+    {
+#ifdef IP_PMTUDISC_PROBE
+        int val = IP_PMTUDISC_PROBE;
+        ret = setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val));
+#else
+        errno = ENOPROTOOPT;
+#endif
+        break;
+    }
+    case AF_INET6:
+    {
+#ifdef IPV6_PMTUDISC_PROBE
+        int val = IPV6_PMTUDISC_PROBE;
+        ret = setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &val, sizeof(val));
+#else
+        errno = ENOPROTOOPT;
+#endif
+        break;
+    }
+    default:
+        errno = EAFNOSUPPORT;
+        break;
+    }
+
+    if (ret < 0)
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+
+    return ret < 0 ? -1 : 0;
+}
+
+int enable_rx_timestamp(int fd)
+{
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+int set_socket_buffer_size(int fd, int rcvbuf_size, int sndbuf_size)
+{
+    int ret = 0;
+
+    if (rcvbuf_size > 0)
+    {
+#ifdef SO_RCVBUFFORCE
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf_size, sizeof(rcvbuf_size)) == 0)
+            rcvbuf_size = 0; // 已经设置成功
+#endif
+        if (rcvbuf_size > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf_size, sizeof(rcvbuf_size)) < 0)
+        {
+            fprintf(stderr, "Error [%s] [setsockopt SO_RCVBUF]: errno = %s.\n", __func__, strerror(errno));
+            ret = -1;
+        }
+    }
+
+    if (sndbuf_size > 0)
+    {
+#ifdef SO_SNDBUFFORCE
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf_size, sizeof(sndbuf_size)) == 0)
+            sndbuf_size = 0;
+#endif
+        if (sndbuf_size > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf_size, sizeof(sndbuf_size)) < 0)
+        {
+            fprintf(stderr, "Error [%s] [setsockopt SO_SNDBUF]: errno = %s.\n", __func__, strerror(errno));
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int get_recv_buffer_size(int fd)
+{
+    int size = 0;
+    socklen_t len = sizeof(size);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0)
+        return -1;
+
+    return size / 2; // Linux 会将设置的值加倍来计入簿记开销
+}
+
+int enable_rxq_ovfl(int fd)
+{
+#ifdef SO_RXQ_OVFL
+    int on = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+int enable_socket_busy_poll(int fd, int busy_poll_usec)
+{
+#ifdef SO_BUSY_POLL
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_usec, sizeof(busy_poll_usec)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt SO_BUSY_POLL]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+#ifdef SO_PREFER_BUSY_POLL
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0) // 内核 5.11 以上才支持，失败不影响 SO_BUSY_POLL
+        fprintf(stderr, "Error [%s] [setsockopt SO_PREFER_BUSY_POLL]: errno = %s.\n", __func__, strerror(errno));
+#endif
+
+    return 0;
+#else
+    (void)fd;
+    (void)busy_poll_usec;
+    return -1;
+#endif
+}
+
+int probe_udp_gso(int fd)
+{
+#if defined(__linux__) && defined(UDP_SEGMENT)
+    int gso_size = 0;
+    socklen_t len = sizeof(gso_size);
+
+    // 内核 4.18 起支持 UDP_SEGMENT，只读取而不修改 socket 上默认的 gso_size
+    if (getsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &gso_size, &len) < 0)
+    {
+        fprintf(stderr, "Error [%s] [getsockopt]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+int enable_zerocopy(int fd)
+{
+#ifdef SO_ZEROCOPY
+    int on = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+int recv_zerocopy_completion(int fd, uint32_t *lo, uint32_t *hi, bool *copied)
+{
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    uint8_t msg_ctrl[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = msg_ctrl;
+    msg.msg_controllen = sizeof(msg_ctrl);
+
+    ssize_t ret;
+    do
+    {
+        ret = recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (!((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+              (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            continue;
+
+        struct sock_extended_err serr;
+        memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+
+        if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) // 不是 zerocopy 完成通知
+            continue;
+
+        *lo = serr.ee_info;
+        *hi = serr.ee_data;
+        *copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return 1;
+    }
+
+    return 2; // 读到了错误队列中的其他消息
+#else
+    (void)fd;
+    (void)lo;
+    (void)hi;
+    (void)copied;
+    return 0;
+#endif
+}
+
+int enable_so_txtime(int fd)
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    struct sock_txtime cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.clockid = CLOCK_MONOTONIC; // 与 timestamp() 以及 ngtcp2 所使用的时钟保持一致
+    cfg.flags = 0;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0)
+    {
+        fprintf(stderr, "Error [%s] [setsockopt]: errno = %s.\n", __func__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
 int get_random_cid(ngtcp2_cid *cid, size_t len)
 {
     if (len > NGTCP2_MAX_CIDLEN)
@@ -6,6 +6,8 @@
 
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
 
 #include <ngtcp2/ngtcp2.h>
 
@@ -28,31 +30,124 @@ T *steal_pointer(T *&ptr)
 // 将 fd 设置为 non-block 模式。
 int set_nonblock(int fd);
 
+// 紧凑的 socket addr，只能容纳 IPv4/IPv6 地址（28 bytes，而 sockaddr_storage 为 128 bytes），用于 connection 中长期保存的地址。
+union SockAddr
+{
+    sockaddr sa;
+    sockaddr_in in;
+    sockaddr_in6 in6;
+};
+
 // 为本端创建 socket fd，并连接到由 host & port 指定的远端地址，返回 fd，并且返回本端以及远端的 socket addr。
 int resolve_and_connect(const char *host, const char *port,
                         sockaddr *local_addr, socklen_t *local_addrlen,
                         sockaddr *remote_addr, socklen_t *remote_addrlen);
 
 // 为本端创建 socket fd，并绑定到由 host & port 指定的本端地址，返回 fd，并且返回本端的 socket addr。
+// reuseport 为 true 时在 bind 之前开启 SO_REUSEPORT，以便之后可以为每个 connection 创建绑定在同一地址上的 connected socket。
 int resolve_and_bind(const char *host, const char *port,
-                     sockaddr *local_addr, socklen_t *local_addrlen);
+                     sockaddr *local_addr, socklen_t *local_addrlen,
+                     bool reuseport = false);
+
+// 创建一个开启了 SO_REUSEPORT 的 UDP socket fd，绑定到 local_addr 并 connect 到 remote_addr，返回 fd，失败时返回 -1。
+// 之后内核会直接将来自 remote_addr 的 packet 分发到该 fd 上，并缓存发送时的路由。
+int create_connected_socket(const sockaddr *local_addr, socklen_t local_addrlen,
+                            const sockaddr *remote_addr, socklen_t remote_addrlen);
 
 // 获取当前的时间戳。
 uint64_t timestamp();
 
+// event loop 时钟：每轮 event loop 迭代（或每处理完一批 packet）调用 refresh_loop_timestamp() 采样一次，
+// 其余地方调用 loop_timestamp() 读取缓存的值，避免在每个调用点都读取时钟。返回值与 timestamp() 的时间基准相同，且单调不减。
+// 处理时间较长的回调（例如 busy-poll 的 spin）应当主动调用 refresh_loop_timestamp()。
+// 缓存的值是 thread_local 的：每个运行 event loop 的线程只能读到自己线程采样的值。
+// 使用 cmake 命令选项 -DOPTION_ENABLE_TSC_CLOCK=ON 时，在支持 invariant TSC 的 x86-64 CPU 上改为读取 TSC 并换算成 ns。
+uint64_t refresh_loop_timestamp();
+uint64_t loop_timestamp();
+
+// 获取 CLOCK_REALTIME 与 CLOCK_MONOTONIC 之间的差值（ns）。
+// 内核给出的 packet 接收时刻基于 CLOCK_REALTIME，减去该差值即可转换到 timestamp() 的时间基准下。
+int64_t realtime_clock_offset();
+
 // 作为 ngtcp2_settings.log_printf 用以输出 debug logging。
 void log_printf(void *user_data, const char *fmt, ...);
 
 // 生成随机的字节数据，长度为 len，存储到 data 中。
+// 使用每个线程各自的 ChaCha20 生成器（种子来自 getrandom），可以在多个线程中同时调用，且输出不可预测，可用于 CID 与 stateless reset token。
 void rand_bytes(uint8_t *data, size_t len);
 
+// recv_packet 从 cmsg 中解析出的、随 packet 一起到达的元数据。
+struct RecvPacketInfo
+{
+    uint32_t ecn;          // IP 头部 TOS/Traffic Class 字段中的 ECN codepoint，取值同 ngtcp2_pkt_info.ecn（NGTCP2_ECN_*）
+    uint64_t rx_timestamp; // 内核收到该 packet 的时刻（SO_TIMESTAMPNS，CLOCK_REALTIME，单位 ns），0 表示不可用
+    uint32_t rxq_drops;    // SO_RXQ_OVFL：开启该选项以来 socket 因接收缓冲区溢出而被内核丢弃的 packet 累计数量，0 表示没有丢包或不可用
+};
+
 // 从 fd 接收 packet，存储到 data 中。同时返回接收到的这个 packet 的远端 socket addr。
+// 若 info 非空，则同时返回 packet 的元数据（需要事先调用 enable_recv_ecn 等函数开启对应的 cmsg）。
 ssize_t recv_packet(int fd, uint8_t *data, size_t data_size,
-                    sockaddr *remote_addr, socklen_t *remote_addrlen);
+                    sockaddr *remote_addr, socklen_t *remote_addrlen,
+                    RecvPacketInfo *info = nullptr);
+
+// send_packet 随 packet 一起交给内核的元数据。
+struct SendPacketInfo
+{
+    uint64_t txtime;  // 若非零（CLOCK_MONOTONIC，单位 ns）且 fd 已开启 SO_TXTIME，则通过 SCM_TXTIME 告知内核该 packet 的发送时刻
+    size_t gso_size;  // 若非零且小于 data_size，则 data 是一串长度为 gso_size 的 packet（最后一个可以更短），通过 UDP_SEGMENT 由内核切分
+    bool zerocopy;    // 是否使用 MSG_ZEROCOPY（fd 需已开启 SO_ZEROCOPY），此时在收到完成通知之前 data 不可被修改或释放
+};
 
 // 将 data 中的 packet 发送到 fd 中。同时传入发送 packet 的目的 socket addr。
 ssize_t send_packet(int fd, const uint8_t *data, size_t data_size,
-                    sockaddr *remote_addr, socklen_t remote_addrlen);
+                    sockaddr *remote_addr, socklen_t remote_addrlen,
+                    const SendPacketInfo *info = nullptr);
+
+// 同上，但 packet 分散在 iovcnt 个 buffer 中，由内核拼接成一个 datagram（或按照 gso_size 切分成一串 packet）。
+ssize_t send_packet(int fd, const iovec *iov, size_t iovcnt,
+                    sockaddr *remote_addr, socklen_t remote_addrlen,
+                    const SendPacketInfo *info = nullptr);
+
+// 为 fd 开启 IP_RECVTOS/IPV6_RECVTCLASS，使得 recv_packet 可以获取每个 packet 的 ECN codepoint。family 为 fd 的地址族。
+int enable_recv_ecn(int fd, int family);
+
+// 通过 IP_TOS/IPV6_TCLASS 设置 fd 之后发送的 packet 的 ECN codepoint。family 为 fd 的地址族。
+int set_send_ecn(int fd, int family, uint32_t ecn);
+
+// 通过 IP_MTU_DISCOVER/IPV6_MTU_DISCOVER 将 fd 设置为 probe 模式：所有 packet 都带上 DF 标记，且不受内核缓存的 path MTU 限制，
+// 以便 ngtcp2 自行进行 Path MTU Discovery（过大的 probe packet 会被丢弃，由 ngtcp2 当作丢包处理）。family 为 fd 的地址族。
+int enable_pmtud_probe(int fd, int family);
+
+// 为 fd 开启 SO_TIMESTAMPNS，使得 recv_packet 可以获取内核收到每个 packet 的时刻。
+int enable_rx_timestamp(int fd);
+
+// 设置 fd 的接收/发送缓冲区大小（bytes），小于等于 0 表示保持原值。
+// 优先使用 SO_RCVBUFFORCE/SO_SNDBUFFORCE（需要 CAP_NET_ADMIN 权限，可以突破 net.core.rmem_max/wmem_max 的限制），失败时退回到 SO_RCVBUF/SO_SNDBUF。
+int set_socket_buffer_size(int fd, int rcvbuf_size, int sndbuf_size);
+
+// 查询 fd 当前的接收缓冲区大小（bytes），已经除去了内核为簿记开销而加倍的部分，失败返回 -1。
+int get_recv_buffer_size(int fd);
+
+// 为 fd 开启 SO_RXQ_OVFL，使得 recv_packet 可以获取内核因接收缓冲区溢出而丢弃的 packet 累计数量。
+int enable_rxq_ovfl(int fd);
+
+// 为 fd 开启 SO_BUSY_POLL（以及 SO_PREFER_BUSY_POLL，若内核支持），使得在 fd 上非阻塞地接收数据时，内核直接轮询网卡队列 busy_poll_usec 微秒。
+int enable_socket_busy_poll(int fd, int busy_poll_usec);
+
+// 检测 fd 是否支持 UDP GSO（UDP_SEGMENT），支持返回 0，否则返回 -1。
+int probe_udp_gso(int fd);
+
+// 为 fd 开启 SO_ZEROCOPY，之后可以使用 MSG_ZEROCOPY 发送 packet。
+int enable_zerocopy(int fd);
+
+// 从 fd 的错误队列中读取一条 MSG_ZEROCOPY 完成通知：序号在 [lo, hi] 范围内的 zerocopy 发送都已完成，对应的 buffer 可以被重用。
+// copied 表示内核实际上还是进行了拷贝（例如 loopback 或网卡不支持 scatter-gather），此时 zerocopy 并无收益。
+// 返回 1 表示读到了完成通知，2 表示读到了其他消息（可以继续读），0 表示错误队列为空，-1 表示出错。
+int recv_zerocopy_completion(int fd, uint32_t *lo, uint32_t *hi, bool *copied);
+
+// 为 fd 开启 SO_TXTIME（基于 CLOCK_MONOTONIC），之后可以为每个发送的 packet 指定发送时刻。
+// 只有当网卡上配置了 fq（或 etf）qdisc 时，内核才会真正按照该时刻发送，否则时间戳会被忽略。成功返回 0，失败返回 -1。
+int enable_so_txtime(int fd);
 
 // 生成长度为 len 的随机 Connection ID，存储到 cid 中。
 int get_random_cid(ngtcp2_cid *cid, size_t len = NGTCP2_MAX_CIDLEN);